@@ -227,6 +227,7 @@ public:
       , m_client_max_window_bits_mode(mode::accept)
       , m_initialized(false)
       , m_compress_buffer_size(8192)
+      , m_compression_level(Z_DEFAULT_COMPRESSION)
     {
         m_dstate.zalloc = Z_NULL;
         m_dstate.zfree = Z_NULL;
@@ -284,7 +285,7 @@ public:
 
         int ret = deflateInit2(
             &m_dstate,
-            Z_DEFAULT_COMPRESSION,
+            m_compression_level,
             Z_DEFLATED,
             -1*deflate_bits,
             4, // memory level 1-9
@@ -327,6 +328,17 @@ public:
         return true;
     }
 
+    /// Set the zlib compression level used for outgoing messages
+    /**
+     * Must be called before the extension is initialized. Values range from
+     * 1 (fastest) to 9 (smallest); Z_DEFAULT_COMPRESSION is used by default.
+     *
+     * @param level The zlib compression level
+     */
+    void set_compression_level(int level) {
+        m_compression_level = level;
+    }
+
     /// Test if the extension was negotiated for this connection
     /**
      * Retrieves whether or not this extension is in use based on the initial
@@ -804,6 +816,7 @@ private:
     bool m_initialized;
     int m_flush;
     size_t m_compress_buffer_size;
+    int m_compression_level;
     lib::unique_ptr_uchar_array m_compress_buffer;
     lib::unique_ptr_uchar_array m_decompress_buffer;
     z_stream m_dstate;
@@ -0,0 +1,695 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+/* synthesizes a large library database using the same schema as
+LocalLibrary, then times a representative set of library queries against it
+with cold and warm page caches. results are written to stdout as json so runs
+can be compared before and after schema or index changes.
+
+usage: core_query_benchmark [--tracks N] [--iterations N] [--db path] [--reuse]
+    [--no-track-rows]
+
+"cold" runs open a new database connection for every sample, so sqlite's
+page cache starts empty; the operating system's file cache is not dropped. */
+
+#include <musikcore/db/Connection.h>
+#include <musikcore/db/Statement.h>
+#include <musikcore/db/ScopedTransaction.h>
+#include <musikcore/library/LocalLibrary.h>
+#include <musikcore/library/QueryBase.h>
+#include <musikcore/library/query/AlbumListQuery.h>
+#include <musikcore/library/query/CategoryListQuery.h>
+#include <musikcore/library/query/CategoryTrackListQuery.h>
+#include <musikcore/library/query/DirectoryListQuery.h>
+#include <musikcore/library/query/DirectoryTrackListQuery.h>
+#include <musikcore/library/query/GetPlaylistQuery.h>
+#include <musikcore/library/query/SearchTrackListQuery.h>
+#include <musikcore/library/query/TrackMetadataBatchQuery.h>
+#include <musikcore/library/query/util/TrackRowStore.h>
+#include <musikcore/runtime/MessageQueue.h>
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace musik::core;
+using namespace musik::core::db;
+using namespace musik::core::library;
+using namespace musik::core::library::query;
+
+using QueryPtr = std::shared_ptr<QueryBase>;
+using QueryFactory = std::function<QueryPtr()>;
+using Clock = std::chrono::steady_clock;
+
+namespace fs = std::filesystem;
+
+struct Options {
+    size_t tracks{ 1000000 };
+    size_t iterations{ 25 };
+    std::string database{ "musikcube-benchmark.db" };
+    bool reuse{ false };
+    bool trackRows{ true };
+};
+
+/* ids of interesting rows in the generated database, used as query inputs */
+struct Fixtures {
+    int64_t trackCount{ 0 };
+    int64_t topGenreId{ 0 };
+    int64_t topArtistId{ 0 };
+    int64_t yearValueId{ 0 };
+    int64_t largestPlaylistId{ 0 };
+    std::string artistDirectory;
+    std::vector<int64_t> trackIds;
+};
+
+static const size_t kGenreCount = 60;
+static const size_t kPlaylistCount = 25;
+static const size_t kMaxPlaylistSize = 20000;
+static const size_t kBatchSize = 500;
+
+static const char* kWords[] = {
+    "love", "night", "blue", "heart", "fire", "rain", "dance", "dream",
+    "light", "river", "summer", "ghost", "gold", "road", "city", "moon",
+    "echo", "stone", "wild", "home", "storm", "shadow", "sky", "glass"
+};
+
+static const size_t kWordCount = sizeof(kWords) / sizeof(kWords[0]);
+
+static void log(const std::string& message) {
+    std::cerr << message << "\n";
+}
+
+static std::string padded(size_t value, size_t width = 6) {
+    std::string result = std::to_string(value);
+    return std::string(width > result.size() ? width - result.size() : 0, '0') + result;
+}
+
+/* zipf-like distribution over [0, count): low indexes are much more likely */
+class Skewed {
+    public:
+        Skewed(size_t count, double exponent) {
+            std::vector<double> weights(count);
+            for (size_t i = 0; i < count; i++) {
+                weights[i] = 1.0 / std::pow((double) i + 1.0, exponent);
+            }
+            this->distribution = std::discrete_distribution<size_t>(weights.begin(), weights.end());
+        }
+
+        size_t operator()(std::mt19937_64& rng) {
+            return this->distribution(rng);
+        }
+
+    private:
+        std::discrete_distribution<size_t> distribution;
+};
+
+static int64_t insertNamed(Statement& stmt, Connection& db, const std::string& name, int64_t sortOrder) {
+    stmt.Reset();
+    stmt.BindText(0, name);
+    stmt.BindInt64(1, sortOrder);
+    stmt.Step();
+    return db.LastInsertedId();
+}
+
+static void generate(Connection& db, const Options& options) {
+    std::mt19937_64 rng(0x6d75736b);
+
+    const size_t trackCount = options.tracks;
+    const size_t artistCount = std::max((size_t) 100, trackCount / 20);
+    const size_t composerCount = std::max((size_t) 10, trackCount / 50);
+
+    LocalLibrary::CreateDatabase(db);
+    LocalLibrary::DropIndexes(db);
+
+    ScopedTransaction transaction(db);
+
+    db.Execute("INSERT INTO paths (path) VALUES ('/music/')");
+
+    log("generating genres and artists...");
+
+    std::vector<int64_t> genreIds, artistIds;
+
+    {
+        Statement genre("INSERT INTO genres (name, sort_order) VALUES (?, ?)", db);
+        for (size_t i = 0; i < kGenreCount; i++) {
+            genreIds.push_back(insertNamed(genre, db, "genre " + padded(i, 3), (int64_t) i));
+        }
+
+        Statement artist("INSERT INTO artists (name, sort_order) VALUES (?, ?)", db);
+        for (size_t i = 0; i < artistCount; i++) {
+            artistIds.push_back(insertNamed(artist, db, "artist " + padded(i), (int64_t) i));
+        }
+    }
+
+    log("generating metadata keys and values...");
+
+    /* extended metadata: a few small, skewed vocabularies plus a large one */
+    struct MetaKey {
+        std::string name;
+        std::vector<int64_t> valueIds;
+    };
+
+    std::vector<MetaKey> metaKeys = {
+        { "year", {} }, { "composer", {} }, { "encoder", {} },
+        { "bitrate", {} }, { "channels", {} }, { "comment", {} }
+    };
+
+    {
+        Statement key("INSERT INTO meta_keys (name) VALUES (?)", db);
+        Statement value("INSERT INTO meta_values (meta_key_id, sort_order, content) VALUES (?, ?, ?)", db);
+
+        auto addValues = [&](MetaKey& metaKey, size_t count, std::function<std::string(size_t)> content) {
+            key.Reset();
+            key.BindText(0, metaKey.name);
+            key.Step();
+            const int64_t keyId = db.LastInsertedId();
+            for (size_t i = 0; i < count; i++) {
+                value.Reset();
+                value.BindInt64(0, keyId);
+                value.BindInt64(1, (int64_t) i);
+                value.BindText(2, content(i));
+                value.Step();
+                metaKey.valueIds.push_back(db.LastInsertedId());
+            }
+        };
+
+        addValues(metaKeys[0], 70, [](size_t i) { return std::to_string(1955 + i); });
+        addValues(metaKeys[1], composerCount, [](size_t i) { return "composer " + padded(i); });
+        addValues(metaKeys[2], 5, [](size_t i) { return "encoder " + std::to_string(i); });
+        addValues(metaKeys[3], 6, [](size_t i) { return std::to_string(128 + i * 64); });
+        addValues(metaKeys[4], 2, [](size_t i) { return std::to_string(i + 1); });
+        addValues(metaKeys[5], trackCount / 10 + 1, [](size_t i) { return "comment " + padded(i, 7); });
+    }
+
+    log("generating albums and tracks...");
+
+    Skewed genreSkew(genreIds.size(), 1.2);
+    Skewed artistSkew(artistIds.size(), 0.8);
+    Skewed composerSkew(metaKeys[1].valueIds.size(), 1.0);
+    Skewed smallSkew(5, 1.5);
+    std::uniform_int_distribution<size_t> albumLength(6, 24);
+    std::uniform_int_distribution<size_t> wordCount(1, 4);
+    std::uniform_int_distribution<size_t> word(0, kWordCount - 1);
+    std::uniform_int_distribution<int64_t> duration(90, 600);
+    std::uniform_int_distribution<size_t> percent(0, 99);
+
+    Statement album("INSERT INTO albums (id, name, sort_order) VALUES (?, ?, ?)", db);
+    Statement directory("INSERT INTO directories (name, parent_id) VALUES (?, ?)", db);
+
+    Statement track(
+        "INSERT INTO tracks ("
+            "track, duration, filesize, visual_genre_id, visual_artist_id, "
+            "album_artist_id, path_id, directory_id, album_id, title, filename, "
+            "filetime, external_id, date_added, date_updated) "
+        "VALUES (?, ?, ?, ?, ?, ?, 1, ?, ?, ?, ?, 1, '', julianday('now'), julianday('now'))",
+        db);
+
+    Statement externalId("UPDATE tracks SET external_id=('local://' || id) WHERE id=?", db);
+    Statement trackGenre("INSERT INTO track_genres (track_id, genre_id) VALUES (?, ?)", db);
+    Statement trackArtist("INSERT INTO track_artists (track_id, artist_id) VALUES (?, ?)", db);
+    Statement trackMeta("INSERT INTO track_meta (track_id, meta_value_id) VALUES (?, ?)", db);
+
+    auto addTrackMeta = [&](int64_t trackId, int64_t valueId) {
+        trackMeta.Reset();
+        trackMeta.BindInt64(0, trackId);
+        trackMeta.BindInt64(1, valueId);
+        trackMeta.Step();
+    };
+
+    /* directories are linked into a hierarchy with track counts, the way
+    the indexer maintains them: "/" -> "/music/" -> artist -> album */
+    std::map<std::string, int64_t> directoryIds;
+    std::map<int64_t, std::pair<int64_t, int64_t>> directoryCounts; /* direct, total */
+
+    auto addDirectory = [&](const std::string& name, int64_t parentId) {
+        auto it = directoryIds.find(name);
+        if (it != directoryIds.end()) {
+            return it->second;
+        }
+        directory.Reset();
+        directory.BindText(0, name);
+        directory.BindInt64(1, parentId);
+        directory.Step();
+        return directoryIds[name] = db.LastInsertedId();
+    };
+
+    const int64_t rootDirectoryId = addDirectory("/", 0);
+    const int64_t musicDirectoryId = addDirectory("/music/", rootDirectoryId);
+
+    size_t generated = 0;
+    int64_t albumId = 0;
+
+    while (generated < trackCount) {
+        ++albumId;
+        const size_t artistIndex = artistSkew(rng);
+        const int64_t artistId = artistIds[artistIndex];
+        const int64_t genreId = genreIds[genreSkew(rng)];
+        const int64_t yearId = metaKeys[0].valueIds[(size_t) albumId % metaKeys[0].valueIds.size()];
+        const std::string albumName = "album " + padded((size_t) albumId);
+        const std::string artistDirectoryName = "/music/artist " + padded(artistIndex) + "/";
+        const std::string directoryName = artistDirectoryName + albumName + "/";
+
+        album.Reset();
+        album.BindInt64(0, albumId);
+        album.BindText(1, albumName);
+        album.BindInt64(2, albumId);
+        album.Step();
+
+        const int64_t artistDirectoryId = addDirectory(artistDirectoryName, musicDirectoryId);
+        const int64_t directoryId = addDirectory(directoryName, artistDirectoryId);
+
+        const size_t length = std::min(albumLength(rng), trackCount - generated);
+        directoryCounts[directoryId].first += (int64_t) length;
+        for (int64_t id : { directoryId, artistDirectoryId, musicDirectoryId, rootDirectoryId }) {
+            directoryCounts[id].second += (int64_t) length;
+        }
+        for (size_t i = 0; i < length; i++) {
+            std::string title;
+            const size_t words = wordCount(rng);
+            for (size_t w = 0; w < words; w++) {
+                title += (w ? " " : "") + std::string(kWords[word(rng)]);
+            }
+
+            track.Reset();
+            track.BindInt64(0, (int64_t) i + 1);
+            track.BindInt64(1, duration(rng));
+            track.BindInt64(2, 4000000 + (int64_t) percent(rng) * 100000);
+            track.BindInt64(3, genreId);
+            track.BindInt64(4, artistId);
+            track.BindInt64(5, artistId);
+            track.BindInt64(6, directoryId);
+            track.BindInt64(7, albumId);
+            track.BindText(8, title);
+            track.BindText(9, directoryName + padded(i + 1, 2) + " " + title + ".flac");
+            track.Step();
+            const int64_t trackId = db.LastInsertedId();
+
+            externalId.Reset();
+            externalId.BindInt64(0, trackId);
+            externalId.Step();
+
+            trackGenre.Reset();
+            trackGenre.BindInt64(0, trackId);
+            trackGenre.BindInt64(1, genreId);
+            trackGenre.Step();
+
+            trackArtist.Reset();
+            trackArtist.BindInt64(0, trackId);
+            trackArtist.BindInt64(1, artistId);
+            trackArtist.Step();
+
+            /* ~10% of tracks have a featured artist */
+            if (percent(rng) < 10) {
+                trackArtist.Reset();
+                trackArtist.BindInt64(0, trackId);
+                trackArtist.BindInt64(1, artistIds[artistSkew(rng)]);
+                trackArtist.Step();
+            }
+
+            addTrackMeta(trackId, yearId);
+            addTrackMeta(trackId, metaKeys[1].valueIds[composerSkew(rng)]);
+            addTrackMeta(trackId, metaKeys[2].valueIds[smallSkew(rng)]);
+            addTrackMeta(trackId, metaKeys[3].valueIds[smallSkew(rng)]);
+            addTrackMeta(trackId, metaKeys[4].valueIds[percent(rng) < 95 ? 1 : 0]);
+            addTrackMeta(trackId, metaKeys[5].valueIds[generated / 10]);
+
+            ++generated;
+        }
+
+        if (albumId % 5000 == 0) {
+            log("  " + std::to_string(generated) + " tracks");
+            transaction.CommitAndRestart();
+        }
+    }
+
+    {
+        Statement counts(
+            "UPDATE directories SET track_count=?, total_track_count=? WHERE id=?", db);
+        for (auto& it : directoryCounts) {
+            counts.Reset();
+            counts.BindInt64(0, it.second.first);
+            counts.BindInt64(1, it.second.second);
+            counts.BindInt64(2, it.first);
+            counts.Step();
+        }
+    }
+
+    log("generating playlists...");
+
+    {
+        Statement playlist("INSERT INTO playlists (name) VALUES (?)", db);
+        Statement entry(
+            "INSERT INTO playlist_tracks (playlist_id, track_external_id, source_id, sort_order) "
+            "VALUES (?, ?, 0, ?)",
+            db);
+
+        std::uniform_int_distribution<size_t> anyTrack(1, trackCount);
+        for (size_t i = 0; i < kPlaylistCount; i++) {
+            playlist.Reset();
+            playlist.BindText(0, "playlist " + padded(i, 2));
+            playlist.Step();
+            const int64_t playlistId = db.LastInsertedId();
+            const size_t size = std::min(trackCount, kMaxPlaylistSize / (i + 1));
+            for (size_t j = 0; j < size; j++) {
+                entry.Reset();
+                entry.BindInt64(0, playlistId);
+                entry.BindText(1, "local://" + std::to_string(anyTrack(rng)));
+                entry.BindInt64(2, (int64_t) j * 1024);
+                entry.Step();
+            }
+        }
+    }
+
+    transaction.CommitAndRestart();
+
+    log("creating indexes...");
+    LocalLibrary::CreateIndexes(db);
+
+    /* the indexer does this at the end of every sync; without it track
+    metadata lookups measure the fallback join */
+    if (options.trackRows) {
+        log("building track rows...");
+        trackrows::Sync(db);
+    }
+
+    db.Execute("ANALYZE");
+}
+
+static Fixtures loadFixtures(Connection& db) {
+    Fixtures fixtures;
+
+    auto scalar = [&db](const char* sql) -> int64_t {
+        Statement stmt(sql, db);
+        return stmt.Step() == db::Row ? stmt.ColumnInt64(0) : 0;
+    };
+
+    fixtures.topGenreId = scalar(
+        "SELECT genre_id FROM track_genres GROUP BY genre_id ORDER BY COUNT(*) DESC LIMIT 1");
+    fixtures.topArtistId = scalar(
+        "SELECT visual_artist_id FROM tracks WHERE visual_genre_id=("
+            "SELECT genre_id FROM track_genres GROUP BY genre_id ORDER BY COUNT(*) DESC LIMIT 1) "
+        "GROUP BY visual_artist_id ORDER BY COUNT(*) DESC LIMIT 1");
+    fixtures.yearValueId = scalar(
+        "SELECT mv.id FROM meta_values mv, meta_keys mk "
+        "WHERE mv.meta_key_id=mk.id AND mk.name='year' ORDER BY mv.id LIMIT 1 OFFSET 40");
+    fixtures.largestPlaylistId = scalar(
+        "SELECT playlist_id FROM playlist_tracks GROUP BY playlist_id ORDER BY COUNT(*) DESC LIMIT 1");
+
+    {
+        /* the parent of one of the top artist's album directories */
+        Statement stmt(
+            "SELECT p.name FROM directories d, directories p, tracks t "
+            "WHERE t.directory_id=d.id AND d.parent_id=p.id AND t.visual_artist_id=? LIMIT 1",
+            db);
+        stmt.BindInt64(0, fixtures.topArtistId);
+        if (stmt.Step() == db::Row) {
+            fixtures.artistDirectory = stmt.ColumnText(0);
+        }
+    }
+
+    {
+        const int64_t count = scalar("SELECT COUNT(*) FROM tracks");
+        fixtures.trackCount = count;
+        std::mt19937_64 rng(42);
+        std::uniform_int_distribution<int64_t> anyTrack(1, std::max((int64_t) 1, count));
+        for (size_t i = 0; i < kBatchSize; i++) {
+            fixtures.trackIds.push_back(anyTrack(rng));
+        }
+    }
+
+    return fixtures;
+}
+
+/* queries are run directly against the benchmark's own connection; they
+only use their library to stamp results with its id. a LocalLibrary would open
+the user's database and start an indexer, so this minimal stand-in is used. */
+class BenchmarkLibrary : public ILibrary {
+    public:
+        int Enqueue(QueryPtr query, Callback cb) override { return -1; }
+        int EnqueueAndWait(QueryPtr query, size_t timeoutMs, Callback cb) override { return -1; }
+        IIndexer* Indexer() override { return nullptr; }
+        int Id() override { return 0; }
+        const std::string& Name() override { return this->name; }
+        void SetMessageQueue(runtime::IMessageQueue& queue) override { }
+        runtime::IMessageQueue& GetMessageQueue() override { return this->messageQueue; }
+        IResourceLocator& GetResourceLocator() override { return this->resourceLocator; }
+        bool IsConfigured() override { return true; }
+        ConnectionState GetConnectionState() const override { return ConnectionState::Connected; }
+        Type GetType() const override { return Type::Local; }
+        void Close() override { }
+
+    private:
+        class ResourceLocator : public IResourceLocator {
+            public:
+                std::string GetTrackUri(sdk::ITrack* track, const std::string& defaultUri) override {
+                    return defaultUri;
+                }
+        };
+
+        std::string name{ "benchmark" };
+        runtime::MessageQueue messageQueue;
+        ResourceLocator resourceLocator;
+};
+
+static std::vector<std::pair<std::string, QueryFactory>> benchmarks(const Fixtures& f) {
+    using MatchType = QueryBase::MatchType;
+    using PredicateList = category::PredicateList;
+    using Predicate = category::Predicate;
+    ILibraryPtr library = std::make_shared<BenchmarkLibrary>();
+
+    return {
+        { "CategoryListQuery/artist", [=]() {
+            return std::make_shared<CategoryListQuery>(MatchType::Substring, "artist"); } },
+        { "CategoryListQuery/album_filtered", [=]() {
+            return std::make_shared<CategoryListQuery>(MatchType::Substring, "album", "album 01"); } },
+        { "CategoryListQuery/artist_by_genre", [=]() {
+            return std::make_shared<CategoryListQuery>(
+                MatchType::Substring, "artist", Predicate{ "genre", f.topGenreId }); } },
+        { "CategoryListQuery/composer_by_genre", [=]() {
+            return std::make_shared<CategoryListQuery>(
+                MatchType::Substring, "composer", Predicate{ "genre", f.topGenreId }); } },
+        { "CategoryListQuery/playlists", [=]() {
+            return std::make_shared<CategoryListQuery>(MatchType::Substring, "playlists"); } },
+        { "CategoryTrackListQuery/genre", [=]() {
+            return std::make_shared<CategoryTrackListQuery>(
+                library, Predicate{ "genre", f.topGenreId }); } },
+        { "CategoryTrackListQuery/genre_artist", [=]() {
+            return std::make_shared<CategoryTrackListQuery>(
+                library, PredicateList{ { "genre", f.topGenreId }, { "artist", f.topArtistId } }); } },
+        { "CategoryTrackListQuery/genre_year", [=]() {
+            return std::make_shared<CategoryTrackListQuery>(
+                library, PredicateList{ { "genre", f.topGenreId }, { "year", f.yearValueId } }); } },
+        { "CategoryTrackListQuery/genre_filtered", [=]() {
+            return std::make_shared<CategoryTrackListQuery>(
+                library, Predicate{ "genre", f.topGenreId }, "love"); } },
+        { "SearchTrackListQuery/like", [=]() {
+            return std::make_shared<SearchTrackListQuery>(
+                library, MatchType::Substring, "night river", TrackSortType::Album); } },
+        { "SearchTrackListQuery/regexp", [=]() {
+            return std::make_shared<SearchTrackListQuery>(
+                library, MatchType::Regex, "^(lo|he).*t$", TrackSortType::Album); } },
+        { "AlbumListQuery/all", [=]() {
+            return std::make_shared<AlbumListQuery>(); } },
+        { "AlbumListQuery/genre", [=]() {
+            return std::make_shared<AlbumListQuery>(Predicate{ "genre", f.topGenreId }); } },
+        { "TrackMetadataBatchQuery/500", [=]() {
+            return std::make_shared<TrackMetadataBatchQuery>(
+                std::unordered_set<int64_t>(f.trackIds.begin(), f.trackIds.end()), library); } },
+        { "DirectoryTrackListQuery/artist", [=]() {
+            return std::make_shared<DirectoryTrackListQuery>(library, f.artistDirectory); } },
+        { "DirectoryListQuery/music", [=]() {
+            return std::make_shared<DirectoryListQuery>("/music/"); } },
+        { "GetPlaylistQuery/largest", [=]() {
+            return std::make_shared<GetPlaylistQuery>(library, f.largestPlaylistId); } },
+        { "CategoryTrackListQuery/playlist", [=]() {
+            return std::make_shared<CategoryTrackListQuery>(
+                library, Predicate{ "playlists", f.largestPlaylistId }); } },
+    };
+}
+
+static double run(Connection& db, const QueryFactory& factory, bool& failed) {
+    auto query = factory();
+    const auto start = Clock::now();
+    query->Run(db);
+    const auto end = Clock::now();
+    failed = failed || query->GetStatus() != IQuery::Finished;
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static nlohmann::json summarize(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+
+    auto percentile = [&samples](double p) {
+        const size_t index = (size_t) std::ceil(p * (double) samples.size());
+        return samples[std::min(samples.size() - 1, index > 0 ? index - 1 : 0)];
+    };
+
+    double total = 0.0;
+    for (auto s : samples) {
+        total += s;
+    }
+
+    return {
+        { "samples", samples.size() },
+        { "min_ms", samples.front() },
+        { "mean_ms", total / (double) samples.size() },
+        { "p50_ms", percentile(0.50) },
+        { "p90_ms", percentile(0.90) },
+        { "p99_ms", percentile(0.99) },
+        { "max_ms", samples.back() }
+    };
+}
+
+static void printHelp() {
+    std::cerr
+        << "usage: core_query_benchmark [options]\n\n"
+        << "  --tracks N       number of tracks to generate (default 1000000)\n"
+        << "  --iterations N   samples per query and cache mode (default 25)\n"
+        << "  --db PATH        database file (default musikcube-benchmark.db)\n"
+        << "  --reuse          use an existing database instead of regenerating\n"
+        << "  --no-track-rows  don't build track rows, to measure uncached metadata lookups\n";
+}
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--tracks" && hasValue) {
+            options.tracks = std::max((size_t) 1, (size_t) std::stoull(argv[++i]));
+        }
+        else if (arg == "--iterations" && hasValue) {
+            options.iterations = std::max((size_t) 1, (size_t) std::stoull(argv[++i]));
+        }
+        else if (arg == "--db" && hasValue) {
+            options.database = argv[++i];
+        }
+        else if (arg == "--reuse") {
+            options.reuse = true;
+        }
+        else if (arg == "--no-track-rows") {
+            options.trackRows = false;
+        }
+        else {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+
+    if (!parseOptions(argc, argv, options)) {
+        printHelp();
+        return 1;
+    }
+
+    const bool exists = fs::exists(fs::u8path(options.database));
+
+    if (!options.reuse || !exists) {
+        if (exists) {
+            fs::remove(fs::u8path(options.database));
+        }
+
+        log("generating " + std::to_string(options.tracks) + " tracks in " + options.database);
+        const auto start = Clock::now();
+        Connection db;
+        db.Open(options.database);
+        generate(db, options);
+        const auto elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        log("generated in " + std::to_string(elapsed) + "s");
+    }
+
+    Fixtures fixtures;
+    {
+        Connection db;
+        db.Open(options.database);
+        fixtures = loadFixtures(db);
+    }
+
+    nlohmann::json results = nlohmann::json::array();
+
+    for (auto& benchmark : benchmarks(fixtures)) {
+        const auto& name = benchmark.first;
+        const auto& factory = benchmark.second;
+        bool failed = false;
+
+        log("running " + name + "...");
+
+        std::vector<double> cold;
+        for (size_t i = 0; i < options.iterations; i++) {
+            Connection db;
+            db.Open(options.database);
+            cold.push_back(run(db, factory, failed));
+        }
+
+        std::vector<double> warm;
+        {
+            Connection db;
+            db.Open(options.database);
+            run(db, factory, failed); /* prime the cache */
+            for (size_t i = 0; i < options.iterations; i++) {
+                warm.push_back(run(db, factory, failed));
+            }
+        }
+
+        results.push_back({
+            { "query", name },
+            { "failed", failed },
+            { "cold", summarize(cold) },
+            { "warm", summarize(warm) }
+        });
+    }
+
+    nlohmann::json output = {
+        { "database", options.database },
+        { "tracks", fixtures.trackCount },
+        { "iterations", options.iterations },
+        { "results", results }
+    };
+
+    std::cout << output.dump(2) << "\n";
+
+    return 0;
+}
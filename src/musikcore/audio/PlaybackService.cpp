@@ -149,7 +149,6 @@ PlaybackService::PlaybackService(
 : library(library)
 , transport(transport)
 , playlist(library)
-, unshuffled(library)
 , repeatMode(RepeatMode::None)
 , messageQueue(messageQueue)
 , timeChangeMode(TimeChangeMode::Seek)
@@ -268,34 +267,20 @@ void PlaybackService::SetTimeChangeMode(TimeChangeMode mode) noexcept {
 void PlaybackService::ToggleShuffle() {
     std::unique_lock<std::recursive_mutex> lock(this->playlistMutex);
 
-    /* remember the ID of the playing track -- we're going to need to look
-    it up after the shuffle */
-    int64_t id = -1;
-    if (this->index < this->playlist.Count()) {
-        id = this->playlist.GetId(this->index);
-    }
-
+    /* the playlist shuffles as a view over its ids, so there's nothing to
+    copy or reorder here; we just need to translate the playback index */
     this->playlist.ClearCache();
-    this->unshuffled.ClearCache();
-    bool shuffled = false;
 
-    if (this->unshuffled.Count() > 0) { /* shuffled -> unshuffled */
-        this->playlist.Clear();
-        this->playlist.Swap(this->unshuffled);
-    }
-    else { /* unshuffled -> shuffle */
-        this->unshuffled.CopyFrom(this->playlist);
-        this->playlist.Shuffle();
-        shuffled = true;
-    }
+    const size_t index = this->playlist.IsShuffled()
+        ? this->playlist.ExitShuffledMode(this->index)
+        : this->playlist.EnterShuffledMode(this->index);
 
-    /* find the new playback index and prefetch the next track */
-    if (id != -1) {
-        const int index = this->playlist.IndexOf(id);
-        if (index != -1) {
-            this->index = index;
-            POST(this, MESSAGE_PREPARE_NEXT_TRACK, NO_POSITION, 0);
-        }
+    const bool shuffled = this->playlist.IsShuffled();
+
+    /* update the playback index and prefetch the next track */
+    if (this->index < this->playlist.Count()) {
+        this->index = index;
+        POST(this, MESSAGE_PREPARE_NEXT_TRACK, NO_POSITION, 0);
     }
 
     POST(this, MESSAGE_SHUFFLED, shuffled ? 1 : 0, 0);
@@ -594,7 +579,7 @@ bool PlaybackService::Previous() {
 
 bool PlaybackService::IsShuffled() {
     std::unique_lock<std::recursive_mutex> lock(this->playlistMutex);
-    return this->unshuffled.Count() > 0;
+    return this->playlist.IsShuffled();
 }
 
 size_t PlaybackService::Count() {
@@ -651,7 +636,6 @@ bool PlaybackService::HotSwap(const TrackList& tracks, size_t index) {
         TrackList temp(this->library);
         temp.CopyFrom(tracks);
         this->playlist.Swap(temp);
-        this->unshuffled.Clear();
         this->index = found ? index : NO_POSITION;
         this->nextIndex = NO_POSITION;
     }
@@ -673,7 +657,6 @@ void PlaybackService::Play(const TrackList& tracks, size_t index) {
             TrackList temp(this->library);
             temp.CopyFrom(tracks);
             this->playlist.Swap(temp);
-            this->unshuffled.Clear();
         }
     }
 
@@ -699,7 +682,6 @@ void PlaybackService::Play(const musik::core::sdk::ITrackList* source, size_t in
             std::unique_lock<std::recursive_mutex> lock(this->playlistMutex);
             if (source != &playlist) {
                 this->CopyFrom(source);
-                this->unshuffled.Clear();
             }
         }
 
@@ -972,7 +954,6 @@ void PlaybackService::OnTimeChanged(double time) {
 void PlaybackService::OnIndexerFinished(int trackCount) {
     std::unique_lock<std::recursive_mutex> lock(this->playlistMutex);
     this->playlist.ClearCache();
-    this->unshuffled.ClearCache();
 }
 
 /* our Editor interface. we proxy all of the ITrackListEditor methods so we
@@ -1113,7 +1094,6 @@ void PlaybackService::Editor::Add(const int64_t id) {
 
 void PlaybackService::Editor::Clear() {
     playback.playlist.Clear();
-    playback.unshuffled.Clear();
     this->playIndex = -1;
     this->nextTrackInvalidated = true;
     this->edited = true;
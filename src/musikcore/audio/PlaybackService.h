@@ -198,7 +198,6 @@ namespace musik { namespace core { namespace audio {
             musik::core::audio::ITransport::Gain GainAtIndex(size_t index);
 
             musik::core::TrackList playlist;
-            musik::core::TrackList unshuffled;
             std::recursive_mutex playlistMutex;
 
             std::vector<std::shared_ptr<musik::core::sdk::IPlaybackRemote>> remotes;
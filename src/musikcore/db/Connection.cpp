@@ -43,11 +43,14 @@
 
 static std::mutex globalMutex;
 
+static const size_t kMaxCapturedStatements = 16;
+
 using namespace musik::core::db;
 
 Connection::Connection() noexcept
 : connection(nullptr)
-, transactionCounter(0) {
+, transactionCounter(0)
+, captureStatements(false) {
     this->UpdateReferenceCount(true);
 }
 
@@ -93,6 +96,8 @@ int Connection::Execute(const char* sql) {
             sqlite3_finalize(stmt);
             return Error;
         }
+
+        this->CaptureStatement(sql);
     }
 
     const int error = this->StepStatement(stmt);
@@ -171,6 +176,35 @@ void Connection::UpdateReferenceCount(bool init) {
     }
 }
 
+void Connection::SetStatementCaptureEnabled(bool enabled) {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->captureStatements = enabled;
+    if (!enabled) {
+        this->capturedStatements.clear();
+    }
+}
+
+std::vector<std::string> Connection::TakeCapturedStatements() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    std::vector<std::string> result;
+    result.swap(this->capturedStatements);
+    return result;
+}
+
+void Connection::CaptureStatement(const char* sql) {
+    /* note: called with `mutex` held */
+    if (this->captureStatements && sql &&
+        this->capturedStatements.size() < kMaxCapturedStatements)
+    {
+        for (auto& existing : this->capturedStatements) {
+            if (existing == sql) {
+                return;
+            }
+        }
+        this->capturedStatements.push_back(sql);
+    }
+}
+
 int Connection::StepStatement(sqlite3_stmt *stmt) noexcept {
     return sqlite3_step(stmt);
 }
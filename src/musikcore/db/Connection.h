@@ -40,6 +40,8 @@
 
 #include <map>
 #include <mutex>
+#include <string>
+#include <vector>
 
 struct sqlite3;
 struct sqlite3_stmt;
@@ -71,10 +73,17 @@ namespace musik { namespace core { namespace db {
             void Interrupt();
             void Checkpoint() noexcept;
 
+            /* when enabled, the SQL of each statement prepared against this
+            connection is remembered (up to a small limit, duplicates ignored)
+            so it can be inspected after the fact; e.g. with EXPLAIN QUERY PLAN. */
+            void SetStatementCaptureEnabled(bool enabled);
+            std::vector<std::string> TakeCapturedStatements();
+
         private:
             void Initialize(unsigned int cache);
             void UpdateReferenceCount(bool init);
             int StepStatement(sqlite3_stmt *stmt) noexcept;
+            void CaptureStatement(const char* sql);
 
             friend class Statement;
             friend class ScopedTransaction;
@@ -82,6 +91,8 @@ namespace musik { namespace core { namespace db {
             int transactionCounter;
             sqlite3 *connection;
             std::mutex mutex;
+            bool captureStatements;
+            std::vector<std::string> capturedStatements;
     };
 
 } } }
@@ -49,6 +49,7 @@ Statement::Statement(const char* sql, Connection &connection) noexcept
 , modifiedRows(0) {
     std::unique_lock<std::mutex> lock(connection.mutex);
     sqlite3_prepare_v2(this->connection->connection, sql, -1, &this->stmt, nullptr);
+    connection.CaptureStatement(sql);
 }
 
 Statement::Statement(Connection &connection) noexcept
@@ -95,6 +96,10 @@ void Statement::BindFloat(int position, float bindFloat) noexcept {
     sqlite3_bind_double(this->stmt, position + 1, bindFloat);
 }
 
+void Statement::BindDouble(int position, double bindDouble) noexcept {
+    sqlite3_bind_double(this->stmt, position + 1, bindDouble);
+}
+
 void Statement::BindText(int position, const std::string& bindText) {
     std::string sanitized;
     utf8::replace_invalid(
@@ -114,6 +119,14 @@ void Statement::BindNull(int position) noexcept {
     sqlite3_bind_null(this->stmt, position + 1);
 }
 
+void Statement::BindBlob(int position, const void* data, size_t size) noexcept {
+    sqlite3_bind_blob64(
+        this->stmt, position + 1,
+        data,
+        static_cast<sqlite3_uint64>(size),
+        SQLITE_TRANSIENT);
+}
+
 const int Statement::ColumnInt32(int column) noexcept {
     return sqlite3_column_int(this->stmt, column);
 }
@@ -126,11 +139,35 @@ const float Statement::ColumnFloat(int column) noexcept {
     return static_cast<float>(sqlite3_column_double(this->stmt, column));
 }
 
+const double Statement::ColumnDouble(int column) noexcept {
+    return sqlite3_column_double(this->stmt, column);
+}
+
 const char* Statement::ColumnText(int column) noexcept {
     const char* text = reinterpret_cast<const char*>(sqlite3_column_text(this->stmt, column));
     return text ? text : "";
 }
 
+const void* Statement::ColumnBlob(int column, size_t& size) noexcept {
+    /* note: sqlite3_column_blob() must be called before sqlite3_column_bytes() */
+    const void* data = sqlite3_column_blob(this->stmt, column);
+    size = data ? static_cast<size_t>(sqlite3_column_bytes(this->stmt, column)) : 0;
+    return data;
+}
+
 const bool Statement::IsNull(int column) noexcept {
     return sqlite3_column_type(this->stmt, column) == SQLITE_NULL;
 }
+
+const int Statement::ColumnCount() noexcept {
+    return sqlite3_column_count(this->stmt);
+}
+
+const char* Statement::ColumnName(int column) noexcept {
+    const char* name = sqlite3_column_name(this->stmt, column);
+    return name ? name : "";
+}
+
+const ColumnType Statement::GetColumnType(int column) noexcept {
+    return static_cast<ColumnType>(sqlite3_column_type(this->stmt, column));
+}
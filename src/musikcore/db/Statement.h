@@ -43,6 +43,15 @@ namespace musik { namespace core { namespace db {
 
     class Connection;
 
+    /* values match the SQLITE_INTEGER, SQLITE_FLOAT, etc. constants */
+    typedef enum {
+        IntegerColumn = 1,
+        FloatColumn = 2,
+        TextColumn = 3,
+        BlobColumn = 4,
+        NullColumn = 5
+    } ColumnType;
+
     class Statement {
         public:
             DELETE_CLASS_DEFAULTS(Statement)
@@ -53,15 +62,23 @@ namespace musik { namespace core { namespace db {
             void BindInt32(int position, int bindInt) noexcept;
             void BindInt64(int position, int64_t bindInt) noexcept;
             void BindFloat(int position, float bindFloat) noexcept;
+            void BindDouble(int position, double bindDouble) noexcept;
             void BindText(int position, const std::string& bindText);
             void BindNull(int position) noexcept;
+            void BindBlob(int position, const void* data, size_t size) noexcept;
 
             const int ColumnInt32(int column) noexcept;
             const int64_t ColumnInt64(int column) noexcept;
             const float ColumnFloat(int column) noexcept;
+            const double ColumnDouble(int column) noexcept;
             const char* ColumnText(int column) noexcept;
+            const void* ColumnBlob(int column, size_t& size) noexcept;
             const bool IsNull(int column) noexcept;
 
+            const int ColumnCount() noexcept;
+            const char* ColumnName(int column) noexcept;
+            const ColumnType GetColumnType(int column) noexcept;
+
             int Step();
 
             void Reset() noexcept;
@@ -62,6 +62,11 @@ namespace musik { namespace core { namespace db {
             virtual int GetId() = 0;
             virtual int GetOptions() = 0;
             virtual std::string Name() = 0;
+
+            /* returns true if the query modifies the library (e.g. playlists,
+            ratings, play counts); results of these queries must never be
+            cached or shared. */
+            virtual bool IsMutating() = 0;
     };
 
     class ISerializableQuery: public IQuery {
@@ -73,6 +78,11 @@ namespace musik { namespace core { namespace db {
             virtual std::string SerializeQuery() = 0;
             virtual std::string SerializeResult() = 0;
             virtual void DeserializeResult(const std::string& data) = 0;
+            /* optional compact binary result encoding, see query/util/Serialization.h.
+            SerializeResultBinary() returns false if the query doesn't support it,
+            in which case callers should fall back to SerializeResult() */
+            virtual bool SerializeResultBinary(std::string& output) = 0;
+            virtual void DeserializeResultBinary(const std::string& data) = 0;
             virtual void Invalidate() = 0;
     };
 
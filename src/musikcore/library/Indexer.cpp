@@ -42,6 +42,9 @@
 #include <musikcore/library/track/IndexerTrack.h>
 #include <musikcore/library/track/LibraryTrack.h>
 #include <musikcore/library/query/TrackMetadataQuery.h>
+#include <musikcore/library/query/util/PlaylistQueryUtil.h>
+#include <musikcore/library/query/util/ChangeLog.h>
+#include <musikcore/library/query/util/TrackRowStore.h>
 #include <musikcore/library/LocalLibraryConstants.h>
 #include <musikcore/library/LibraryFactory.h>
 #include <musikcore/db/Connection.h>
@@ -59,6 +62,7 @@
 #include <algorithm>
 #include <atomic>
 #include <functional>
+#include <unordered_map>
 
 #define STRESS_TEST_DB 0
 
@@ -111,6 +115,20 @@ static std::string normalizePath(const std::string& path) {
     return std::fs::path(std::fs::u8path(path)).make_preferred().u8string();
 }
 
+/* returns the parent of a directory formatted by NormalizeDir(), or an
+empty string if the directory is a root. */
+static std::string parentDirectory(std::string dir) {
+    const char sep = std::fs::path::preferred_separator;
+    while (dir.size() > 1 && dir.back() == sep) {
+        dir.pop_back();
+    }
+    const std::string parent = std::fs::u8path(dir).parent_path().u8string();
+    if (parent.empty() || parent == dir) {
+        return "";
+    }
+    return NormalizeDir(parent);
+}
+
 Indexer::Indexer(const std::string& libraryPath, const std::string& dbFilename)
 : thread(nullptr)
 , incrementalUrisScanned(0)
@@ -340,6 +358,13 @@ void Indexer::FinalizeSync(const SyncContext& context) {
         this->SyncCleanup();
     }
 
+    /* rebuild the directory hierarchy used for browsing */
+    musik::debug::info(TAG, "updating directories");
+
+    if (!this->Bail()) {
+        this->SyncDirectories();
+    }
+
     /* optimize and sort */
     musik::debug::info(TAG, "optimizing");
 
@@ -347,6 +372,21 @@ void Indexer::FinalizeSync(const SyncContext& context) {
         this->SyncOptimize();
     }
 
+    /* build denormalized records for new and changed tracks */
+    if (!this->Bail()) {
+        musik::debug::info(TAG, "updating track records");
+        const size_t updated = library::query::trackrows::Sync(this->dbConnection);
+        musik::debug::info(TAG, "updated " + std::to_string(updated) + " track records");
+    }
+
+    /* forget about the oldest deleted rows; see ChangeLog */
+    if (!this->Bail()) {
+        const size_t pruned = library::query::changelog::Prune(this->dbConnection);
+        if (pruned) {
+            musik::debug::info(TAG, "pruned " + std::to_string(pruned) + " change log entries");
+        }
+    }
+
     /* run analyzers. */
     this->RunAnalyzers();
 
@@ -725,9 +765,9 @@ void Indexer::SyncCleanup() {
     this->dbConnection.Execute("DELETE FROM meta_values WHERE id NOT IN (SELECT DISTINCT(meta_value_id) FROM track_meta)");
     this->dbConnection.Execute("DELETE FROM meta_keys WHERE id NOT IN (SELECT DISTINCT(meta_key_id) FROM meta_values)");
 
-    /* orphaned replay gain and directories */
+    /* orphaned replay gain. note: orphaned directories are removed by
+    SyncDirectories() because parents of directories with tracks are kept */
     this->dbConnection.Execute("DELETE FROM replay_gain WHERE track_id NOT IN (SELECT id FROM tracks)");
-    this->dbConnection.Execute("DELETE FROM directories WHERE id NOT IN (SELECT DISTINCT directory_id FROM tracks)");
 
     /* NOTE: we used to remove orphaned local library tracks here, but we don't anymore because
     the indexer generates stable external ids by hashing various file and metadata fields */
@@ -757,47 +797,28 @@ void Indexer::SyncCleanup() {
 }
 
 void Indexer::SyncPlaylistTracksOrder() {
-    /* make sure playlist sort orders are always sequential without holes. we
-    do this anyway, as playlists are updated, but there's no way to guarantee
-    it stays this way -- plugins, external processes, etc can cause problems */
-
-    db::Statement playlists(
-        "SELECT DISTINCT id FROM playlists",
-        this->dbConnection);
+    /* playlist sort orders are sparse (see PlaylistQueryUtil.h), so holes are
+    expected and harmless. duplicates are not: plugins, external processes,
+    etc can leave rows that compare equal, which makes positional edits
+    ambiguous. only compact the playlists that need it. */
 
-    db::Statement tracks(
-        "SELECT track_external_id, sort_order "
-        "FROM playlist_tracks WHERE playlist_id=? "
-        "ORDER BY sort_order",
-        this->dbConnection);
-
-    db::Statement update(
-        "UPDATE playlist_tracks "
-        "SET sort_order=? "
-        "WHERE track_external_id=? AND sort_order=?",
-        this->dbConnection);
-
-    struct Record { std::string id; int order; };
+    std::vector<int64_t> playlistIds;
 
-    while (playlists.Step() == db::Row) {
-        tracks.ResetAndUnbind();
-        tracks.BindInt64(0, playlists.ColumnInt64(0));
+    {
+        db::Statement duplicates(
+            "SELECT DISTINCT playlist_id "
+            "FROM playlist_tracks "
+            "GROUP BY playlist_id, sort_order "
+            "HAVING COUNT(*) > 1",
+            this->dbConnection);
 
-        /* gotta cache these in memory because we can't update the
-        table at the same time we're iterating */
-        std::vector<Record> records;
-        while (tracks.Step() == db::Row) {
-            records.push_back({ tracks.ColumnText(0), tracks.ColumnInt32(1) });
+        while (duplicates.Step() == db::Row) {
+            playlistIds.push_back(duplicates.ColumnInt64(0));
         }
+    }
 
-        int order = 0;
-        for (auto& r : records) {
-            update.ResetAndUnbind();
-            update.BindInt32(0, order++);
-            update.BindText(1, r.id);
-            update.BindInt32(2, r.order);
-            update.Step();
-        }
+    for (auto id : playlistIds) {
+        playlist::Compact(this->dbConnection, id);
     }
 }
 
@@ -864,6 +885,124 @@ void Indexer::SyncOptimize() {
     optimize(this->dbConnection, "content", "meta_values");
 }
 
+void Indexer::SyncDirectories() {
+    /* IndexerTrack adds a row for each directory that contains a track. here
+    we make sure all ancestors of those directories exist too, link each one
+    to its parent, and update the track counts, so directories can be browsed
+    without touching the filesystem. */
+    struct Directory {
+        int64_t id, parentId, trackCount, totalTrackCount;
+        Directory* parent;
+        int64_t newTrackCount, newTotalTrackCount;
+        bool used;
+    };
+
+    db::ScopedTransaction transaction(this->dbConnection);
+
+    std::unordered_map<std::string, Directory> directories;
+    std::unordered_map<int64_t, Directory*> idToDirectory;
+
+    {
+        db::Statement stmt(
+            "SELECT id, name, parent_id, track_count, total_track_count FROM directories",
+            this->dbConnection);
+
+        while (stmt.Step() == db::Row) {
+            Directory& dir = directories[stmt.ColumnText(1)];
+            dir = { stmt.ColumnInt64(0), stmt.ColumnInt64(2),
+                stmt.ColumnInt64(3), stmt.ColumnInt64(4), nullptr, 0, 0, false };
+            idToDirectory[dir.id] = &dir;
+        }
+    }
+
+    /* add missing ancestors and link everything to its parent */
+    {
+        db::Statement insert("INSERT INTO directories (name) VALUES (?)", this->dbConnection);
+
+        std::vector<std::string> pending;
+        for (auto& it : directories) {
+            pending.push_back(it.first);
+        }
+
+        while (!pending.empty()) {
+            const std::string name = pending.back();
+            pending.pop_back();
+
+            const std::string parentName = parentDirectory(name);
+            if (parentName.empty()) {
+                continue;
+            }
+
+            auto it = directories.find(parentName);
+            if (it == directories.end()) {
+                insert.Reset();
+                insert.BindText(0, parentName);
+                if (insert.Step() != db::Done) {
+                    continue;
+                }
+                const int64_t id = this->dbConnection.LastInsertedId();
+                it = directories.insert({ parentName, { id, 0, 0, 0, nullptr, 0, 0, false } }).first;
+                idToDirectory[id] = &it->second;
+                pending.push_back(parentName);
+            }
+
+            directories[name].parent = &it->second;
+        }
+    }
+
+    /* visible tracks count towards the totals; any track at all keeps the
+    directory, and its ancestors, alive */
+    {
+        db::Statement stmt(
+            "SELECT directory_id, COUNT(*), SUM(visible=1) "
+            "FROM tracks "
+            "WHERE directory_id IS NOT NULL "
+            "GROUP BY directory_id",
+            this->dbConnection);
+
+        while (stmt.Step() == db::Row) {
+            auto it = idToDirectory.find(stmt.ColumnInt64(0));
+            if (it != idToDirectory.end()) {
+                const int64_t visible = stmt.ColumnInt64(2);
+                it->second->newTrackCount = visible;
+                for (Directory* dir = it->second; dir; dir = dir->parent) {
+                    dir->newTotalTrackCount += visible;
+                    dir->used = true;
+                }
+            }
+        }
+    }
+
+    db::Statement update(
+        "UPDATE directories SET parent_id=?, track_count=?, total_track_count=? WHERE id=?",
+        this->dbConnection);
+
+    db::Statement remove("DELETE FROM directories WHERE id=?", this->dbConnection);
+
+    for (auto& it : directories) {
+        Directory& dir = it.second;
+        if (!dir.used) {
+            remove.Reset();
+            remove.BindInt64(0, dir.id);
+            remove.Step();
+        }
+        else {
+            const int64_t parentId = dir.parent ? dir.parent->id : 0;
+            if (parentId != dir.parentId ||
+                dir.newTrackCount != dir.trackCount ||
+                dir.newTotalTrackCount != dir.totalTrackCount)
+            {
+                update.Reset();
+                update.BindInt64(0, parentId);
+                update.BindInt64(1, dir.newTrackCount);
+                update.BindInt64(2, dir.newTotalTrackCount);
+                update.BindInt64(3, dir.id);
+                update.Step();
+            }
+        }
+    }
+}
+
 void Indexer::ProcessAddRemoveQueue() {
     std::unique_lock<decltype(this->stateMutex)> lock(this->stateMutex);
     while (!this->addRemoveQueue.empty()) {
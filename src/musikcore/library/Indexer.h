@@ -128,6 +128,7 @@ namespace musik { namespace core {
 
             void SyncDelete();
             void SyncCleanup();
+            void SyncDirectories();
 
             void SyncPlaylistTracksOrder();
 
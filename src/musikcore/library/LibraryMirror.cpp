@@ -0,0 +1,419 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "pch.hpp"
+
+#include <musikcore/library/LibraryMirror.h>
+#include <musikcore/library/LocalLibrary.h>
+#include <musikcore/library/query/util/ChangeLog.h>
+#include <musikcore/library/query/util/TrackRowStore.h>
+#include <musikcore/db/ScopedTransaction.h>
+#include <musikcore/db/Statement.h>
+#include <musikcore/debug.h>
+
+#include <algorithm>
+#include <chrono>
+
+using namespace musik::core;
+using namespace musik::core::db;
+using namespace musik::core::library;
+using namespace musik::core::library::query;
+
+static const std::string TAG = "LibraryMirror";
+static const size_t kPageSize = 2000;
+static const size_t kFetchTimeoutMs = 60000;
+static const size_t kFetchPollMs = 20;
+
+static bool isValidIdentifier(const std::string& name) {
+    return name.size() && std::all_of(name.begin(), name.end(), [](char c) {
+        return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_';
+    });
+}
+
+static void bindValue(Statement& stmt, int position, const nlohmann::json& value) {
+    if (value.is_number_float()) {
+        stmt.BindDouble(position, value.get<double>());
+    }
+    else if (value.is_number()) {
+        stmt.BindInt64(position, value.get<int64_t>());
+    }
+    else if (value.is_string()) {
+        stmt.BindText(position, value.get<std::string>());
+    }
+    else if (value.is_boolean()) {
+        stmt.BindInt32(position, value.get<bool>() ? 1 : 0);
+    }
+    else {
+        stmt.BindNull(position);
+    }
+}
+
+LibraryMirror::LibraryMirror(ILibrary& remote, const std::string& filename)
+: remote(remote)
+, filename(filename) {
+    this->writer.Open(filename.c_str());
+    LocalLibrary::CreateDatabase(this->writer);
+
+    /* we only ever receive changes, we don't need to track them */
+    changelog::SetEnabled(this->writer, false);
+
+    this->writer.Execute(
+        "CREATE TABLE IF NOT EXISTS mirror_state ("
+            "generation INTEGER NOT NULL)");
+
+    this->reader.Open(filename.c_str());
+
+    this->thread = std::make_unique<std::thread>(std::bind(&LibraryMirror::ThreadProc, this));
+}
+
+LibraryMirror::~LibraryMirror() {
+    {
+        std::unique_lock<std::mutex> lock(this->stateMutex);
+        this->exit = true;
+        this->current = false;
+    }
+    this->syncCondition.notify_all();
+    this->thread->join();
+}
+
+void LibraryMirror::Invalidate() {
+    std::unique_lock<std::mutex> lock(this->stateMutex);
+    this->current = false;
+    ++this->syncRequests;
+    this->syncCondition.notify_all();
+}
+
+void LibraryMirror::Suspend() {
+    std::unique_lock<std::mutex> lock(this->stateMutex);
+    this->current = false;
+}
+
+bool LibraryMirror::Run(QueryBase& query) {
+    std::unique_lock<std::mutex> lock(this->readerMutex);
+    if (!this->current) {
+        return false;
+    }
+    return query.Run(this->reader) && query.GetStatus() == IQuery::Finished;
+}
+
+void LibraryMirror::ThreadProc() {
+    while (true) {
+        int64_t request = 0;
+
+        {
+            std::unique_lock<std::mutex> lock(this->stateMutex);
+            while (!this->exit && this->syncRequests == this->syncRequestsHandled) {
+                this->syncCondition.wait(lock);
+            }
+            if (this->exit) {
+                return;
+            }
+            request = this->syncRequests;
+        }
+
+        const bool synced = this->Sync();
+
+        {
+            /* if we were invalidated while syncing, go around again */
+            std::unique_lock<std::mutex> lock(this->stateMutex);
+            this->syncRequestsHandled = request;
+            this->current = synced && request == this->syncRequests && !this->exit;
+        }
+    }
+}
+
+LibraryMirror::ChangesPtr LibraryMirror::Fetch(ChangesPtr query) {
+    /* don't use EnqueueAndWait(): we need to be able to bail early if we're
+    being torn down while a page is in flight */
+    auto isDone = [query]() {
+        const int status = query->GetStatus();
+        return status == IQuery::Finished || status == IQuery::Failed || status == IQuery::Canceled;
+    };
+
+    this->remote.Enqueue(query);
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kFetchTimeoutMs);
+
+    {
+        std::unique_lock<std::mutex> lock(this->stateMutex);
+        while (!this->exit && !isDone()) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                break;
+            }
+            /* completion callbacks are delivered via the message queue, and may
+            outlive us, so just poll. the destructor wakes us early. */
+            this->syncCondition.wait_for(lock, std::chrono::milliseconds(kFetchPollMs));
+        }
+        if (this->exit) {
+            return ChangesPtr();
+        }
+    }
+
+    return query->GetStatus() == IQuery::Finished ? query : ChangesPtr();
+}
+
+bool LibraryMirror::Sync() {
+    int64_t generation = this->GetGeneration();
+
+    bool snapshotTaken = false;
+    if (generation < 0) {
+        if (!this->SyncSnapshot()) {
+            return false;
+        }
+        snapshotTaken = true;
+        generation = this->GetGeneration();
+    }
+
+    size_t updated = 0;
+
+    while (true) {
+        auto changes = this->Fetch(std::make_shared<LibraryChangesQuery>(generation, kPageSize));
+        if (!changes) {
+            return false;
+        }
+
+        auto result = changes->GetResult();
+
+        if (result->reset) {
+            /* the server can't tell us what changed; start over, but only once */
+            if (snapshotTaken || !this->SyncSnapshot()) {
+                return false;
+            }
+            snapshotTaken = true;
+            generation = this->GetGeneration();
+            continue;
+        }
+
+        if (!this->Apply(*result, result->generation)) {
+            return false;
+        }
+
+        generation = result->generation;
+
+        for (auto& table : result->tables) {
+            updated += table.rows.size() + table.deleted.size();
+        }
+
+        if (!result->more) {
+            break;
+        }
+
+        std::unique_lock<std::mutex> lock(this->stateMutex);
+        if (this->exit) {
+            return false;
+        }
+    }
+
+    if (updated) {
+        musik::debug::info(TAG, "applied " + std::to_string(updated) + " changes");
+    }
+
+    trackrows::Sync(this->writer);
+
+    return true;
+}
+
+bool LibraryMirror::SyncSnapshot() {
+    musik::debug::info(TAG, "downloading snapshot");
+
+    /* start from scratch. note the generation stays unset until we have
+    everything, so an interrupted snapshot starts over next time. */
+    {
+        ScopedTransaction transaction(this->writer);
+        this->writer.Execute("DELETE FROM mirror_state");
+        for (auto& table : changelog::Tables()) {
+            const std::string clear = "DELETE FROM " + table;
+            this->writer.Execute(clear.c_str());
+        }
+        this->writer.Execute("DELETE FROM track_rows");
+    }
+
+    /* changes made while we're downloading will be picked up by the next
+    incremental sync, which starts from the generation the server had when
+    we got the first page. */
+    int64_t generation = -1;
+    size_t count = 0;
+
+    for (auto& table : changelog::Tables()) {
+        int64_t after = 0;
+        while (true) {
+            auto page = this->Fetch(std::make_shared<LibraryChangesQuery>(table, after, kPageSize));
+            if (!page) {
+                return false;
+            }
+
+            auto result = page->GetResult();
+
+            if (generation < 0) {
+                generation = result->generation;
+            }
+
+            if (!this->Apply(*result, -1)) {
+                return false;
+            }
+
+            for (auto& output : result->tables) {
+                count += output.rows.size();
+                if (!output.rows.empty()) {
+                    after = std::max(after, output.rows.back().at(0).get<int64_t>());
+                }
+            }
+
+            if (!result->more) {
+                break;
+            }
+
+            std::unique_lock<std::mutex> lock(this->stateMutex);
+            if (this->exit) {
+                return false;
+            }
+        }
+    }
+
+    this->SetGeneration(std::max(generation, (int64_t) 0));
+
+    musik::debug::info(TAG, "downloaded " + std::to_string(count) + " rows");
+
+    return true;
+}
+
+bool LibraryMirror::Apply(const LibraryChangesQuery::Result& changes, int64_t generation) {
+    ScopedTransaction transaction(this->writer);
+
+    bool invalidateTrackRows = false;
+
+    for (auto& table : changes.tables) {
+        if (!this->ApplyTable(table)) {
+            musik::debug::error(TAG, "failed to apply changes to " + table.name);
+            transaction.Cancel();
+            return false;
+        }
+
+        /* track records are denormalized from these, and the triggers only
+        watch for updates, not the deletes and inserts we do here */
+        if (table.name == "albums" || table.name == "artists" || table.name == "genres") {
+            invalidateTrackRows = true;
+        }
+    }
+
+    if (invalidateTrackRows) {
+        this->writer.Execute("DELETE FROM track_rows");
+    }
+
+    if (generation >= 0) {
+        this->SetGeneration(generation);
+    }
+
+    return true;
+}
+
+bool LibraryMirror::ApplyTable(const LibraryChangesQuery::Table& table) {
+    auto& tables = changelog::Tables();
+    if (std::find(tables.begin(), tables.end(), table.name) == tables.end()) {
+        return false;
+    }
+
+    Statement remove(("DELETE FROM " + table.name + " WHERE rowid=?").c_str(), this->writer);
+
+    for (const int64_t rowId : table.deleted) {
+        remove.ResetAndUnbind();
+        remove.BindInt64(0, rowId);
+        if (remove.Step() != Done) {
+            return false;
+        }
+    }
+
+    if (table.rows.empty()) {
+        return true;
+    }
+
+    /* tables with an `id` column use it as their rowid; for the others we
+    need to specify the rowid explicitly to keep it in sync with the server */
+    const bool hasId = std::find(
+        table.columns.begin(), table.columns.end(), "id") != table.columns.end();
+
+    std::string columns = hasId ? "" : "rowid";
+    std::string values = hasId ? "" : "?";
+    for (auto& column : table.columns) {
+        if (!isValidIdentifier(column)) {
+            return false;
+        }
+        columns += (columns.size() ? ", " : "") + column;
+        values += values.size() ? ", ?" : "?";
+    }
+
+    const std::string sql =
+        "INSERT INTO " + table.name + " (" + columns + ") VALUES (" + values + ")";
+
+    Statement insert(sql.c_str(), this->writer);
+
+    const size_t first = hasId ? 1 : 0;
+    const size_t count = table.columns.size() + 1;
+
+    for (auto& row : table.rows) {
+        if (!row.is_array() || row.size() != count) {
+            return false;
+        }
+
+        /* delete, then insert (instead of INSERT OR REPLACE), so the
+        track_rows triggers see the old row go away */
+        remove.ResetAndUnbind();
+        remove.BindInt64(0, row[0].get<int64_t>());
+        if (remove.Step() != Done) {
+            return false;
+        }
+
+        insert.ResetAndUnbind();
+        for (size_t i = first; i < count; i++) {
+            bindValue(insert, (int) (i - first), row[i]);
+        }
+        if (insert.Step() != Done) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int64_t LibraryMirror::GetGeneration() {
+    Statement stmt("SELECT generation FROM mirror_state", this->writer);
+    return stmt.Step() == Row ? stmt.ColumnInt64(0) : -1;
+}
+
+void LibraryMirror::SetGeneration(int64_t generation) {
+    this->writer.Execute("DELETE FROM mirror_state");
+    Statement stmt("INSERT INTO mirror_state (generation) VALUES (?)", this->writer);
+    stmt.BindInt64(0, generation);
+    stmt.Step();
+}
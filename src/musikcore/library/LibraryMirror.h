@@ -0,0 +1,107 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <musikcore/config.h>
+#include <musikcore/db/Connection.h>
+#include <musikcore/library/ILibrary.h>
+#include <musikcore/library/QueryBase.h>
+#include <musikcore/library/query/LibraryChangesQuery.h>
+#include <musikcore/support/DeleteDefaults.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace musik { namespace core { namespace library {
+
+    /* a local copy of a remote library's metadata, stored using the regular
+    LocalLibrary schema, so read-only queries can be answered without a
+    network round trip. a background thread pulls change sets from the
+    server (see LibraryChangesQuery) whenever the mirror is invalidated; the
+    first sync, or one after the server lost track of our generation,
+    downloads everything. */
+    class LibraryMirror {
+        public:
+            DELETE_CLASS_DEFAULTS(LibraryMirror)
+
+            /* `remote` is used to fetch changes and must outlive the mirror */
+            LibraryMirror(musik::core::ILibrary& remote, const std::string& filename);
+            ~LibraryMirror();
+
+            const std::string& Filename() const noexcept { return this->filename; }
+
+            /* true if the mirror was synced and nothing has changed since */
+            bool IsCurrent() const noexcept { return this->current; }
+
+            /* the remote library changed (or may have); stop answering
+            queries and schedule a sync */
+            void Invalidate();
+
+            /* stop answering queries until the next sync, e.g. because we
+            lost the connection to the server */
+            void Suspend();
+
+            /* runs a read-only query against the mirror. returns false if the
+            mirror isn't current or the query failed. */
+            bool Run(musik::core::library::query::QueryBase& query);
+
+        private:
+            using LibraryChangesQuery = musik::core::library::query::LibraryChangesQuery;
+            using ChangesPtr = std::shared_ptr<LibraryChangesQuery>;
+
+            void ThreadProc();
+            bool Sync();
+            bool SyncSnapshot();
+            ChangesPtr Fetch(ChangesPtr query);
+            bool Apply(const LibraryChangesQuery::Result& changes, int64_t generation);
+            bool ApplyTable(const LibraryChangesQuery::Table& table);
+            int64_t GetGeneration();
+            void SetGeneration(int64_t generation);
+
+            musik::core::ILibrary& remote;
+            std::string filename;
+            musik::core::db::Connection writer, reader;
+            std::mutex readerMutex, stateMutex;
+            std::condition_variable syncCondition;
+            std::unique_ptr<std::thread> thread;
+            int64_t syncRequests{ 0 }, syncRequestsHandled{ 0 };
+            bool exit{ false };
+            std::atomic<bool> current{ false };
+    };
+
+} } }
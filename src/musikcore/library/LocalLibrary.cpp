@@ -39,7 +39,14 @@
 #include <musikcore/library/QueryBase.h>
 #include <musikcore/support/Common.h>
 #include <musikcore/support/Preferences.h>
+#include <musikcore/support/PreferenceKeys.h>
 #include <musikcore/library/Indexer.h>
+#include <musikcore/library/query/MarkTrackPlayedQuery.h>
+#include <musikcore/library/query/SetTrackRatingQuery.h>
+#include <musikcore/library/query/TrackMetadataBatchQuery.h>
+#include <musikcore/library/query/TrackMetadataQuery.h>
+#include <musikcore/library/query/util/ChangeLog.h>
+#include <musikcore/library/query/util/TrackRowStore.h>
 #include <musikcore/runtime/Message.h>
 #include <musikcore/debug.h>
 
@@ -56,10 +63,18 @@ using namespace musik::core::library;
 using namespace musik::core::runtime;
 using namespace std::chrono;
 
-#define DATABASE_VERSION 10
+#define DATABASE_VERSION 11
 #define VERBOSE_LOGGING 1
 #define MESSAGE_QUERY_COMPLETED 5000
 
+/* buffered track writes (see TrackWriteQueue) are flushed once the query
+queue has been idle this long, and before the next query runs. while the
+indexer is running they are held back, up to the maximum delay, so they
+don't contend with its transactions; queries see pending ratings anyway,
+they're applied to the tracks they return (see ApplyPendingWrites). */
+constexpr int64_t kWriteBehindIdleMs = 500;
+constexpr int64_t kWriteBehindMaxDelayMs = 30000;
+
 class LocalResourceLocator: public ILibrary::IResourceLocator {
     public:
         std::string GetTrackUri(
@@ -98,7 +113,9 @@ LocalLibrary::LocalLibrary(std::string name, int id, MessageQueue* messageQueue)
 : name(name)
 , id(id)
 , exit(false)
-, messageQueue(messageQueue) {
+, capturingQueries(0)
+, messageQueue(messageQueue)
+, prefs(Preferences::ForComponent(musik::core::prefs::components::Settings)) {
     if (this->messageQueue) {
         this->messageQueue->Register(this);
     }
@@ -108,6 +125,9 @@ LocalLibrary::LocalLibrary(std::string name, int id, MessageQueue* messageQueue)
     this->db.Open(this->GetDatabaseFilename().c_str());
     LocalLibrary::CreateDatabase(this->db);
 
+    query::changelog::SetEnabled(this->db, this->prefs->GetBool(
+        musik::core::prefs::keys::LibraryMirrorServingEnabled, false));
+
     this->indexer = new core::Indexer(
         this->GetLibraryDirectory(),
         this->GetDatabaseFilename());
@@ -156,6 +176,8 @@ void LocalLibrary::Close() {
         thread->join();
         delete thread;
     }
+
+    this->FlushWrites(true);
 }
 
 bool LocalLibrary::IsConfigured() {
@@ -207,7 +229,11 @@ int LocalLibrary::EnqueueAndWait(QueryPtr query, size_t timeoutMs, Callback call
         context->query = localQuery;
         context->callback = callback;
 
-        if (timeoutMs == kWaitIndefinite) {
+        if (this->DeferWrite(context)) {
+            this->queueCondition.notify_all(); /* wakes the thread to schedule a flush */
+        }
+        else if (timeoutMs == kWaitIndefinite) {
+            this->FlushWrites();
             this->RunQuery(context);
         }
         else {
@@ -237,7 +263,15 @@ int LocalLibrary::EnqueueAndWait(QueryPtr query, size_t timeoutMs, Callback call
 LocalLibrary::QueryContextPtr LocalLibrary::GetNextQuery() {
     std::unique_lock<std::recursive_mutex> lock(this->mutex);
     while (!this->queryQueue.size() && !this->exit) {
-        this->queueCondition.wait(lock);
+        if (this->writeQueue.Empty()) {
+            this->queueCondition.wait(lock);
+        }
+        else {
+            const auto result = this->queueCondition.wait_for(lock, kWriteBehindIdleMs * milliseconds(1));
+            if (result == std::cv_status::timeout && !this->queryQueue.size()) {
+                return QueryContextPtr(); /* idle; let the caller flush pending writes */
+            }
+        }
     }
 
     if (this->exit) {
@@ -254,9 +288,85 @@ void LocalLibrary::ThreadProc() {
     while (!this->exit) {
         auto query = GetNextQuery();
         if (query) {
+            this->FlushWrites();
             this->RunQuery(query);
             this->queueCondition.notify_all();
         }
+        else if (!this->exit) {
+            this->FlushWrites();
+        }
+    }
+}
+
+bool LocalLibrary::DeferWrite(QueryContextPtr context) {
+    /* play counts and ratings are buffered and written in batches; the
+    query completes immediately. */
+    if (auto played = std::dynamic_pointer_cast<query::MarkTrackPlayedQuery>(context->query)) {
+        played->Defer(this->writeQueue);
+    }
+    else if (auto rating = std::dynamic_pointer_cast<query::SetTrackRatingQuery>(context->query)) {
+        rating->Defer(this->writeQueue);
+    }
+    else {
+        return false;
+    }
+
+    if (VERBOSE_LOGGING) {
+        musik::debug::info(TAG, "query '" + context->query->Name() + "' deferred");
+    }
+
+    this->NotifyQueryCompleted(context);
+    return true;
+}
+
+void LocalLibrary::ApplyPendingWrites(LocalQueryPtr completed) {
+    /* buffered ratings may not have been written yet (e.g. while indexing),
+    so overlay them on the tracks a query returns */
+    int rating = 0;
+    auto apply = [this, &rating](TrackPtr track) {
+        if (track && track->Contains(constants::Track::RATING) &&
+            this->writeQueue.PendingRating(track->GetId(), rating))
+        {
+            track->SetValue(constants::Track::RATING, std::to_string(rating).c_str());
+        }
+    };
+
+    if (completed->GetStatus() != db::IQuery::Finished) {
+        return;
+    }
+    else if (auto single = std::dynamic_pointer_cast<query::TrackMetadataQuery>(completed)) {
+        apply(single->Result());
+    }
+    else if (auto batch = std::dynamic_pointer_cast<query::TrackMetadataBatchQuery>(completed)) {
+        for (auto& it : batch->Result()) {
+            apply(it.second);
+        }
+    }
+}
+
+void LocalLibrary::FlushWrites(bool force) {
+    /* a forced flush always goes through the queue, which waits for any
+    flush already in progress on another thread */
+    if (!force) {
+        if (this->writeQueue.Empty()) {
+            return;
+        }
+
+        bool indexing = false;
+        {
+            std::unique_lock<std::recursive_mutex> lock(this->mutex);
+            indexing = this->indexer &&
+                this->indexer->GetState() == IIndexer::StateIndexing;
+        }
+        if (indexing && this->writeQueue.PendingMs() < kWriteBehindMaxDelayMs) {
+            return;
+        }
+    }
+
+    const size_t count = this->writeQueue.Flush(this->db);
+
+    if (VERBOSE_LOGGING && count > 0) {
+        musik::debug::info(TAG, u8fmt("flushed buffered writes for %d tracks", (int) count));
     }
 }
 
@@ -268,15 +378,43 @@ void LocalLibrary::RunQuery(QueryContextPtr context, bool notify) {
             musik::debug::info(TAG, "query '" + query->Name() + "' running");
         }
 
+        /* statement capture is per-connection, so only the outermost query
+        captures statements if queries are run re-entrantly. */
+        const int slowQueryThresholdMs = this->prefs->GetInt(
+            musik::core::prefs::keys::LibrarySlowQueryThresholdMs, 0);
+
+        const bool capture = slowQueryThresholdMs > 0 &&
+            this->capturingQueries.fetch_add(1) == 0;
+
+        if (capture) {
+            this->db.SetStatementCaptureEnabled(true);
+        }
+
+        const auto start = steady_clock::now();
+
         query->Run(this->db);
+        this->ApplyPendingWrites(query);
+
+        const double durationMs =
+            std::chrono::duration<double, std::milli>(steady_clock::now() - start).count();
+
+        std::vector<std::string> statements;
+        if (capture) {
+            statements = this->db.TakeCapturedStatements();
+            this->db.SetStatementCaptureEnabled(false);
+        }
+        if (slowQueryThresholdMs > 0) {
+            this->capturingQueries.fetch_sub(1);
+        }
+
+        this->profiler.Record(query->Name(), durationMs);
+
+        if (slowQueryThresholdMs > 0 && durationMs >= (double) slowQueryThresholdMs) {
+            this->profiler.RecordSlowQuery(this->db, *query, durationMs, statements);
+        }
 
         if (notify) {
-            if (this->messageQueue) {
-                this->messageQueue->Post(std::make_shared<QueryCompletedMessage>(this, context));
-            }
-            else {
-                this->QueryCompleted(query.get());
-            }
+            this->NotifyQueryCompleted(context);
         }
         else if (context->callback) {
             context->callback(context->query);
@@ -291,6 +429,15 @@ void LocalLibrary::RunQuery(QueryContextPtr context, bool notify) {
     }
 }
 
+void LocalLibrary::NotifyQueryCompleted(QueryContextPtr context) {
+    if (this->messageQueue) {
+        this->messageQueue->Post(std::make_shared<QueryCompletedMessage>(this, context));
+    }
+    else {
+        this->QueryCompleted(context->query.get());
+    }
+}
+
 void LocalLibrary::SetMessageQueue(musik::core::runtime::IMessageQueue& queue) {
     if (this->messageQueue && this->messageQueue != &queue) {
         this->messageQueue->Unregister(this);
@@ -413,6 +560,14 @@ static void upgradeV9ToV10(db::Connection& db) {
     db.Execute("UPDATE tracks set disc=1 where disc is null or disc like \"\"");
 }
 
+static void upgradeV10ToV11(db::Connection& db) {
+    /* the directory hierarchy is rebuilt by the indexer on the next sync */
+    db.Execute("ALTER TABLE directories ADD COLUMN parent_id INTEGER DEFAULT 0");
+    db.Execute("ALTER TABLE directories ADD COLUMN track_count INTEGER DEFAULT 0");
+    db.Execute("ALTER TABLE directories ADD COLUMN total_track_count INTEGER DEFAULT 0");
+    scheduleSyncDueToDbUpgrade = true;
+}
+
 static void setVersion(db::Connection& db, int version) {
     db.Execute("DELETE FROM version");
     db::Statement stmt("INSERT INTO version VALUES(?)", db);
@@ -510,11 +665,17 @@ void LocalLibrary::CreateDatabase(db::Connection &db){
             "id INTEGER PRIMARY KEY AUTOINCREMENT,"
             "path TEXT default '')");
 
-    /* browse directories */
+    /* browse directories. this is the library's directory hierarchy, as
+    maintained by the indexer: every directory with tracks, plus all of its
+    ancestors. track_count is the number of visible tracks directly inside
+    the directory, and total_track_count includes all subdirectories. */
     db.Execute(
         "CREATE TABLE IF NOT EXISTS directories ("
         "id INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "name TEXT NOT NULL)");
+        "name TEXT NOT NULL,"
+        "parent_id INTEGER DEFAULT 0,"
+        "track_count INTEGER DEFAULT 0,"
+        "total_track_count INTEGER DEFAULT 0)");
 
     /* thumbnails */
     db.Execute(
@@ -625,6 +786,15 @@ void LocalLibrary::CreateDatabase(db::Connection &db){
             "id INTEGER PRIMARY KEY AUTOINCREMENT, "
             "track_id INTEGER)");
 
+    /* session play queue journal; see PersistedPlayQueueQuery */
+    db.Execute(
+        "CREATE TABLE IF NOT EXISTS last_session_play_queue_journal ( "
+            "id INTEGER PRIMARY KEY AUTOINCREMENT, "
+            "op INTEGER NOT NULL, "
+            "position INTEGER NOT NULL DEFAULT 0, "
+            "count INTEGER NOT NULL DEFAULT 0, "
+            "track_ids BLOB)");
+
     /* upgrade playlist tracks table */
     if (lastVersion == 1) {
         upgradeV1toV2(db);
@@ -662,6 +832,18 @@ void LocalLibrary::CreateDatabase(db::Connection &db){
         upgradeV9ToV10(db);
     }
 
+    if (lastVersion >= 1 && lastVersion < 11) {
+        upgradeV10ToV11(db);
+    }
+
+    /* denormalized track metadata records; see TrackRowStore. created after
+    the upgrades because some of them recreate tables the triggers watch */
+    query::trackrows::CreateSchema(db);
+
+    /* row-level change tracking for remote mirrors; see ChangeLog. the
+    triggers are installed separately, if serving mirrors is enabled. */
+    query::changelog::CreateSchema(db);
+
     /* ensure our version is set correctly */
     setVersion(db, DATABASE_VERSION);
 
@@ -690,10 +872,17 @@ void LocalLibrary::DropIndexes(db::Connection &db) {
     db.Execute("DROP INDEX IF EXISTS tracks_dirty_index");
     db.Execute("DROP INDEX IF EXISTS tracks_external_id_filetime_index");
     db.Execute("DROP INDEX IF EXISTS tracks_by_source_index");
+    db.Execute("DROP INDEX IF EXISTS tracks_directory_id_index");
+
+    db.Execute("DROP INDEX IF EXISTS directories_name_index");
+    db.Execute("DROP INDEX IF EXISTS directories_parent_id_index");
 
     db.Execute("DROP INDEX IF EXISTS playlist_tracks_index_1");
     db.Execute("DROP INDEX IF EXISTS playlist_tracks_index_2");
     db.Execute("DROP INDEX IF EXISTS playlist_tracks_index_3");
+    db.Execute("DROP INDEX IF EXISTS playlist_tracks_index_4");
+
+    db.Execute("DROP INDEX IF EXISTS track_rows_external_id_index");
 }
 
 void LocalLibrary::CreateIndexes(db::Connection &db) {
@@ -722,10 +911,17 @@ void LocalLibrary::CreateIndexes(db::Connection &db) {
     db.Execute("CREATE INDEX IF NOT EXISTS tracks_dirty_index ON tracks (id, filename, filesize, filetime)");
     db.Execute("CREATE INDEX IF NOT EXISTS tracks_external_id_filetime_index ON tracks (external_id, filetime)");
     db.Execute("CREATE INDEX IF NOT EXISTS tracks_by_source_index ON tracks (id, external_id, filename, source_id)");
+    db.Execute("CREATE INDEX IF NOT EXISTS tracks_directory_id_index ON tracks (directory_id)");
+
+    db.Execute("CREATE INDEX IF NOT EXISTS directories_name_index ON directories (name)");
+    db.Execute("CREATE INDEX IF NOT EXISTS directories_parent_id_index ON directories (parent_id)");
 
     db.Execute("CREATE INDEX IF NOT EXISTS playlist_tracks_index_1 ON playlist_tracks (track_external_id,playlist_id,sort_order)");
     db.Execute("CREATE INDEX IF NOT EXISTS playlist_tracks_index_2 ON playlist_tracks (track_external_id,sort_order)");
     db.Execute("CREATE INDEX IF NOT EXISTS playlist_tracks_index_3 ON playlist_tracks (track_external_id)");
+    db.Execute("CREATE INDEX IF NOT EXISTS playlist_tracks_index_4 ON playlist_tracks (playlist_id,sort_order)");
+
+    db.Execute("CREATE INDEX IF NOT EXISTS track_rows_external_id_index ON track_rows (external_id)");
 }
 
 void LocalLibrary::InvalidateTrackMetadata(db::Connection& db) {
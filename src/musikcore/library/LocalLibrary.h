@@ -41,6 +41,9 @@
 #include <musikcore/library/IIndexer.h>
 #include <musikcore/library/IQuery.h>
 #include <musikcore/library/QueryBase.h>
+#include <musikcore/library/QueryProfiler.h>
+#include <musikcore/library/TrackWriteQueue.h>
+#include <musikcore/support/Preferences.h>
 
 #include <thread>
 #include <mutex>
@@ -86,6 +89,7 @@ namespace musik { namespace core { namespace library {
 
             /* implementation specific */
             db::Connection& GetConnection() { return this->db; }
+            QueryProfiler& GetQueryProfiler() noexcept { return this->profiler; }
             std::string GetLibraryDirectory();
             std::string GetDatabaseFilename();
             static void CreateDatabase(db::Connection &db);
@@ -109,6 +113,10 @@ namespace musik { namespace core { namespace library {
             LocalLibrary(std::string name, int id, MessageQueue* messageQueue); /* ctor */
 
             void RunQuery(QueryContextPtr context, bool notify = true);
+            void NotifyQueryCompleted(QueryContextPtr context);
+            bool DeferWrite(QueryContextPtr context);
+            void FlushWrites(bool force = false);
+            void ApplyPendingWrites(LocalQueryPtr completed);
             void ThreadProc();
             QueryContextPtr GetNextQuery();
 
@@ -124,9 +132,13 @@ namespace musik { namespace core { namespace library {
             std::condition_variable_any queueCondition;
             std::recursive_mutex mutex;
             std::atomic<bool> exit;
+            std::atomic<int> capturingQueries;
 
             core::IIndexer *indexer;
             core::db::Connection db;
+            QueryProfiler profiler;
+            TrackWriteQueue writeQueue;
+            std::shared_ptr<musik::core::Preferences> prefs;
     };
 
 } } }
@@ -48,6 +48,7 @@
 #include <musikcore/library/query/SavePlaylistQuery.h>
 #include <musikcore/library/query/TrackMetadataQuery.h>
 #include <musikcore/library/query/TrackListQueryBase.h>
+#include <musikcore/library/query/util/PlaylistQueryUtil.h>
 #include <musikcore/library/QueryRegistry.h>
 #include <musikcore/library/LibraryFactory.h>
 #include <musikcore/library/track/LibraryTrack.h>
@@ -209,61 +210,34 @@ class RemoveFromPlaylistQuery : public QueryBase {
 
             ScopedTransaction transaction(db);
 
-            {
-                Statement deleteStmt(
-                    "DELETE FROM playlist_tracks "
-                    "WHERE playlist_id=? AND track_external_id=? AND sort_order=?",
-                    db);
-
-                for (size_t i = 0; i < count; i++) {
-                    const auto id = this->externalIds[i];
-                    const auto o = this->sortOrders[i];
-
-                    deleteStmt.ResetAndUnbind();
-                    deleteStmt.BindInt64(0, this->playlistId);
-                    deleteStmt.BindText(1, this->externalIds[i]);
-                    deleteStmt.BindInt32(2, this->sortOrders[i]);
-                    if (deleteStmt.Step() == Done) {
-                        ++this->updated;
-                    }
-                }
+            /* clients identify tracks by their (external id, position)
+            pair; sort orders in the table are sparse, so we map positions
+            back to rows and delete by rowid. remaining rows keep their
+            sort orders, so nothing needs to be renumbered. */
+            std::vector<playlist::Row> rows;
+            if (!playlist::LoadRows(db, this->playlistId, rows)) {
+                transaction.Cancel();
+                return false;
             }
 
-            bool error = false;
-
-            {
-                Statement playlistTracks(
-                    "SELECT track_external_id, sort_order FROM playlist_tracks "
-                    "WHERE playlist_id=? ORDER BY sort_order ASC",
-                    db);
-
-                Statement updateStmt(
-                    "UPDATE playlist_tracks "
-                    "SET sort_order=? "
-                    "WHERE playlist_id=? AND track_external_id=? AND sort_order=?",
-                    db);
-
-                int order = 0;
-
-                playlistTracks.BindInt64(0, this->playlistId);
-                while (playlistTracks.Step() == Row) {
-                    updateStmt.ResetAndUnbind();
-                    updateStmt.BindInt32(0, order++);
-                    updateStmt.BindInt64(1, this->playlistId);
-                    updateStmt.BindText(2, playlistTracks.ColumnText(0));
-                    updateStmt.BindInt32(3, playlistTracks.ColumnInt32(1));
-                    if (updateStmt.Step() != Done) {
-                        error = true;
-                        break;
+            std::vector<int64_t> rowIds;
+            for (size_t i = 0; i < count; i++) {
+                const int position = this->sortOrders[i];
+                if (position >= 0 && (size_t) position < rows.size()) {
+                    auto& row = rows[(size_t) position];
+                    if (row.rowId != -1 && row.externalId == this->externalIds[i]) {
+                        rowIds.push_back(row.rowId);
+                        row.rowId = -1; /* guard against duplicate requests */
                     }
                 }
             }
 
-            if (!error) {
+            if (playlist::DeleteRows(db, rowIds)) {
+                this->updated = rowIds.size();
                 transaction.CommitAndRestart();
             }
             else {
-                this->updated = 0;
+                transaction.Cancel();
             }
 
             if (this->updated > 0) {
@@ -278,6 +252,10 @@ class RemoveFromPlaylistQuery : public QueryBase {
             return "RemoveFromPlaylistQuery";
         }
 
+        bool IsMutating() override {
+            return true;
+        }
+
     private:
         ILibraryPtr library;
         int64_t playlistId;
@@ -789,7 +767,15 @@ bool LocalMetadataProxy::SendRawQuery(
         if (libraryQuery) {
             localLibrary->EnqueueAndWait(libraryQuery);
             if (libraryQuery->GetStatus() == IQuery::Finished) {
-                std::string result = libraryQuery->SerializeResult();
+                std::string result;
+                if (serialization::IsBinaryResultRequested(json) &&
+                    libraryQuery->SerializeResultBinary(result))
+                {
+                    result = serialization::EncodeBinaryResult(result);
+                }
+                else {
+                    result = libraryQuery->SerializeResult();
+                }
                 *resultData = static_cast<char*>(allocator.Allocate(result.size() + 1));
                 if (*resultData) {
                     *resultSize = (int) result.size() + 1;
@@ -105,6 +105,10 @@ namespace musik { namespace core { namespace library { namespace query {
                 return this->options;
             }
 
+            bool IsMutating() override {
+                return false;
+            }
+
             /* ISerializableQuery */
 
             std::string SerializeQuery() override {
@@ -119,6 +123,14 @@ namespace musik { namespace core { namespace library { namespace query {
                 throw std::runtime_error("not implemented");
             }
 
+            bool SerializeResultBinary(std::string& output) override {
+                return false;
+            }
+
+            void DeserializeResultBinary(const std::string& data) override {
+                throw std::runtime_error("not implemented");
+            }
+
             void Invalidate() override {
                 this->SetStatus(IQuery::Failed);
             }
@@ -0,0 +1,188 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "pch.hpp"
+
+#include <musikcore/library/QueryProfiler.h>
+#include <musikcore/db/Statement.h>
+#include <musikcore/debug.h>
+#include <musikcore/support/Common.h>
+
+#include <chrono>
+#include <cmath>
+#include <unordered_map>
+
+using namespace musik::core;
+using namespace musik::core::db;
+using namespace musik::core::library;
+using namespace musik::core::library::query;
+
+static const std::string TAG = "QueryProfiler";
+
+static inline size_t bucketIndex(double durationMs) noexcept {
+    size_t index = 0;
+    double upper = 1.0;
+    while (durationMs >= upper && index < QueryProfiler::kBucketCount - 1) {
+        upper *= 2.0;
+        ++index;
+    }
+    return index;
+}
+
+static inline double bucketUpperBoundMs(size_t index) noexcept {
+    return std::ldexp(1.0, (int) index);
+}
+
+double QueryProfiler::Stats::MeanMs() const noexcept {
+    return this->count ? this->totalMs / (double) this->count : 0.0;
+}
+
+double QueryProfiler::Stats::PercentileMs(double percentile) const noexcept {
+    if (this->count == 0) {
+        return 0.0;
+    }
+
+    const uint64_t rank = std::max(
+        (uint64_t) 1, (uint64_t) std::ceil(percentile * (double) this->count));
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount - 1; i++) {
+        seen += this->buckets[i];
+        if (seen >= rank) {
+            return std::min(bucketUpperBoundMs(i), this->maxMs);
+        }
+    }
+
+    return this->maxMs;
+}
+
+void QueryProfiler::Record(const std::string& name, double durationMs) {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    auto& entry = this->stats[name];
+    if (entry.name.empty()) {
+        entry.name = name;
+    }
+    ++entry.count;
+    entry.totalMs += durationMs;
+    entry.maxMs = std::max(entry.maxMs, durationMs);
+    ++entry.buckets[bucketIndex(durationMs)];
+}
+
+void QueryProfiler::RecordSlowQuery(
+    Connection& db,
+    QueryBase& query,
+    double durationMs,
+    const std::vector<std::string>& statements)
+{
+    SlowQuery slow;
+    slow.name = query.Name();
+    slow.durationMs = durationMs;
+    slow.timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    /* not every query supports serialization (local-only queries don't) */
+    try {
+        slow.parameters = query.SerializeQuery();
+    }
+    catch (...) {
+    }
+
+    for (auto& sql : statements) {
+        auto plan = ExplainQueryPlan(db, sql);
+        if (plan.size()) {
+            slow.plans.push_back(sql + "\n" + plan);
+        }
+    }
+
+    musik::debug::warning(TAG, u8fmt(
+        "slow query '%s' took %.1fms params=%s",
+        slow.name.c_str(),
+        durationMs,
+        slow.parameters.size() ? slow.parameters.c_str() : "n/a"));
+
+    for (auto& plan : slow.plans) {
+        musik::debug::warning(TAG, plan);
+    }
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->slowQueries.push_back(std::move(slow));
+    while (this->slowQueries.size() > kMaxSlowQueries) {
+        this->slowQueries.pop_front();
+    }
+}
+
+std::vector<QueryProfiler::Stats> QueryProfiler::GetStats() const {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    std::vector<Stats> result;
+    result.reserve(this->stats.size());
+    for (auto& it : this->stats) {
+        result.push_back(it.second);
+    }
+    return result;
+}
+
+std::vector<QueryProfiler::SlowQuery> QueryProfiler::GetSlowQueries() const {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    return std::vector<SlowQuery>(this->slowQueries.begin(), this->slowQueries.end());
+}
+
+void QueryProfiler::Reset() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->stats.clear();
+    this->slowQueries.clear();
+}
+
+std::string QueryProfiler::ExplainQueryPlan(Connection& db, const std::string& sql) {
+    /* columns are: id, parent, notused, detail. rows form a tree via
+    `parent`; indent each row by its depth. */
+    Statement explain(("EXPLAIN QUERY PLAN " + sql).c_str(), db);
+
+    std::unordered_map<int, size_t> depths;
+    std::string result;
+
+    while (explain.Step() == db::Row) {
+        const int id = explain.ColumnInt32(0);
+        const int parent = explain.ColumnInt32(1);
+        auto it = depths.find(parent);
+        const size_t depth = it == depths.end() ? 0 : it->second + 1;
+        depths[id] = depth;
+
+        if (result.size()) {
+            result += "\n";
+        }
+        result += std::string(depth * 2, ' ') + explain.ColumnText(3);
+    }
+
+    return result;
+}
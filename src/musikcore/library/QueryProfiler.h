@@ -0,0 +1,107 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <musikcore/config.h>
+#include <musikcore/db/Connection.h>
+#include <musikcore/library/QueryBase.h>
+
+#include <array>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace musik { namespace core { namespace library {
+
+    /* collects per-query latency histograms for a LocalLibrary, and keeps a
+    short log of queries that exceeded the configured slow query threshold,
+    including their parameters and the query plans of the SQL they ran. */
+    class QueryProfiler {
+        public:
+            /* bucket 0 holds samples under 1ms; bucket i holds samples in
+            [2^(i-1), 2^i) ms. the last bucket is open-ended. */
+            static const size_t kBucketCount = 16;
+            static const size_t kMaxSlowQueries = 64;
+
+            struct Stats {
+                std::string name;
+                uint64_t count{ 0 };
+                double totalMs{ 0.0 };
+                double maxMs{ 0.0 };
+                std::array<uint64_t, kBucketCount> buckets{};
+
+                double MeanMs() const noexcept;
+
+                /* approximate; returns the upper bound of the bucket that
+                contains the requested percentile (0.0 - 1.0) */
+                double PercentileMs(double percentile) const noexcept;
+            };
+
+            struct SlowQuery {
+                std::string name;
+                double durationMs{ 0.0 };
+                int64_t timestamp{ 0 };
+                std::string parameters;
+                std::vector<std::string> plans;
+            };
+
+            DELETE_COPY_AND_ASSIGNMENT_DEFAULTS(QueryProfiler)
+
+            QueryProfiler() noexcept { }
+
+            void Record(const std::string& name, double durationMs);
+
+            void RecordSlowQuery(
+                musik::core::db::Connection& db,
+                musik::core::library::query::QueryBase& query,
+                double durationMs,
+                const std::vector<std::string>& statements);
+
+            std::vector<Stats> GetStats() const;
+            std::vector<SlowQuery> GetSlowQueries() const;
+            void Reset();
+
+            static std::string ExplainQueryPlan(
+                musik::core::db::Connection& db, const std::string& sql);
+
+        private:
+            mutable std::mutex mutex;
+            std::map<std::string, Stats> stats;
+            std::deque<SlowQuery> slowQueries;
+    };
+
+} } }
@@ -42,7 +42,9 @@
 #include <musikcore/library/query/CategoryListQuery.h>
 #include <musikcore/library/query/CategoryTrackListQuery.h>
 #include <musikcore/library/query/DeletePlaylistQuery.h>
+#include <musikcore/library/query/DirectoryListQuery.h>
 #include <musikcore/library/query/DirectoryTrackListQuery.h>
+#include <musikcore/library/query/LibraryChangesQuery.h>
 #include <musikcore/library/query/LyricsQuery.h>
 #include <musikcore/library/query/MarkTrackPlayedQuery.h>
 #include <musikcore/library/query/NowPlayingTrackListQuery.h>
@@ -84,9 +86,15 @@ namespace musik { namespace core { namespace library {
             if (name == DeletePlaylistQuery::kQueryName) {
                 return DeletePlaylistQuery::DeserializeQuery(library, data);
             }
+            if (name == DirectoryListQuery::kQueryName) {
+                return DirectoryListQuery::DeserializeQuery(data);
+            }
             if (name == DirectoryTrackListQuery::kQueryName) {
                 return DirectoryTrackListQuery::DeserializeQuery(library, data);
             }
+            if (name == LibraryChangesQuery::kQueryName) {
+                return LibraryChangesQuery::DeserializeQuery(data);
+            }
             if (name == LyricsQuery::kQueryName) {
                 return LyricsQuery::DeserializeQuery(data);
             }
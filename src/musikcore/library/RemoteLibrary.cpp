@@ -43,6 +43,8 @@
 #include <musikcore/library/IQuery.h>
 #include <musikcore/library/LibraryFactory.h>
 #include <musikcore/library/QueryRegistry.h>
+#include <musikcore/library/query/LibraryChangesQuery.h>
+#include <musikcore/library/query/LyricsQuery.h>
 #include <musikcore/runtime/Message.h>
 #include <musikcore/support/NarrowCast.h>
 #include <musikcore/debug.h>
@@ -66,6 +68,14 @@ using namespace std::chrono;
 #define MESSAGE_RECONNECT_SOCKET 5001
 #define MESSAGE_UPDATE_CONNECTION_STATE 5002
 
+/* servers starting with this api version broadcast library_changed messages,
+which we need to safely cache query results */
+static const int kLibraryChangedApiVersion = 21;
+/* ...and this one added LibraryChangesQuery, required by LibraryMirror */
+static const int kLibraryChangesApiVersion = 22;
+static const size_t kMaxCachedResults = 512;
+static const size_t kMaxCachedResultBytes = 16 * 1024 * 1024;
+
 class NullIndexer: public musik::core::IIndexer {
     public:
         void AddPath(const std::string& path) noexcept override { }
@@ -129,6 +139,15 @@ const std::string& RemoteLibrary::Name() {
 void RemoteLibrary::Close() {
     this->wsc.Disconnect();
 
+    {
+        /* waits for any sync in progress to stop */
+        std::shared_ptr<LibraryMirror> mirror;
+        {
+            std::unique_lock<std::mutex> lock(this->mirrorMutex);
+            mirror.swap(this->mirror);
+        }
+    }
+
     std::unique_ptr<std::thread> thread;
 
     {
@@ -152,6 +171,14 @@ bool RemoteLibrary::IsConfigured() {
     return prefs->GetBool(core::prefs::keys::RemoteLibraryViewed, false);
 }
 
+static inline bool canRunOnMirror(RemoteLibrary::QueryPtr candidate) {
+    const std::string name = candidate->Name();
+    return
+        !candidate->IsMutating() &&
+        name != query::LibraryChangesQuery::kQueryName &&
+        name != query::LyricsQuery::kQueryName;
+}
+
 static inline bool isQueryDone(RemoteLibrary::Query query) {
     switch (query->GetStatus()) {
         case IQuery::Idle:
@@ -162,20 +189,6 @@ static inline bool isQueryDone(RemoteLibrary::Query query) {
     }
 }
 
-bool RemoteLibrary::IsQueryInFlight(Query query) {
-    for (auto& kv : this->queriesInFlight) {
-        if (query == kv.second->query) {
-            return true;
-        }
-    }
-    for (const auto& queryContext : this->queryQueue) {
-        if (queryContext->query == query) {
-            return true;
-        }
-    }
-    return false;
-}
-
 int RemoteLibrary::Enqueue(QueryPtr query, Callback callback) {
     return this->EnqueueAndWait(query, 0LL, callback);
 }
@@ -198,25 +211,59 @@ int RemoteLibrary::EnqueueAndWait(QueryPtr query, size_t timeoutMs, Callback cal
         auto context = std::make_shared<QueryContext>();
         context->query = serializableQuery;
         context->callback = callback;
+        context->cacheGeneration = this->cacheGeneration.load();
+
+        auto mirror = this->GetMirror();
+
+        if (query->IsMutating()) {
+            this->InvalidateCache();
+            if (mirror) {
+                /* reads go to the server until the mirror catches up */
+                mirror->Suspend();
+            }
+        }
+        else if (
+            mirror && mirror->IsCurrent() && canRunOnMirror(query) &&
+            dynamic_cast<query::QueryBase*>(query.get()))
+        {
+            context->mirror = mirror;
+        }
+        else if (query->Name() != query::LibraryChangesQuery::kQueryName) {
+            /* read-only queries with identical parameters are interchangeable, so
+            they can be answered from the cache, or share a single round trip with
+            an identical query that's already in flight */
+            context->key = query->Name() + ":" + serializableQuery->SerializeQuery();
+        }
 
-        queryQueue.push_back(context);
-        queueCondition.notify_all();
+        if (context->key.size() && this->TryCompleteFromCache(context)) {
+            context->completed = true;
+            this->OnQueryCompleted(context);
+            return query->GetId();
+        }
+
+        auto leader = context->key.size()
+            ? this->queriesInFlightByKey.find(context->key)
+            : this->queriesInFlightByKey.end();
+
+        if (leader != this->queriesInFlightByKey.end()) {
+            leader->second->followers.push_back(context);
+        }
+        else {
+            if (context->key.size()) {
+                this->queriesInFlightByKey[context->key] = context;
+            }
+            queryQueue.push_back(context);
+            queueCondition.notify_all();
+        }
 
         if (timeoutMs > 0) {
-            while (
-                !this->exit &&
-                this->IsQueryInFlight(context->query) &&
-                !isQueryDone(context->query))
-            {
+            const auto deadline = steady_clock::now() + timeoutMs * milliseconds(1);
+            while (!this->exit && !context->completed) {
                 if (timeoutMs == kWaitIndefinite) {
                     this->syncQueryCondition.wait(lock);
-                    break;
                 }
-                else {
-                    const auto result = this->syncQueryCondition.wait_for(lock, timeoutMs * milliseconds(1));
-                    if (result == std::cv_status::timeout) {
-                        break;
-                    }
+                else if (this->syncQueryCondition.wait_until(lock, deadline) == std::cv_status::timeout) {
+                    break;
                 }
             }
         }
@@ -274,18 +321,196 @@ void RemoteLibrary::OnQueryCompleted(const std::string& messageId, Query query)
 
     {
         std::unique_lock<std::recursive_mutex> lock(this->queueMutex);
-        context = queriesInFlight[messageId];
-        queriesInFlight.erase(messageId);
+        auto it = queriesInFlight.find(messageId);
+        if (it != queriesInFlight.end()) {
+            context = it->second;
+            queriesInFlight.erase(it);
+        }
     }
 
     if (context) {
-        this->OnQueryCompleted(context);
+        this->FinishQuery(context);
+    }
+}
+
+void RemoteLibrary::FinishQuery(QueryContextPtr context) {
+    std::vector<QueryContextPtr> followers;
+
+    {
+        std::unique_lock<std::recursive_mutex> lock(this->queueMutex);
+        if (context->key.size()) {
+            auto it = this->queriesInFlightByKey.find(context->key);
+            if (it != this->queriesInFlightByKey.end() && it->second == context) {
+                this->queriesInFlightByKey.erase(it);
+            }
+        }
+        std::swap(followers, context->followers);
+    }
+
+    auto query = context->query;
+
+    if (!isQueryDone(query)) {
+        query->Invalidate();
+    }
+
+    if (query->IsMutating()) {
+        this->InvalidateCache();
+        auto mirror = this->GetMirror();
+        if (mirror) {
+            mirror->Invalidate();
+        }
+    }
+
+    /* serialize the result once, then use it to populate the cache and any
+    identical queries that were waiting on this one */
+    std::string data;
+    bool binary = false;
+    bool serialized = false;
+
+    if (query->GetStatus() == IQuery::Finished &&
+        context->key.size() &&
+        (followers.size() || this->cacheEnabled))
+    {
+        try {
+            binary = query->SerializeResultBinary(data);
+            if (!binary) {
+                data = query->SerializeResult();
+            }
+            serialized = true;
+        }
+        catch (...) {
+            musik::debug::warning(TAG, "failed to serialize result for " + query->Name());
+        }
+    }
+
+    for (auto& follower : followers) {
+        try {
+            if (!serialized) {
+                follower->query->Invalidate();
+            }
+            else if (binary) {
+                follower->query->DeserializeResultBinary(data);
+            }
+            else {
+                follower->query->DeserializeResult(data);
+            }
+        }
+        catch (...) {
+            follower->query->Invalidate();
+        }
+    }
+
+    {
+        std::unique_lock<std::recursive_mutex> lock(this->queueMutex);
+        if (serialized) {
+            this->CacheResult(context, data, binary);
+        }
+        context->completed = true;
+        for (auto& follower : followers) {
+            follower->completed = true;
+        }
+    }
+
+    this->OnQueryCompleted(context);
+    for (auto& follower : followers) {
+        this->OnQueryCompleted(follower);
     }
 
     this->syncQueryCondition.notify_all();
 }
 
+bool RemoteLibrary::TryCompleteFromCache(QueryContextPtr context) {
+    std::unique_lock<std::recursive_mutex> lock(this->queueMutex);
+
+    auto it = this->cachedResults.find(context->key);
+    if (it == this->cachedResults.end()) {
+        return false;
+    }
+
+    auto& entry = it->second;
+    bool hit = this->cacheEnabled && entry.cacheGeneration == this->cacheGeneration;
+
+    if (hit) {
+        try {
+            if (entry.binary) {
+                context->query->DeserializeResultBinary(entry.data);
+            }
+            else {
+                context->query->DeserializeResult(entry.data);
+            }
+        }
+        catch (...) {
+            hit = false;
+        }
+    }
+
+    if (hit) {
+        this->cachedResultOrder.splice(
+            this->cachedResultOrder.begin(), this->cachedResultOrder, entry.position);
+    }
+    else {
+        this->cachedResultBytes -= entry.data.size();
+        this->cachedResultOrder.erase(entry.position);
+        this->cachedResults.erase(it);
+    }
+
+    return hit;
+}
+
+void RemoteLibrary::CacheResult(QueryContextPtr context, const std::string& data, bool binary) {
+    std::unique_lock<std::recursive_mutex> lock(this->queueMutex);
+
+    /* the library may have changed while this query was in flight, in which
+    case its result is potentially stale and must not be cached */
+    if (!this->cacheEnabled ||
+        context->cacheGeneration != this->cacheGeneration ||
+        data.size() > kMaxCachedResultBytes / 4)
+    {
+        return;
+    }
+
+    auto existing = this->cachedResults.find(context->key);
+    if (existing != this->cachedResults.end()) {
+        this->cachedResultBytes -= existing->second.data.size();
+        this->cachedResultOrder.erase(existing->second.position);
+        this->cachedResults.erase(existing);
+    }
+
+    this->cachedResultOrder.push_front(context->key);
+    auto& entry = this->cachedResults[context->key];
+    entry.data = data;
+    entry.binary = binary;
+    entry.cacheGeneration = context->cacheGeneration;
+    entry.position = this->cachedResultOrder.begin();
+    this->cachedResultBytes += data.size();
+
+    while (this->cachedResults.size() > kMaxCachedResults ||
+           this->cachedResultBytes > kMaxCachedResultBytes)
+    {
+        auto oldest = this->cachedResults.find(this->cachedResultOrder.back());
+        this->cachedResultBytes -= oldest->second.data.size();
+        this->cachedResults.erase(oldest);
+        this->cachedResultOrder.pop_back();
+    }
+}
+
+void RemoteLibrary::InvalidateCache() {
+    /* lock-free: stale entries are discarded lazily when they're next looked up,
+    and results for queries that were sent before this point won't be cached. */
+    ++this->cacheGeneration;
+}
+
 void RemoteLibrary::RunQuery(QueryContextPtr context) {
+    if (context->mirror) {
+        /* if the mirror went stale since the query was enqueued, send it to
+        the server instead */
+        auto localQuery = dynamic_cast<query::QueryBase*>(context->query.get());
+        if (context->mirror->Run(*localQuery)) {
+            this->FinishQuery(context);
+            return;
+        }
+    }
+
     std::unique_lock<std::recursive_mutex> lock(this->queueMutex);
 #if 0
     this->RunQueryOnLoopback(context);
@@ -309,7 +534,7 @@ void RemoteLibrary::RunQueryOnLoopback(QueryContextPtr context) {
             context->query->Name(), context->query->SerializeQuery(), localLibrary);
 
         if (!localQuery) {
-            OnQueryCompleted(context);
+            this->FinishQuery(context);
             return;
         }
 
@@ -318,9 +543,15 @@ void RemoteLibrary::RunQueryOnLoopback(QueryContextPtr context) {
             kWaitIndefinite,
             [this, context, localQuery](auto result) {
             if (localQuery->GetStatus() == IQuery::Finished) {
-                context->query->DeserializeResult(localQuery->SerializeResult());
+                std::string binary;
+                if (localQuery->SerializeResultBinary(binary)) {
+                    context->query->DeserializeResultBinary(binary);
+                }
+                else {
+                    context->query->DeserializeResult(localQuery->SerializeResult());
+                }
             }
-            this->OnQueryCompleted(context);
+            this->FinishQuery(context);
         });
     }
 }
@@ -333,8 +564,7 @@ void RemoteLibrary::RunQueryOnWebSocketClient(QueryContextPtr context) {
         }
         else {
             context->query->Invalidate();
-            this->OnQueryCompleted(context);
-            this->syncQueryCondition.notify_all();
+            this->FinishQuery(context);
         }
     }
 }
@@ -380,6 +610,24 @@ void RemoteLibrary::OnClientInvalidPassword(Client* client) {
 }
 
 void RemoteLibrary::OnClientStateChanged(Client* client, State newState, State oldState) {
+    /* we can't know what changed on the server while we weren't connected, and
+    only newer servers tell us when their library changes. */
+    this->InvalidateCache();
+    this->lastLibraryGeneration = -1;
+    this->cacheEnabled =
+        newState == State::Connected &&
+        this->wsc.LastServerApiVersion() >= kLibraryChangedApiVersion;
+
+    auto mirror = this->GetMirror();
+    if (mirror) {
+        if (newState == State::Connected && this->wsc.LastServerApiVersion() >= kLibraryChangesApiVersion) {
+            mirror->Invalidate();
+        }
+        else {
+            mirror->Suspend();
+        }
+    }
+
     static std::map<State, ConnectionState> kConnectionStateMap = {
         { State::Disconnected, ConnectionState::Disconnected },
         { State::Disconnecting, ConnectionState::Disconnected },
@@ -412,6 +660,16 @@ void RemoteLibrary::OnClientQueryFailed(Client* client, const std::string& messa
     this->OnQueryCompleted(messageId, query);
 }
 
+void RemoteLibrary::OnClientLibraryChanged(Client* client, int64_t generation) {
+    if (this->lastLibraryGeneration.exchange(generation) != generation) {
+        this->InvalidateCache();
+        auto mirror = this->GetMirror();
+        if (mirror) {
+            mirror->Invalidate();
+        }
+    }
+}
+
 /* RemoteLibrary::RemoteResourceLocator */
 
 std::string RemoteLibrary::GetTrackUri(musik::core::sdk::ITrack* track, const std::string& defaultUri) {
@@ -469,5 +727,60 @@ void RemoteLibrary::ReloadConnectionFromPreferences() {
     const auto port = narrow_cast<unsigned short>(prefs->GetInt(core::prefs::keys::RemoteLibraryWssPort, 7905));
     auto password = prefs->GetString(core::prefs::keys::RemoteLibraryPassword, "");
     const auto useTls = prefs->GetBool(core::prefs::keys::RemoteLibraryWssTls, false);
+    this->ReloadMirrorFromPreferences();
     this->wsc.Connect(host, port, password, useTls);
+}
+
+std::shared_ptr<LibraryMirror> RemoteLibrary::GetMirror() {
+    std::unique_lock<std::mutex> lock(this->mirrorMutex);
+    return this->mirror;
+}
+
+void RemoteLibrary::ReloadMirrorFromPreferences() {
+    auto prefs = Preferences::ForComponent(core::prefs::components::Settings);
+
+    std::string filename;
+
+    if (prefs->GetBool(core::prefs::keys::RemoteLibraryMirrorEnabled, false)) {
+        /* one mirror per server */
+        std::string server =
+            prefs->GetString(core::prefs::keys::RemoteLibraryHostname, "127.0.0.1") + "_" +
+            std::to_string(prefs->GetInt(core::prefs::keys::RemoteLibraryWssPort, 7905));
+
+        for (auto& c : server) {
+            if (!isalnum((unsigned char) c) && c != '.' && c != '-') {
+                c = '_';
+            }
+        }
+
+        std::string directory = musik::core::GetDataDirectory() + "mirrors/";
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::u8path(directory), ec);
+        filename = directory + server + ".db";
+    }
+
+    std::shared_ptr<LibraryMirror> previous;
+
+    {
+        std::unique_lock<std::mutex> lock(this->mirrorMutex);
+        if (this->mirror && this->mirror->Filename() == filename) {
+            return;
+        }
+        previous = this->mirror;
+        this->mirror.reset();
+        if (filename.size()) {
+            this->mirror = std::make_shared<LibraryMirror>(*this, filename);
+        }
+    }
+
+    /* stops the previous mirror's sync thread (if it's not in use) */
+    previous.reset();
+
+    auto mirror = this->GetMirror();
+    if (mirror &&
+        this->wsc.ConnectionState() == Client::State::Connected &&
+        this->wsc.LastServerApiVersion() >= kLibraryChangesApiVersion)
+    {
+        mirror->Invalidate();
+    }
 }
\ No newline at end of file
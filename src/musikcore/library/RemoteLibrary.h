@@ -40,6 +40,7 @@
 #include <musikcore/library/ILibrary.h>
 #include <musikcore/library/IIndexer.h>
 #include <musikcore/library/IQuery.h>
+#include <musikcore/library/LibraryMirror.h>
 #include <musikcore/net/WebSocketClient.h>
 
 #include <thread>
@@ -47,6 +48,9 @@
 #include <condition_variable>
 #include <unordered_map>
 #include <string>
+#include <list>
+#include <vector>
+#include <atomic>
 
 namespace musik { namespace core { namespace library {
 
@@ -90,6 +94,7 @@ namespace musik { namespace core { namespace library {
             void OnClientStateChanged(Client* client, State newState, State oldState) override;
             void OnClientQuerySucceeded(Client* client, const std::string& messageId, Query query) override;
             void OnClientQueryFailed(Client* client, const std::string& messageId, Query query, Client::QueryError reason) override;
+            void OnClientLibraryChanged(Client* client, int64_t generation) override;
 
             /* IResourceLocator */
             std::string GetTrackUri(musik::core::sdk::ITrack* track, const std::string& defaultUri) override;
@@ -104,6 +109,18 @@ namespace musik { namespace core { namespace library {
             struct QueryContext {
                 std::shared_ptr<musik::core::db::ISerializableQuery> query;
                 Callback callback;
+                std::string key; /* query name + serialized query; empty if not shareable */
+                std::shared_ptr<LibraryMirror> mirror; /* set if the query should run locally */
+                int64_t cacheGeneration{ 0 };
+                bool completed{ false };
+                std::vector<std::shared_ptr<QueryContext>> followers;
+            };
+
+            struct CachedResult {
+                std::string data;
+                bool binary{ false };
+                int64_t cacheGeneration{ 0 };
+                std::list<std::string>::iterator position;
             };
 
             using QueryContextPtr = std::shared_ptr<QueryContext>;
@@ -116,8 +133,14 @@ namespace musik { namespace core { namespace library {
             void OnQueryCompleted(const std::string& messageId, Query query);
             void OnQueryCompleted(QueryContextPtr context);
             void NotifyQueryCompleted(QueryContextPtr context);
+            void FinishQuery(QueryContextPtr context);
+
+            bool TryCompleteFromCache(QueryContextPtr context);
+            void CacheResult(QueryContextPtr context, const std::string& data, bool binary);
+            void InvalidateCache();
 
-            bool IsQueryInFlight(Query query);
+            std::shared_ptr<LibraryMirror> GetMirror();
+            void ReloadMirrorFromPreferences();
 
             void ThreadProc();
             QueryContextPtr GetNextQuery();
@@ -132,6 +155,17 @@ namespace musik { namespace core { namespace library {
             std::string name;
 
             std::unordered_map<std::string, QueryContextPtr> queriesInFlight;
+            std::unordered_map<std::string, QueryContextPtr> queriesInFlightByKey;
+
+            std::unordered_map<std::string, CachedResult> cachedResults;
+            std::list<std::string> cachedResultOrder;
+            size_t cachedResultBytes{ 0 };
+            std::atomic<int64_t> cacheGeneration{ 0 };
+            std::atomic<int64_t> lastLibraryGeneration{ -1 };
+            std::atomic<bool> cacheEnabled{ false };
+
+            std::shared_ptr<LibraryMirror> mirror;
+            std::mutex mirrorMutex;
 
             std::unique_ptr<std::thread> thread;
             std::condition_variable_any queueCondition, syncQueryCondition;
@@ -0,0 +1,170 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "pch.hpp"
+
+#include <musikcore/library/TrackWriteQueue.h>
+#include <musikcore/db/Statement.h>
+
+#include <algorithm>
+
+using namespace musik::core::db;
+using namespace musik::core::library;
+using namespace std::chrono;
+
+void TrackWriteQueue::MarkPlayed(int64_t trackId) {
+    const int64_t now = duration_cast<milliseconds>(
+        system_clock::now().time_since_epoch()).count();
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->writes.empty()) {
+        this->oldest = Clock::now();
+    }
+    Write& write = this->writes[trackId];
+    ++write.playCount;
+    write.lastPlayedMs = now;
+}
+
+void TrackWriteQueue::SetRating(int64_t trackId, int rating) {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->writes.empty()) {
+        this->oldest = Clock::now();
+    }
+    this->writes[trackId].rating = rating;
+}
+
+bool TrackWriteQueue::Empty() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    return this->writes.empty();
+}
+
+int64_t TrackWriteQueue::PendingMs() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->writes.empty()) {
+        return 0;
+    }
+    return duration_cast<milliseconds>(Clock::now() - this->oldest).count();
+}
+
+bool TrackWriteQueue::PendingRating(int64_t trackId, int& rating) {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    for (auto* map : { &this->writes, &this->flushing }) { /* newest first */
+        auto it = map->find(trackId);
+        if (it != map->end() && it->second.rating >= 0) {
+            rating = it->second.rating;
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t TrackWriteQueue::Flush(Connection& db) {
+    /* held until the transaction commits, so a caller that finds the queue
+    empty still waits for an in-flight flush to land */
+    std::unique_lock<std::mutex> flushLock(this->flushMutex);
+
+    Clock::time_point queued;
+
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        std::swap(this->flushing, this->writes);
+        queued = this->oldest;
+    }
+
+    if (this->flushing.empty()) {
+        return 0;
+    }
+
+    /* not a ScopedTransaction: we need to know if it actually committed */
+    const bool began = db.Execute("BEGIN IMMEDIATE TRANSACTION") == Okay;
+    bool ok = began;
+
+    if (began) {
+        Statement played(
+            "UPDATE tracks "
+            "SET play_count=(play_count+?), last_played=julianday(? / 1000.0, 'unixepoch') "
+            "WHERE id=?",
+            db);
+
+        Statement rated("UPDATE tracks SET rating=? WHERE id=?", db);
+
+        for (auto& it : this->flushing) {
+            const Write& write = it.second;
+
+            if (ok && write.playCount > 0) {
+                played.Reset();
+                played.BindInt32(0, write.playCount);
+                played.BindInt64(1, write.lastPlayedMs);
+                played.BindInt64(2, it.first);
+                ok = played.Step() == Done;
+            }
+
+            if (ok && write.rating >= 0) {
+                rated.Reset();
+                rated.BindInt32(0, write.rating);
+                rated.BindInt64(1, it.first);
+                ok = rated.Step() == Done;
+            }
+        }
+    }
+
+    if (ok) {
+        ok = db.Execute("COMMIT TRANSACTION") == Okay;
+    }
+
+    if (began && !ok) {
+        db.Execute("ROLLBACK TRANSACTION");
+    }
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    if (!ok) {
+        /* put the batch back, underneath anything queued since */
+        for (auto& it : this->flushing) {
+            Write& write = this->writes[it.first];
+            write.playCount += it.second.playCount;
+            write.lastPlayedMs = std::max(write.lastPlayedMs, it.second.lastPlayedMs);
+            if (write.rating < 0) {
+                write.rating = it.second.rating;
+            }
+        }
+        this->oldest = queued;
+        this->flushing.clear();
+        return 0;
+    }
+
+    const size_t count = this->flushing.size();
+    this->flushing.clear();
+    return count;
+}
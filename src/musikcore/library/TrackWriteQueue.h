@@ -0,0 +1,90 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <musikcore/config.h>
+#include <musikcore/db/Connection.h>
+#include <musikcore/support/DeleteDefaults.h>
+
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+
+namespace musik { namespace core { namespace library {
+
+    /* a write-behind buffer for small, frequent track updates (play counts
+    and ratings). updates are coalesced per track and applied in a single
+    transaction when the owning library calls Flush(), so callers never
+    wait on a database write. */
+    class TrackWriteQueue {
+        public:
+            DELETE_COPY_AND_ASSIGNMENT_DEFAULTS(TrackWriteQueue)
+
+            TrackWriteQueue() noexcept { }
+
+            void MarkPlayed(int64_t trackId);
+            void SetRating(int64_t trackId, int rating);
+
+            bool Empty();
+
+            /* milliseconds since the oldest pending update was queued */
+            int64_t PendingMs();
+
+            /* true if a rating for the track has been queued (or is being
+            written) but hasn't been committed yet; lets reads see it. */
+            bool PendingRating(int64_t trackId, int& rating);
+
+            /* writes all pending updates, returns the number of tracks updated.
+            concurrent calls are serialized. if the transaction fails (e.g. the
+            database stays busy) the updates are kept for the next call. */
+            size_t Flush(musik::core::db::Connection& db);
+
+        private:
+            using Clock = std::chrono::steady_clock;
+
+            struct Write {
+                int playCount{ 0 };
+                int64_t lastPlayedMs{ 0 }; /* unix epoch */
+                int rating{ -1 };
+            };
+
+            std::mutex mutex;
+            std::mutex flushMutex;
+            std::unordered_map<int64_t, Write> writes;
+            std::unordered_map<int64_t, Write> flushing; /* taken by Flush(), not yet committed */
+            Clock::time_point oldest;
+    };
+
+} } }
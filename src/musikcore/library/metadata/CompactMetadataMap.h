@@ -0,0 +1,143 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "InternedString.h"
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+namespace musik { namespace core {
+
+    /* a small, flat multimap of interned key/value pairs. entries are kept
+    sorted by key (and in insertion order for duplicate keys), which gives
+    us the same iteration and lookup semantics as the std::multimap it
+    replaces, but with a single contiguous allocation per track and cheap
+    copies: copying the map is just a handful of atomic reference count
+    increments, no string data is duplicated. */
+    class CompactMetadataMap {
+        public:
+            using key_type = InternedString;
+            using mapped_type = InternedString;
+            using value_type = std::pair<InternedString, InternedString>;
+            using Storage = std::vector<value_type>;
+            using iterator = Storage::iterator;
+            using const_iterator = Storage::const_iterator;
+            using size_type = Storage::size_type;
+
+            CompactMetadataMap() = default;
+            CompactMetadataMap(const CompactMetadataMap&) = default;
+            CompactMetadataMap(CompactMetadataMap&&) noexcept = default;
+            CompactMetadataMap& operator=(const CompactMetadataMap&) = default;
+            CompactMetadataMap& operator=(CompactMetadataMap&&) noexcept = default;
+
+            iterator begin() noexcept { return entries.begin(); }
+            iterator end() noexcept { return entries.end(); }
+            const_iterator begin() const noexcept { return entries.begin(); }
+            const_iterator end() const noexcept { return entries.end(); }
+            size_type size() const noexcept { return entries.size(); }
+            bool empty() const noexcept { return entries.empty(); }
+            void clear() noexcept { entries.clear(); }
+            void reserve(size_type count) { entries.reserve(count); }
+
+            /* returns the first value for the specified key */
+            iterator find(std::string_view key) {
+                auto it = this->LowerBound(key);
+                return (it != entries.end() && it->first.str() == key) ? it : entries.end();
+            }
+
+            const_iterator find(std::string_view key) const {
+                return const_cast<CompactMetadataMap*>(this)->find(key);
+            }
+
+            std::pair<iterator, iterator> equal_range(std::string_view key) {
+                return std::make_pair(this->LowerBound(key), this->UpperBound(key));
+            }
+
+            size_type count(std::string_view key) const {
+                auto range = const_cast<CompactMetadataMap*>(this)->equal_range(key);
+                return (size_type) std::distance(range.first, range.second);
+            }
+
+            /* multimap semantics: adds a new entry after any existing entries
+            with the same key */
+            iterator insert(value_type&& value) {
+                auto it = this->UpperBound(value.first.str());
+                return entries.insert(it, std::move(value));
+            }
+
+            iterator insert(const std::pair<std::string, std::string>& value) {
+                return this->insert(value_type(
+                    InternedString(value.first), InternedString(value.second)));
+            }
+
+            /* map semantics: replaces all existing values for the key */
+            void set(const std::string& key, const std::string& value) {
+                this->erase(key);
+                this->insert(std::make_pair(key, value));
+            }
+
+            size_type erase(std::string_view key) {
+                auto range = this->equal_range(key);
+                const size_type count = (size_type) std::distance(range.first, range.second);
+                entries.erase(range.first, range.second);
+                return count;
+            }
+
+            /* releases excess capacity; useful once a track has been fully
+            populated and is about to sit in a cache */
+            void shrink_to_fit() { entries.shrink_to_fit(); }
+
+        private:
+            static bool KeyLess(const value_type& entry, std::string_view key) {
+                return entry.first.str() < key;
+            }
+
+            static bool LessKey(std::string_view key, const value_type& entry) {
+                return key < entry.first.str();
+            }
+
+            iterator LowerBound(std::string_view key) {
+                return std::lower_bound(entries.begin(), entries.end(), key, &KeyLess);
+            }
+
+            iterator UpperBound(std::string_view key) {
+                return std::upper_bound(entries.begin(), entries.end(), key, &LessKey);
+            }
+
+            Storage entries;
+    };
+
+} }
@@ -0,0 +1,194 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "pch.hpp"
+#include "InternedString.h"
+
+#include <mutex>
+#include <unordered_map>
+
+using namespace musik::core;
+
+static const std::string kEmpty;
+static constexpr size_t kShardCount = 16;
+
+struct InternedString::Entry {
+    Entry(std::string_view value, size_t hash): value(value), hash(hash), refs(1) { }
+    const std::string value;
+    const size_t hash;
+    std::atomic<int> refs;
+};
+
+namespace {
+    /* the pool is split into a handful of independently locked shards so
+    the indexer and the library thread don't serialize on a single mutex
+    while materializing tracks. */
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string_view, InternedString::Entry*> entries;
+        size_t bytes { 0 };
+    };
+
+    static Shard& shardFor(size_t hash) {
+        /* intentionally leaked: handles may outlive static destruction order */
+        static Shard* shards = new Shard[kShardCount];
+        return shards[hash % kShardCount];
+    }
+}
+
+InternedString::InternedString(const char* value): entry(nullptr) {
+    if (value) {
+        this->Acquire(std::string_view(value));
+    }
+}
+
+InternedString::InternedString(const std::string& value): entry(nullptr) {
+    this->Acquire(std::string_view(value));
+}
+
+InternedString::InternedString(std::string_view value): entry(nullptr) {
+    this->Acquire(value);
+}
+
+InternedString::InternedString(const InternedString& other) noexcept
+: entry(other.entry) {
+    if (entry) {
+        entry->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+InternedString::InternedString(InternedString&& other) noexcept
+: entry(other.entry) {
+    other.entry = nullptr;
+}
+
+InternedString::~InternedString() {
+    this->Release();
+}
+
+InternedString& InternedString::operator=(const InternedString& other) noexcept {
+    if (this->entry != other.entry) {
+        if (other.entry) {
+            other.entry->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+        this->Release();
+        this->entry = other.entry;
+    }
+    return *this;
+}
+
+InternedString& InternedString::operator=(InternedString&& other) noexcept {
+    if (this != &other) {
+        this->Release();
+        this->entry = other.entry;
+        other.entry = nullptr;
+    }
+    return *this;
+}
+
+const std::string& InternedString::str() const noexcept {
+    return entry ? entry->value : kEmpty;
+}
+
+size_t InternedString::Hash() const noexcept {
+    return std::hash<const Entry*>()(entry);
+}
+
+void InternedString::Acquire(std::string_view value) {
+    if (value.empty()) {
+        return;
+    }
+
+    const size_t hash = std::hash<std::string_view>()(value);
+    Shard& shard = shardFor(hash);
+    std::unique_lock<std::mutex> lock(shard.mutex);
+
+    auto it = shard.entries.find(value);
+    if (it != shard.entries.end()) {
+        it->second->refs.fetch_add(1, std::memory_order_relaxed);
+        this->entry = it->second;
+    }
+    else {
+        this->entry = new Entry(value, hash);
+        shard.entries[std::string_view(this->entry->value)] = this->entry;
+        shard.bytes += value.size();
+    }
+}
+
+void InternedString::Release() noexcept {
+    if (!entry) {
+        return;
+    }
+
+    /* fast path: we're not the last reference, so we can decrement without
+    taking the shard lock. the 1 -> 0 transition must happen under the lock,
+    otherwise a concurrent Acquire() could resurrect an entry we're about to
+    delete. */
+    int refs = entry->refs.load(std::memory_order_relaxed);
+    while (refs > 1) {
+        if (entry->refs.compare_exchange_weak(refs, refs - 1, std::memory_order_acq_rel)) {
+            entry = nullptr;
+            return;
+        }
+    }
+
+    Shard& shard = shardFor(entry->hash);
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    if (entry->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        shard.entries.erase(std::string_view(entry->value));
+        shard.bytes -= entry->value.size();
+        delete entry;
+    }
+    entry = nullptr;
+}
+
+size_t InternedString::PoolSize() {
+    size_t total = 0;
+    for (size_t i = 0; i < kShardCount; i++) {
+        Shard& shard = shardFor(i);
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        total += shard.entries.size();
+    }
+    return total;
+}
+
+size_t InternedString::PoolBytes() {
+    size_t total = 0;
+    for (size_t i = 0; i < kShardCount; i++) {
+        Shard& shard = shardFor(i);
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        total += shard.bytes;
+    }
+    return total;
+}
@@ -0,0 +1,102 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <atomic>
+#include <functional>
+
+namespace musik { namespace core {
+
+    /* an immutable, reference counted handle to a string that lives in a
+    process-wide pool. metadata keys and values are extremely repetitive
+    across tracks ("artist", "album", genre names, etc), so instead of
+    every track carrying its own copy we store each distinct string once
+    and share it. copying an InternedString is a single atomic increment,
+    and two handles are equal if and only if they point to the same entry. */
+    class InternedString {
+        public:
+            struct Entry;
+
+            InternedString() noexcept: entry(nullptr) { }
+            InternedString(const char* value);
+            InternedString(const std::string& value);
+            InternedString(std::string_view value);
+            InternedString(const InternedString& other) noexcept;
+            InternedString(InternedString&& other) noexcept;
+            ~InternedString();
+
+            InternedString& operator=(const InternedString& other) noexcept;
+            InternedString& operator=(InternedString&& other) noexcept;
+
+            const std::string& str() const noexcept;
+            const char* c_str() const noexcept { return str().c_str(); }
+            size_t size() const noexcept { return str().size(); }
+            bool empty() const noexcept { return entry == nullptr; }
+
+            operator const std::string&() const noexcept { return str(); }
+
+            bool operator==(const InternedString& other) const noexcept { return entry == other.entry; }
+            bool operator!=(const InternedString& other) const noexcept { return entry != other.entry; }
+            bool operator==(const std::string& other) const noexcept { return str() == other; }
+            bool operator!=(const std::string& other) const noexcept { return str() != other; }
+            bool operator==(const char* other) const noexcept { return str() == other; }
+            bool operator!=(const char* other) const noexcept { return str() != other; }
+            bool operator<(const InternedString& other) const noexcept { return str() < other.str(); }
+
+            size_t Hash() const noexcept;
+
+            /* diagnostics: number of distinct strings currently in the
+            pool, and the sum of their lengths */
+            static size_t PoolSize();
+            static size_t PoolBytes();
+
+        private:
+            void Acquire(std::string_view value);
+            void Release() noexcept;
+
+            Entry* entry;
+    };
+
+} }
+
+namespace std {
+    template <> struct hash<musik::core::InternedString> {
+        size_t operator()(const musik::core::InternedString& s) const noexcept {
+            return s.Hash();
+        }
+    };
+}
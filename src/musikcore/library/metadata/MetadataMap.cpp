@@ -96,7 +96,7 @@ musik::core::sdk::IResource::Class MetadataMap::GetClass() {
 int MetadataMap::GetString(const char* key, char* dst, int size) {
     auto it = metadata.find(key);
     if (it != metadata.end()) {
-        return (int) CopyString(it->second, dst, (size_t) size);
+        return (int) CopyString(it->second.str(), dst, (size_t) size);
     }
 
     if (dst && size > 0) {
@@ -163,7 +163,7 @@ const char* MetadataMap::GetType() {
 }
 
 void MetadataMap::Set(const char* key, const std::string& value) {
-    this->metadata[key] = value;
+    this->metadata.set(key, value);
 }
 
 musik::core::sdk::IMap* MetadataMap::GetSdkValue() {
@@ -172,6 +172,6 @@ musik::core::sdk::IMap* MetadataMap::GetSdkValue() {
 
 void MetadataMap::Each(std::function<void(const std::string&, const std::string&)> callback) {
     for (auto& kv : this->metadata) {
-        callback(kv.first, kv.second);
+        callback(kv.first.str(), kv.second.str());
     }
 }
\ No newline at end of file
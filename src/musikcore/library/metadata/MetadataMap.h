@@ -35,8 +35,8 @@
 #pragma once
 
 #include <musikcore/sdk/IMap.h>
+#include "CompactMetadataMap.h"
 #include <string>
-#include <unordered_map>
 #include <memory>
 #include <functional>
 
@@ -78,8 +78,9 @@ namespace musik { namespace core {
 
         private:
             int64_t id;
-            std::string type, value;
-            std::unordered_map<std::string, std::string> metadata;
+            InternedString type;
+            std::string value;
+            CompactMetadataMap metadata;
     };
 
     using MetadataMapPtr = std::shared_ptr<MetadataMap>;
@@ -169,6 +169,21 @@ void AlbumListQuery::DeserializeResult(const std::string& data) {
     this->SetStatus(IQuery::Finished);
 }
 
+bool AlbumListQuery::SerializeResultBinary(std::string& output) {
+    BinaryWriter writer;
+    WriteMetadataMapList(writer, *this->result);
+    output = writer.Release();
+    return true;
+}
+
+void AlbumListQuery::DeserializeResultBinary(const std::string& data) {
+    this->SetStatus(IQuery::Failed);
+    BinaryReader reader(data);
+    this->result = std::make_shared<MetadataMapList>();
+    ReadMetadataMapList(reader, *this->result);
+    this->SetStatus(IQuery::Finished);
+}
+
 std::shared_ptr<AlbumListQuery> AlbumListQuery::DeserializeQuery(const std::string& data) {
     nlohmann::json options = nlohmann::json::parse(data)["options"];
     auto result = std::make_shared<AlbumListQuery>();
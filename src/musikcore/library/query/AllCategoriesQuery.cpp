@@ -112,6 +112,21 @@ void AllCategoriesQuery::DeserializeResult(const std::string& data) {
     this->SetStatus(IQuery::Finished);
 }
 
+bool AllCategoriesQuery::SerializeResultBinary(std::string& output) {
+    BinaryWriter writer;
+    WriteValueList(writer, *this->result);
+    output = writer.Release();
+    return true;
+}
+
+void AllCategoriesQuery::DeserializeResultBinary(const std::string& data) {
+    this->SetStatus(IQuery::Failed);
+    BinaryReader reader(data);
+    this->result = std::make_shared<SdkValueList>();
+    ReadValueList(reader, *this->result);
+    this->SetStatus(IQuery::Finished);
+}
+
 std::shared_ptr<AllCategoriesQuery> AllCategoriesQuery::DeserializeQuery(const std::string& data) {
     return std::make_shared<AllCategoriesQuery>();
 }
\ No newline at end of file
@@ -61,6 +61,8 @@ namespace musik { namespace core { namespace library { namespace query {
             std::string SerializeQuery() override;
             std::string SerializeResult() override;
             void DeserializeResult(const std::string& data) override;
+            bool SerializeResultBinary(std::string& output) override;
+            void DeserializeResultBinary(const std::string& data) override;
             static std::shared_ptr<AllCategoriesQuery> DeserializeQuery(const std::string& data);
 
         protected:
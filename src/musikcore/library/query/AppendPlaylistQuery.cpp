@@ -37,6 +37,7 @@
 #include <musikcore/library/track/LibraryTrack.h>
 #include <musikcore/library/query/TrackMetadataQuery.h>
 #include <musikcore/library/query/util/Serialization.h>
+#include <musikcore/library/query/util/PlaylistQueryUtil.h>
 #include <musikcore/library/LocalLibraryConstants.h>
 #include <musikcore/runtime/Message.h>
 #include <musikcore/support/Messages.h>
@@ -59,16 +60,6 @@ using namespace musik::core::runtime;
 
 const std::string AppendPlaylistQuery::kQueryName = "AppendPlaylistQuery";
 
-static std::string INSERT_PLAYLIST_TRACK_QUERY =
-    "INSERT INTO playlist_tracks (track_external_id, source_id, playlist_id, sort_order) "
-    "VALUES (?, ?, ?, ?)";
-
-static std::string UPDATE_OFFSET_QUERY =
-    "UPDATE playlist_tracks SET offset = offset + ? WHERE playlist_id = ? AND offset >= ?";
-
-static std::string GET_MAX_SORT_ORDER_QUERY =
-    "SELECT COALESCE(MAX(sort_order), -1) from playlist_tracks where playlist_id = ?";
-
 AppendPlaylistQuery::AppendPlaylistQuery(
     musik::core::ILibraryPtr library,
     const int64_t playlistId,
@@ -106,55 +97,19 @@ bool AppendPlaylistQuery::OnRun(musik::core::db::Connection &db) {
 
     ScopedTransaction transaction(db);
 
-    int offset = this->offset;
-
-    if (offset < 0) {
-        /* get the max offset, we're appending to the end and don't want
-        to screw up our sort order! */
-        Statement queryMax(GET_MAX_SORT_ORDER_QUERY.c_str(), db);
-        queryMax.BindInt64(0, playlistId);
-        if (queryMax.Step() == db::Row) {
-            offset = queryMax.ColumnInt32(0) + 1;
-        }
+    std::vector<int64_t> ids;
+    ids.reserve(tracks->Count());
+    for (size_t i = 0; i < tracks->Count(); i++) {
+        ids.push_back(tracks->GetId(i));
     }
 
+    /* `offset` is the position to insert at; a negative value appends. */
+    std::vector<playlist::Entry> entries;
+    if (!playlist::ResolveTrackIds(db, ids, entries) ||
+        !playlist::Insert(db, playlistId, entries, this->offset))
     {
-        Statement updateOffsets(UPDATE_OFFSET_QUERY.c_str(), db);
-        updateOffsets.BindInt32(0, offset);
-        updateOffsets.BindInt64(1, playlistId);
-        updateOffsets.BindInt32(2, offset);
-
-        if (updateOffsets.Step() == db::Error) {
-            return false;
-        }
-    }
-
-    Statement insertTrack(INSERT_PLAYLIST_TRACK_QUERY.c_str(), db);
-
-    for (size_t i = 0; i < tracks->Count(); i++) {
-        const auto id = tracks->GetId(i);
-        auto target = std::make_shared<LibraryTrack>(id, this->library);
-
-        std::shared_ptr<TrackMetadataQuery> query =
-            std::make_shared<TrackMetadataQuery>(
-                target,
-                this->library,
-                TrackMetadataQuery::Type::IdsOnly);
-
-        this->library->EnqueueAndWait(query);
-
-        if (query->GetStatus() == IQuery::Finished) {
-            auto track = query->Result();
-            insertTrack.Reset();
-            insertTrack.BindText(0, track->GetString("external_id"));
-            insertTrack.BindText(1, track->GetString("source_id"));
-            insertTrack.BindInt64(2, playlistId);
-            insertTrack.BindInt32(3, offset++);
-
-            if (insertTrack.Step() == db::Error) {
-                return false;
-            }
-        }
+        transaction.Cancel();
+        return false;
     }
 
     transaction.CommitAndRestart();
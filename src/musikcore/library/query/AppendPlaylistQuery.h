@@ -61,6 +61,7 @@ namespace musik { namespace core { namespace library { namespace query {
 
             /* IQuery */
             std::string Name() override { return kQueryName; }
+            bool IsMutating() override { return true; }
 
             /* ISerializableQuery */
             std::string SerializeQuery() override;
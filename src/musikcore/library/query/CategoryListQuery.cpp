@@ -274,6 +274,21 @@ void CategoryListQuery::DeserializeResult(const std::string& data) {
     this->SetStatus(IQuery::Finished);
 }
 
+bool CategoryListQuery::SerializeResultBinary(std::string& output) {
+    BinaryWriter writer;
+    WriteValueList(writer, *this->result);
+    output = writer.Release();
+    return true;
+}
+
+void CategoryListQuery::DeserializeResultBinary(const std::string& data) {
+    this->SetStatus(IQuery::Failed);
+    BinaryReader reader(data);
+    this->result = std::make_shared<SdkValueList>();
+    ReadValueList(reader, *this->result);
+    this->SetStatus(IQuery::Finished);
+}
+
 std::shared_ptr<CategoryListQuery> CategoryListQuery::DeserializeQuery(const std::string& data) {
     nlohmann::json options = nlohmann::json::parse(data)["options"];
     std::shared_ptr<CategoryListQuery> result(new CategoryListQuery());
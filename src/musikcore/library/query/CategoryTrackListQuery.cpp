@@ -241,6 +241,17 @@ void CategoryTrackListQuery::DeserializeResult(const std::string& data) {
     this->SetStatus(IQuery::Finished);
 }
 
+bool CategoryTrackListQuery::SerializeResultBinary(std::string& output) {
+    output = this->SerializeBinaryResultWithHeadersAndTrackList();
+    return true;
+}
+
+void CategoryTrackListQuery::DeserializeResultBinary(const std::string& data) {
+    this->SetStatus(IQuery::Failed);
+    this->DeserializeBinaryTrackListAndHeaders(data);
+    this->SetStatus(IQuery::Finished);
+}
+
 std::shared_ptr<CategoryTrackListQuery> CategoryTrackListQuery::DeserializeQuery(
     musik::core::ILibraryPtr library, const std::string& data)
 {
@@ -88,6 +88,8 @@ namespace musik { namespace core { namespace library { namespace query {
             std::string SerializeQuery() override;
             std::string SerializeResult() override;
             void DeserializeResult(const std::string& data) override;
+            bool SerializeResultBinary(std::string& output) override;
+            void DeserializeResultBinary(const std::string& data) override;
             static std::shared_ptr<CategoryTrackListQuery> DeserializeQuery(
                 musik::core::ILibraryPtr library, const std::string& data);
 
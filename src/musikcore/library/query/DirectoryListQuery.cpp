@@ -0,0 +1,127 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "pch.hpp"
+#include "DirectoryListQuery.h"
+
+#include <musikcore/db/Statement.h>
+#include <musikcore/support/Common.h>
+
+#pragma warning(push, 0)
+#include <nlohmann/json.hpp>
+#pragma warning(pop)
+
+using namespace musik::core::db;
+using namespace musik::core::library::query;
+
+const std::string DirectoryListQuery::kQueryName = "DirectoryListQuery";
+
+DirectoryListQuery::DirectoryListQuery(const std::string& directory) {
+    this->directory = directory;
+    this->result = std::make_shared<std::vector<Entry>>();
+}
+
+DirectoryListQuery::Result DirectoryListQuery::GetResult() noexcept {
+    return this->result;
+}
+
+bool DirectoryListQuery::OnRun(Connection& db) {
+    this->result = std::make_shared<std::vector<Entry>>();
+
+    Statement stmt(
+        "SELECT d.name, d.total_track_count, EXISTS ("
+        "  SELECT 1 FROM directories c "
+        "  WHERE c.parent_id=d.id AND c.total_track_count > 0) "
+        "FROM directories d "
+        "WHERE d.total_track_count > 0 AND d.parent_id=("
+        "  SELECT id FROM directories WHERE name=?) "
+        "ORDER BY d.name",
+        db);
+
+    stmt.BindText(0, musik::core::NormalizeDir(this->directory));
+
+    while (stmt.Step() == db::Row) {
+        this->result->push_back({
+            stmt.ColumnText(0),
+            stmt.ColumnInt64(1),
+            stmt.ColumnInt32(2) != 0
+        });
+    }
+
+    return true;
+}
+
+/* ISerializableQuery */
+
+std::string DirectoryListQuery::SerializeQuery() {
+    nlohmann::json output = {
+        { "name", kQueryName },
+        { "options", {
+            { "directory", this->directory }
+        }}
+    };
+    return output.dump();
+}
+
+std::string DirectoryListQuery::SerializeResult() {
+    nlohmann::json entries = nlohmann::json::array();
+    for (auto& entry : *this->result) {
+        entries.push_back({
+            { "path", entry.path },
+            { "trackCount", entry.trackCount },
+            { "hasSubdirectories", entry.hasSubdirectories }
+        });
+    }
+    nlohmann::json output = { { "result", entries } };
+    return output.dump();
+}
+
+void DirectoryListQuery::DeserializeResult(const std::string& data) {
+    this->SetStatus(IQuery::Failed);
+    auto json = nlohmann::json::parse(data);
+    this->result = std::make_shared<std::vector<Entry>>();
+    for (auto& entry : json["result"]) {
+        this->result->push_back({
+            entry.value("path", ""),
+            entry.value("trackCount", (int64_t) 0),
+            entry.value("hasSubdirectories", false)
+        });
+    }
+    this->SetStatus(IQuery::Finished);
+}
+
+std::shared_ptr<DirectoryListQuery> DirectoryListQuery::DeserializeQuery(const std::string& data) {
+    auto options = nlohmann::json::parse(data)["options"];
+    return std::make_shared<DirectoryListQuery>(options.value("directory", ""));
+}
@@ -0,0 +1,84 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <musikcore/support/DeleteDefaults.h>
+#include <musikcore/library/QueryBase.h>
+
+#include <memory>
+#include <vector>
+
+namespace musik { namespace core { namespace library { namespace query {
+
+    /* lists the subdirectories of a library directory, using the directory
+    hierarchy maintained by the indexer instead of the filesystem. only
+    directories that contain visible tracks (at any depth) are returned. */
+    class DirectoryListQuery : public musik::core::library::query::QueryBase {
+        public:
+            static const std::string kQueryName;
+
+            struct Entry {
+                std::string path;
+                int64_t trackCount;
+                bool hasSubdirectories;
+            };
+
+            using Result = std::shared_ptr<std::vector<Entry>>;
+
+            DELETE_CLASS_DEFAULTS(DirectoryListQuery)
+
+            DirectoryListQuery(const std::string& directory);
+
+            Result GetResult() noexcept;
+
+            /* IQuery */
+            std::string Name() override { return kQueryName; }
+
+            /* ISerializableQuery */
+            std::string SerializeQuery() override;
+            std::string SerializeResult() override;
+            void DeserializeResult(const std::string& data) override;
+            static std::shared_ptr<DirectoryListQuery> DeserializeQuery(const std::string& data);
+
+        protected:
+            /* QueryBase */
+            bool OnRun(musik::core::db::Connection &db) override;
+
+        private:
+            std::string directory;
+            Result result;
+    };
+
+} } } }
@@ -36,6 +36,7 @@
 #include <musikcore/library/LocalLibraryConstants.h>
 #include <musikcore/library/query/util/Serialization.h>
 #include <musikcore/i18n/Locale.h>
+#include <musikcore/support/Common.h>
 #include "DirectoryTrackListQuery.h"
 #include "CategoryTrackListQuery.h"
 
@@ -69,18 +70,23 @@ bool DirectoryTrackListQuery::OnRun(Connection& db) {
     this->headers = std::make_shared<std::set<size_t>>();
     this->durations = std::make_shared<std::map<size_t, size_t>>();
 
+    /* walk the directory hierarchy maintained by the indexer to find the
+    specified directory and all of its subdirectories */
     std::string query =
+        " WITH RECURSIVE subdirectories(id) AS ("
+        "   SELECT id FROM directories WHERE name=?"
+        "   UNION ALL"
+        "   SELECT d.id FROM directories d, subdirectories s WHERE d.parent_id=s.id)"
         " SELECT t.id, t.duration, al.name "
         " FROM tracks t, albums al, artists ar, genres gn "
-        " WHERE t.visible=1 AND directory_id IN ("
-        "   SELECT id FROM directories WHERE name LIKE ?)"
+        " WHERE t.visible=1 AND t.directory_id IN subdirectories"
         " AND t.album_id=al.id AND t.visual_genre_id=gn.id AND t.visual_artist_id=ar.id "
         " ORDER BY al.name, disc, track, ar.name ";
 
     query += this->GetLimitAndOffset();
 
     Statement select(query.c_str(), db);
-    select.BindText(0, this->directory + "%");
+    select.BindText(0, musik::core::NormalizeDir(this->directory));
 
     std::string lastAlbum;
     size_t lastHeaderIndex = 0;
@@ -144,6 +150,17 @@ void DirectoryTrackListQuery::DeserializeResult(const std::string& data) {
     this->SetStatus(IQuery::Finished);
 }
 
+bool DirectoryTrackListQuery::SerializeResultBinary(std::string& output) {
+    output = this->SerializeBinaryResultWithHeadersAndTrackList();
+    return true;
+}
+
+void DirectoryTrackListQuery::DeserializeResultBinary(const std::string& data) {
+    this->SetStatus(IQuery::Failed);
+    this->DeserializeBinaryTrackListAndHeaders(data);
+    this->SetStatus(IQuery::Finished);
+}
+
 std::shared_ptr<DirectoryTrackListQuery> DirectoryTrackListQuery::DeserializeQuery(
     ILibraryPtr library, const std::string& data)
 {
@@ -123,6 +123,17 @@ void GetPlaylistQuery::DeserializeResult(const std::string& data) {
     this->SetStatus(IQuery::Finished);
 }
 
+bool GetPlaylistQuery::SerializeResultBinary(std::string& output) {
+    output = this->SerializeBinaryResultWithHeadersAndTrackList();
+    return true;
+}
+
+void GetPlaylistQuery::DeserializeResultBinary(const std::string& data) {
+    this->SetStatus(IQuery::Failed);
+    this->DeserializeBinaryTrackListAndHeaders(data);
+    this->SetStatus(IQuery::Finished);
+}
+
 std::shared_ptr<GetPlaylistQuery> GetPlaylistQuery::DeserializeQuery(
     musik::core::ILibraryPtr library, const std::string& data)
 {
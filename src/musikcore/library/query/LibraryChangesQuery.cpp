@@ -0,0 +1,268 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "pch.hpp"
+#include "LibraryChangesQuery.h"
+
+#include <musikcore/db/Statement.h>
+#include <musikcore/library/query/util/ChangeLog.h>
+
+#include <algorithm>
+
+using namespace musik::core::db;
+using namespace musik::core::library::query;
+
+const std::string LibraryChangesQuery::kQueryName = "LibraryChangesQuery";
+
+static const size_t kMaxLimit = 10000;
+
+static int tableIndex(const std::string& name) {
+    auto& tables = changelog::Tables();
+    auto it = std::find(tables.begin(), tables.end(), name);
+    return it == tables.end() ? -1 : (int) (it - tables.begin());
+}
+
+static std::vector<std::string> columnNames(Statement& stmt) {
+    /* column 0 is always the rowid */
+    std::vector<std::string> result;
+    for (int i = 1; i < stmt.ColumnCount(); i++) {
+        result.push_back(stmt.ColumnName(i));
+    }
+    return result;
+}
+
+static nlohmann::json readRow(Statement& stmt) {
+    nlohmann::json row = nlohmann::json::array();
+    for (int i = 0; i < stmt.ColumnCount(); i++) {
+        switch (stmt.GetColumnType(i)) {
+            case IntegerColumn: row.push_back(stmt.ColumnInt64(i)); break;
+            case FloatColumn: row.push_back(stmt.ColumnDouble(i)); break;
+            case TextColumn: row.push_back(stmt.ColumnText(i)); break;
+            default: row.push_back(nullptr); break; /* no blobs in replicated tables */
+        }
+    }
+    return row;
+}
+
+LibraryChangesQuery::LibraryChangesQuery(int64_t generation, size_t limit) {
+    this->generation = generation;
+    this->afterRowId = 0;
+    this->limit = std::min(std::max(limit, (size_t) 1), kMaxLimit);
+    this->result = std::make_shared<Result>();
+}
+
+LibraryChangesQuery::LibraryChangesQuery(const std::string& table, int64_t afterRowId, size_t limit) {
+    this->generation = 0;
+    this->table = table;
+    this->afterRowId = afterRowId;
+    this->limit = std::min(std::max(limit, (size_t) 1), kMaxLimit);
+    this->result = std::make_shared<Result>();
+}
+
+std::shared_ptr<LibraryChangesQuery::Result> LibraryChangesQuery::GetResult() noexcept {
+    return this->result;
+}
+
+bool LibraryChangesQuery::OnRun(Connection& db) {
+    /* serving mirrors is turned off; clients fall back to regular queries */
+    if (!changelog::Enabled(db)) {
+        return false;
+    }
+
+    this->result = std::make_shared<Result>();
+    return this->table.size() ? this->RunSnapshot(db) : this->RunIncremental(db);
+}
+
+bool LibraryChangesQuery::RunSnapshot(Connection& db) {
+    if (tableIndex(this->table) < 0) {
+        return false;
+    }
+
+    this->result->generation = changelog::Generation(db);
+
+    const std::string query =
+        "SELECT rowid, * FROM " + this->table + " WHERE rowid > ? ORDER BY rowid LIMIT ?";
+
+    Statement stmt(query.c_str(), db);
+    stmt.BindInt64(0, this->afterRowId);
+    stmt.BindInt64(1, (int64_t) this->limit);
+
+    Table output;
+    output.name = this->table;
+    output.rows = nlohmann::json::array();
+    while (stmt.Step() == Row) {
+        if (output.columns.empty()) {
+            output.columns = columnNames(stmt);
+        }
+        output.rows.push_back(readRow(stmt));
+    }
+
+    this->result->more = output.rows.size() == this->limit;
+    this->result->tables.push_back(std::move(output));
+    return true;
+}
+
+bool LibraryChangesQuery::RunIncremental(Connection& db) {
+    const int64_t current = changelog::Generation(db);
+
+    if (this->generation < 0 ||
+        this->generation < changelog::Floor(db) ||
+        this->generation > current)
+    {
+        /* we don't have (all of) the changes since the caller's generation,
+        or it's from a different database altogether */
+        this->result->reset = true;
+        this->result->generation = current;
+        return true;
+    }
+
+    auto& tables = changelog::Tables();
+    std::vector<std::unique_ptr<Statement>> selects(tables.size());
+    std::vector<int> outputIndex(tables.size(), -1);
+
+    Statement changes(
+        "SELECT seq, table_id, row_id FROM change_log WHERE seq > ? ORDER BY seq LIMIT ?",
+        db);
+
+    changes.BindInt64(0, this->generation);
+    changes.BindInt64(1, (int64_t) this->limit);
+
+    size_t count = 0;
+    int64_t last = this->generation;
+
+    while (changes.Step() == Row) {
+        ++count;
+        last = changes.ColumnInt64(0);
+        const int tableId = changes.ColumnInt32(1);
+        const int64_t rowId = changes.ColumnInt64(2);
+
+        if (tableId < 0 || tableId >= (int) tables.size()) {
+            continue;
+        }
+
+        if (outputIndex[tableId] < 0) {
+            const std::string query = "SELECT rowid, * FROM " + tables[tableId] + " WHERE rowid=?";
+            selects[tableId] = std::make_unique<Statement>(query.c_str(), db);
+            outputIndex[tableId] = (int) this->result->tables.size();
+            this->result->tables.push_back(Table());
+            this->result->tables.back().name = tables[tableId];
+            this->result->tables.back().rows = nlohmann::json::array();
+        }
+
+        auto& select = *selects[tableId];
+        auto& output = this->result->tables[outputIndex[tableId]];
+
+        select.ResetAndUnbind();
+        select.BindInt64(0, rowId);
+        if (select.Step() == Row) {
+            if (output.columns.empty()) {
+                output.columns = columnNames(select);
+            }
+            output.rows.push_back(readRow(select));
+        }
+        else {
+            output.deleted.push_back(rowId);
+        }
+    }
+
+    this->result->generation = last;
+    this->result->more = count == this->limit;
+    return true;
+}
+
+/* ISerializableQuery */
+
+std::string LibraryChangesQuery::SerializeQuery() {
+    nlohmann::json output = {
+        { "name", kQueryName },
+        { "options", {
+            { "generation", this->generation },
+            { "table", this->table },
+            { "afterRowId", this->afterRowId },
+            { "limit", this->limit }
+        }}
+    };
+    return output.dump();
+}
+
+std::string LibraryChangesQuery::SerializeResult() {
+    nlohmann::json tables = nlohmann::json::array();
+    for (auto& table : this->result->tables) {
+        tables.push_back({
+            { "name", table.name },
+            { "columns", table.columns },
+            { "rows", table.rows },
+            { "deleted", table.deleted }
+        });
+    }
+    nlohmann::json output = {
+        { "result", {
+            { "generation", this->result->generation },
+            { "reset", this->result->reset },
+            { "more", this->result->more },
+            { "tables", tables }
+        }}
+    };
+    return output.dump();
+}
+
+void LibraryChangesQuery::DeserializeResult(const std::string& data) {
+    this->SetStatus(IQuery::Failed);
+    auto json = nlohmann::json::parse(data)["result"];
+    this->result = std::make_shared<Result>();
+    this->result->generation = json.value("generation", (int64_t) 0);
+    this->result->reset = json.value("reset", false);
+    this->result->more = json.value("more", false);
+    for (auto& table : json["tables"]) {
+        Table output;
+        output.name = table.value("name", "");
+        output.columns = table["columns"].get<std::vector<std::string>>();
+        output.rows = table["rows"];
+        output.deleted = table["deleted"].get<std::vector<int64_t>>();
+        this->result->tables.push_back(std::move(output));
+    }
+    this->SetStatus(IQuery::Finished);
+}
+
+std::shared_ptr<LibraryChangesQuery> LibraryChangesQuery::DeserializeQuery(const std::string& data) {
+    auto options = nlohmann::json::parse(data)["options"];
+    const auto table = options.value("table", "");
+    const auto limit = options.value("limit", kMaxLimit);
+    if (table.size()) {
+        return std::make_shared<LibraryChangesQuery>(
+            table, options.value("afterRowId", (int64_t) 0), limit);
+    }
+    return std::make_shared<LibraryChangesQuery>(
+        options.value("generation", (int64_t) 0), limit);
+}
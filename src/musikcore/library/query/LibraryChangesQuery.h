@@ -0,0 +1,106 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <musikcore/support/DeleteDefaults.h>
+#include <musikcore/library/QueryBase.h>
+
+#pragma warning(push, 0)
+#include <nlohmann/json.hpp>
+#pragma warning(pop)
+
+#include <memory>
+#include <vector>
+
+namespace musik { namespace core { namespace library { namespace query {
+
+    /* returns rows of the replicated library tables so a remote client can
+    keep a local mirror of the library (see LibraryMirror and ChangeLog). in
+    incremental mode it returns every row that changed after the specified
+    generation, and in snapshot mode it returns a page of a single table.
+    results are paged; if `more` is set, the caller should ask again. */
+    class LibraryChangesQuery : public musik::core::library::query::QueryBase {
+        public:
+            static const std::string kQueryName;
+
+            struct Table {
+                std::string name;
+                std::vector<std::string> columns; /* not including the rowid */
+                nlohmann::json rows; /* [[rowid, column values...], ...] */
+                std::vector<int64_t> deleted; /* rowids */
+            };
+
+            struct Result {
+                int64_t generation{ 0 };
+                bool reset{ false }; /* changes are unavailable, take a snapshot */
+                bool more{ false };
+                std::vector<Table> tables;
+            };
+
+            DELETE_CLASS_DEFAULTS(LibraryChangesQuery)
+
+            /* changes after the specified generation */
+            LibraryChangesQuery(int64_t generation, size_t limit);
+
+            /* rows in `table` with rowids greater than `afterRowId` */
+            LibraryChangesQuery(const std::string& table, int64_t afterRowId, size_t limit);
+
+            std::shared_ptr<Result> GetResult() noexcept;
+
+            /* IQuery */
+            std::string Name() override { return kQueryName; }
+
+            /* ISerializableQuery */
+            std::string SerializeQuery() override;
+            std::string SerializeResult() override;
+            void DeserializeResult(const std::string& data) override;
+            static std::shared_ptr<LibraryChangesQuery> DeserializeQuery(const std::string& data);
+
+        protected:
+            /* QueryBase */
+            bool OnRun(musik::core::db::Connection &db) override;
+
+        private:
+            bool RunIncremental(musik::core::db::Connection &db);
+            bool RunSnapshot(musik::core::db::Connection &db);
+
+            int64_t generation;
+            std::string table;
+            int64_t afterRowId;
+            size_t limit;
+            std::shared_ptr<Result> result;
+    };
+
+} } } }
@@ -62,6 +62,12 @@ bool MarkTrackPlayedQuery::OnRun(musik::core::db::Connection &db) {
     return this->result;
 }
 
+void MarkTrackPlayedQuery::Defer(musik::core::library::TrackWriteQueue& queue) {
+    queue.MarkPlayed(this->trackId);
+    this->result = true;
+    this->SetStatus(IQuery::Finished);
+}
+
 /* ISerializableQuery */
 
 std::string MarkTrackPlayedQuery::SerializeQuery() {
@@ -37,6 +37,9 @@
 #include <musikcore/db/Statement.h>
 #include <musikcore/db/ScopedTransaction.h>
 #include <musikcore/library/track/TrackList.h>
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
 
 using namespace musik::core;
 using namespace musik::core::db;
@@ -44,6 +47,331 @@ using namespace musik::core::library::query;
 
 const std::string PersistedPlayQueueQuery::kQueryName = "PersistedPlayQueueQuery";
 
+/* the play queue is persisted as a journal of edits in the
+last_session_play_queue_journal table. each record is one of:
+
+  - Base: a chunk of track ids appended to the queue. a compacted journal
+    is nothing but a sequence of Base records.
+  - Splice: remove `count` tracks at `position`, then insert `track_ids`
+    at `position`. appends, inserts, and removals are all splices.
+  - Move: move the track at `position` to index `count`.
+
+saving diffs the current queue against what we last persisted and writes a
+single record describing the change, so the cost scales with the size of the
+edit, not the size of the queue. once the journal gets too long, or an edit
+touches most of the queue (e.g. a shuffle), we rewrite it as Base records.
+note the playback index is not journaled; it's stored in session prefs. */
+
+enum class JournalOp: int { Base = 0, Splice = 1, Move = 2 };
+
+static const size_t kBaseChunkSize = 8192;
+static const size_t kMaxDeltaRecords = 512;
+
+static const char* kSelectJournalQuery =
+    "SELECT id, op, position, count, track_ids "
+    "FROM last_session_play_queue_journal "
+    "ORDER BY id ASC";
+
+static const char* kDataVersionQuery = "PRAGMA data_version";
+
+static const char* kDatabaseListQuery = "PRAGMA database_list";
+
+static const char* kInsertJournalQuery =
+    "INSERT INTO last_session_play_queue_journal (op, position, count, track_ids) "
+    "VALUES (?, ?, ?, ?)";
+
+static const char* kSelectLegacyQuery =
+    "SELECT track_id FROM last_session_play_queue ORDER BY id ASC";
+
+/* the ids we last wrote to (or read from) the journal, one per library, so
+libraries with different databases don't share them. entries are dropped once
+their library is destroyed. queries all run on their library's query thread,
+but guard it anyway. sqlite's data_version changes whenever another connection
+commits to the database, in which case the journal may have changed out from
+under us and is reloaded. the database filename is kept too, in case the
+library's database changes. */
+namespace {
+    struct PersistedState {
+        std::vector<int64_t> ids;
+        std::string database;
+        int64_t dataVersion{ 0 };
+        size_t records{ 0 };
+        size_t deltaRecords{ 0 };
+        size_t deltaIds{ 0 };
+        bool needsCompaction{ false };
+        bool valid{ false };
+    };
+
+    struct LibraryState {
+        std::weak_ptr<ILibrary> library;
+        PersistedState state;
+    };
+
+    static std::mutex statesMutex;
+    static std::unordered_map<ILibrary*, LibraryState> states;
+}
+
+static void encodeIds(const int64_t* ids, size_t count, std::string& output) {
+    output.resize(count * 8);
+    char* out = output.data();
+    for (size_t i = 0; i < count; i++) {
+        const uint64_t id = static_cast<uint64_t>(ids[i]);
+        for (size_t b = 0; b < 8; b++) {
+            *out++ = static_cast<char>((id >> (b * 8)) & 0xff);
+        }
+    }
+}
+
+static void decodeIds(const void* data, size_t size, std::vector<int64_t>& output) {
+    const unsigned char* in = static_cast<const unsigned char*>(data);
+    const size_t count = size / 8;
+    output.clear();
+    output.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        uint64_t id = 0;
+        for (size_t b = 0; b < 8; b++) {
+            id |= static_cast<uint64_t>(*in++) << (b * 8);
+        }
+        output.push_back(static_cast<int64_t>(id));
+    }
+}
+
+static void applySplice(
+    std::vector<int64_t>& ids,
+    int64_t position,
+    int64_t count,
+    const std::vector<int64_t>& insert)
+{
+    const size_t at = (size_t) std::clamp(position, (int64_t) 0, (int64_t) ids.size());
+    const size_t remove = (size_t) std::clamp(count, (int64_t) 0, (int64_t) (ids.size() - at));
+    ids.erase(ids.begin() + at, ids.begin() + at + remove);
+    ids.insert(ids.begin() + at, insert.begin(), insert.end());
+}
+
+static void applyMove(std::vector<int64_t>& ids, int64_t from, int64_t to) {
+    if (from < 0 || to < 0 || (size_t) from >= ids.size() || (size_t) to >= ids.size()) {
+        return;
+    }
+    if (from < to) {
+        std::rotate(ids.begin() + from, ids.begin() + from + 1, ids.begin() + to + 1);
+    }
+    else if (from > to) {
+        std::rotate(ids.begin() + to, ids.begin() + from, ids.begin() + from + 1);
+    }
+}
+
+static int64_t dataVersion(Connection& db) {
+    Statement query(kDataVersionQuery, db);
+    return query.Step() == db::Row ? query.ColumnInt64(0) : -1;
+}
+
+static std::string databaseFilename(Connection& db) {
+    Statement query(kDatabaseListQuery, db);
+    while (query.Step() == db::Row) {
+        if (std::string(query.ColumnText(1)) == "main") {
+            return query.ColumnText(2);
+        }
+    }
+    return "";
+}
+
+static PersistedState& stateFor(ILibraryPtr library, Connection& db) {
+    /* forget libraries that no longer exist. this also keeps a new library
+    allocated at a destroyed one's address from inheriting its state. */
+    for (auto it = states.begin(); it != states.end();) {
+        it = it->second.library.expired() ? states.erase(it) : std::next(it);
+    }
+
+    LibraryState& entry = states[library.get()];
+    entry.library = library;
+
+    PersistedState& state = entry.state;
+    const std::string database = databaseFilename(db);
+    if (state.database != database) {
+        state = PersistedState();
+        state.database = database;
+    }
+    return state;
+}
+
+static void loadState(PersistedState& state, Connection& db) {
+    state.ids.clear();
+    state.dataVersion = dataVersion(db);
+    state.records = 0;
+    state.deltaRecords = state.deltaIds = 0;
+    state.needsCompaction = false;
+
+    std::vector<int64_t> chunk;
+
+    Statement journal(kSelectJournalQuery, db);
+    while (journal.Step() == db::Row) {
+        const auto op = static_cast<JournalOp>(journal.ColumnInt32(1));
+        const auto position = journal.ColumnInt64(2);
+        const auto count = journal.ColumnInt64(3);
+        size_t size = 0;
+        const void* data = journal.ColumnBlob(4, size);
+        decodeIds(data, size, chunk);
+
+        switch (op) {
+            case JournalOp::Base:
+                state.ids.insert(state.ids.end(), chunk.begin(), chunk.end());
+                break;
+            case JournalOp::Splice:
+                applySplice(state.ids, position, count, chunk);
+                ++state.deltaRecords;
+                state.deltaIds += chunk.size();
+                break;
+            case JournalOp::Move:
+                applyMove(state.ids, position, count);
+                ++state.deltaRecords;
+                break;
+        }
+
+        ++state.records;
+    }
+
+    /* nothing journaled yet. this may be a database that was last used with
+    an older version that stored one row per track; read those, and make sure
+    they're migrated to the journal on the next save. */
+    if (state.records == 0) {
+        Statement legacy(kSelectLegacyQuery, db);
+        while (legacy.Step() == db::Row) {
+            state.ids.push_back(legacy.ColumnInt64(0));
+        }
+        state.needsCompaction = state.ids.size() > 0;
+    }
+
+    state.valid = true;
+}
+
+static bool journalChanged(PersistedState& state, Connection& db) {
+    /* our own writes don't change data_version, only other connections' */
+    return dataVersion(db) != state.dataVersion;
+}
+
+static bool appendRecord(
+    PersistedState& state,
+    Connection& db,
+    JournalOp op,
+    int64_t position,
+    int64_t count,
+    const int64_t* ids,
+    size_t idCount)
+{
+    std::string blob;
+    encodeIds(ids, idCount, blob);
+
+    Statement insert(kInsertJournalQuery, db);
+    insert.BindInt32(0, static_cast<int>(op));
+    insert.BindInt64(1, position);
+    insert.BindInt64(2, count);
+    insert.BindBlob(3, blob.data(), blob.size());
+
+    if (insert.Step() != db::Done) {
+        return false;
+    }
+
+    ++state.records;
+    return true;
+}
+
+static bool compact(PersistedState& state, Connection& db, const std::vector<int64_t>& ids) {
+    db.Execute("DELETE FROM last_session_play_queue_journal");
+    db.Execute("DELETE FROM last_session_play_queue");
+
+    state.records = 0;
+    state.deltaRecords = state.deltaIds = 0;
+    state.needsCompaction = false;
+
+    for (size_t i = 0; i < ids.size(); i += kBaseChunkSize) {
+        const size_t count = std::min(kBaseChunkSize, ids.size() - i);
+        if (!appendRecord(state, db, JournalOp::Base, 0, 0, ids.data() + i, count)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool isRotation(
+    const std::vector<int64_t>& from,
+    const std::vector<int64_t>& to,
+    size_t begin,
+    size_t end)
+{
+    /* true if to[begin, end) is from[begin, end) with its last element
+    moved to the front */
+    return
+        from[end - 1] == to[begin] &&
+        std::equal(from.begin() + begin, from.begin() + end - 1, to.begin() + begin + 1);
+}
+
+static bool save(PersistedState& state, Connection& db, const std::vector<int64_t>& ids) {
+    const auto& persisted = state.ids;
+
+    if (state.needsCompaction) {
+        return compact(state, db, ids);
+    }
+
+    /* find the changed region by trimming the common prefix and suffix */
+    const size_t shortest = std::min(persisted.size(), ids.size());
+    size_t prefix = 0;
+    while (prefix < shortest && persisted[prefix] == ids[prefix]) {
+        ++prefix;
+    }
+
+    size_t suffix = 0;
+    while (suffix < shortest - prefix &&
+        persisted[persisted.size() - suffix - 1] == ids[ids.size() - suffix - 1])
+    {
+        ++suffix;
+    }
+
+    const size_t removed = persisted.size() - prefix - suffix;
+    const size_t added = ids.size() - prefix - suffix;
+
+    if (removed == 0 && added == 0) {
+        return true; /* nothing changed */
+    }
+
+    /* single track moves show up as a rotation of the changed region */
+    if (removed == added && added > 1) {
+        const size_t end = prefix + added;
+        if (isRotation(persisted, ids, prefix, end)) {
+            ++state.deltaRecords;
+            return state.deltaRecords > kMaxDeltaRecords
+                ? compact(state, db, ids)
+                : appendRecord(state, db, JournalOp::Move, (int64_t) end - 1, (int64_t) prefix, nullptr, 0);
+        }
+        if (isRotation(ids, persisted, prefix, end)) {
+            ++state.deltaRecords;
+            return state.deltaRecords > kMaxDeltaRecords
+                ? compact(state, db, ids)
+                : appendRecord(state, db, JournalOp::Move, (int64_t) prefix, (int64_t) end - 1, nullptr, 0);
+        }
+    }
+
+    /* if the journal has grown long, or its deltas carry more ids than the
+    queue itself, it's cheaper to rewrite it (and faster to restore) */
+    ++state.deltaRecords;
+    state.deltaIds += added;
+
+    if (state.deltaRecords > kMaxDeltaRecords ||
+        state.deltaIds > std::max(kBaseChunkSize, ids.size() / 2))
+    {
+        return compact(state, db, ids);
+    }
+
+    return appendRecord(
+        state,
+        db,
+        JournalOp::Splice,
+        (int64_t) prefix,
+        (int64_t) removed,
+        ids.data() + prefix,
+        added);
+}
+
 PersistedPlayQueueQuery::PersistedPlayQueueQuery(
     musik::core::ILibraryPtr library,
     musik::core::audio::PlaybackService& playback,
@@ -56,34 +384,35 @@ PersistedPlayQueueQuery::PersistedPlayQueueQuery(
 }
 
 bool PersistedPlayQueueQuery::OnRun(musik::core::db::Connection &db) {
-    if (this->type == Type::Save) {
-        ScopedTransaction transaction(db);
+    std::unique_lock<std::mutex> lock(statesMutex);
 
+    PersistedState& state = stateFor(this->library, db);
+
+    if (this->type == Type::Save) {
         TrackList tracks(this->library);
         this->playback.CopyTo(tracks);
+        const auto ids = tracks.GetIds();
 
-        {
-            Statement deleteTracks("DELETE FROM last_session_play_queue", db);
-            deleteTracks.Step();
+        if (!state.valid || journalChanged(state, db)) {
+            loadState(state, db);
         }
 
-        {
-            Statement insert("INSERT INTO last_session_play_queue (track_id) VALUES (?)", db);
-            for (size_t i = 0; i < tracks.Count(); i++) {
-                insert.Reset();
-                insert.BindInt64(0, tracks.GetId(i));
-                insert.Step();
-            }
+        ScopedTransaction transaction(db);
+
+        if (!save(state, db, ids)) {
+            transaction.Cancel();
+            state.valid = false;
+            return false;
         }
+
+        state.ids = ids;
     }
     else if (this->type == Type::Restore) {
-        auto editor = this->playback.Edit();
-        editor.Clear();
+        loadState(state, db);
 
-        Statement query("SELECT track_id FROM last_session_play_queue ORDER BY id ASC", db);
-        while (query.Step() == db::Row) {
-            editor.Add(query.ColumnInt64(0));
-        }
+        /* hand the ids to playback all at once instead of one at a time */
+        TrackList tracks(this->library, state.ids.data(), state.ids.size());
+        this->playback.CopyFrom(tracks);
     }
 
     return true;
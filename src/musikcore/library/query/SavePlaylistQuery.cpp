@@ -39,6 +39,7 @@
 #include <musikcore/library/track/LibraryTrack.h>
 #include <musikcore/library/query/TrackMetadataQuery.h>
 #include <musikcore/library/query/util/Serialization.h>
+#include <musikcore/library/query/util/PlaylistQueryUtil.h>
 #include <musikcore/library/LocalLibraryConstants.h>
 #include <musikcore/db/ScopedTransaction.h>
 #include <musikcore/db/Statement.h>
@@ -60,18 +61,9 @@ const std::string SavePlaylistQuery::kQueryName = "SavePlaylistQuery";
 static std::string CREATE_PLAYLIST_QUERY =
     "INSERT INTO playlists (name) VALUES (?);";
 
-static std::string INSERT_PLAYLIST_TRACK_QUERY =
-    "INSERT INTO playlist_tracks (track_external_id, source_id, playlist_id, sort_order) VALUES (?, ?, ?, ?);";
-
-static std::string DELETE_PLAYLIST_TRACKS_QUERY =
-    "DELETE FROM playlist_tracks WHERE playlist_id=?;";
-
 static std::string RENAME_PLAYLIST_QUERY =
     "UPDATE playlists SET name=? WHERE id=?";
 
-static std::string GET_MAX_SORT_ORDER_QUERY =
-    "SELECT MAX(sort_order) from playlist_tracks where playlist_id = ?";
-
 /* STATIC FACTORY METHODS */
 
 std::shared_ptr<SavePlaylistQuery> SavePlaylistQuery::Save(
@@ -257,41 +249,32 @@ int64_t SavePlaylistQuery::GetPlaylistId() const noexcept {
     return playlistId;
 }
 
-bool SavePlaylistQuery::AddTracksToPlaylist(
+bool SavePlaylistQuery::ResolveTracks(
     musik::core::db::Connection &db,
-    int64_t playlistId,
-    TrackListWrapper& tracks)
+    TrackListWrapper& tracks,
+    std::vector<playlist::Entry>& output)
 {
-    int offset = 0;
-
-    /* get the max offset, we're appending to the end and don't want
-    to screw up our sort order! */
-    Statement queryMax(GET_MAX_SORT_ORDER_QUERY.c_str(), db);
-    queryMax.BindInt64(0, playlistId);
-    if (queryMax.Step() == db::Row) {
-        offset = queryMax.ColumnInt32(0) + 1;
-    }
-
-    /* insert all the tracks. */
-    Statement insertTrack(INSERT_PLAYLIST_TRACK_QUERY.c_str(), db);
-
-    TrackPtr track;
-    for (size_t i = 0; i < tracks.Count(); i++) {
-        track = tracks.Get(this->library, i);
-        if (track) {
-            insertTrack.Reset();
-            insertTrack.BindText(0, track->GetString("external_id"));
-            insertTrack.BindText(1, track->GetString("source_id"));
-            insertTrack.BindInt64(2, playlistId);
-            insertTrack.BindInt32(3, offset++);
-
-            if (insertTrack.Step() == db::Error) {
-                return false;
-            }
+    /* look up external ids in bulk instead of materializing every track */
+    std::vector<int64_t> ids;
+    ITrackList* trackList = tracks.Get();
+    if (trackList) {
+        ids.reserve(trackList->Count());
+        for (size_t i = 0; i < trackList->Count(); i++) {
+            ids.push_back(trackList->GetId(i));
         }
     }
+    return playlist::ResolveTrackIds(db, ids, output);
+}
 
-    return true;
+bool SavePlaylistQuery::AddTracksToPlaylist(
+    musik::core::db::Connection &db,
+    int64_t playlistId,
+    TrackListWrapper& tracks)
+{
+    std::vector<playlist::Entry> entries;
+    return
+        this->ResolveTracks(db, tracks, entries) &&
+        playlist::Insert(db, playlistId, entries);
 }
 
 bool SavePlaylistQuery::AddCategoryTracksToPlaylist(
@@ -353,17 +336,11 @@ bool SavePlaylistQuery::RenamePlaylist(musik::core::db::Connection &db) {
 bool SavePlaylistQuery::ReplacePlaylist(musik::core::db::Connection &db) {
     ScopedTransaction transaction(db);
 
-    /* delete existing tracks, we'll replace 'em */
-    Statement createPlaylist(DELETE_PLAYLIST_TRACKS_QUERY.c_str(), db);
-    createPlaylist.BindInt64(0, this->playlistId);
-
-    if (createPlaylist.Step() == db::Error) {
-        transaction.Cancel();
-        return false;
-    }
-
-    /* add tracks to playlist */
-    if (!this->AddTracksToPlaylist(db, playlistId, this->tracks)) {
+    /* only rows that were added, removed or moved are written */
+    std::vector<playlist::Entry> entries;
+    if (!this->ResolveTracks(db, this->tracks, entries) ||
+        !playlist::Replace(db, this->playlistId, entries))
+    {
         transaction.Cancel();
         return false;
     }
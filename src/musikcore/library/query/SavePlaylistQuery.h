@@ -38,6 +38,7 @@
 #include <musikcore/library/track/TrackList.h>
 #include <musikcore/db/Connection.h>
 #include <musikcore/library/ILibrary.h>
+#include <musikcore/library/query/util/PlaylistQueryUtil.h>
 #include <memory>
 
 namespace musik { namespace core { namespace library { namespace query {
@@ -94,6 +95,7 @@ namespace musik { namespace core { namespace library { namespace query {
 
             /* IQuery */
             std::string Name() override { return kQueryName; }
+            bool IsMutating() override { return true; }
 
             /* ISerializableQuery */
             std::string SerializeQuery() override;
@@ -182,6 +184,11 @@ namespace musik { namespace core { namespace library { namespace query {
                 int64_t playlistId,
                 TrackListWrapper& tracks);
 
+            bool ResolveTracks(
+                musik::core::db::Connection &db,
+                TrackListWrapper& tracks,
+                std::vector<playlist::Entry>& output);
+
             bool result{ false };
             Operation op;
             musik::core::ILibraryPtr library;
@@ -220,6 +220,17 @@ void SearchTrackListQuery::DeserializeResult(const std::string& data) {
     this->SetStatus(IQuery::Finished);
 }
 
+bool SearchTrackListQuery::SerializeResultBinary(std::string& output) {
+    output = this->SerializeBinaryResultWithHeadersAndTrackList();
+    return true;
+}
+
+void SearchTrackListQuery::DeserializeResultBinary(const std::string& data) {
+    this->SetStatus(IQuery::Failed);
+    this->DeserializeBinaryTrackListAndHeaders(data);
+    this->SetStatus(IQuery::Finished);
+}
+
 std::shared_ptr<SearchTrackListQuery> SearchTrackListQuery::DeserializeQuery(musik::core::ILibraryPtr library, const std::string& data) {
     auto options = nlohmann::json::parse(data)["options"];
     auto result = std::make_shared<SearchTrackListQuery>(
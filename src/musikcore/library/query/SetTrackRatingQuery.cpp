@@ -58,6 +58,12 @@ bool SetTrackRatingQuery::OnRun(musik::core::db::Connection &db) {
     return this->result;
 }
 
+void SetTrackRatingQuery::Defer(musik::core::library::TrackWriteQueue& queue) {
+    queue.SetRating(this->trackId, this->rating);
+    this->result = true;
+    this->SetStatus(IQuery::Finished);
+}
+
 /* ISerializableQuery */
 
 std::string SetTrackRatingQuery::SerializeQuery() {
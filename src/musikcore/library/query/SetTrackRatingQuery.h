@@ -35,6 +35,7 @@
 #pragma once
 
 #include <musikcore/library/QueryBase.h>
+#include <musikcore/library/TrackWriteQueue.h>
 
 namespace musik { namespace core { namespace library { namespace query {
 
@@ -46,8 +47,13 @@ namespace musik { namespace core { namespace library { namespace query {
 
             SetTrackRatingQuery(int64_t trackId, int rating) noexcept;
 
+            /* completes the query by adding the update to the specified
+            write-behind queue instead of writing it immediately */
+            void Defer(musik::core::library::TrackWriteQueue& queue);
+
             /* IQuery */
             std::string Name() override { return kQueryName; }
+            bool IsMutating() override { return true; }
 
             /* ISerializableQuery */
             std::string SerializeQuery() override;
@@ -110,6 +110,19 @@ namespace musik { namespace core { namespace library { namespace query {
                 return output;
             }
 
+            std::string SerializeBinaryResultWithHeadersAndTrackList() {
+                serialization::BinaryWriter writer;
+                serialization::WriteHeadersAndDurations(writer, *this->GetHeaders(), *this->GetDurations());
+                serialization::WriteTrackListIds(writer, *this->GetResult());
+                return writer.Release();
+            }
+
+            void DeserializeBinaryTrackListAndHeaders(const std::string& data) {
+                serialization::BinaryReader reader(data);
+                serialization::ReadHeadersAndDurations(reader, *this->GetHeaders(), *this->GetDurations());
+                serialization::ReadTrackListIds(reader, *this->GetResult());
+            }
+
             void DeserializeTrackListAndHeaders(
                 nlohmann::json& result,
                 ILibraryPtr library,
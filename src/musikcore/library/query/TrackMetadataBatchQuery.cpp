@@ -38,6 +38,7 @@
 #include <musikcore/library/query/util/Serialization.h>
 #include <musikcore/library/track/LibraryTrack.h>
 #include <musikcore/library/query/util/TrackQueryFragments.h>
+#include <musikcore/library/query/util/TrackRowStore.h>
 #include <musikcore/sdk/String.h>
 
 #include <musikcore/sdk/ReplayGain.h>
@@ -62,29 +63,10 @@ TrackMetadataBatchQuery::TrackMetadataBatchQuery(std::unordered_set<int64_t> tra
 }
 
 bool TrackMetadataBatchQuery::OnRun(Connection& db) {
-    std::string idList;
-    size_t i = 0;
-    for (const int64_t id : this->trackIds) {
-        idList += std::to_string(id);
-        if (i < this->trackIds.size() - 1) {
-            idList += ",";
-        }
-        ++i;
-    }
-
-    std::string query = tracks::kAllMetadataQueryByIdBatch;
-    str::ReplaceAll(query, "{{ids}}", idList.c_str());
-
-    Statement trackQuery(query.c_str(), db);
-
-    while (trackQuery.Step() == Row) {
-        auto id = trackQuery.ColumnInt64(0);
-        auto track = std::make_shared<LibraryTrack>(id, this->library);
-        tracks::ParseFullTrackMetadata(track, trackQuery);
-        this->result[id] = track;
-    }
-
-    return true;
+    /* e.g. a TrackList scrolled past this window */
+    return trackrows::Load(
+        db, this->trackIds, this->library, this->result,
+        [this]() { return this->IsCanceled(); });
 }
 
 /* ISerializableQuery */
@@ -123,6 +105,28 @@ void TrackMetadataBatchQuery::DeserializeResult(const std::string& data) {
     this->SetStatus(IQuery::Finished);
 }
 
+bool TrackMetadataBatchQuery::SerializeResultBinary(std::string& output) {
+    BinaryWriter writer;
+    writer.WriteVarUInt(this->result.size());
+    for (auto& kv : this->result) {
+        WriteTrack(writer, kv.second, false);
+    }
+    output = writer.Release();
+    return true;
+}
+
+void TrackMetadataBatchQuery::DeserializeResultBinary(const std::string& data) {
+    this->SetStatus(IQuery::Failed);
+    BinaryReader reader(data);
+    const size_t count = (size_t) reader.ReadVarUInt();
+    for (size_t i = 0; i < count; i++) {
+        auto track = std::make_shared<LibraryTrack>(-1LL, this->library);
+        ReadTrack(reader, track, false);
+        this->result[track->GetId()] = track;
+    }
+    this->SetStatus(IQuery::Finished);
+}
+
 std::shared_ptr<TrackMetadataBatchQuery> TrackMetadataBatchQuery::DeserializeQuery(
     musik::core::ILibraryPtr library, const std::string& data)
 {
@@ -65,6 +65,8 @@ class TrackMetadataBatchQuery: public QueryBase {
         std::string SerializeQuery() override;
         std::string SerializeResult() override;
         void DeserializeResult(const std::string& data) override;
+        bool SerializeResultBinary(std::string& output) override;
+        void DeserializeResultBinary(const std::string& data) override;
         static std::shared_ptr<TrackMetadataBatchQuery> DeserializeQuery(
             musik::core::ILibraryPtr library, const std::string& data);
 
@@ -38,6 +38,7 @@
 #include <musikcore/library/query/util/Serialization.h>
 #include <musikcore/library/track/LibraryTrack.h>
 #include <musikcore/library/query/util/TrackQueryFragments.h>
+#include <musikcore/library/query/util/TrackRowStore.h>
 #include <musikcore/sdk/ReplayGain.h>
 
 #pragma warning(push, 0)
@@ -62,21 +63,21 @@ TrackMetadataQuery::TrackMetadataQuery(TrackPtr target, ILibraryPtr library, Typ
 bool TrackMetadataQuery::OnRun(Connection& db) {
     result->SetMetadataState(MetadataState::Loading);
 
-    const bool queryById = this->result->GetId() != 0;
-
-    std::string query;
-
     if (this->type == Type::Full) {
-        query = queryById
-            ? tracks::kAllMetadataQueryById
-            : tracks::kAllMetadataQueryByExternalId;
-    }
-    else {
-        query = queryById
-            ? tracks::kIdsOnlyQueryById
-            : tracks::kIdsOnlyQueryByExternalId;
+        if (trackrows::Load(db, this->result)) {
+            result->SetMetadataState(MetadataState::Loaded);
+            return true;
+        }
+        result->SetMetadataState(MetadataState::Missing);
+        return false;
     }
 
+    const bool queryById = this->result->GetId() != 0;
+
+    const std::string query = queryById
+        ? tracks::kIdsOnlyQueryById
+        : tracks::kIdsOnlyQueryByExternalId;
+
     Statement trackQuery(query.c_str(), db);
 
     if (queryById) {
@@ -92,12 +93,7 @@ bool TrackMetadataQuery::OnRun(Connection& db) {
     }
 
     if (trackQuery.Step() == Row) {
-        if (this->type == Type::Full) {
-            tracks::ParseFullTrackMetadata(result, trackQuery);
-        }
-        else {
-            tracks::ParseIdsOnlyTrackMetadata(result, trackQuery);
-        }
+        tracks::ParseIdsOnlyTrackMetadata(result, trackQuery);
         result->SetMetadataState(MetadataState::Loaded);
         return true;
     }
@@ -135,6 +131,25 @@ void TrackMetadataQuery::DeserializeResult(const std::string& data) {
     this->SetStatus(IQuery::Finished);
 }
 
+bool TrackMetadataQuery::SerializeResultBinary(std::string& output) {
+    const bool onlyIds = this->type == Type::IdsOnly;
+    BinaryWriter writer;
+    writer.WriteBool(onlyIds);
+    WriteTrack(writer, this->result, onlyIds);
+    output = writer.Release();
+    return true;
+}
+
+void TrackMetadataQuery::DeserializeResultBinary(const std::string& data) {
+    this->SetStatus(IQuery::Failed);
+    BinaryReader reader(data);
+    const bool onlyIds = reader.ReadBool();
+    auto parsedResult = std::make_shared<LibraryTrack>(-1LL, this->library);
+    ReadTrack(reader, parsedResult, onlyIds);
+    this->result = parsedResult;
+    this->SetStatus(IQuery::Finished);
+}
+
 std::shared_ptr<TrackMetadataQuery> TrackMetadataQuery::DeserializeQuery(
     musik::core::ILibraryPtr library, const std::string& data)
 {
@@ -0,0 +1,249 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "pch.hpp"
+#include "ChangeLog.h"
+
+#include <musikcore/db/Statement.h>
+#include <musikcore/db/ScopedTransaction.h>
+
+#include <algorithm>
+#include <functional>
+
+using namespace musik::core;
+using namespace musik::core::db;
+
+namespace musik { namespace core { namespace library { namespace query {
+
+    namespace changelog {
+
+        static const size_t kMaxDeletedEntries = 100000;
+
+        const std::vector<std::string>& Tables() {
+            static const std::vector<std::string> kTables = {
+                "tracks",
+                "genres",
+                "track_genres",
+                "artists",
+                "track_artists",
+                "meta_keys",
+                "meta_values",
+                "track_meta",
+                "albums",
+                "directories",
+                "thumbnails",
+                "playlists",
+                "playlist_tracks",
+                "replay_gain"
+            };
+            return kTables;
+        }
+
+        static std::string triggerName(const std::string& table, const std::string& op) {
+            return "change_log_on_" + table + "_" + op;
+        }
+
+        void CreateSchema(Connection& db) {
+            db.Execute(
+                "CREATE TABLE IF NOT EXISTS change_log ("
+                    "seq INTEGER PRIMARY KEY AUTOINCREMENT,"
+                    "table_id INTEGER NOT NULL,"
+                    "row_id INTEGER NOT NULL,"
+                    "UNIQUE (table_id, row_id))");
+
+            db.Execute(
+                "CREATE TABLE IF NOT EXISTS change_log_state ("
+                    "floor INTEGER NOT NULL DEFAULT 0,"
+                    "pruned_at INTEGER NOT NULL DEFAULT 0)");
+
+            /* fails harmlessly if the column already exists */
+            db.Execute("ALTER TABLE change_log_state ADD COLUMN pruned_at INTEGER NOT NULL DEFAULT 0");
+
+            {
+                Statement stmt("SELECT floor FROM change_log_state", db);
+                if (stmt.Step() != Row) {
+                    db.Execute("INSERT INTO change_log_state (floor) VALUES (0)");
+                }
+            }
+        }
+
+        static void createTriggers(Connection& db) {
+            /* INSERT OR REPLACE deletes the row's previous entry, so each row
+            only ever has one entry: the one for its most recent change. */
+            const auto& tables = Tables();
+            for (size_t i = 0; i < tables.size(); i++) {
+                const std::string& table = tables[i];
+                const std::string id = std::to_string(i);
+
+                const std::string onInsert =
+                    "CREATE TRIGGER IF NOT EXISTS " + triggerName(table, "insert") + " "
+                    "AFTER INSERT ON " + table + " BEGIN "
+                    "INSERT OR REPLACE INTO change_log (table_id, row_id) VALUES (" + id + ", NEW.rowid); END";
+
+                const std::string onUpdate =
+                    "CREATE TRIGGER IF NOT EXISTS " + triggerName(table, "update") + " "
+                    "AFTER UPDATE ON " + table + " BEGIN "
+                    "INSERT OR REPLACE INTO change_log (table_id, row_id) VALUES (" + id + ", NEW.rowid); END";
+
+                const std::string onDelete =
+                    "CREATE TRIGGER IF NOT EXISTS " + triggerName(table, "delete") + " "
+                    "AFTER DELETE ON " + table + " BEGIN "
+                    "INSERT OR REPLACE INTO change_log (table_id, row_id) VALUES (" + id + ", OLD.rowid); END";
+
+                db.Execute(onInsert.c_str());
+                db.Execute(onUpdate.c_str());
+                db.Execute(onDelete.c_str());
+            }
+        }
+
+        static void dropTriggers(Connection& db) {
+            for (auto& table : Tables()) {
+                for (auto op : { "insert", "update", "delete" }) {
+                    const std::string drop = "DROP TRIGGER IF EXISTS " + triggerName(table, op);
+                    db.Execute(drop.c_str());
+                }
+            }
+        }
+
+        bool Enabled(Connection& db) {
+            Statement stmt("SELECT 1 FROM sqlite_master WHERE type='trigger' AND name=?", db);
+            stmt.BindText(0, triggerName(Tables().front(), "insert"));
+            return stmt.Step() == Row;
+        }
+
+        void SetEnabled(Connection& db, bool enabled) {
+            if (enabled == Enabled(db)) {
+                return;
+            }
+
+            ScopedTransaction transaction(db);
+
+            if (enabled) {
+                createTriggers(db);
+
+                /* nothing was recorded while tracking was off, so every
+                existing generation is now incomplete. burn a sequence number
+                and raise the floor to it, so mirrors at or below it start
+                over and new ones pick up from here. */
+                db.Execute("INSERT INTO change_log (table_id, row_id) VALUES (-1, -1)");
+                const int64_t seq = db.LastInsertedId();
+
+                Statement remove("DELETE FROM change_log WHERE seq=?", db);
+                remove.BindInt64(0, seq);
+                remove.Step();
+
+                Statement update("UPDATE change_log_state SET floor=?, pruned_at=?", db);
+                update.BindInt64(0, seq);
+                update.BindInt64(1, seq);
+                update.Step();
+            }
+            else {
+                dropTriggers(db);
+                db.Execute("DELETE FROM change_log");
+            }
+        }
+
+        int64_t Generation(Connection& db) {
+            Statement stmt(
+                "SELECT MAX(COALESCE((SELECT MAX(seq) FROM change_log), 0), floor) "
+                "FROM change_log_state",
+                db);
+            return stmt.Step() == Row ? stmt.ColumnInt64(0) : 0;
+        }
+
+        int64_t Floor(Connection& db) {
+            Statement stmt("SELECT floor FROM change_log_state", db);
+            return stmt.Step() == Row ? stmt.ColumnInt64(0) : 0;
+        }
+
+        size_t Prune(Connection& db) {
+            /* at most one deleted-row entry is added per change, so there
+            can't be more than twice the limit until this many changes have
+            been made since the last prune. until then, skip the scan. */
+            const int64_t generation = Generation(db);
+            {
+                Statement stmt("SELECT pruned_at FROM change_log_state", db);
+                if (stmt.Step() != Row ||
+                    generation - stmt.ColumnInt64(0) < (int64_t) kMaxDeletedEntries)
+                {
+                    return 0;
+                }
+            }
+
+            {
+                Statement update("UPDATE change_log_state SET pruned_at=?", db);
+                update.BindInt64(0, generation);
+                update.Step();
+            }
+
+            std::vector<int64_t> deleted;
+            const auto& tables = Tables();
+            for (size_t i = 0; i < tables.size(); i++) {
+                const std::string query =
+                    "SELECT c.seq FROM change_log c WHERE c.table_id=? AND NOT EXISTS "
+                    "(SELECT 1 FROM " + tables[i] + " WHERE rowid=c.row_id)";
+                Statement stmt(query.c_str(), db);
+                stmt.BindInt32(0, (int) i);
+                while (stmt.Step() == Row) {
+                    deleted.push_back(stmt.ColumnInt64(0));
+                }
+            }
+
+            if (deleted.size() <= kMaxDeletedEntries) {
+                return 0;
+            }
+
+            /* keep the newest entries, drop everything else */
+            std::sort(deleted.begin(), deleted.end(), std::greater<int64_t>());
+            deleted.erase(deleted.begin(), deleted.begin() + kMaxDeletedEntries);
+            const int64_t floor = deleted.front();
+
+            ScopedTransaction transaction(db);
+
+            Statement remove("DELETE FROM change_log WHERE seq=?", db);
+            for (const int64_t seq : deleted) {
+                remove.Reset();
+                remove.BindInt64(0, seq);
+                remove.Step();
+            }
+
+            Statement update("UPDATE change_log_state SET floor=MAX(floor, ?)", db);
+            update.BindInt64(0, floor);
+            update.Step();
+
+            return deleted.size();
+        }
+    }
+
+} } } }
@@ -0,0 +1,87 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <musikcore/db/Connection.h>
+#include <string>
+#include <vector>
+
+namespace musik { namespace core { namespace library { namespace query {
+
+    namespace changelog {
+
+        /* the change_log table records the most recent change to every row
+        of the replicated tables, so remote mirrors (see LibraryMirror) can
+        pull incremental change sets instead of downloading the whole library
+        again. triggers give each change a new, monotonically increasing
+        sequence number; the highest one is the library's current generation.
+
+        entries for deleted rows are kept so mirrors learn about deletions,
+        but the oldest of them are pruned after indexer runs. mirrors that are
+        older than the pruned range (the "floor") have to download everything
+        again.
+
+        the triggers slow down every write to the library, so they're only
+        installed while serving mirrors is enabled. */
+
+        /* the replicated tables. a table's index in this list is stored in
+        the log, so it's append-only. */
+        const std::vector<std::string>& Tables();
+
+        /* creates the log tables. change tracking starts out disabled. */
+        void CreateSchema(musik::core::db::Connection& db);
+
+        /* true if the triggers that maintain the log are installed */
+        bool Enabled(musik::core::db::Connection& db);
+
+        /* installs or drops the triggers. when tracking is turned off the
+        log is cleared; when it's turned back on the floor is raised, so
+        existing mirrors download everything again. */
+        void SetEnabled(musik::core::db::Connection& db, bool enabled);
+
+        /* the sequence number of the most recent change, or 0 */
+        int64_t Generation(musik::core::db::Connection& db);
+
+        /* changes with sequence numbers at or below this may be missing */
+        int64_t Floor(musik::core::db::Connection& db);
+
+        /* removes the oldest deleted-row entries if there are too many of
+        them, and raises the floor accordingly. only looks for them once
+        enough changes have been made since the last time. returns the number
+        removed. */
+        size_t Prune(musik::core::db::Connection& db);
+    }
+
+} } } }
@@ -0,0 +1,419 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "pch.hpp"
+#include "PlaylistQueryUtil.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <deque>
+
+using namespace musik::core::db;
+
+namespace musik { namespace core { namespace library { namespace query {
+
+    namespace playlist {
+
+        /* sqlite's default SQLITE_MAX_VARIABLE_NUMBER is 999 on older builds;
+        stay comfortably below it. */
+        static const size_t kInsertBatchSize = 200; /* 4 variables per row */
+        static const size_t kIdBatchSize = 500;
+
+        static std::string placeholders(size_t count, const std::string& group) {
+            std::string result;
+            result.reserve(count * (group.size() + 1));
+            for (size_t i = 0; i < count; i++) {
+                if (i > 0) {
+                    result += ",";
+                }
+                result += group;
+            }
+            return result;
+        }
+
+        bool ResolveTrackIds(
+            Connection& db,
+            const std::vector<int64_t>& trackIds,
+            std::vector<Entry>& output)
+        {
+            std::unordered_map<int64_t, Entry> resolved;
+
+            for (size_t offset = 0; offset < trackIds.size(); offset += kIdBatchSize) {
+                const size_t count = std::min(kIdBatchSize, trackIds.size() - offset);
+                const std::string sql =
+                    "SELECT id, external_id, source_id FROM tracks WHERE id IN (" +
+                    placeholders(count, "?") + ")";
+                Statement stmt(sql.c_str(), db);
+                for (size_t i = 0; i < count; i++) {
+                    stmt.BindInt64((int) i, trackIds[offset + i]);
+                }
+                int result;
+                while ((result = stmt.Step()) == db::Row) {
+                    resolved[stmt.ColumnInt64(0)] = { stmt.ColumnText(1), stmt.ColumnInt64(2) };
+                }
+                if (result == db::Error) {
+                    return false;
+                }
+            }
+
+            output.reserve(output.size() + trackIds.size());
+            for (auto id : trackIds) {
+                auto it = resolved.find(id);
+                if (it != resolved.end()) {
+                    output.push_back(it->second);
+                }
+            }
+
+            return true;
+        }
+
+        bool LoadRows(Connection& db, int64_t playlistId, std::vector<Row>& output) {
+            Statement stmt(
+                "SELECT rowid, track_external_id, sort_order FROM playlist_tracks "
+                "WHERE playlist_id=? ORDER BY sort_order, rowid",
+                db);
+            stmt.BindInt64(0, playlistId);
+            int result;
+            while ((result = stmt.Step()) == db::Row) {
+                output.push_back({ stmt.ColumnInt64(0), stmt.ColumnText(1), stmt.ColumnInt64(2) });
+            }
+            return result != db::Error;
+        }
+
+        bool InsertEntries(
+            Connection& db,
+            int64_t playlistId,
+            const std::vector<Entry>& entries,
+            size_t begin,
+            size_t end,
+            int64_t first,
+            int64_t stride)
+        {
+            static const std::string kInsert =
+                "INSERT INTO playlist_tracks (track_external_id, source_id, playlist_id, sort_order) VALUES ";
+
+            std::unique_ptr<Statement> fullBatch;
+            int64_t sortOrder = first;
+
+            for (size_t offset = begin; offset < end; offset += kInsertBatchSize) {
+                const size_t count = std::min(kInsertBatchSize, end - offset);
+
+                /* the full-size statement is prepared once and reused; only
+                the trailing partial batch needs its own statement */
+                std::unique_ptr<Statement> partialBatch;
+                Statement* stmt;
+                if (count == kInsertBatchSize) {
+                    if (!fullBatch) {
+                        const std::string sql = kInsert + placeholders(count, "(?,?,?,?)");
+                        fullBatch = std::make_unique<Statement>(sql.c_str(), db);
+                    }
+                    stmt = fullBatch.get();
+                    stmt->ResetAndUnbind();
+                }
+                else {
+                    const std::string sql = kInsert + placeholders(count, "(?,?,?,?)");
+                    partialBatch = std::make_unique<Statement>(sql.c_str(), db);
+                    stmt = partialBatch.get();
+                }
+
+                for (size_t i = 0; i < count; i++) {
+                    const Entry& entry = entries[offset + i];
+                    const int base = (int) i * 4;
+                    stmt->BindText(base + 0, entry.externalId);
+                    stmt->BindInt64(base + 1, entry.sourceId);
+                    stmt->BindInt64(base + 2, playlistId);
+                    stmt->BindInt64(base + 3, sortOrder);
+                    sortOrder += stride;
+                }
+
+                if (stmt->Step() == db::Error) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        bool DeleteRows(Connection& db, const std::vector<int64_t>& rowIds) {
+            for (size_t offset = 0; offset < rowIds.size(); offset += kIdBatchSize) {
+                const size_t count = std::min(kIdBatchSize, rowIds.size() - offset);
+                const std::string sql =
+                    "DELETE FROM playlist_tracks WHERE rowid IN (" + placeholders(count, "?") + ")";
+                Statement stmt(sql.c_str(), db);
+                for (size_t i = 0; i < count; i++) {
+                    stmt.BindInt64((int) i, rowIds[offset + i]);
+                }
+                if (stmt.Step() == db::Error) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool Compact(Connection& db, int64_t playlistId) {
+            std::vector<Row> rows;
+            if (!LoadRows(db, playlistId, rows)) {
+                return false;
+            }
+
+            Statement update("UPDATE playlist_tracks SET sort_order=? WHERE rowid=?", db);
+            int64_t sortOrder = 0;
+            for (auto& row : rows) {
+                if (row.sortOrder != sortOrder) {
+                    update.ResetAndUnbind();
+                    update.BindInt64(0, sortOrder);
+                    update.BindInt64(1, row.rowId);
+                    if (update.Step() == db::Error) {
+                        return false;
+                    }
+                }
+                sortOrder += kSortOrderGap;
+            }
+
+            return true;
+        }
+
+        /* returns the sort order of the row at the specified position, or
+        false if there is no such row */
+        static bool sortOrderAt(Connection& db, int64_t playlistId, int64_t position, int64_t& output) {
+            Statement stmt(
+                "SELECT sort_order FROM playlist_tracks WHERE playlist_id=? "
+                "ORDER BY sort_order, rowid LIMIT 1 OFFSET ?",
+                db);
+            stmt.BindInt64(0, playlistId);
+            stmt.BindInt64(1, position);
+            if (stmt.Step() == db::Row) {
+                output = stmt.ColumnInt64(0);
+                return true;
+            }
+            return false;
+        }
+
+        static bool append(Connection& db, int64_t playlistId, const std::vector<Entry>& entries) {
+            int64_t first = 0;
+            Statement max(
+                "SELECT MAX(sort_order) FROM playlist_tracks WHERE playlist_id=?", db);
+            max.BindInt64(0, playlistId);
+            if (max.Step() == db::Row && !max.IsNull(0)) {
+                first = max.ColumnInt64(0) + kSortOrderGap;
+            }
+            return InsertEntries(db, playlistId, entries, 0, entries.size(), first, kSortOrderGap);
+        }
+
+        bool Insert(
+            Connection& db,
+            int64_t playlistId,
+            const std::vector<Entry>& entries,
+            int64_t position)
+        {
+            if (entries.empty()) {
+                return true;
+            }
+
+            int64_t upper = 0;
+            if (position < 0 || !sortOrderAt(db, playlistId, position, upper)) {
+                return append(db, playlistId, entries);
+            }
+
+            const int64_t count = (int64_t) entries.size();
+            int64_t lower = upper - (count + 1) * kSortOrderGap;
+            if (position > 0) {
+                sortOrderAt(db, playlistId, position - 1, lower);
+            }
+
+            if (upper - lower - 1 < count) {
+                /* out of room. re-space the playlist; if that's still not enough
+                (i.e. we're inserting more than kSortOrderGap tracks at once),
+                shift everything after the insertion point down. */
+                if (!Compact(db, playlistId)) {
+                    return false;
+                }
+                lower = (position - 1) * kSortOrderGap;
+                upper = position * kSortOrderGap;
+                if (upper - lower - 1 < count) {
+                    const int64_t shift = (count + 1) * kSortOrderGap;
+                    Statement update(
+                        "UPDATE playlist_tracks SET sort_order=sort_order+? "
+                        "WHERE playlist_id=? AND sort_order>=?",
+                        db);
+                    update.BindInt64(0, shift);
+                    update.BindInt64(1, playlistId);
+                    update.BindInt64(2, upper);
+                    if (update.Step() == db::Error) {
+                        return false;
+                    }
+                    upper += shift;
+                }
+            }
+
+            const int64_t stride = (upper - lower) / (count + 1);
+            return InsertEntries(db, playlistId, entries, 0, entries.size(), lower + stride, stride);
+        }
+
+        /* returns the indexes of a longest strictly increasing subsequence */
+        static std::vector<size_t> longestIncreasingSubsequence(const std::vector<int64_t>& values) {
+            std::vector<size_t> tails; /* index into values */
+            std::vector<int64_t> predecessors(values.size(), -1);
+            for (size_t i = 0; i < values.size(); i++) {
+                auto it = std::lower_bound(
+                    tails.begin(), tails.end(), values[i],
+                    [&values](size_t index, int64_t value) { return values[index] < value; });
+                if (it != tails.begin()) {
+                    predecessors[i] = (int64_t) *(it - 1);
+                }
+                if (it == tails.end()) {
+                    tails.push_back(i);
+                }
+                else {
+                    *it = i;
+                }
+            }
+            std::vector<size_t> result(tails.size());
+            int64_t current = tails.empty() ? -1 : (int64_t) tails.back();
+            for (size_t i = result.size(); i > 0; i--) {
+                result[i - 1] = (size_t) current;
+                current = predecessors[(size_t) current];
+            }
+            return result;
+        }
+
+        static bool rewrite(Connection& db, int64_t playlistId, const std::vector<Entry>& entries) {
+            Statement deleteAll("DELETE FROM playlist_tracks WHERE playlist_id=?", db);
+            deleteAll.BindInt64(0, playlistId);
+            if (deleteAll.Step() == db::Error) {
+                return false;
+            }
+            return InsertEntries(db, playlistId, entries, 0, entries.size(), 0, kSortOrderGap);
+        }
+
+        bool Replace(Connection& db, int64_t playlistId, const std::vector<Entry>& entries) {
+            std::vector<Row> rows;
+            if (!LoadRows(db, playlistId, rows)) {
+                return false;
+            }
+
+            for (size_t i = 1; i < rows.size(); i++) {
+                if (rows[i].sortOrder == rows[i - 1].sortOrder) {
+                    return rewrite(db, playlistId, entries); /* ambiguous order */
+                }
+            }
+
+            /* match each new entry with an existing row for the same track,
+            in order, so duplicates pair up with duplicates. */
+            std::unordered_map<std::string, std::deque<size_t>> available;
+            for (size_t i = 0; i < rows.size(); i++) {
+                available[rows[i].externalId].push_back(i);
+            }
+
+            std::vector<size_t> matchedNew;
+            std::vector<int64_t> matchedOld;
+            for (size_t i = 0; i < entries.size(); i++) {
+                auto it = available.find(entries[i].externalId);
+                if (it != available.end() && !it->second.empty()) {
+                    matchedNew.push_back(i);
+                    matchedOld.push_back((int64_t) it->second.front());
+                    it->second.pop_front();
+                }
+            }
+
+            /* the rows that stay in the same relative order can be kept as-is;
+            everything else is deleted and/or re-inserted. */
+            std::vector<int64_t> anchor(entries.size(), -1); /* new index -> old index */
+            std::vector<bool> keepOld(rows.size(), false);
+            for (size_t i : longestIncreasingSubsequence(matchedOld)) {
+                anchor[matchedNew[i]] = matchedOld[i];
+                keepOld[(size_t) matchedOld[i]] = true;
+            }
+
+            /* figure out where the new rows go before writing anything, so
+            we can fall back to a full rewrite if there's not enough room. */
+            struct Segment { size_t begin, end; int64_t first, stride; };
+            std::vector<Segment> segments;
+            size_t i = 0;
+            while (i < entries.size()) {
+                if (anchor[i] >= 0) {
+                    ++i;
+                    continue;
+                }
+                const size_t begin = i;
+                while (i < entries.size() && anchor[i] < 0) {
+                    ++i;
+                }
+                const int64_t count = (int64_t) (i - begin);
+                const bool hasLower = begin > 0;
+                const bool hasUpper = i < entries.size();
+                const int64_t lower = hasLower ? rows[(size_t) anchor[begin - 1]].sortOrder : 0;
+                const int64_t upper = hasUpper ? rows[(size_t) anchor[i]].sortOrder : 0;
+                if (hasLower && hasUpper) {
+                    if (upper - lower - 1 < count) {
+                        return rewrite(db, playlistId, entries);
+                    }
+                    const int64_t stride = (upper - lower) / (count + 1);
+                    segments.push_back({ begin, i, lower + stride, stride });
+                }
+                else if (hasLower) {
+                    segments.push_back({ begin, i, lower + kSortOrderGap, kSortOrderGap });
+                }
+                else if (hasUpper) {
+                    segments.push_back({ begin, i, upper - count * kSortOrderGap, kSortOrderGap });
+                }
+                else {
+                    segments.push_back({ begin, i, 0, kSortOrderGap });
+                }
+            }
+
+            std::vector<int64_t> deleted;
+            for (size_t j = 0; j < rows.size(); j++) {
+                if (!keepOld[j]) {
+                    deleted.push_back(rows[j].rowId);
+                }
+            }
+
+            if (!DeleteRows(db, deleted)) {
+                return false;
+            }
+
+            for (auto& segment : segments) {
+                if (!InsertEntries(db, playlistId, entries,
+                    segment.begin, segment.end, segment.first, segment.stride))
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+    }
+
+} } } }
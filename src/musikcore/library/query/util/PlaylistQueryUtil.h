@@ -0,0 +1,118 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <musikcore/db/Connection.h>
+#include <musikcore/db/Statement.h>
+#include <string>
+#include <vector>
+
+namespace musik { namespace core { namespace library { namespace query {
+
+    namespace playlist {
+
+        /* playlist_tracks.sort_order values are sparse: consecutive rows are
+        spaced kSortOrderGap apart. this allows us to insert or move tracks
+        by assigning them sort orders between their new neighbors, touching
+        only the affected rows. when two neighbors run out of room we compact
+        the playlist back to evenly spaced values. note that sort orders are
+        never exposed to clients; they only see positions. */
+        static const int64_t kSortOrderGap = 1024;
+
+        struct Entry {
+            std::string externalId;
+            int64_t sourceId;
+        };
+
+        struct Row {
+            int64_t rowId;
+            std::string externalId;
+            int64_t sortOrder;
+        };
+
+        /* resolves the specified track ids to their external ids using a
+        small number of batched queries. order is preserved; ids that can't
+        be found are skipped. */
+        bool ResolveTrackIds(
+            musik::core::db::Connection& db,
+            const std::vector<int64_t>& trackIds,
+            std::vector<Entry>& output);
+
+        /* loads the playlist's rows in sort order */
+        bool LoadRows(
+            musik::core::db::Connection& db,
+            int64_t playlistId,
+            std::vector<Row>& output);
+
+        /* inserts the specified entries with multi-row INSERT statements,
+        assigning sort orders `first`, `first + stride`, ... */
+        bool InsertEntries(
+            musik::core::db::Connection& db,
+            int64_t playlistId,
+            const std::vector<Entry>& entries,
+            size_t begin,
+            size_t end,
+            int64_t first,
+            int64_t stride);
+
+        /* deletes the specified rows in batches */
+        bool DeleteRows(
+            musik::core::db::Connection& db,
+            const std::vector<int64_t>& rowIds);
+
+        /* re-spaces all of the playlist's rows kSortOrderGap apart, keeping
+        their relative order. rows with identical sort orders are ordered by
+        insertion. */
+        bool Compact(musik::core::db::Connection& db, int64_t playlistId);
+
+        /* inserts `entries` at the specified position (or appends them if
+        position is negative or past the end). only the new rows are written
+        unless the playlist needs to be compacted to make room. */
+        bool Insert(
+            musik::core::db::Connection& db,
+            int64_t playlistId,
+            const std::vector<Entry>& entries,
+            int64_t position = -1);
+
+        /* replaces the playlist's contents with `entries`. rows that keep
+        their relative order are left untouched; only removed, added, and
+        moved rows are written. */
+        bool Replace(
+            musik::core::db::Connection& db,
+            int64_t playlistId,
+            const std::vector<Entry>& entries);
+    }
+
+} } } }
@@ -35,6 +35,11 @@
 #include "pch.hpp"
 #include "Serialization.h"
 #include <musikcore/library/track/LibraryTrack.h>
+#include <musikcore/library/LocalLibraryConstants.h>
+
+#pragma warning(push, 0)
+#include <websocketpp/base64/base64.hpp>
+#pragma warning(pop)
 
 using namespace musik::core;
 using namespace musik::core::library::query;
@@ -251,6 +256,309 @@ namespace musik { namespace core { namespace library { namespace query {
             }
         }
 
+        /* binary encoding */
+
+        const std::string kBinaryResultPrefix = "mcbin1:";
+        const std::string kResultFormatKey = "result_format";
+        const std::string kResultFormatBinary = "binary";
+
+        static const unsigned char kBinaryMagic[] = { 'M', 'C', 'B', 1 };
+
+        /* the order here is part of the wire format; append only! */
+        static const char* kBinaryTrackFields[] = {
+            constants::Track::TRACK_NUM,
+            constants::Track::DISC_NUM,
+            constants::Track::BPM,
+            constants::Track::DURATION,
+            constants::Track::FILESIZE,
+            constants::Track::TITLE,
+            constants::Track::FILENAME,
+            constants::Track::THUMBNAIL_ID,
+            constants::Track::ALBUM,
+            constants::Track::ALBUM_ARTIST,
+            constants::Track::GENRE,
+            constants::Track::ARTIST,
+            constants::Track::FILETIME,
+            constants::Track::GENRE_ID,
+            constants::Track::ARTIST_ID,
+            constants::Track::ALBUM_ARTIST_ID,
+            constants::Track::ALBUM_ID,
+            constants::Track::RATING
+        };
+
+        BinaryWriter::BinaryWriter() {
+            this->output.append((const char*) kBinaryMagic, sizeof(kBinaryMagic));
+        }
+
+        void BinaryWriter::WriteVarUInt(uint64_t value) {
+            while (value >= 0x80) {
+                this->output.push_back((char) ((value & 0x7f) | 0x80));
+                value >>= 7;
+            }
+            this->output.push_back((char) value);
+        }
+
+        void BinaryWriter::WriteVarInt(int64_t value) {
+            this->WriteVarUInt(((uint64_t) value << 1) ^ (uint64_t) (value >> 63));
+        }
+
+        void BinaryWriter::WriteDouble(double value) {
+            static_assert(sizeof(double) == sizeof(uint64_t), "unexpected double size");
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            for (int i = 0; i < 8; i++) {
+                this->output.push_back((char) ((bits >> (i * 8)) & 0xff));
+            }
+        }
+
+        void BinaryWriter::WriteBool(bool value) {
+            this->output.push_back(value ? 1 : 0);
+        }
+
+        void BinaryWriter::WriteString(const std::string& value) {
+            /* 0 means "literal follows", otherwise it's a 1-based index
+            into the strings we've already written. */
+            auto it = this->strings.find(value);
+            if (it != this->strings.end()) {
+                this->WriteVarUInt(it->second);
+                return;
+            }
+            this->WriteVarUInt(0);
+            this->WriteVarUInt(value.size());
+            this->output.append(value);
+            this->strings[value] = this->strings.size() + 1;
+        }
+
+        BinaryReader::BinaryReader(const std::string& input)
+        : input(input)
+        , offset(0) {
+            this->Require(sizeof(kBinaryMagic));
+            if (memcmp(input.data(), kBinaryMagic, sizeof(kBinaryMagic)) != 0) {
+                throw std::runtime_error("invalid binary result header");
+            }
+            this->offset = sizeof(kBinaryMagic);
+        }
+
+        void BinaryReader::Require(size_t bytes) {
+            if (this->offset + bytes > this->input.size()) {
+                throw std::runtime_error("binary result truncated");
+            }
+        }
+
+        uint64_t BinaryReader::ReadVarUInt() {
+            uint64_t result = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                this->Require(1);
+                const uint8_t byte = (uint8_t) this->input[this->offset++];
+                result |= (uint64_t) (byte & 0x7f) << shift;
+                if (!(byte & 0x80)) {
+                    return result;
+                }
+            }
+            throw std::runtime_error("invalid varint");
+        }
+
+        int64_t BinaryReader::ReadVarInt() {
+            const uint64_t value = this->ReadVarUInt();
+            return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+        }
+
+        double BinaryReader::ReadDouble() {
+            this->Require(8);
+            uint64_t bits = 0;
+            for (int i = 0; i < 8; i++) {
+                bits |= (uint64_t) (uint8_t) this->input[this->offset++] << (i * 8);
+            }
+            double result;
+            memcpy(&result, &bits, sizeof(result));
+            return result;
+        }
+
+        bool BinaryReader::ReadBool() {
+            this->Require(1);
+            return this->input[this->offset++] != 0;
+        }
+
+        const std::string& BinaryReader::ReadString() {
+            const uint64_t index = this->ReadVarUInt();
+            if (index > 0) {
+                if (index > this->strings.size()) {
+                    throw std::runtime_error("invalid string reference");
+                }
+                return this->strings[(size_t) index - 1];
+            }
+            const uint64_t size = this->ReadVarUInt();
+            this->Require((size_t) size);
+            this->strings.push_back(this->input.substr(this->offset, (size_t) size));
+            this->offset += (size_t) size;
+            return this->strings.back();
+        }
+
+        void WriteTrackListIds(BinaryWriter& writer, const TrackList& input) {
+            /* ids are delta encoded; lists are frequently sorted by something
+            that correlates with insertion order, so deltas tend to be small. */
+            const size_t count = input.Count();
+            writer.WriteVarUInt(count);
+            int64_t last = 0;
+            for (size_t i = 0; i < count; i++) {
+                const int64_t id = input.GetId(i);
+                writer.WriteVarInt(id - last);
+                last = id;
+            }
+        }
+
+        void ReadTrackListIds(BinaryReader& reader, TrackList& output) {
+            output.Clear();
+            const size_t count = (size_t) reader.ReadVarUInt();
+            int64_t last = 0;
+            for (size_t i = 0; i < count; i++) {
+                last += reader.ReadVarInt();
+                output.Add(last);
+            }
+        }
+
+        void WriteHeadersAndDurations(
+            BinaryWriter& writer,
+            const std::set<size_t>& headers,
+            const std::map<size_t, size_t>& durations)
+        {
+            writer.WriteVarUInt(headers.size());
+            for (auto header : headers) {
+                writer.WriteVarUInt(header);
+            }
+            writer.WriteVarUInt(durations.size());
+            for (auto& kv : durations) {
+                writer.WriteVarUInt(kv.first);
+                writer.WriteVarUInt(kv.second);
+            }
+        }
+
+        void ReadHeadersAndDurations(
+            BinaryReader& reader,
+            std::set<size_t>& headers,
+            std::map<size_t, size_t>& durations)
+        {
+            size_t count = (size_t) reader.ReadVarUInt();
+            for (size_t i = 0; i < count; i++) {
+                headers.insert((size_t) reader.ReadVarUInt());
+            }
+            count = (size_t) reader.ReadVarUInt();
+            for (size_t i = 0; i < count; i++) {
+                const size_t key = (size_t) reader.ReadVarUInt();
+                durations[key] = (size_t) reader.ReadVarUInt();
+            }
+        }
+
+        void WriteTrack(BinaryWriter& writer, const TrackPtr input, bool onlyIds) {
+            writer.WriteVarInt(input->GetId());
+            writer.WriteString(input->GetString(constants::Track::EXTERNAL_ID));
+            writer.WriteString(input->GetString(constants::Track::SOURCE_ID));
+            if (!onlyIds) {
+                for (auto field : kBinaryTrackFields) {
+                    writer.WriteString(input->GetString(field));
+                }
+                auto replayGain = input->GetReplayGain();
+                writer.WriteDouble(replayGain.albumGain);
+                writer.WriteDouble(replayGain.albumPeak);
+                writer.WriteDouble(replayGain.trackGain);
+                writer.WriteDouble(replayGain.trackPeak);
+            }
+        }
+
+        void ReadTrack(BinaryReader& reader, TrackPtr output, bool onlyIds) {
+            output->SetId(reader.ReadVarInt());
+            output->SetValue(constants::Track::EXTERNAL_ID, reader.ReadString().c_str());
+            output->SetValue(constants::Track::SOURCE_ID, reader.ReadString().c_str());
+            if (!onlyIds) {
+                for (auto field : kBinaryTrackFields) {
+                    output->SetValue(field, reader.ReadString().c_str());
+                }
+                musik::core::sdk::ReplayGain replayGain;
+                replayGain.albumGain = (float) reader.ReadDouble();
+                replayGain.albumPeak = (float) reader.ReadDouble();
+                replayGain.trackGain = (float) reader.ReadDouble();
+                replayGain.trackPeak = (float) reader.ReadDouble();
+                output->SetReplayGain(replayGain);
+            }
+            output->SetMetadataState(MetadataState::Loaded);
+        }
+
+        void WriteValueList(BinaryWriter& writer, const SdkValueList& input) {
+            size_t count = 0;
+            input.Each([&count](auto value) { ++count; });
+            writer.WriteVarUInt(count);
+            input.Each([&writer](auto value) {
+                writer.WriteString(value->ToString());
+                writer.WriteVarInt(value->GetId());
+                writer.WriteString(value->GetType());
+            });
+        }
+
+        void ReadValueList(BinaryReader& reader, SdkValueList& output) {
+            output.Clear();
+            const size_t count = (size_t) reader.ReadVarUInt();
+            for (size_t i = 0; i < count; i++) {
+                std::string value = reader.ReadString();
+                const int64_t id = reader.ReadVarInt();
+                output.Add(std::make_shared<SdkValue>(value, id, reader.ReadString()));
+            }
+        }
+
+        void WriteMetadataMapList(BinaryWriter& writer, const MetadataMapList& input) {
+            writer.WriteVarUInt(input.Count());
+            for (size_t i = 0; i < input.Count(); i++) {
+                auto map = input.GetSharedAt(i);
+                writer.WriteVarInt(map->GetId());
+                writer.WriteString(map->GetTypeValue());
+                writer.WriteString(map->GetType());
+                size_t count = 0;
+                map->Each([&count](const std::string& key, const std::string& value) { ++count; });
+                writer.WriteVarUInt(count);
+                map->Each([&writer](const std::string& key, const std::string& value) {
+                    writer.WriteString(key);
+                    writer.WriteString(value);
+                });
+            }
+        }
+
+        void ReadMetadataMapList(BinaryReader& reader, MetadataMapList& output) {
+            output.Clear();
+            const size_t count = (size_t) reader.ReadVarUInt();
+            for (size_t i = 0; i < count; i++) {
+                const int64_t id = reader.ReadVarInt();
+                std::string value = reader.ReadString();
+                auto map = std::make_shared<MetadataMap>(id, value, reader.ReadString());
+                const size_t fieldCount = (size_t) reader.ReadVarUInt();
+                for (size_t j = 0; j < fieldCount; j++) {
+                    std::string key = reader.ReadString();
+                    map->Set(key.c_str(), reader.ReadString());
+                }
+                output.Add(map);
+            }
+        }
+
+        std::string EncodeBinaryResult(const std::string& binary) {
+            return kBinaryResultPrefix + websocketpp::base64_encode(binary);
+        }
+
+        bool IsEncodedBinaryResult(const std::string& data) {
+            return data.compare(0, kBinaryResultPrefix.size(), kBinaryResultPrefix) == 0;
+        }
+
+        std::string DecodeBinaryResult(const std::string& data) {
+            return websocketpp::base64_decode(data.substr(kBinaryResultPrefix.size()));
+        }
+
+        bool IsBinaryResultRequested(const nlohmann::json& serializedQuery) {
+            return serializedQuery.value(kResultFormatKey, "") == kResultFormatBinary;
+        }
+
+        std::string RequestBinaryResult(const std::string& serializedQuery) {
+            nlohmann::json json = nlohmann::json::parse(serializedQuery);
+            json[kResultFormatKey] = kResultFormatBinary;
+            return json.dump();
+        }
+
     }
 
 } } } }
@@ -45,6 +45,12 @@
 #include <musikcore/library/track/TrackList.h>
 #include <musikcore/library/ILibrary.h>
 
+#include <unordered_map>
+#include <vector>
+#include <deque>
+#include <set>
+#include <map>
+
 namespace musik { namespace core { namespace library { namespace query {
 
     namespace serialization {
@@ -105,6 +111,92 @@ namespace musik { namespace core { namespace library { namespace query {
         void JsonMapToDuration(
             const nlohmann::json& input,
             std::map<size_t, size_t>& output);
+
+        /* compact binary result encoding. this is an alternative to the JSON
+        representation used above, and is used for queries that may return a
+        large number of rows. values are written directly to an output buffer
+        as they are visited (and read back the same way), so no intermediate
+        document is ever built. integers are written as (zigzag) varints, and
+        strings that have already appeared in the payload are written as
+        back-references, which collapses repetitive album/artist/genre values.
+
+        when binary results cross a text-only boundary (e.g. the websocket
+        `send_raw_query` envelope, or IMetadataProxy::SendRawQuery) they are
+        base64 encoded and prefixed with `kBinaryResultPrefix`. clients opt
+        in by adding `"result_format": "binary"` to the top level of the
+        serialized query; servers that don't understand the field ignore it
+        and respond with JSON, which clients detect via the missing prefix. */
+
+        extern const std::string kBinaryResultPrefix;
+        extern const std::string kResultFormatKey;
+        extern const std::string kResultFormatBinary;
+
+        class BinaryWriter {
+            public:
+                BinaryWriter();
+
+                void WriteVarUInt(uint64_t value);
+                void WriteVarInt(int64_t value);
+                void WriteDouble(double value);
+                void WriteBool(bool value);
+                void WriteString(const std::string& value);
+
+                const std::string& Data() const noexcept { return this->output; }
+                std::string&& Release() noexcept { return std::move(this->output); }
+
+            private:
+                std::string output;
+                std::unordered_map<std::string, uint64_t> strings;
+        };
+
+        class BinaryReader {
+            public:
+                /* throws std::runtime_error if the data is not a valid
+                binary payload, or is truncated */
+                BinaryReader(const std::string& input);
+
+                uint64_t ReadVarUInt();
+                int64_t ReadVarInt();
+                double ReadDouble();
+                bool ReadBool();
+                const std::string& ReadString();
+
+            private:
+                void Require(size_t bytes);
+
+                const std::string& input;
+                size_t offset;
+                std::deque<std::string> strings; /* stable references */
+        };
+
+        void WriteTrackListIds(BinaryWriter& writer, const musik::core::TrackList& input);
+        void ReadTrackListIds(BinaryReader& reader, musik::core::TrackList& output);
+
+        void WriteHeadersAndDurations(
+            BinaryWriter& writer,
+            const std::set<size_t>& headers,
+            const std::map<size_t, size_t>& durations);
+
+        void ReadHeadersAndDurations(
+            BinaryReader& reader,
+            std::set<size_t>& headers,
+            std::map<size_t, size_t>& durations);
+
+        void WriteTrack(BinaryWriter& writer, const musik::core::TrackPtr input, bool onlyIds);
+        void ReadTrack(BinaryReader& reader, musik::core::TrackPtr output, bool onlyIds);
+
+        void WriteValueList(BinaryWriter& writer, const musik::core::library::query::SdkValueList& input);
+        void ReadValueList(BinaryReader& reader, musik::core::library::query::SdkValueList& output);
+
+        void WriteMetadataMapList(BinaryWriter& writer, const musik::core::MetadataMapList& input);
+        void ReadMetadataMapList(BinaryReader& reader, musik::core::MetadataMapList& output);
+
+        /* helpers for the text-safe envelope described above */
+        std::string EncodeBinaryResult(const std::string& binary);
+        bool IsEncodedBinaryResult(const std::string& data);
+        std::string DecodeBinaryResult(const std::string& data);
+        bool IsBinaryResultRequested(const nlohmann::json& serializedQuery);
+        std::string RequestBinaryResult(const std::string& serializedQuery);
     }
 
 } } } }
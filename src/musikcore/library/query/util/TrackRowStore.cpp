@@ -0,0 +1,308 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "pch.hpp"
+#include "TrackRowStore.h"
+
+#include <musikcore/db/Statement.h>
+#include <musikcore/db/ScopedTransaction.h>
+#include <musikcore/library/LocalLibraryConstants.h>
+#include <musikcore/library/track/LibraryTrack.h>
+#include <musikcore/library/query/util/Serialization.h>
+#include <musikcore/library/query/util/TrackQueryFragments.h>
+#include <musikcore/sdk/String.h>
+
+#include <vector>
+
+using namespace musik::core;
+using namespace musik::core::db;
+using namespace musik::core::sdk;
+using namespace musik::core::library::query::serialization;
+
+namespace musik { namespace core { namespace library { namespace query {
+
+    namespace trackrows {
+
+        static const size_t kIdBatchSize = 500;
+        static const size_t kSyncBatchSize = 1000;
+
+        static const std::string kInsertRecord =
+            "INSERT OR REPLACE INTO track_rows (id, external_id, data) VALUES (?, ?, ?)";
+
+        /* every tracks column that feeds into a record (see tracks::kColumns) */
+        static const std::string kTrackColumns =
+            "track, disc, bpm, duration, filesize, title, filename, thumbnail_id, "
+            "filetime, visual_genre_id, visual_artist_id, album_artist_id, "
+            "album_id, source_id, external_id, rating";
+
+        static std::string joinIds(
+            std::vector<int64_t>::const_iterator begin,
+            std::vector<int64_t>::const_iterator end)
+        {
+            std::string result;
+            for (auto it = begin; it != end; ++it) {
+                if (it != begin) {
+                    result += ",";
+                }
+                result += std::to_string(*it);
+            }
+            return result;
+        }
+
+        static bool decode(Statement& stmt, int column, TrackPtr track) {
+            size_t size = 0;
+            const char* data = static_cast<const char*>(stmt.ColumnBlob(column, size));
+            if (!data || !size) {
+                return false;
+            }
+            try {
+                const std::string record(data, size);
+                BinaryReader reader(record);
+                ReadTrack(reader, track, false);
+                return true;
+            }
+            catch (...) {
+                return false; /* corrupt or stale format; rebuilt on fallback */
+            }
+        }
+
+        static void store(Statement& insert, int64_t id, TrackPtr track) {
+            /* records always carry the real id, even if the track being
+            loaded was looked up by external id */
+            const int64_t originalId = track->GetId();
+            track->SetId(id);
+            BinaryWriter writer;
+            WriteTrack(writer, track, false);
+            track->SetId(originalId);
+
+            const std::string& data = writer.Data();
+            insert.ResetAndUnbind();
+            insert.BindInt64(0, id);
+            insert.BindText(1, track->GetString(constants::Track::EXTERNAL_ID));
+            insert.BindBlob(2, data.data(), data.size());
+            insert.Step();
+        }
+
+        void CreateSchema(Connection& db) {
+            db.Execute(
+                "CREATE TABLE IF NOT EXISTS track_rows ("
+                    "id INTEGER PRIMARY KEY,"
+                    "external_id TEXT,"
+                    "data BLOB NOT NULL)");
+
+            /* invalidation: drop a track's record when anything it was built
+            from changes. play counts, last played times, etc. aren't part of
+            the record, so updating them leaves it alone. */
+            const std::string onTrackUpdate =
+                "CREATE TRIGGER IF NOT EXISTS track_rows_on_track_update "
+                "AFTER UPDATE OF " + kTrackColumns + " ON tracks "
+                "BEGIN DELETE FROM track_rows WHERE id=OLD.id; END";
+
+            db.Execute(onTrackUpdate.c_str());
+
+            db.Execute(
+                "CREATE TRIGGER IF NOT EXISTS track_rows_on_track_delete "
+                "AFTER DELETE ON tracks "
+                "BEGIN DELETE FROM track_rows WHERE id=OLD.id; END");
+
+            db.Execute(
+                "CREATE TRIGGER IF NOT EXISTS track_rows_on_replay_gain_insert "
+                "AFTER INSERT ON replay_gain "
+                "BEGIN DELETE FROM track_rows WHERE id=NEW.track_id; END");
+
+            db.Execute(
+                "CREATE TRIGGER IF NOT EXISTS track_rows_on_replay_gain_update "
+                "AFTER UPDATE ON replay_gain "
+                "BEGIN DELETE FROM track_rows WHERE id IN (OLD.track_id, NEW.track_id); END");
+
+            db.Execute(
+                "CREATE TRIGGER IF NOT EXISTS track_rows_on_replay_gain_delete "
+                "AFTER DELETE ON replay_gain "
+                "BEGIN DELETE FROM track_rows WHERE id=OLD.track_id; END");
+
+            db.Execute(
+                "CREATE TRIGGER IF NOT EXISTS track_rows_on_album_update "
+                "AFTER UPDATE OF name ON albums "
+                "BEGIN DELETE FROM track_rows WHERE id IN "
+                "(SELECT id FROM tracks WHERE album_id=NEW.id); END");
+
+            db.Execute(
+                "CREATE TRIGGER IF NOT EXISTS track_rows_on_artist_update "
+                "AFTER UPDATE OF name ON artists "
+                "BEGIN DELETE FROM track_rows WHERE id IN "
+                "(SELECT id FROM tracks WHERE visual_artist_id=NEW.id OR album_artist_id=NEW.id); END");
+
+            db.Execute(
+                "CREATE TRIGGER IF NOT EXISTS track_rows_on_genre_update "
+                "AFTER UPDATE OF name ON genres "
+                "BEGIN DELETE FROM track_rows WHERE id IN "
+                "(SELECT id FROM tracks WHERE visual_genre_id=NEW.id); END");
+        }
+
+        size_t Sync(Connection& db) {
+            const std::string query =
+                "SELECT DISTINCT " + tracks::kColumns + " " +
+                "FROM " + tracks::kTables + " " +
+                "LEFT JOIN " + tracks::kReplayGainJoin + " " +
+                "WHERE t.id NOT IN (SELECT id FROM track_rows) AND " + tracks::kPredicate;
+
+            size_t count = 0;
+            ScopedTransaction transaction(db);
+            Statement select(query.c_str(), db);
+            Statement insert(kInsertRecord.c_str(), db);
+            while (select.Step() == Row) {
+                const int64_t id = select.ColumnInt64(0);
+                /* records don't carry a library, and the indexer has none
+                to give; LibraryTrack(id, ILibraryPtr) would dereference it */
+                auto track = std::make_shared<LibraryTrack>(id, 0);
+                tracks::ParseFullTrackMetadata(track, select);
+                store(insert, id, track);
+                if (++count % kSyncBatchSize == 0) {
+                    transaction.CommitAndRestart();
+                }
+            }
+            return count;
+        }
+
+        bool Load(Connection& db, TrackPtr track) {
+            const bool byId = track->GetId() != 0;
+            const int64_t id = track->GetId();
+            const std::string externalId = track->GetString(constants::Track::EXTERNAL_ID);
+
+            if (!byId && !externalId.size()) {
+                return false;
+            }
+
+            {
+                Statement select(byId
+                    ? "SELECT data FROM track_rows WHERE id=?"
+                    : "SELECT data FROM track_rows WHERE external_id=?", db);
+
+                if (byId) {
+                    select.BindInt64(0, id);
+                }
+                else {
+                    select.BindText(0, externalId);
+                }
+
+                if (select.Step() == Row && decode(select, 0, track)) {
+                    track->SetId(id);
+                    return true;
+                }
+            }
+
+            /* no record yet: fall back to the join. reads never write the
+            record back; the indexer's Sync() fills it in, so a lookup never
+            contends with the indexer for the database. */
+            Statement query(byId
+                ? tracks::kAllMetadataQueryById.c_str()
+                : tracks::kAllMetadataQueryByExternalId.c_str(), db);
+
+            if (byId) {
+                query.BindInt64(0, id);
+            }
+            else {
+                query.BindText(0, externalId);
+            }
+
+            if (query.Step() != Row) {
+                return false;
+            }
+
+            tracks::ParseFullTrackMetadata(track, query);
+            return true;
+        }
+
+        bool Load(
+            Connection& db,
+            const std::unordered_set<int64_t>& ids,
+            ILibraryPtr library,
+            IdToTrackMap& result,
+            std::function<bool()> isCanceled)
+        {
+            const std::vector<int64_t> all(ids.begin(), ids.end());
+            std::vector<int64_t> missing;
+
+            for (size_t i = 0; i < all.size(); i += kIdBatchSize) {
+                const auto end = all.begin() + std::min(all.size(), i + kIdBatchSize);
+                const std::string query =
+                    "SELECT id, data FROM track_rows WHERE id IN (" +
+                    joinIds(all.begin() + i, end) + ")";
+
+                Statement select(query.c_str(), db);
+                while (select.Step() == Row) {
+                    if (isCanceled && isCanceled()) {
+                        return false;
+                    }
+                    const int64_t id = select.ColumnInt64(0);
+                    auto track = std::make_shared<LibraryTrack>(id, library);
+                    if (decode(select, 1, track)) {
+                        result[id] = track;
+                    }
+                }
+
+                for (auto it = all.begin() + i; it != end; ++it) {
+                    if (result.find(*it) == result.end()) {
+                        missing.push_back(*it);
+                    }
+                }
+            }
+
+            if (missing.empty()) {
+                return true;
+            }
+
+            /* no records for these yet: fall back to the join (see above) */
+            for (size_t i = 0; i < missing.size(); i += kIdBatchSize) {
+                const auto end = missing.begin() + std::min(missing.size(), i + kIdBatchSize);
+                std::string query = tracks::kAllMetadataQueryByIdBatch;
+                str::ReplaceAll(query, "{{ids}}", joinIds(missing.begin() + i, end).c_str());
+
+                Statement select(query.c_str(), db);
+                while (select.Step() == Row) {
+                    if (isCanceled && isCanceled()) {
+                        return false;
+                    }
+                    const int64_t id = select.ColumnInt64(0);
+                    auto track = std::make_shared<LibraryTrack>(id, library);
+                    tracks::ParseFullTrackMetadata(track, select);
+                    result[id] = track;
+                }
+            }
+
+            return true;
+        }
+    }
+
+} } } }
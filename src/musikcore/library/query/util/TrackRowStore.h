@@ -0,0 +1,86 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <musikcore/db/Connection.h>
+#include <musikcore/library/track/Track.h>
+#include <musikcore/library/ILibrary.h>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+
+namespace musik { namespace core { namespace library { namespace query {
+
+    namespace trackrows {
+
+        /* the track_rows table is a denormalized copy of everything the
+        track metadata queries return (the tracks/albums/artists/genres join,
+        plus replay gain), one binary-encoded record per track, keyed by id
+        and indexed by external id. fetching a track is a primary key lookup
+        instead of a five-way join.
+
+        records are maintained lazily: triggers delete a track's record
+        whenever anything it was built from changes, lookups that miss fall
+        back to the join (they never write, so reads stay read-only), and the
+        indexer fills in any missing records at the end of each sync. */
+
+        using IdToTrackMap = std::unordered_map<int64_t, musik::core::TrackPtr>;
+
+        /* creates the table and the invalidation triggers */
+        void CreateSchema(musik::core::db::Connection& db);
+
+        /* builds records for all tracks that don't have one. returns the
+        number of records written. */
+        size_t Sync(musik::core::db::Connection& db);
+
+        /* loads the track's metadata by id, or by external id if the track's
+        id is 0. returns false if the track doesn't exist. */
+        bool Load(
+            musik::core::db::Connection& db,
+            musik::core::TrackPtr track);
+
+        /* loads metadata for all of the specified ids into `result`; ids that
+        don't exist are omitted. `isCanceled`, if specified, is polled for
+        every row; once it returns true loading stops and false is returned. */
+        bool Load(
+            musik::core::db::Connection& db,
+            const std::unordered_set<int64_t>& ids,
+            musik::core::ILibraryPtr library,
+            IdToTrackMap& result,
+            std::function<bool()> isCanceled = std::function<bool()>());
+    }
+
+} } } }
@@ -158,7 +158,7 @@ double IndexerTrack::GetDouble(const char* key, double defaultValue) {
 void IndexerTrack::SetValue(const char* metakey, const char* value) {
     if (metakey && value && strlen(value)) {
         this->internalMetadata->metadata.insert(
-            std::pair<std::string, std::string>(metakey,value));
+            MetadataMap::value_type(metakey, value));
     }
 }
 
@@ -512,20 +512,20 @@ void IndexerTrack::ProcessNonStandardMetadata(db::Connection& connection) {
         bool keyCached = false, valueCached = false;
 
         /* lookup the ID for the key; insert if it doesn't exist.. */
-        if (metadataIdCache.find("metaKey-" + it->first) != metadataIdCache.end()) {
-            keyId = metadataIdCache["metaKey-" + it->first];
+        if (metadataIdCache.find("metaKey-" + it->first.str()) != metadataIdCache.end()) {
+            keyId = metadataIdCache["metaKey-" + it->first.str()];
             keyCached = true;
         }
         else {
             selectMetaKey.Reset();
-            selectMetaKey.BindText(0, it->first);
+            selectMetaKey.BindText(0, it->first.str());
 
             if (selectMetaKey.Step() == db::Row) {
                 keyId = selectMetaKey.ColumnInt64(0);
             }
             else {
                 insertMetaKey.Reset();
-                insertMetaKey.BindText(0, it->first);
+                insertMetaKey.BindText(0, it->first.str());
 
                 if (insertMetaKey.Step() == db::Done) {
                     keyId = connection.LastInsertedId();
@@ -533,7 +533,7 @@ void IndexerTrack::ProcessNonStandardMetadata(db::Connection& connection) {
             }
 
             if (keyId != 0) {
-                metadataIdCache["metaKey-" + it->first] = keyId;
+                metadataIdCache["metaKey-" + it->first.str()] = keyId;
             }
         }
 
@@ -546,14 +546,14 @@ void IndexerTrack::ProcessNonStandardMetadata(db::Connection& connection) {
 
         int64_t valueId = 0;
 
-        if (metadataIdCache.find("metaValue-" + it->second) != metadataIdCache.end()) {
-            valueId = metadataIdCache["metaValue-" + it->second];
+        if (metadataIdCache.find("metaValue-" + it->second.str()) != metadataIdCache.end()) {
+            valueId = metadataIdCache["metaValue-" + it->second.str()];
             valueCached = true;
         }
         else {
             selectMetaValue.Reset();
             selectMetaValue.BindInt64(0, keyId);
-            selectMetaValue.BindText(1, it->second);
+            selectMetaValue.BindText(1, it->second.str());
 
             if (selectMetaValue.Step() == db::Row) {
                 valueId = selectMetaValue.ColumnInt64(0);
@@ -561,7 +561,7 @@ void IndexerTrack::ProcessNonStandardMetadata(db::Connection& connection) {
             else {
                 insertMetaValue.Reset();
                 insertMetaValue.BindInt64(0, keyId);
-                insertMetaValue.BindText(1, it->second);
+                insertMetaValue.BindText(1, it->second.str());
 
                 if (insertMetaValue.Step() == db::Done) {
                     valueId = connection.LastInsertedId();
@@ -569,7 +569,7 @@ void IndexerTrack::ProcessNonStandardMetadata(db::Connection& connection) {
             }
 
             if (valueId != 0) {
-                metadataIdCache["metaValue-" + it->second] = valueId;
+                metadataIdCache["metaValue-" + it->second.str()] = valueId;
             }
         }
 
@@ -787,13 +787,16 @@ void IndexerTrack::SaveDirectory(db::Connection& db, const std::string& filename
             }
 
             if (dirId != -1) {
-                db::Statement update("UPDATE tracks SET directory_id=? WHERE id=?", db);
-                update.BindInt64(0, dirId);
-                update.BindInt64(1, this->trackId);
-                update.Step();
+                metadataIdCache["directoryId-" + dir] = dirId;
             }
         }
 
+        if (dirId != -1) {
+            db::Statement update("UPDATE tracks SET directory_id=? WHERE id=?", db);
+            update.BindInt64(0, dirId);
+            update.BindInt64(1, this->trackId);
+            update.Step();
+        }
     }
     catch (...) {
         /* not much we can do, but we don't want the app to die if we're
@@ -115,13 +115,11 @@ double LibraryTrack::GetDouble(const char* key, double defaultValue) {
 }
 
 void LibraryTrack::SetValue(const char* metakey, const char* value) {
-    if (value) {
-        std::string strValue(value);
-        if (strValue.size()) {
-            std::unique_lock<std::mutex> lock(this->mutex);
-            this->metadata.insert(std::pair<std::string, std::string>(metakey, strValue));
-        }
-
+    if (value && *value) {
+        /* intern outside of the lock; the pool has its own synchronization */
+        MetadataMap::value_type entry(metakey, value);
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->metadata.insert(std::move(entry));
     }
 }
 
@@ -38,6 +38,7 @@
 #include <musikcore/sdk/ITagStore.h>
 #include <musikcore/library/ILibrary.h>
 #include <musikcore/sdk/ITrack.h>
+#include <musikcore/library/metadata/CompactMetadataMap.h>
 #include <atomic>
 #include <vector>
 #include <map>
@@ -52,7 +53,7 @@ namespace musik { namespace core {
         public std::enable_shared_from_this<Track>
     {
         public:
-            typedef std::multimap<std::string, std::string> MetadataMap;
+            typedef musik::core::CompactMetadataMap MetadataMap;
             typedef std::pair<MetadataMap::iterator, MetadataMap::iterator> MetadataIteratorRange;
 
             virtual musik::core::ILibraryPtr Library() noexcept;
@@ -0,0 +1,308 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "pch.hpp"
+#include "TrackIdList.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace musik::core;
+
+/* leaves are small enough that a mid-leaf insert or copy-on-write clone
+is cheap, and branches wide enough that a million ids are three levels */
+static constexpr size_t kLeafCapacity = 256;
+static constexpr size_t kBranchCapacity = 64;
+
+TrackIdList::TrackIdList() noexcept {
+}
+
+TrackIdList::TrackIdList(const int64_t* ids, size_t count) {
+    if (!ids || !count) {
+        return;
+    }
+
+    /* bulk load: pack full leaves, then build branches bottom-up */
+    std::vector<NodePtr> level;
+    for (size_t i = 0; i < count; i += kLeafCapacity) {
+        auto leaf = std::make_shared<Node>();
+        const size_t end = std::min(count, i + kLeafCapacity);
+        leaf->ids.assign(ids + i, ids + end);
+        leaf->count = end - i;
+        level.push_back(leaf);
+    }
+
+    while (level.size() > 1) {
+        std::vector<NodePtr> parents;
+        for (size_t i = 0; i < level.size(); i += kBranchCapacity) {
+            auto branch = std::make_shared<Node>();
+            branch->leaf = false;
+            const size_t end = std::min(level.size(), i + kBranchCapacity);
+            for (size_t j = i; j < end; j++) {
+                branch->count += level[j]->count;
+                branch->children.push_back(level[j]);
+            }
+            parents.push_back(branch);
+        }
+        level.swap(parents);
+    }
+
+    this->root = level.front();
+}
+
+TrackIdList::TrackIdList(const std::vector<int64_t>& ids)
+: TrackIdList(ids.data(), ids.size()) {
+}
+
+size_t TrackIdList::Size() const noexcept {
+    return this->root ? this->root->count : 0;
+}
+
+bool TrackIdList::Empty() const noexcept {
+    return this->Size() == 0;
+}
+
+int64_t TrackIdList::At(size_t index) const {
+    if (index >= this->Size()) {
+        throw std::out_of_range("TrackIdList index out of range");
+    }
+    const Node* node = this->root.get();
+    while (!node->leaf) {
+        for (auto& child : node->children) {
+            if (index < child->count) {
+                node = child.get();
+                break;
+            }
+            index -= child->count;
+        }
+    }
+    return node->ids[index];
+}
+
+size_t TrackIdList::Find(int64_t id) const {
+    size_t offset = 0, result = npos;
+    this->ForEachBlock([&offset, &result, id](const int64_t* ids, size_t count) {
+        auto it = std::find(ids, ids + count, id);
+        if (it != ids + count) {
+            result = offset + (size_t)(it - ids);
+            return false;
+        }
+        offset += count;
+        return true;
+    });
+    return result;
+}
+
+std::vector<int64_t> TrackIdList::ToVector() const {
+    std::vector<int64_t> result;
+    result.reserve(this->Size());
+    this->ForEachBlock([&result](const int64_t* ids, size_t count) {
+        result.insert(result.end(), ids, ids + count);
+        return true;
+    });
+    return result;
+}
+
+void TrackIdList::Set(size_t index, int64_t id) {
+    if (index >= this->Size()) {
+        throw std::out_of_range("TrackIdList index out of range");
+    }
+    Node* node = Mutable(this->root);
+    while (!node->leaf) {
+        for (auto& child : node->children) {
+            if (index < child->count) {
+                node = Mutable(child);
+                break;
+            }
+            index -= child->count;
+        }
+    }
+    node->ids[index] = id;
+}
+
+void TrackIdList::Insert(size_t index, int64_t id) {
+    if (!this->root) {
+        this->root = std::make_shared<Node>();
+    }
+    index = std::min(index, this->root->count);
+    auto split = Insert(this->root, index, id);
+    if (split) { /* the root split; grow the tree by a level */
+        auto root = std::make_shared<Node>();
+        root->leaf = false;
+        root->count = this->root->count + split->count;
+        root->children.push_back(this->root);
+        root->children.push_back(split);
+        this->root = root;
+    }
+}
+
+void TrackIdList::PushBack(int64_t id) {
+    this->Insert(this->Size(), id);
+}
+
+void TrackIdList::Erase(size_t index) {
+    if (index >= this->Size()) {
+        throw std::out_of_range("TrackIdList index out of range");
+    }
+    Erase(this->root, index);
+    while (!this->root->leaf && this->root->children.size() == 1) {
+        this->root = this->root->children.front(); /* shrink by a level */
+    }
+    if (this->root->count == 0) {
+        this->root.reset();
+    }
+}
+
+void TrackIdList::Clear() noexcept {
+    this->root.reset();
+}
+
+void TrackIdList::Swap(TrackIdList& other) noexcept {
+    std::swap(this->root, other.root);
+}
+
+size_t TrackIdList::Width(const Node& node) noexcept {
+    return node.leaf ? node.ids.size() : node.children.size();
+}
+
+TrackIdList::Node* TrackIdList::Mutable(NodePtr& node) {
+    /* copy-on-write: a node is only modified in place if this is the only
+    list that references it. cloning a branch just copies its child pointers,
+    so the children remain shared until they're edited themselves. */
+    if (node.use_count() > 1) {
+        node = std::make_shared<Node>(*node);
+    }
+    return node.get();
+}
+
+TrackIdList::NodePtr TrackIdList::Insert(NodePtr& nodePtr, size_t index, int64_t id) {
+    Node* node = Mutable(nodePtr);
+    ++node->count;
+
+    if (node->leaf) {
+        node->ids.insert(node->ids.begin() + index, id);
+        if (node->ids.size() <= kLeafCapacity) {
+            return NodePtr();
+        }
+        auto right = std::make_shared<Node>();
+        const size_t half = node->ids.size() / 2;
+        right->ids.assign(node->ids.begin() + half, node->ids.end());
+        right->count = right->ids.size();
+        node->ids.resize(half);
+        node->count = half;
+        return right;
+    }
+
+    size_t i = 0;
+    for (; i < node->children.size() - 1; i++) {
+        if (index <= node->children[i]->count) {
+            break;
+        }
+        index -= node->children[i]->count;
+    }
+
+    auto split = Insert(node->children[i], index, id);
+    if (split) {
+        node->children.insert(node->children.begin() + i + 1, split);
+    }
+
+    if (node->children.size() <= kBranchCapacity) {
+        return NodePtr();
+    }
+
+    auto right = std::make_shared<Node>();
+    right->leaf = false;
+    const size_t half = node->children.size() / 2;
+    right->children.assign(node->children.begin() + half, node->children.end());
+    node->children.resize(half);
+    for (auto& child : right->children) {
+        right->count += child->count;
+    }
+    node->count -= right->count;
+    return right;
+}
+
+void TrackIdList::Erase(NodePtr& nodePtr, size_t index) {
+    Node* node = Mutable(nodePtr);
+    --node->count;
+
+    if (node->leaf) {
+        node->ids.erase(node->ids.begin() + index);
+        return;
+    }
+
+    size_t i = 0;
+    for (; i < node->children.size(); i++) {
+        if (index < node->children[i]->count) {
+            break;
+        }
+        index -= node->children[i]->count;
+    }
+
+    Erase(node->children[i], index);
+    Rebalance(*node, i);
+}
+
+void TrackIdList::Rebalance(Node& parent, size_t index) {
+    auto& children = parent.children;
+
+    if (children[index]->count == 0) {
+        children.erase(children.begin() + index);
+        return;
+    }
+
+    /* merge an underfull node into a neighbor if the result fits. we don't
+    bother borrowing from neighbors, so nodes may stay sparse, but the tree
+    can't degrade into a list of near-empty blocks */
+    const size_t capacity = children[index]->leaf ? kLeafCapacity : kBranchCapacity;
+    if (children.size() < 2 || Width(*children[index]) >= capacity / 4) {
+        return;
+    }
+
+    const size_t left = (index > 0) ? index - 1 : index;
+    const Node& right = *children[left + 1];
+    if (Width(*children[left]) + Width(right) > capacity) {
+        return;
+    }
+
+    Node* merged = Mutable(children[left]);
+    if (merged->leaf) {
+        merged->ids.insert(merged->ids.end(), right.ids.begin(), right.ids.end());
+    }
+    else {
+        merged->children.insert(merged->children.end(), right.children.begin(), right.children.end());
+    }
+    merged->count += right.count;
+    children.erase(children.begin() + left + 1);
+}
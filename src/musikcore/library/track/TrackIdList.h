@@ -0,0 +1,110 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace musik { namespace core {
+
+    /* an ordered list of track ids stored as a persistent (copy-on-write)
+    b+tree of fixed-size id blocks. copies share structure and are O(1);
+    indexed reads and edits are O(log n), and only copy the nodes along
+    the edited path if they are shared with another list. */
+    class TrackIdList {
+        public:
+            static constexpr size_t npos = (size_t) -1;
+
+            TrackIdList() noexcept;
+            TrackIdList(const int64_t* ids, size_t count);
+            TrackIdList(const std::vector<int64_t>& ids);
+
+            size_t Size() const noexcept;
+            bool Empty() const noexcept;
+            int64_t At(size_t index) const;
+            int64_t operator[](size_t index) const { return this->At(index); }
+            size_t Find(int64_t id) const;
+            std::vector<int64_t> ToVector() const;
+
+            void Set(size_t index, int64_t id);
+            void Insert(size_t index, int64_t id);
+            void PushBack(int64_t id);
+            void Erase(size_t index);
+            void Clear() noexcept;
+            void Swap(TrackIdList& other) noexcept;
+
+            /* calls `fn(const int64_t* ids, size_t count)` for each block
+            of ids, in order. returning false stops the iteration. */
+            template <typename Fn> void ForEachBlock(Fn fn) const {
+                if (this->root) {
+                    ForEachBlock(*this->root, fn);
+                }
+            }
+
+        private:
+            struct Node;
+            using NodePtr = std::shared_ptr<Node>;
+
+            struct Node {
+                bool leaf{ true };
+                size_t count{ 0 };
+                std::vector<int64_t> ids; /* leaf only */
+                std::vector<NodePtr> children; /* branch only */
+            };
+
+            template <typename Fn> static bool ForEachBlock(const Node& node, Fn& fn) {
+                if (node.leaf) {
+                    return node.ids.empty() || fn(node.ids.data(), node.ids.size());
+                }
+                for (auto& child : node.children) {
+                    if (!ForEachBlock(*child, fn)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            static size_t Width(const Node& node) noexcept;
+            static Node* Mutable(NodePtr& node);
+            static NodePtr Insert(NodePtr& node, size_t index, int64_t id);
+            static void Erase(NodePtr& node, size_t index);
+            static void Rebalance(Node& parent, size_t index);
+
+            NodePtr root;
+    };
+
+} }
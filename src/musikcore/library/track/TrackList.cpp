@@ -49,6 +49,8 @@
 #include <map>
 #include <random>
 #include <chrono>
+#include <algorithm>
+#include <limits>
 
 using namespace musik::core;
 using namespace musik::core::db;
@@ -60,80 +62,143 @@ using namespace std::chrono;
 static constexpr size_t kDefaultCacheSize = 50;
 static constexpr int64_t kCacheWindowTimeoutMs = 150LL;
 
+/* scroll tracking: Get() calls closer together than kScrollBurstMs are
+considered part of the same redraw; a pause longer than kScrollIdleMs
+resets the measured velocity */
+static constexpr int64_t kScrollBurstMs = 8LL;
+static constexpr int64_t kScrollIdleMs = 500LL;
+
+/* once scrolling faster than kPrefetchMinVelocity rows per second we fetch
+ahead far enough to cover kPrefetchHorizonMs of continued scrolling, up to
+kMaxPrefetchRows. the lru cache is allowed to grow by the same amount so
+prefetched rows aren't immediately evicted */
+static constexpr double kPrefetchMinVelocity = 15.0;
+static constexpr double kPrefetchHorizonMs = 750.0;
+static constexpr size_t kMaxPrefetchRows = 400;
+
 TrackList::TrackList(ILibraryPtr library)
 : library(library)
 , cacheSize(kDefaultCacheSize) {
 }
 
 TrackList::TrackList(TrackList* other)
-: ids(other->ids)
-, library(other->library)
+: library(other->library)
 , cacheSize(kDefaultCacheSize) {
+    this->CopyFrom(*other);
 }
 
 TrackList::TrackList(std::shared_ptr<TrackList> other)
-    : ids(other->ids)
-    , library(other->library)
+    : library(other->library)
     , cacheSize(kDefaultCacheSize) {
+    this->CopyFrom(*other);
 }
 
 TrackList::TrackList(ILibraryPtr library, const int64_t* trackIds, size_t trackIdCount)
 : library(library)
 , cacheSize(kDefaultCacheSize) {
     if (trackIds != nullptr && trackIdCount > 0) {
-        this->ids.insert(this->ids.end(), &trackIds[0], &trackIds[trackIdCount]);
+        this->ids = TrackIdList(trackIds, trackIdCount);
     }
 }
 
 size_t TrackList::Count() const noexcept {
-    return ids.size();
+    return this->ids.Size() + this->inserted.size();
 }
 
 void TrackList::Add(const int64_t id) {
-    this->ids.push_back(id);
+    /* in View mode this extends the unpermuted tail, so the new id is
+    last in both the shuffled and unshuffled orders */
+    this->ids.PushBack(id);
+    if (this->shuffleState == ShuffleState::Materialized) {
+        this->unshuffledIds.PushBack(id);
+    }
 }
 
 bool TrackList::Insert(int64_t id, size_t index) {
-    if (index < narrow_cast<int>(this->ids.size())) {
-        this->ids.insert(this->ids.begin() + index, id);
+    if (index >= this->Count()) {
+        this->Add(id);
+        return true;
+    }
+
+    if (this->shuffleState == ShuffleState::View) {
+        auto it = this->FindInserted(index);
+        for (auto shift = it; shift != this->inserted.end(); ++shift) {
+            ++shift->first;
+        }
+        this->inserted.insert(it, std::make_pair(index, id));
         return true;
     }
-    this->ids.push_back(id);
+
+    if (this->shuffleState == ShuffleState::Materialized) {
+        /* the new id follows whatever precedes it in the shuffled order */
+        auto& unshuffled = this->unshuffledIds;
+        size_t anchor = 0;
+        if (index > 0) {
+            anchor = unshuffled.Find(this->ids.At(index - 1));
+            anchor = (anchor == TrackIdList::npos) ? unshuffled.Size() : anchor + 1;
+        }
+        unshuffled.Insert(anchor, id);
+    }
+
+    this->ids.Insert(index, id);
     return true;
 }
 
 bool TrackList::Swap(size_t index1, size_t index2) {
-    const auto size = this->ids.size();
+    const auto size = this->Count();
     if (index1 < size && index2 < size) {
-        auto temp = this->ids.at(index1);
-        this->ids.at(index1) = this->ids.at(index2);
-        this->ids.at(index2) = temp;
+        this->Materialize();
+        auto temp = this->ids.At(index1);
+        this->ids.Set(index1, this->ids.At(index2));
+        this->ids.Set(index2, temp);
         return true;
     }
     return false;
 }
 
 bool TrackList::Move(size_t from, size_t to) {
-    const auto size = this->ids.size();
+    const auto size = this->Count();
     if (from < size && to < size && from != to) {
-        auto temp = this->ids.at(from);
-        this->ids.erase(this->ids.begin() + from);
-        this->ids.insert(this->ids.begin() + to, temp);
+        this->Materialize();
+        auto temp = this->ids.At(from);
+        this->ids.Erase(from);
+        this->ids.Insert(to, temp);
         return true;
     }
     return false;
 }
 
 bool TrackList::Delete(size_t index) {
-    if (index < narrow_cast<int>(this->ids.size())) {
-        this->ids.erase(this->ids.begin() + index);
-        return true;
+    if (index >= this->Count()) {
+        return false;
     }
-    return false;
+
+    if (this->shuffleState == ShuffleState::View) {
+        auto it = this->FindInserted(index);
+        if (it != this->inserted.end() && it->first == index) {
+            it = this->inserted.erase(it);
+            for (; it != this->inserted.end(); ++it) {
+                --it->first;
+            }
+            return true;
+        }
+        this->Materialize();
+    }
+
+    if (this->shuffleState == ShuffleState::Materialized) {
+        auto& unshuffled = this->unshuffledIds;
+        const size_t position = unshuffled.Find(this->ids.At(index));
+        if (position != TrackIdList::npos) {
+            unshuffled.Erase(position);
+        }
+    }
+
+    this->ids.Erase(index);
+    return true;
 }
 
 TrackPtr TrackList::Get(size_t index, bool async) const {
-    if (index > this->ids.size() - 1) {
+    if (index >= this->Count()) {
         auto missing = std::make_shared<LibraryTrack>(-1LL, this->library);
         missing->SetMetadataState(MetadataState::Missing);
         return missing;
@@ -154,22 +219,30 @@ TrackPtr TrackList::Get(size_t index, bool async) const {
 
     return TrackPtr();
 #else
-    /* batch a window around the requested index */
-    auto id = this->ids.at(index);
+    /* batch a window around the requested index, extended in the direction
+    we're scrolling */
+    auto id = this->GetId(index);
+    this->UpdateScrollVelocity(index);
+
     auto cached = this->GetFromCache(id);
-    if (cached) { return cached; }
+    if (cached) {
+        ++this->stats.hits;
+        if (async) {
+            this->PrefetchAhead(index);
+        }
+        return cached;
+    }
+
+    ++this->stats.misses;
 
-    const int half = (narrow_cast<int>(this->cacheSize) - 1) / 2;
-    int remain = narrow_cast<int>(this->cacheSize) - 1;
-    const int from = narrow_cast<int>(index) - half;
-    remain -= from > 0 ? half : (half + from);
-    const int to = narrow_cast<int>(index) + remain;
-    this->CacheWindow(std::max(0, from), to, async);
+    size_t from = 0, to = 0;
+    this->GetPrefetchWindow(index, from, to);
+    this->CacheWindow(from, to, async);
 
     cached = this->GetFromCache(id);
 
     if (async && !cached) {
-        auto loadingTrack = std::make_shared<LibraryTrack>(this->ids.at(index), this->library);
+        auto loadingTrack = std::make_shared<LibraryTrack>(id, this->library);
         loadingTrack->SetMetadataState(MetadataState::Loading);
         return loadingTrack;
     }
@@ -179,7 +252,7 @@ TrackPtr TrackList::Get(size_t index, bool async) const {
 }
 
 TrackPtr TrackList::GetWithTimeout(size_t index, size_t timeoutMs) const {
-    auto id = this->ids.at(index);
+    auto id = this->GetId(index);
     auto cached = this->GetFromCache(id);
     if (cached) { return cached; }
 
@@ -199,36 +272,260 @@ ITrack* TrackList::GetTrack(size_t index) const {
 }
 
 int64_t TrackList::GetId(size_t index) const {
-    return this->ids.at(index);
+    if (this->shuffleState != ShuffleState::View) {
+        return this->ids.At(index);
+    }
+    if (!this->inserted.empty()) {
+        auto it = this->FindInserted(index);
+        if (it != this->inserted.end() && it->first == index) {
+            return it->second;
+        }
+        index -= (size_t)(it - this->inserted.begin());
+    }
+    return this->GetBaseId(index);
+}
+
+int64_t TrackList::GetBaseId(size_t index) const {
+    /* `index` excludes mid-list inserts: the first permutation.Count()
+    ids are permuted, anything appended after entering View mode isn't */
+    if (index < this->permutation.Count()) {
+        return this->ids[this->permutation.Map(index)];
+    }
+    return this->ids.At(index);
+}
+
+TrackList::InsertedList::iterator TrackList::FindInserted(size_t index) {
+    return std::lower_bound(
+        this->inserted.begin(),
+        this->inserted.end(),
+        index,
+        [](const auto& entry, size_t i) { return entry.first < i; });
+}
+
+TrackList::InsertedList::const_iterator TrackList::FindInserted(size_t index) const {
+    return std::lower_bound(
+        this->inserted.begin(),
+        this->inserted.end(),
+        index,
+        [](const auto& entry, size_t i) { return entry.first < i; });
+}
+
+const std::vector<int64_t> TrackList::GetIds() const {
+    if (this->shuffleState != ShuffleState::View) {
+        return this->ids.ToVector();
+    }
+
+    /* flatten once, then apply the permutation and merge in the inserted
+    ids, rather than walking the tree for every index */
+    const auto base = this->ids.ToVector();
+    const size_t permuted = this->permutation.Count();
+    std::vector<int64_t> result;
+    result.reserve(this->Count());
+    auto inserted = this->inserted.begin();
+    for (size_t i = 0; i < base.size(); i++) {
+        for (; inserted != this->inserted.end() && inserted->first == result.size(); ++inserted) {
+            result.push_back(inserted->second);
+        }
+        result.push_back(i < permuted ? base[this->permutation.Map(i)] : base[i]);
+    }
+    for (; inserted != this->inserted.end(); ++inserted) {
+        result.push_back(inserted->second);
+    }
+    return result;
 }
 
 void TrackList::CopyFrom(const TrackList& from) {
+    if (&from == this) {
+        return;
+    }
+
     this->Clear();
 
-    std::copy(
-        from.ids.begin(),
-        from.ids.end(),
-        std::back_inserter(this->ids));
+    /* ids are shared copy-on-write, so copying (including the shuffle
+    state) is constant time regardless of list size */
+    this->ids = from.ids;
+    this->shuffleState = from.shuffleState;
+    this->permutation = from.permutation;
+    this->inserted = from.inserted;
+    this->unshuffledIds = from.unshuffledIds;
 }
 
 void TrackList::CopyTo(TrackList& to) {
-    to.CopyFrom(this);
+    to.CopyFrom(*this);
 }
 
 int TrackList::IndexOf(int64_t id) const {
-    auto it = std::find(this->ids.begin(), this->ids.end(), id);
-    return narrow_cast<int>((it == this->ids.end()) ? -1 : it - this->ids.begin());
+    if (this->shuffleState != ShuffleState::View) {
+        const size_t position = this->ids.Find(id);
+        return (position == TrackIdList::npos) ? -1 : narrow_cast<int>(position);
+    }
+
+    /* find the lowest permuted position of the id, then account for any
+    ids inserted ahead of it */
+    constexpr size_t kNotFound = std::numeric_limits<size_t>::max();
+    const size_t permuted = this->permutation.Count();
+    size_t result = kNotFound, offset = 0;
+    this->ids.ForEachBlock([&](const int64_t* block, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            if (block[i] == id) {
+                const size_t index = offset + i;
+                result = std::min(result, index < permuted ? this->permutation.Unmap(index) : index);
+            }
+        }
+        offset += count;
+        return true;
+    });
+    if (result != kNotFound) {
+        for (auto& entry : this->inserted) {
+            if (entry.first > result) {
+                break;
+            }
+            ++result;
+        }
+    }
+    for (auto& entry : this->inserted) {
+        if (entry.first >= result) {
+            break;
+        }
+        if (entry.second == id) {
+            result = entry.first;
+            break;
+        }
+    }
+    return (result == kNotFound) ? -1 : narrow_cast<int>(result);
+}
+
+bool TrackList::IsShuffled() const noexcept {
+    return this->shuffleState != ShuffleState::None;
+}
+
+size_t TrackList::EnterShuffledMode(size_t index) {
+    if (this->shuffleState != ShuffleState::None || this->ids.Empty()) {
+        return index;
+    }
+    auto seed = static_cast<uint64_t>(system_clock::now().time_since_epoch().count());
+    this->permutation = Permutation(this->ids.Size(), seed);
+    this->shuffleState = ShuffleState::View;
+    return (index < this->ids.Size()) ? this->permutation.Unmap(index) : index;
+}
+
+size_t TrackList::ExitShuffledMode(size_t index) {
+    if (this->shuffleState == ShuffleState::View) {
+        if (this->inserted.empty()) {
+            if (index < this->permutation.Count()) {
+                index = this->permutation.Map(index);
+            }
+        }
+        else {
+            size_t unshuffledIndex = index;
+            this->ids = TrackIdList(this->Unshuffle(index, unshuffledIndex));
+            index = unshuffledIndex;
+        }
+    }
+    else if (this->shuffleState == ShuffleState::Materialized) {
+        const bool valid = index < this->ids.Size();
+        const int64_t id = valid ? this->ids[index] : -1;
+        this->ids.Swap(this->unshuffledIds);
+        if (valid) {
+            const size_t position = this->ids.Find(id);
+            if (position != TrackIdList::npos) {
+                index = position;
+            }
+        }
+    }
+    this->ResetShuffle();
+    return index;
+}
+
+std::vector<int64_t> TrackList::Unshuffle(size_t index, size_t& unshuffledIndex) const {
+    /* rebuilds the unshuffled order from View mode state. ids inserted into
+    the middle of the shuffled view are placed directly after the id that
+    preceded them in the view (or at the front if there was none) */
+    const auto base = this->ids.ToVector();
+    const size_t count = base.size();
+    const size_t permuted = this->permutation.Count();
+    const auto unpermute = [this, permuted](size_t i) {
+        return (i < permuted) ? this->permutation.Map(i) : i;
+    };
+
+    /* (anchor + 1, position in `inserted`); 0 means the front */
+    std::vector<std::pair<size_t, size_t>> anchors;
+    anchors.reserve(this->inserted.size());
+    for (size_t i = 0; i < this->inserted.size(); i++) {
+        const size_t before = this->inserted[i].first - i;
+        anchors.push_back(std::make_pair(before ? unpermute(before - 1) + 1 : 0, i));
+    }
+    std::sort(anchors.begin(), anchors.end());
+
+    size_t target = std::numeric_limits<size_t>::max();
+    bool targetInserted = false;
+    if (index < this->Count()) {
+        auto it = this->FindInserted(index);
+        targetInserted = (it != this->inserted.end() && it->first == index);
+        target = targetInserted
+            ? (size_t)(it - this->inserted.begin())
+            : unpermute(index - (size_t)(it - this->inserted.begin()));
+    }
+
+    std::vector<int64_t> result;
+    result.reserve(this->Count());
+    auto anchor = anchors.begin();
+    const auto drain = [&](size_t key) {
+        for (; anchor != anchors.end() && anchor->first == key; ++anchor) {
+            if (targetInserted && anchor->second == target) {
+                unshuffledIndex = result.size();
+            }
+            result.push_back(this->inserted[anchor->second].second);
+        }
+    };
+
+    drain(0);
+    for (size_t i = 0; i < count; i++) {
+        if (!targetInserted && i == target) {
+            unshuffledIndex = result.size();
+        }
+        result.push_back(base[i]);
+        drain(i + 1);
+    }
+
+    return result;
+}
+
+void TrackList::Materialize() {
+    /* some edits can't be expressed against a permutation; when that
+    happens we fall back to storing both orders explicitly */
+    if (this->shuffleState != ShuffleState::View) {
+        return;
+    }
+    size_t unused = 0;
+    auto unshuffled = this->Unshuffle(0, unused);
+    this->ids = TrackIdList(this->GetIds());
+    this->unshuffledIds = TrackIdList(unshuffled);
+    this->inserted.clear();
+    this->permutation = Permutation();
+    this->shuffleState = ShuffleState::Materialized;
+}
+
+void TrackList::ResetShuffle() noexcept {
+    this->shuffleState = ShuffleState::None;
+    this->permutation = Permutation();
+    this->inserted.clear();
+    this->unshuffledIds.Clear();
 }
 
 void TrackList::Shuffle() {
+    this->Materialize();
     auto seed = static_cast<unsigned>(system_clock::now().time_since_epoch().count());
     auto rng = std::default_random_engine(seed);
-    std::shuffle(this->ids.begin(), this->ids.end(), rng);
+    auto ids = this->ids.ToVector();
+    std::shuffle(ids.begin(), ids.end(), rng);
+    this->ids = TrackIdList(ids);
 }
 
 void TrackList::Clear() noexcept {
     this->ClearCache();
-    this->ids.clear();
+    this->ids.Clear();
+    this->ResetShuffle();
 }
 
 void TrackList::ClearCache() noexcept {
@@ -238,6 +535,10 @@ void TrackList::ClearCache() noexcept {
 
 void TrackList::Swap(TrackList& tl) noexcept {
     std::swap(tl.ids, this->ids);
+    std::swap(tl.shuffleState, this->shuffleState);
+    std::swap(tl.permutation, this->permutation);
+    std::swap(tl.inserted, this->inserted);
+    std::swap(tl.unshuffledIds, this->unshuffledIds);
 }
 
 TrackPtr TrackList::GetFromCache(int64_t key) const {
@@ -268,7 +569,7 @@ void TrackList::AddToCache(int64_t key, TrackPtr value) const {
 }
 
 void TrackList::PruneCache() const {
-    while (this->cacheMap.size() > cacheSize) {
+    while (this->cacheMap.size() > cacheSize + kMaxPrefetchRows) {
         auto last = cacheList.end();
         --last;
         cacheMap.erase(this->cacheMap.find(*last));
@@ -276,10 +577,92 @@ void TrackList::PruneCache() const {
     }
 }
 
+void TrackList::UpdateScrollVelocity(size_t index) const {
+    /* a redraw calls Get() for each visible row, top to bottom, in quick
+    succession. we only sample the first index of each burst, and derive
+    the velocity from how far it moved since the previous burst. */
+    auto& scroll = this->scroll;
+    const auto now = ScrollTracker::Clock::now();
+    const auto sinceLast = duration_cast<milliseconds>(now - scroll.lastAccess).count();
+    scroll.lastAccess = now;
+    if (sinceLast < kScrollBurstMs) {
+        return;
+    }
+
+    const auto elapsed = duration_cast<milliseconds>(now - scroll.burstStart).count();
+    if (elapsed > kScrollIdleMs || elapsed <= 0) {
+        scroll.velocity = 0.0;
+    }
+    else {
+        const double rows = (double) index - (double) scroll.top;
+        scroll.velocity = (scroll.velocity + (rows * 1000.0 / (double) elapsed)) / 2.0;
+    }
+
+    scroll.top = index;
+    scroll.burstStart = now;
+}
+
+void TrackList::GetPrefetchWindow(size_t index, size_t& from, size_t& to) const {
+    /* by default the window is a screen above and below the requested row.
+    when scrolling it's skewed to cover where we'll be shortly */
+    const size_t count = this->Count();
+    const size_t visible = std::max((size_t) 1, (this->cacheSize - 1) / 2);
+    const double speed = std::abs(this->scroll.velocity);
+
+    size_t behind = visible, ahead = visible;
+    if (speed >= kPrefetchMinVelocity) {
+        const size_t lookahead = std::min(
+            kMaxPrefetchRows,
+            std::max(visible, (size_t)(speed * kPrefetchHorizonMs / 1000.0)));
+        if (this->scroll.velocity > 0.0) {
+            ahead += lookahead;
+            behind = visible / 2;
+        }
+        else {
+            behind += lookahead;
+            ahead = visible + visible / 2; /* `index` is the top row */
+        }
+    }
+
+    from = (index > behind) ? index - behind : 0;
+    to = (count > 0) ? std::min(count - 1, index + ahead) : 0;
+}
+
+void TrackList::PrefetchAhead(size_t index) const {
+    /* the requested row is cached, but if we're scrolling quickly and the
+    rows coming up next aren't, start fetching them before they're needed
+    so the list doesn't show placeholders at its leading edge. */
+    const double velocity = this->scroll.velocity;
+    if (std::abs(velocity) < kPrefetchMinVelocity || this->inflightQuery) {
+        return;
+    }
+
+    const size_t count = this->Count();
+    const size_t visible = std::max((size_t) 1, (this->cacheSize - 1) / 2);
+    size_t probe = index;
+    if (velocity > 0.0) {
+        probe = std::min(count - 1, index + visible * 2);
+    }
+    else {
+        probe = (index > visible) ? index - visible : 0;
+    }
+
+    if (this->cacheMap.find(this->GetId(probe)) == this->cacheMap.end()) {
+        size_t from = 0, to = 0;
+        this->GetPrefetchWindow(probe, from, to);
+        this->CacheWindow(from, to, true);
+    }
+}
+
+TrackList::CacheStats TrackList::GetCacheStats() const noexcept {
+    return this->stats;
+}
+
 void TrackList::CacheWindow(size_t from, size_t to, bool async) const {
     std::unordered_set<int64_t> idsNotInCache;
-    for (size_t i = from; i <= std::min(to, this->ids.size() - 1); i++) {
-        auto id = this->ids.at(i);
+    const size_t count = this->Count();
+    for (size_t i = from; count > 0 && i <= std::min(to, count - 1); i++) {
+        auto id = this->GetId(i);
         if (this->cacheMap.find(id) == this->cacheMap.end()) {
             if (async && currentWindow.Contains(i)) {
                 continue;
@@ -293,26 +676,51 @@ void TrackList::CacheWindow(size_t from, size_t to, bool async) const {
     }
 
     if (async && currentWindow.Valid()) {
-        this->nextWindow.Set(from, to);
-        return; /* when this query finishes we'll start up the next one.
-         this is like a poor man's debounce. or maybe a rich man's debounce? */
+        const bool overlaps = from <= currentWindow.to && to >= currentWindow.from;
+        if (overlaps || !this->inflightQuery) {
+            this->nextWindow.Set(from, to);
+            return; /* when this query finishes we'll start up the next one.
+             this is like a poor man's debounce. or maybe a rich man's debounce? */
+        }
+
+        /* we've scrolled clear of the window that's being fetched, so its
+        results won't be visible; cancel it and fetch what we need now. */
+        this->inflightQuery->Cancel();
+        this->inflightQuery.reset();
+        this->currentWindow.Reset();
+        this->nextWindow.Reset();
+        ++this->stats.canceled;
     }
 
+    ++this->stats.queries;
+    this->stats.rows += idsNotInCache.size();
+
     auto query = std::make_shared<TrackMetadataBatchQuery>(idsNotInCache, this->library);
     if (async) {
         currentWindow.Set(from, to);
+        this->inflightQuery = query;
         auto shared = shared_from_this(); /* ensure we remain alive for the duration of the query */
         auto completionFinished = std::make_shared<bool>(false); /* ugh... keep it alive. */
         auto completion = [this, completionFinished, shared, from, to, query](auto q) {
             if (*completionFinished) {
                 return;
             }
-            if (query->GetStatus() == IQuery::Finished) {
+            *completionFinished = true;
+            const bool finished = query->GetStatus() == IQuery::Finished;
+            if (finished) {
                 auto& result = query->Result();
                 for (auto& kv : result) {
                     this->AddToCache(kv.first, kv.second);
                 }
             }
+            if (this->inflightQuery != query) {
+                /* canceled and superseded by another window */
+                if (finished) {
+                    this->WindowCached(const_cast<TrackList*>(this), from, to);
+                }
+                return;
+            }
+            this->inflightQuery.reset();
             this->currentWindow.Reset();
             if (this->nextWindow.Valid()) {
                 const size_t from = nextWindow.from;
@@ -321,10 +729,12 @@ void TrackList::CacheWindow(size_t from, size_t to, bool async) const {
                 this->CacheWindow(from, to, true);
             }
             this->WindowCached(const_cast<TrackList*>(this), from, to);
-            *completionFinished = true;
         };
 
-        this->library->EnqueueAndWait(query, kCacheWindowTimeoutMs, completion);
+        /* while scrolling quickly, don't block the caller waiting for the
+        window; placeholders are better than a stuttering list. */
+        const bool scrolling = std::abs(this->scroll.velocity) >= kPrefetchMinVelocity;
+        this->library->EnqueueAndWait(query, scrolling ? 0 : kCacheWindowTimeoutMs, completion);
 
         const auto status = query->GetStatus();
         if (status != IQuery::Idle && status != IQuery::Running) {
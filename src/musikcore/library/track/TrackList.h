@@ -38,15 +38,23 @@
 #include <musikcore/sdk/ITrackListEditor.h>
 
 #include <musikcore/library/track/Track.h>
+#include <musikcore/library/track/TrackIdList.h>
 #include <musikcore/library/ILibrary.h>
+#include <musikcore/support/Permutation.h>
 
 #include <sigslot/sigslot.h>
 
 #include <unordered_map>
 #include <list>
+#include <vector>
+#include <chrono>
 
 namespace musik { namespace core {
 
+    namespace library { namespace query {
+        class TrackMetadataBatchQuery;
+    } }
+
     class TrackList :
         public musik::core::sdk::ITrackList,
         public std::enable_shared_from_this<TrackList>,
@@ -55,6 +63,14 @@ namespace musik { namespace core {
         public:
             mutable sigslot::signal3<const TrackList*, size_t, size_t> WindowCached;
 
+            struct CacheStats {
+                size_t hits{ 0 };
+                size_t misses{ 0 };
+                size_t queries{ 0 }; /* batch queries issued */
+                size_t rows{ 0 }; /* ids requested by those queries */
+                size_t canceled{ 0 }; /* in-flight queries scrolled past */
+            };
+
             TrackList(ILibraryPtr library);
             TrackList(TrackList* other);
             TrackList(std::shared_ptr<TrackList> other);
@@ -76,6 +92,15 @@ namespace musik { namespace core {
             void Clear() noexcept;
             void Shuffle();
 
+            /* shuffled mode presents a seeded permutation of the underlying
+            ids instead of reordering (and copying) them, so entering and
+            leaving it is constant time. ids added while shuffled are
+            appended to the unshuffled order as well. both methods return
+            the position of the track at `index` in the new ordering. */
+            bool IsShuffled() const noexcept;
+            size_t EnterShuffledMode(size_t index);
+            size_t ExitShuffledMode(size_t index);
+
             /* implementation specific */
             TrackPtr Get(size_t index, bool async = false) const;
             TrackPtr GetWithTimeout(size_t index, size_t timeoutMs) const;
@@ -85,7 +110,8 @@ namespace musik { namespace core {
             void CopyTo(TrackList& to);
             void CacheWindow(size_t from, size_t to, bool async) const;
             void SetCacheWindowSize(size_t size);
-            const std::vector<int64_t> GetIds() const { return ids; };
+            CacheStats GetCacheStats() const noexcept;
+            const std::vector<int64_t> GetIds() const;
 
             musik::core::sdk::ITrackList* GetSdkValue();
 
@@ -99,6 +125,22 @@ namespace musik { namespace core {
                 void Set(size_t from, size_t to) noexcept { this->from = from; this->to = to; }
             };
 
+            enum class ShuffleState: int {
+                None = 0,
+                View = 1, /* `ids` unshuffled, read through `permutation` */
+                Materialized = 2 /* `ids` shuffled, `unshuffledIds` original order */
+            };
+
+            typedef std::vector<std::pair<size_t, int64_t>> InsertedList;
+
+            struct ScrollTracker {
+                using Clock = std::chrono::steady_clock;
+                size_t top{ 0 };
+                Clock::time_point burstStart;
+                Clock::time_point lastAccess;
+                double velocity{ 0.0 }; /* rows per second, negative is up */
+            };
+
             typedef std::list<int64_t> CacheList;
             typedef std::pair<TrackPtr, CacheList::iterator> CacheValue;
             typedef std::unordered_map<int64_t, CacheValue> CacheMap;
@@ -106,6 +148,16 @@ namespace musik { namespace core {
             TrackPtr GetFromCache(int64_t key) const;
             void AddToCache(int64_t key, TrackPtr value) const;
             void PruneCache() const;
+            void UpdateScrollVelocity(size_t index) const;
+            void GetPrefetchWindow(size_t index, size_t& from, size_t& to) const;
+            void PrefetchAhead(size_t index) const;
+
+            int64_t GetBaseId(size_t index) const;
+            InsertedList::iterator FindInserted(size_t index);
+            InsertedList::const_iterator FindInserted(size_t index) const;
+            std::vector<int64_t> Unshuffle(size_t index, size_t& unshuffledIndex) const;
+            void Materialize();
+            void ResetShuffle() noexcept;
 
             /* lru cache structures */
             mutable CacheList cacheList;
@@ -113,9 +165,18 @@ namespace musik { namespace core {
             mutable size_t cacheSize;
             mutable QueryWindow currentWindow;
             mutable QueryWindow nextWindow;
+            mutable std::shared_ptr<library::query::TrackMetadataBatchQuery> inflightQuery;
+            mutable ScrollTracker scroll;
+            mutable CacheStats stats;
 
-            std::vector<int64_t> ids;
+            TrackIdList ids;
             ILibraryPtr library;
+
+            /* shuffle state */
+            ShuffleState shuffleState{ ShuffleState::None };
+            Permutation permutation;
+            InsertedList inserted; /* View: ids inserted mid-list, sorted by position */
+            TrackIdList unshuffledIds; /* Materialized only */
     };
 
     class TrackListEditor : public musik::core::sdk::ITrackListEditor {
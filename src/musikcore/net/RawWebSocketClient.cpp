@@ -36,6 +36,8 @@
 
 #include <musikcore/net/RawWebSocketClient.h>
 
+#include <algorithm>
+
 using namespace musik::core;
 using namespace musik::core::net;
 
@@ -89,8 +91,16 @@ void RawWebSocketClient::SetFailHandler(FailHandler failHandler) {
 }
 
 void RawWebSocketClient::SetMessageHandler(MessageHandler messageHandler) {
-    this->plainTextClient->set_message_handler(messageHandler);
-    this->tlsClient->set_message_handler(messageHandler);
+    auto counted = [this, messageHandler](Connection connection, Message message) {
+        /* frames are inflated on this thread as they arrive; count wire
+        bytes, like Send() */
+        const size_t compressed = deflate::Extension::compressedBytesIn;
+        deflate::Extension::compressedBytesIn = 0;
+        this->bytesIn += compressed ? compressed : message->get_payload().size();
+        messageHandler(connection, message);
+    };
+    this->plainTextClient->set_message_handler(counted);
+    this->tlsClient->set_message_handler(counted);
 }
 
 void RawWebSocketClient::SetCloseHandler(CloseHandler closeHandler) {
@@ -105,23 +115,65 @@ void RawWebSocketClient::SetSendMessageErrorHandler(SendMessageErrorHandler erro
 void RawWebSocketClient::Send(Connection connection, const std::string& message) {
     std::error_code ec;
     if (mode == Mode::PlainText) {
-        this->plainTextClient->send(connection, message, websocketpp::frame::opcode::text, ec);
+        ec = this->Send(*this->plainTextClient, connection, message);
     }
     else if (mode == Mode::TLS) {
-        this->tlsClient->send(connection, message, websocketpp::frame::opcode::text, ec);
+        ec = this->Send(*this->tlsClient, connection, message);
     }
     if (ec && sendMessageErrorHandler) {
         sendMessageErrorHandler(ec);
     }
 }
 
+template <typename T>
+std::error_code RawWebSocketClient::Send(T& client, Connection connection, const std::string& message) {
+    std::error_code ec;
+    auto con = client.get_con_from_hdl(connection, ec);
+    if (ec) {
+        return ec;
+    }
+
+    auto msg = con->get_message(websocketpp::frame::opcode::text, message.size());
+    msg->append_payload(message);
+    msg->set_compressed(message.size() >= this->compressionThreshold);
+
+    /* the message is framed (and compressed) synchronously on this thread */
+    deflate::Extension::compressedBytesOut = 0;
+
+    ec = con->send(msg);
+    if (!ec) {
+        const size_t compressed = deflate::Extension::compressedBytesOut;
+        this->bytesOut += compressed ? compressed : message.size();
+    }
+
+    return ec;
+}
+
 void RawWebSocketClient::SetPongTimeout(long timeoutMs) {
     this->plainTextClient->set_pong_timeout(timeoutMs);
     this->tlsClient->set_pong_timeout(timeoutMs);
 }
 
+void RawWebSocketClient::SetCompressionThreshold(size_t bytes) {
+    this->compressionThreshold = bytes;
+}
+
+void RawWebSocketClient::SetCompressionLevel(int level) {
+    deflate::Extension::level = std::max(-1, std::min(9, level));
+}
+
+uint64_t RawWebSocketClient::BytesIn() const {
+    return this->bytesIn;
+}
+
+uint64_t RawWebSocketClient::BytesOut() const {
+    return this->bytesOut;
+}
+
 void RawWebSocketClient::Connect(const std::string& uri) {
     websocketpp::lib::error_code ec;
+    this->bytesIn = 0;
+    this->bytesOut = 0;
     if (mode == Mode::PlainText) {
         PlainTextClient::connection_ptr connection = plainTextClient->get_connection(uri, ec);
         if (!ec) {
@@ -43,6 +43,7 @@
 #pragma warning(push, 0)
 #include <websocketpp/config/asio_no_tls_client.hpp>
 #include <websocketpp/config/asio_client.hpp>
+#include <websocketpp/extensions/permessage_deflate/enabled.hpp>
 #include <websocketpp/client.hpp>
 #pragma warning(pop)
 
@@ -53,11 +54,56 @@
 
 namespace musik { namespace core { namespace net {
 
+    namespace deflate {
+        struct Config {};
+
+        /* the stock permessage-deflate extension with a configurable, process-wide
+        compression level (0 means compression isn't offered at all). also tallies
+        compressed input and output for the calling thread, which is how Send()
+        and the message handler learn a message's size on the wire. */
+        class Extension: public websocketpp::extensions::permessage_deflate::enabled<Config> {
+            public:
+                using base = websocketpp::extensions::permessage_deflate::enabled<Config>;
+
+                static inline std::atomic<int> level{ Z_DEFAULT_COMPRESSION };
+                static inline thread_local size_t compressedBytesIn = 0;
+                static inline thread_local size_t compressedBytesOut = 0;
+
+                Extension() {
+                    this->set_compression_level(level);
+                }
+
+                std::string generate_offer() const {
+                    return level == 0 ? std::string() : base::generate_offer();
+                }
+
+                websocketpp::lib::error_code compress(std::string const& in, std::string& out) {
+                    const size_t before = out.size();
+                    auto result = base::compress(in, out);
+                    compressedBytesOut += out.size() - before;
+                    return result;
+                }
+
+                websocketpp::lib::error_code decompress(uint8_t const* buf, size_t len, std::string& out) {
+                    compressedBytesIn += len;
+                    return base::decompress(buf, len, out);
+                }
+        };
+
+        struct PlainTextConfig: public websocketpp::config::asio_client {
+            typedef Extension permessage_deflate_type;
+        };
+
+        struct TlsConfig: public websocketpp::config::asio_tls_client {
+            typedef Extension permessage_deflate_type;
+        };
+    }
+
     class RawWebSocketClient {
         public:
-            using PlainTextClient = websocketpp::client<websocketpp::config::asio_client>;
+            using PlainTextClient = websocketpp::client<deflate::PlainTextConfig>;
             using PlainTextClientPtr = std::unique_ptr<PlainTextClient>;
-            using TlsClient = websocketpp::client<websocketpp::config::asio_tls_client>;
+            using TlsClient = websocketpp::client<deflate::TlsConfig>;
             using TlsClientPtr = std::unique_ptr<TlsClient>;
             using SslContext = std::shared_ptr<asio::ssl::context>;
             using Message = websocketpp::config::asio_client::message_type::ptr;
@@ -86,12 +132,24 @@ namespace musik { namespace core { namespace net {
             void SetSendMessageErrorHandler(SendMessageErrorHandler errorHandler);
             void Send(Connection connection, const std::string& message);
             void SetPongTimeout(long timeoutMs);
+            void SetCompressionThreshold(size_t bytes);
             void Connect(const std::string& uri);
             void Run();
 
+            /* applies to all connections made after the call, in any client */
+            static void SetCompressionLevel(int level);
+
+            /* counters for the most recent connection */
+            uint64_t BytesIn() const;
+            uint64_t BytesOut() const;
+
         private:
+            template <typename T>
+            std::error_code Send(T& client, Connection connection, const std::string& message);
 
             Mode mode;
+            size_t compressionThreshold{ 1024 };
+            std::atomic<uint64_t> bytesIn{ 0 }, bytesOut{ 0 };
             TlsClientPtr tlsClient;
             PlainTextClientPtr plainTextClient;
             SendMessageErrorHandler sendMessageErrorHandler;
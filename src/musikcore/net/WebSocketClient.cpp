@@ -40,6 +40,7 @@
 #include <musikcore/support/Preferences.h>
 #include <musikcore/runtime/Message.h>
 #include <musikcore/sdk/version.h>
+#include <musikcore/library/query/util/Serialization.h>
 
 #pragma warning(push, 0)
 #include <nlohmann/json.hpp>
@@ -49,6 +50,7 @@ using namespace musik::core;
 using namespace musik::core::sdk;
 using namespace musik::core::net;
 using namespace musik::core::runtime;
+using namespace musik::core::library::query;
 
 using ClientPtr = WebSocketClient::ClientPtr;
 using ClientMessage = WebSocketClient::ClientMessage;
@@ -102,6 +104,14 @@ static inline std::string createSendRawQueryRequest(const std::string& rawQuery,
     return rawQueryJson.dump();
 }
 
+static inline std::string serializeQuery(WebSocketClient::Query query) {
+    auto prefs = Preferences::ForComponent(musik::core::prefs::components::Settings);
+    if (prefs->GetBool(musik::core::prefs::keys::RemoteLibraryBinaryQueryResults, true)) {
+        return serialization::RequestBinaryResult(query->SerializeQuery());
+    }
+    return query->SerializeQuery();
+}
+
 static inline bool extractRawQueryResult(
     nlohmann::json& responseJson, std::string& rawResult)
 {
@@ -144,14 +154,23 @@ WebSocketClient::WebSocketClient(IMessageQueue* messageQueue, Listener* listener
         nlohmann::json responseJson = nlohmann::json::parse(message->get_payload());
         auto name = responseJson["name"].get<std::string>();
         auto messageId = responseJson["id"].get<std::string>();
-        if (name == "authenticate") {
+        if (responseJson.value("type", "") == "broadcast") {
+            if (name == "library_changed") {
+                auto& options = responseJson["options"];
+                this->listener->OnClientLibraryChanged(
+                    this, options.value("generation", (int64_t) 0));
+            }
+        }
+        else if (name == "authenticate") {
             this->connection = connection;
 
             auto prefs = Preferences::ForComponent(core::prefs::components::Settings);
             auto const ignoreVersionMismatch = prefs->GetInt(
                 core::prefs::keys::RemoteLibraryIgnoreVersionMismatch, false);
 
-            this->serverVersion = responseJson["options"]["environment"]["app_version"].get<std::string>();
+            auto& environment = responseJson["options"]["environment"];
+            this->serverVersion = environment["app_version"].get<std::string>();
+            this->serverApiVersion = environment.value("api_version", 0);
             if (!ignoreVersionMismatch && !isVersionCompatible(this->serverVersion)) {
                 this->SetDisconnected(ConnectionError::IncompatibleVersion);
             }
@@ -160,9 +179,19 @@ WebSocketClient::WebSocketClient(IMessageQueue* messageQueue, Listener* listener
             }
         }
         else if (name == "send_raw_query") {
-            auto query = this->messageIdToQuery[messageId];
+            /* responses may arrive in any order; look up (and release) the
+            pending query under the lock, then deserialize outside of it so
+            other requests can continue to be enqueued in the meantime. */
+            Query query;
+            {
+                std::unique_lock<decltype(this->mutex)> lock(this->mutex);
+                auto it = this->messageIdToQuery.find(messageId);
+                if (it != this->messageIdToQuery.end()) {
+                    query = it->second;
+                    this->messageIdToQuery.erase(it);
+                }
+            }
             if (query) {
-                this->messageIdToQuery.erase(messageId);
                 auto& options = responseJson["options"];
                 if (options.find("success") != options.end() && options["success"] == false) {
                     this->listener->OnClientQueryFailed(
@@ -173,7 +202,13 @@ WebSocketClient::WebSocketClient(IMessageQueue* messageQueue, Listener* listener
                     if (extractRawQueryResult(responseJson, rawResult)) {
                         if (query) {
                             try {
-                                query->DeserializeResult(rawResult);
+                                if (serialization::IsEncodedBinaryResult(rawResult)) {
+                                    query->DeserializeResultBinary(
+                                        serialization::DecodeBinaryResult(rawResult));
+                                }
+                                else {
+                                    query->DeserializeResult(rawResult);
+                                }
                                 this->listener->OnClientQuerySucceeded(this, messageId, query);
                             }
                             catch (...) {
@@ -222,6 +257,19 @@ std::string WebSocketClient::LastServerVersion() const {
     return this->serverVersion;
 }
 
+int WebSocketClient::LastServerApiVersion() const {
+    std::unique_lock<decltype(this->mutex)> lock(this->mutex);
+    return this->serverApiVersion;
+}
+
+uint64_t WebSocketClient::BytesIn() const {
+    return this->rawClient ? this->rawClient->BytesIn() : 0;
+}
+
+uint64_t WebSocketClient::BytesOut() const {
+    return this->rawClient ? this->rawClient->BytesOut() : 0;
+}
+
 WebSocketClient::State WebSocketClient::ConnectionState() const {
     std::unique_lock<decltype(this->mutex)> lock(this->mutex);
     return this->state;
@@ -252,7 +300,7 @@ std::string WebSocketClient::EnqueueQuery(Query query) {
     if (this->state == State::Connected) {
         this->rawClient->Send(
             this->connection,
-            createSendRawQueryRequest(query->SerializeQuery(), messageId));
+            createSendRawQueryRequest(serializeQuery(query), messageId));
     }
     return messageId;
 }
@@ -282,6 +330,7 @@ void WebSocketClient::Connect(
 void WebSocketClient::Reconnect() {
     std::unique_lock<decltype(this->mutex)> lock(this->mutex);
     this->serverVersion = "";
+    this->serverApiVersion = 0;
 
     this->Disconnect();
 
@@ -290,6 +339,12 @@ void WebSocketClient::Reconnect() {
     auto const prefs = Preferences::ForComponent(core::prefs::components::Settings);
     auto const timeout = prefs->GetInt(core::prefs::keys::RemoteLibraryLatencyTimeoutMs, 5000);
 
+    /* 0 disables compression, -1 is zlib's default. */
+    RawWebSocketClient::SetCompressionLevel(
+        prefs->GetInt(core::prefs::keys::RemoteLibraryCompressionLevel, 6));
+    rawClient->SetCompressionThreshold((size_t) std::max(0,
+        prefs->GetInt(core::prefs::keys::RemoteLibraryCompressionThreshold, 1024)));
+
     this->SetState(State::Connecting);
 
     this->thread = std::make_unique<std::thread>([&, timeout]() {
@@ -348,7 +403,7 @@ void WebSocketClient::SendPendingQueries() {
         if (query) {
             this->rawClient->Send(
                 this->connection,
-                createSendRawQueryRequest(query->SerializeQuery(), messageId));
+                createSendRawQueryRequest(serializeQuery(query), messageId));
         }
     }
 }
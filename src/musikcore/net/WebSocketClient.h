@@ -85,6 +85,7 @@ namespace musik { namespace core { namespace net {
                     virtual void OnClientStateChanged(Client* client, State newState, State oldState) = 0;
                     virtual void OnClientQuerySucceeded(Client* client, const std::string& messageId, Query query) = 0;
                     virtual void OnClientQueryFailed(Client* client, const std::string& messageId, Query query, QueryError result) = 0;
+                    virtual void OnClientLibraryChanged(Client* client, int64_t generation) = 0;
             };
 
             WebSocketClient(
@@ -106,6 +107,9 @@ namespace musik { namespace core { namespace net {
             State ConnectionState() const;
             ConnectionError LastConnectionError() const;
             std::string LastServerVersion() const;
+            int LastServerApiVersion() const;
+            uint64_t BytesIn() const;
+            uint64_t BytesOut() const;
             std::string Uri() const;
 
             std::string EnqueueQuery(Query query);
@@ -132,6 +136,7 @@ namespace musik { namespace core { namespace net {
             std::atomic<bool> quit{ false };
             ConnectionError connectionError{ ConnectionError::None };
             std::string serverVersion;
+            int serverApiVersion{ 0 };
             State state{ State::Disconnected };
             Listener* listener{ nullptr };
             musik::core::runtime::IMessageQueue* messageQueue;
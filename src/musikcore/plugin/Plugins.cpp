@@ -67,6 +67,7 @@ typedef void(*SetEnvironment)(IEnvironment*);
 typedef void(*SetDebug)(IDebug*);
 typedef void(*SetMetadataProxy)(IMetadataProxy*);
 typedef void(*SetIndexerNotifier)(IIndexerNotifier*);
+typedef void(*SetLibraryGeneration)(int64_t);
 
 static const std::string SUPEREQ_PLUGIN_GUID = "6f0ed53b-0f13-4220-9b0a-ca496b6421cc";
 
@@ -123,6 +124,55 @@ static class Debug: public IDebug {
         }
 } debugger;
 
+/* keeps a monotonically increasing "generation" for the local library, bumped
+every time the indexer finishes or a mutating query completes. plugins that
+export SetLibraryGeneration() are notified so they can invalidate caches (e.g.
+the server broadcasts the change to its remote clients). */
+static class LibraryGenerationObserver: public sigslot::has_slots<> {
+    public:
+        void Attach(ILibraryPtr library) {
+            this->Detach();
+            this->library = library;
+            if (library) {
+                library->QueryCompleted.connect(this, &LibraryGenerationObserver::OnQueryCompleted);
+                library->Indexer()->Finished.connect(this, &LibraryGenerationObserver::OnIndexerFinished);
+            }
+            this->Notify(this->generation.load());
+        }
+
+        void Detach() {
+            if (this->library) {
+                this->library->QueryCompleted.disconnect(this);
+                this->library->Indexer()->Finished.disconnect(this);
+                this->library.reset();
+            }
+        }
+
+    private:
+        void OnQueryCompleted(musik::core::db::IQuery* query) {
+            if (query->GetStatus() == musik::core::db::IQuery::Finished &&
+                query->IsMutating())
+            {
+                this->Notify(++this->generation);
+            }
+        }
+
+        void OnIndexerFinished(int count) {
+            this->Notify(++this->generation);
+        }
+
+        void Notify(int64_t generation) {
+            PluginFactory::Instance().QueryFunction<SetLibraryGeneration>(
+                "SetLibraryGeneration",
+                [generation](musik::core::sdk::IPlugin* plugin, SetLibraryGeneration func) {
+                    func(generation);
+                });
+        }
+
+        ILibraryPtr library;
+        std::atomic<int64_t> generation{ 0 };
+} libraryGenerationObserver;
+
 static class NullDebug: public IDebug { /* used during shutdown */
     public:
         void Verbose(const char* tag, const char* message) override {}
@@ -406,6 +456,9 @@ namespace musik { namespace core { namespace plugin {
             [](musik::core::sdk::IPlugin* plugin, SetEnvironment func) {
                 func(&environment);
             });
+
+        /* library generation */
+        libraryGenerationObserver.Attach(LibraryFactory::Instance().DefaultLocalLibrary());
     }
 
     IEnvironment& Environment() {
@@ -416,6 +469,9 @@ namespace musik { namespace core { namespace plugin {
         /* preferences */
         Preferences::SavePluginPreferences();
 
+        /* library generation */
+        libraryGenerationObserver.Detach();
+
         /* data providers */
         PluginFactory::Instance().QueryFunction<SetMetadataProxy>(
             "SetMetadataProxy",
@@ -0,0 +1,124 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace musik { namespace core {
+
+    /* a seeded bijection over [0, count), implemented as a small feistel
+    network. the network permutes the smallest power-of-four domain that
+    covers `count`; values that land outside of the range are fed back
+    through the network ("cycle walking") until they land inside it. this
+    lets us present a shuffled view of a list in O(1) space, and map indexes
+    in both directions in (expected) constant time. */
+    class Permutation {
+        public:
+            Permutation() noexcept { }
+
+            Permutation(size_t count, uint64_t seed) noexcept
+            : count(count)
+            , seed(seed) {
+                size_t bits = 2;
+                while (bits < 64 && (uint64_t(1) << bits) < (uint64_t) count) {
+                    bits += 2;
+                }
+                this->halfBits = bits / 2;
+                this->halfMask = (uint64_t(1) << this->halfBits) - 1;
+            }
+
+            size_t Count() const noexcept {
+                return this->count;
+            }
+
+            /* returns the position that `index` maps to */
+            size_t Map(size_t index) const noexcept {
+                uint64_t value = index;
+                do {
+                    value = this->Forward(value);
+                } while (value >= this->count);
+                return (size_t) value;
+            }
+
+            /* inverse of Map(): returns the index that maps to `position` */
+            size_t Unmap(size_t position) const noexcept {
+                uint64_t value = position;
+                do {
+                    value = this->Backward(value);
+                } while (value >= this->count);
+                return (size_t) value;
+            }
+
+        private:
+            static const int kRounds = 4;
+
+            uint64_t Round(uint64_t value, int round) const noexcept {
+                /* splitmix64 finalizer */
+                uint64_t z = value + this->seed + (uint64_t) (round + 1) * 0x9e3779b97f4a7c15ULL;
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+                return (z ^ (z >> 31)) & this->halfMask;
+            }
+
+            uint64_t Forward(uint64_t value) const noexcept {
+                uint64_t left = value >> this->halfBits;
+                uint64_t right = value & this->halfMask;
+                for (int i = 0; i < kRounds; i++) {
+                    const uint64_t next = left ^ this->Round(right, i);
+                    left = right;
+                    right = next;
+                }
+                return (left << this->halfBits) | right;
+            }
+
+            uint64_t Backward(uint64_t value) const noexcept {
+                uint64_t left = value >> this->halfBits;
+                uint64_t right = value & this->halfMask;
+                for (int i = kRounds - 1; i >= 0; i--) {
+                    const uint64_t previous = right ^ this->Round(left, i);
+                    right = left;
+                    left = previous;
+                }
+                return (left << this->halfBits) | right;
+            }
+
+            size_t count{ 0 };
+            uint64_t seed{ 0 };
+            unsigned halfBits{ 1 };
+            uint64_t halfMask{ 1 };
+    };
+
+} }
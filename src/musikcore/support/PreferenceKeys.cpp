@@ -68,6 +68,8 @@ namespace musik { namespace core { namespace prefs {
     const std::string keys::AuddioApiToken = "AuddioApiToken";
     const std::string keys::LibraryType = "LibraryType";
     const std::string keys::PlaybackTrackQueryTimeoutMs = "PlaybackTrackQueryTimeoutMs";
+    const std::string keys::LibrarySlowQueryThresholdMs = "LibrarySlowQueryThresholdMs";
+    const std::string keys::LibraryMirrorServingEnabled = "LibraryMirrorServingEnabled";
     const std::string keys::RemoteLibraryHostname = "RemoteLibraryHostname";
     const std::string keys::RemoteLibraryWssPort = "RemoteLibraryWssPort";
     const std::string keys::RemoteLibraryHttpPort = "RemoteLibraryHttpPort";
@@ -81,6 +83,10 @@ namespace musik { namespace core { namespace prefs {
     const std::string keys::RemoteLibraryTranscoderFormat = "RemoteLibraryTranscoderFormat";
     const std::string keys::RemoteLibraryTranscoderBitrate = "RemoteLibraryTranscoderBitrate";
     const std::string keys::RemoteLibraryIgnoreVersionMismatch = "RemoteLibraryIgnoreVersionMismatch";
+    const std::string keys::RemoteLibraryBinaryQueryResults = "RemoteLibraryBinaryQueryResults";
+    const std::string keys::RemoteLibraryMirrorEnabled = "RemoteLibraryMirrorEnabled";
+    const std::string keys::RemoteLibraryCompressionLevel = "RemoteLibraryCompressionLevel";
+    const std::string keys::RemoteLibraryCompressionThreshold = "RemoteLibraryCompressionThreshold";
     const std::string keys::AsyncTrackListQueries = "AsyncTrackListQueries";
     const std::string keys::PiggyEnabled = "PiggyEnabled";
     const std::string keys::PiggyHostname = "PiggyHostname";
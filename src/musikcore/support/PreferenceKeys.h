@@ -72,6 +72,8 @@ namespace musik { namespace core { namespace prefs {
         extern const std::string AuddioApiToken;
         extern const std::string LibraryType;
         extern const std::string PlaybackTrackQueryTimeoutMs;
+        extern const std::string LibrarySlowQueryThresholdMs;
+        extern const std::string LibraryMirrorServingEnabled;
         extern const std::string RemoteLibraryHostname;
         extern const std::string RemoteLibraryWssPort;
         extern const std::string RemoteLibraryHttpPort;
@@ -85,6 +87,10 @@ namespace musik { namespace core { namespace prefs {
         extern const std::string RemoteLibraryTranscoderFormat;
         extern const std::string RemoteLibraryTranscoderBitrate;
         extern const std::string RemoteLibraryIgnoreVersionMismatch;
+        extern const std::string RemoteLibraryBinaryQueryResults;
+        extern const std::string RemoteLibraryMirrorEnabled;
+        extern const std::string RemoteLibraryCompressionLevel;
+        extern const std::string RemoteLibraryCompressionThreshold;
         extern const std::string AsyncTrackListQueries;
         extern const std::string PiggyEnabled;
         extern const std::string PiggyHostname;
@@ -34,6 +34,7 @@
 
 #include <stdafx.h>
 #include <app/layout/ConsoleLayout.h>
+#include <app/overlay/QueryStatsOverlay.h>
 #include <musikcore/i18n/Locale.h>
 #include <musikcore/sdk/version.h>
 #include <cursespp/App.h>
@@ -95,6 +96,10 @@ bool ConsoleLayout::KeyPress(const std::string& kn) {
         this->adapter->Clear();
         return true;
     }
+    else if (Hotkeys::Is(Hotkeys::ShowQueryStats, kn)) {
+        QueryStatsOverlay::Show();
+        return true;
+    }
     return LayoutBase::KeyPress(kn);
 }
 
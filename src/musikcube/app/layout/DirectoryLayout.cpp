@@ -72,7 +72,7 @@ DirectoryLayout::DirectoryLayout(
 , hasSubdirectories(true) {
     this->InitializeWindows();
     this->library->Indexer()->Progress.connect(this, &DirectoryLayout::OnIndexerProgress);
-    this->library->Indexer()->Finished.connect(this, &DirectoryLayout::OnIndexerProgress);
+    this->library->Indexer()->Finished.connect(this, &DirectoryLayout::OnIndexerFinished);
 }
 
 void DirectoryLayout::OnLayout() {
@@ -102,6 +102,7 @@ void DirectoryLayout::InitializeWindows() {
             std::placeholders::_4);
 
     this->adapter = std::make_shared<DirectoryAdapter>();
+    this->adapter->SetLibrary(this->library);
     this->adapter->SetAllowEscapeRoot(false);
     this->adapter->SetItemDecorator(decorator);
     this->adapter->SetShowRootDirectory(true);
@@ -146,6 +147,26 @@ void DirectoryLayout::OnIndexerProgress(int count) {
     this->Requery(true);
 }
 
+void DirectoryLayout::OnIndexerFinished(int count) {
+    /* called from the indexer thread; the adapter is only touched from
+    the ui thread, so refresh it from there */
+    this->Post(message::IndexerFinished);
+}
+
+void DirectoryLayout::ProcessMessage(musik::core::runtime::IMessage &message) {
+    if (message.Type() == message::IndexerFinished) {
+        /* the indexer rebuilds the directory hierarchy at the end of a sync */
+        this->adapter->Refresh();
+        this->hasSubdirectories = this->adapter->HasSubDirectories();
+        this->directoryList->OnAdapterChanged();
+        this->Requery(true);
+        this->Layout();
+    }
+    else {
+        LayoutBase::ProcessMessage(message);
+    }
+}
+
 void DirectoryLayout::RequeryTrackList(ListWindow *view) {
     size_t selected = this->directoryList->GetSelectedIndex();
     std::string fullPath = "";
@@ -44,6 +44,7 @@
 #include <musikcore/audio/PlaybackService.h>
 
 #include <musikcore/library/ILibrary.h>
+#include <musikcore/runtime/IMessage.h>
 
 #include <sigslot/sigslot.h>
 
@@ -68,6 +69,7 @@ namespace musik {
                 void OnVisibilityChanged(bool visible) override;
                 void OnLayout() override;
                 bool KeyPress(const std::string& key) override;
+                void ProcessMessage(musik::core::runtime::IMessage &message) override;
 
             private:
                 void InitializeWindows();
@@ -90,6 +92,7 @@ namespace musik {
                     size_t oldIndex);
 
                 void OnIndexerProgress(int count);
+                void OnIndexerFinished(int count);
 
                 musik::core::audio::PlaybackService& playback;
                 musik::core::ILibraryPtr library;
@@ -115,7 +115,10 @@ static inline std::shared_ptr<ISchema> AdvancedSettingsSchema() {
     schema->AddBool(cube::prefs::keys::AutoHideCommandBar, false);
     schema->AddInt(core::prefs::keys::RemoteLibraryLatencyTimeoutMs, 5000);
     schema->AddBool(core::prefs::keys::RemoteLibraryIgnoreVersionMismatch, false);
+    schema->AddBool(core::prefs::keys::RemoteLibraryBinaryQueryResults, true);
     schema->AddInt(core::prefs::keys::PlaybackTrackQueryTimeoutMs, 5000);
+    schema->AddInt(core::prefs::keys::LibrarySlowQueryThresholdMs, 0);
+    schema->AddBool(core::prefs::keys::LibraryMirrorServingEnabled, false);
     schema->AddBool(core::prefs::keys::AsyncTrackListQueries, true);
     schema->AddBool(cube::prefs::keys::DisableRatingColumn, false);
     schema->AddBool(cube::prefs::keys::DisableWindowTitleUpdates, cube::prefs::defaults::DisableWindowTitleUpdates);
@@ -35,6 +35,7 @@
 #include <stdafx.h>
 
 #include <musikcore/support/Common.h>
+#include <musikcore/library/query/DirectoryListQuery.h>
 #include <cursespp/Text.h>
 #include <cursespp/ScrollAdapterBase.h>
 #include <cursespp/SingleLineEntry.h>
@@ -46,6 +47,8 @@
 namespace fs = std::filesystem;
 
 using namespace musik::cube;
+using namespace musik::core::db;
+using namespace musik::core::library::query;
 using namespace cursespp;
 
 #ifdef WIN32
@@ -148,6 +151,14 @@ static fs::path stringToPath(const std::string& path) {
     return fs::u8path(musik::core::NormalizeDir(path));
 }
 
+static std::string trimSeparator(std::string path) {
+    const char sep = fs::path::preferred_separator;
+    if (path.size() > 1 && path.back() == sep) {
+        path.pop_back();
+    }
+    return path;
+}
+
 DirectoryAdapter::DirectoryAdapter() {
     this->showDotfiles = false;
     this->showRootDirectory = false;
@@ -163,6 +174,37 @@ void DirectoryAdapter::SetAllowEscapeRoot(bool allow) {
     this->allowEscapeRoot = allow;
 }
 
+void DirectoryAdapter::SetLibrary(musik::core::ILibraryPtr library) {
+    /* when a library is specified we list the directories it has indexed,
+    using the indexer's directory hierarchy, instead of the filesystem */
+    this->library = library;
+    this->BuildDirectoryList();
+}
+
+void DirectoryAdapter::BuildDirectoryList() {
+    if (!this->library) {
+        buildDirectoryList(this->dir, this->subdirs, this->showDotfiles);
+        return;
+    }
+
+    this->subdirs.clear();
+    this->subdirsHaveSubdirs.clear();
+
+    auto query = std::make_shared<DirectoryListQuery>(this->dir.u8string());
+    this->library->EnqueueAndWait(query);
+
+    if (query->GetStatus() == IQuery::Finished) {
+        for (auto& entry : *query->GetResult()) {
+            const std::string path = trimSeparator(entry.path);
+            const std::string leaf = fs::u8path(path).filename().u8string();
+            if (this->showDotfiles || !leaf.size() || leaf.at(0) != '.') {
+                this->subdirs.push_back(path);
+                this->subdirsHaveSubdirs.push_back(entry.hasSubdirectories);
+            }
+        }
+    }
+}
+
 void DirectoryAdapter::SetShowRootDirectory(bool show) {
     if (show != this->showRootDirectory) {
         this->showRootDirectory = show;
@@ -212,7 +254,7 @@ size_t DirectoryAdapter::Select(cursespp::ListWindow* window) {
     }
 #endif
 
-    buildDirectoryList(dir, subdirs, showDotfiles);
+    this->BuildDirectoryList();
     window->OnAdapterChanged();
 
     return selectedIndex;
@@ -226,7 +268,7 @@ void DirectoryAdapter::SetRootDirectory(const std::string& directory) {
         dir = musik::core::GetHomeDirectory();
         rootDir = kDefaultRoot;
     }
-    buildDirectoryList(dir, subdirs, showDotfiles);
+    this->BuildDirectoryList();
 }
 
 std::string DirectoryAdapter::GetFullPathAt(size_t index) {
@@ -273,7 +315,7 @@ void DirectoryAdapter::SetDotfilesVisible(bool visible) {
             return;
         }
 #endif
-        buildDirectoryList(dir, subdirs, showDotfiles);
+        this->BuildDirectoryList();
     }
 }
 
@@ -292,7 +334,7 @@ std::string DirectoryAdapter::GetCurrentPath() {
 }
 
 void DirectoryAdapter::Refresh() {
-    buildDirectoryList(dir, subdirs, showDotfiles);
+    this->BuildDirectoryList();
 }
 
 bool DirectoryAdapter::IsAtRoot() {
@@ -323,10 +365,16 @@ bool DirectoryAdapter::HasSubDirectories(size_t index) {
         return !this->subdirs.empty();
     }
     index -= this->GetHeaderCount();
+    if (this->library) {
+        return this->subdirsHaveSubdirs.at(index);
+    }
     return hasSubdirectories(fs::u8path(this->subdirs.at(index)), this->showDotfiles);
 }
 
 bool DirectoryAdapter::HasSubDirectories() {
+    if (this->library) {
+        return !this->subdirs.empty();
+    }
     return hasSubdirectories(this->dir, this->showDotfiles);
 }
 
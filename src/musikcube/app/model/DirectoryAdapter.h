@@ -36,6 +36,7 @@
 
 #include <cursespp/ScrollAdapterBase.h>
 #include <cursespp/ListWindow.h>
+#include <musikcore/library/ILibrary.h>
 
 #include <filesystem>
 #include <vector>
@@ -62,6 +63,7 @@ namespace musik {
                 size_t IndexOf(const std::string& leaf);
                 void SetDotfilesVisible(bool visible);
                 void SetShowRootDirectory(bool showRootDirectory);
+                void SetLibrary(musik::core::ILibraryPtr library);
                 bool IsAtRoot();
                 void Refresh();
 
@@ -74,9 +76,12 @@ namespace musik {
                 bool ShowCurrentDirectory();
                 bool IsCurrentDirectory(size_t index);
                 size_t GetHeaderCount();
+                void BuildDirectoryList();
 
                 std::filesystem::path dir, rootDir;
                 std::vector<std::string> subdirs;
+                std::vector<bool> subdirsHaveSubdirs;
+                musik::core::ILibraryPtr library;
                 std::stack<size_t> selectedIndexStack;
                 bool showDotfiles, allowEscapeRoot, showRootDirectory;
         };
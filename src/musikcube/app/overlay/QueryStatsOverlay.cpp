@@ -0,0 +1,152 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdafx.h>
+
+#include "QueryStatsOverlay.h"
+#include <musikcore/i18n/Locale.h>
+#include <musikcore/library/LibraryFactory.h>
+#include <musikcore/library/LocalLibrary.h>
+#include <musikcore/support/Common.h>
+#include <cursespp/SimpleScrollAdapter.h>
+#include <cursespp/ListOverlay.h>
+#include <cursespp/DialogOverlay.h>
+#include <cursespp/App.h>
+
+using namespace cursespp;
+using namespace musik::cube;
+using namespace musik::core;
+using namespace musik::core::library;
+
+using Stats = QueryProfiler::Stats;
+using SlowQuery = QueryProfiler::SlowQuery;
+
+static void showMessage(const std::string& title, const std::string& message) {
+    std::shared_ptr<DialogOverlay> dialog(new DialogOverlay());
+
+    (*dialog)
+        .SetTitle(title)
+        .SetMessage(message)
+        .AddButton("KEY_ENTER", "ENTER", _TSTR("button_ok"));
+
+    App::Overlays().Push(dialog);
+}
+
+static std::string formatStats(const Stats& stats) {
+    return u8fmt(
+        "%s: n=%llu avg=%.1f p50=%.0f p95=%.0f p99=%.0f max=%.1fms",
+        stats.name.c_str(),
+        (unsigned long long) stats.count,
+        stats.MeanMs(),
+        stats.PercentileMs(0.50),
+        stats.PercentileMs(0.95),
+        stats.PercentileMs(0.99),
+        stats.maxMs);
+}
+
+static std::string formatSlowQueryDetails(const SlowQuery& slow) {
+    std::string result = u8fmt("%s: %.1fms", slow.name.c_str(), slow.durationMs);
+    if (slow.parameters.size()) {
+        result += "\n\n" + slow.parameters;
+    }
+    for (auto& plan : slow.plans) {
+        result += "\n\n" + plan;
+    }
+    return result;
+}
+
+void QueryStatsOverlay::Show() {
+    using Adapter = cursespp::SimpleScrollAdapter;
+
+    auto library = std::dynamic_pointer_cast<LocalLibrary>(
+        LibraryFactory::Instance().DefaultLocalLibrary());
+
+    if (!library) {
+        return;
+    }
+
+    auto& profiler = library->GetQueryProfiler();
+    auto stats = profiler.GetStats();
+    auto slow = std::make_shared<std::vector<SlowQuery>>(profiler.GetSlowQueries());
+
+    if (stats.empty() && slow->empty()) {
+        showMessage(
+            _TSTR("query_stats_overlay_title"),
+            _TSTR("query_stats_overlay_no_data"));
+        return;
+    }
+
+    /* slowest queries first */
+    std::sort(stats.begin(), stats.end(), [](const Stats& a, const Stats& b) {
+        return a.PercentileMs(0.95) > b.PercentileMs(0.95);
+    });
+
+    std::shared_ptr<Adapter> adapter(new Adapter());
+    adapter->SetSelectable(true);
+
+    for (auto& s : stats) {
+        adapter->AddEntry(formatStats(s));
+    }
+
+    const size_t firstSlowQuery = adapter->GetEntryCount();
+
+    /* most recent slow queries first */
+    for (auto it = slow->rbegin(); it != slow->rend(); ++it) {
+        adapter->AddEntry(u8fmt(
+            _TSTR("query_stats_overlay_slow_query").c_str(),
+            it->name.c_str(),
+            it->durationMs));
+    }
+
+    std::shared_ptr<ListOverlay> dialog(new ListOverlay());
+
+    dialog->SetAdapter(adapter)
+        .SetTitle(_TSTR("query_stats_overlay_title"))
+        .SetWidthPercent(80)
+        .SetAutoDismiss(false)
+        .SetItemSelectedCallback(
+            [slow, firstSlowQuery]
+            (ListOverlay* overlay, IScrollAdapterPtr adapter, size_t index) {
+                if (index >= firstSlowQuery) {
+                    const size_t offset = index - firstSlowQuery;
+                    if (offset < slow->size()) {
+                        showMessage(
+                            _TSTR("query_stats_overlay_title"),
+                            formatSlowQueryDetails((*slow)[slow->size() - offset - 1]));
+                    }
+                }
+            });
+
+    cursespp::App::Overlays().Push(dialog);
+}
@@ -133,6 +133,8 @@ static std::unordered_map<std::string, Id> NAME_TO_ID = {
 
     { "show_equalizer", Id::ShowEqualizer },
 
+    { "show_query_stats", Id::ShowQueryStats },
+
     { "metadata_rescan", Id::RescanMetadata },
 
     { "hotkeys_reset_to_default", Id::HotkeysResetToDefault },
@@ -228,6 +230,8 @@ static std::unordered_map<Id, std::string, EnumHasher> ID_TO_DEFAULT = {
 
     { Id::ShowEqualizer, "^E" },
 
+    { Id::ShowQueryStats, "M-q" },
+
     { Id::RescanMetadata, "^R"},
 
     { Id::HotkeysResetToDefault, "M-r" },
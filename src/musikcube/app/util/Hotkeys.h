@@ -76,6 +76,7 @@ namespace musik {
                     ViewRefresh,
                     ToggleVisualizer,
                     ShowEqualizer,
+                    ShowQueryStats,
 
                     /* playback */
                     ToggleMute,
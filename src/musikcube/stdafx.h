@@ -115,6 +115,7 @@ asio's streambuf. include it up front so work around this */
 #include <musikcore/library/query/CategoryListQuery.h>
 #include <musikcore/library/query/CategoryTrackListQuery.h>
 #include <musikcore/library/query/DeletePlaylistQuery.h>
+#include <musikcore/library/query/DirectoryListQuery.h>
 #include <musikcore/library/query/DirectoryTrackListQuery.h>
 #include <musikcore/library/query/GetPlaylistQuery.h>
 #include <musikcore/library/query/LyricsQuery.h>
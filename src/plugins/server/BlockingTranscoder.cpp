@@ -33,6 +33,7 @@
 //////////////////////////////////////////////////////////////////////////////
 
 #include "BlockingTranscoder.h"
+#include "TranscodeCache.h"
 #include "Util.h"
 #include <filesystem>
 #include <algorithm>
@@ -131,6 +132,7 @@ bool BlockingTranscoder::Transcode() {
                         ec);
                 }
                 else {
+                    TranscodeCache::Add(this->context, this->finalFilename);
                     result = true;
                 }
             }
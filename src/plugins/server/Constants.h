@@ -45,10 +45,21 @@ namespace defaults {
     static const int http_server_port = 7906;
     static const std::string password = "";
     static const int transcoder_cache_count = 50;
+    static const int transcoder_cache_size_mb = 512;
     static const int transcoder_max_active_count = 4;
     static const bool use_ipv6 = false;
     static const bool transcoder_synchronous = false;
     static const bool transcoder_synchronous_fallback = false;
+    static const int transcoder_prefetch_count = 2;
+    static const int transcoder_prefetch_threads = 1;
+    static const int websocket_compression_level = 6;
+    static const int websocket_compression_threshold = 1024;
+    static const int websocket_server_worker_threads = 4;
+    static const int thumbnail_resize_threads = 2;
+    static const int thumbnail_cache_size_mb = 64;
+    static const int http_server_thread_pool_size = 0;
+    static const int http_server_connection_limit = 0;
+    static const int http_server_per_ip_connection_limit = 0;
 }
 
 namespace prefs {
@@ -58,9 +69,20 @@ namespace prefs {
     static const std::string http_server_port = "http_server_port";
     static const std::string use_ipv6 = "use_ipv6";
     static const std::string transcoder_cache_count = "transcoder_cache_count";
+    static const std::string transcoder_cache_size_mb = "transcoder_cache_size_mb";
     static const std::string transcoder_max_active_count = "transcoder_max_active_count";
     static const std::string transcoder_synchronous = "transcoder_synchronous";
     static const std::string transcoder_synchronous_fallback = "transcoder_synchronous_fallback";
+    static const std::string transcoder_prefetch_count = "transcoder_prefetch_count";
+    static const std::string transcoder_prefetch_threads = "transcoder_prefetch_threads";
+    static const std::string websocket_compression_level = "websocket_compression_level";
+    static const std::string websocket_compression_threshold = "websocket_compression_threshold";
+    static const std::string websocket_server_worker_threads = "websocket_server_worker_threads";
+    static const std::string thumbnail_resize_threads = "thumbnail_resize_threads";
+    static const std::string thumbnail_cache_size_mb = "thumbnail_cache_size_mb";
+    static const std::string http_server_thread_pool_size = "http_server_thread_pool_size";
+    static const std::string http_server_connection_limit = "http_server_connection_limit";
+    static const std::string http_server_per_ip_connection_limit = "http_server_per_ip_connection_limit";
 }
 
 namespace message {
@@ -132,6 +154,7 @@ namespace key {
     static const std::string predicates = "predicates";
     static const std::string sdk_version = "sdk_version";
     static const std::string api_version = "api_version";
+    static const std::string generation = "generation";
     static const std::string app_version = "app_version";
     static const std::string driver_name = "driver_name";
     static const std::string all = "all";
@@ -144,6 +167,26 @@ namespace key {
     static const std::string enabled = "enabled";
     static const std::string bands = "bands";
     static const std::string time = "time";
+    static const std::string compressed = "compressed";
+    static const std::string bytes_in = "bytes_in";
+    static const std::string bytes_out = "bytes_out";
+    static const std::string uncompressed_bytes_in = "uncompressed_bytes_in";
+    static const std::string uncompressed_bytes_out = "uncompressed_bytes_out";
+    static const std::string thread_pool_size = "thread_pool_size";
+    static const std::string connection_limit = "connection_limit";
+    static const std::string per_ip_connection_limit = "per_ip_connection_limit";
+    static const std::string active_connections = "active_connections";
+    static const std::string peak_connections = "peak_connections";
+    static const std::string active_requests = "active_requests";
+    static const std::string total_requests = "total_requests";
+    static const std::string thumbnail_jobs = "thumbnail_jobs";
+    static const std::string active_transcoders = "active_transcoders";
+    static const std::string transcoder_cache_entries = "transcoder_cache_entries";
+    static const std::string transcoder_cache_bytes = "transcoder_cache_bytes";
+    static const std::string transcoder_cache_budget = "transcoder_cache_budget";
+    static const std::string transcoder_cache_hits = "transcoder_cache_hits";
+    static const std::string transcoder_cache_misses = "transcoder_cache_misses";
+    static const std::string transcoder_prefetch_jobs = "transcoder_prefetch_jobs";
 }
 
 namespace value {
@@ -209,6 +252,7 @@ namespace request {
     static const std::string set_transport_type = "set_transport_type";
     static const std::string snapshot_play_queue = "snapshot_play_queue";
     static const std::string invalidate_play_queue_snapshot = "invalidate_play_queue_snapshot";
+    static const std::string get_connection_stats = "get_connection_stats";
 }
 
 namespace fragment {
@@ -216,11 +260,13 @@ namespace fragment {
     static const std::string id = "id";
     static const std::string external_id = "external_id";
     static const std::string thumbnail = "thumbnail";
+    static const std::string stats = "stats";
 }
 
 namespace broadcast {
     static const std::string playback_overview_changed = "playback_overview_changed";
     static const std::string play_queue_changed = "play_queue_changed";
+    static const std::string library_changed = "library_changed";
 }
 
 static auto PLAYBACK_STATE_TO_STRING = std::unordered_map<musik::core::sdk::PlaybackState, std::string>({
@@ -247,4 +293,4 @@ static auto TRANSPORT_TYPE_TO_STRING = std::unordered_map<musik::core::sdk::Tran
     { musik::core::sdk::TransportType::Crossfade, "crossfade" },
 });
 
-static const int ApiVersion = 20;
+static const int ApiVersion = 23;
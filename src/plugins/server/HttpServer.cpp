@@ -36,15 +36,20 @@
 #include "Constants.h"
 #include "Util.h"
 #include "Transcoder.h"
+#include "TranscodeCache.h"
+#include "TranscodeSession.h"
 #include "TranscodingAudioDataStream.h"
 
 #include <musikcore/sdk/ITrack.h>
 #include <musikcore/sdk/String.h>
 
+#include <nlohmann/json.hpp>
+
 #pragma warning(push, 0)
 #include <websocketpp/base64/base64.hpp>
 #pragma warning(pop, 0)
 
+#include <algorithm>
 #include <unordered_map>
 #include <string>
 #include <cstdlib>
@@ -52,9 +57,13 @@
 
 #include <fcntl.h>
 #include <stdio.h>
+#include <sys/stat.h>
+#include <ctime>
 
 #ifdef WIN32
 #include <io.h>
+#else
+#include <unistd.h>
 #endif
 
 #include <vector>
@@ -62,9 +71,27 @@
 #define HTTP_416_DISABLED true
 #define ENABLE_DEBUG 1
 
+/* MHD_create_response_from_fd_at_offset64() lets microhttpd use sendfile()
+(or equivalent) for plain local files. older versions fall back to reading
+through an IDataStream, like everything else. */
+#if MHD_VERSION >= 0x00094400
+#define ENABLE_FD_RESPONSES 1
+#endif
+
 static const char* ENVIRONMENT_DISABLE_HTTP_SERVER_AUTH = "MUSIKCUBE_DISABLE_HTTP_SERVER_AUTH";
 static const char* TAG = "HttpServer";
 
+/* content addressed by something that never changes (thumbnail ids, external ids) */
+static const char* CACHE_CONTROL_IMMUTABLE = "public, max-age=31536000, immutable";
+/* may change; clients should revalidate, which is cheap thanks to etags */
+static const char* CACHE_CONTROL_REVALIDATE = "no-cache";
+
+/* a seek into an in-progress transcode that lands at most this far (in audio
+time) beyond what's been encoded waits for the encoder, which runs many times
+faster than real time. a seek any further starts a separate transcode at the
+requested position. */
+static const double SEGMENT_SEEK_THRESHOLD_SECONDS = 10.0;
+
 namespace std {
     namespace fs = std::filesystem;
 }
@@ -87,7 +114,8 @@ std::unordered_map<std::string, std::string> CONTENT_TYPE_MAP = {
     { ".mpp", "audio/x-musepack" },
     { ".ape", "audio/monkeys-audio" },
     { ".wma", "audio/x-ms-wma" },
-    { ".jpg", "image/jpeg" }
+    { ".jpg", "image/jpeg" },
+    { ".png", "image/png" }
 };
 
 struct Range {
@@ -162,17 +190,12 @@ static void fileFreeCallback(void *cls) {
     delete range;
 }
 
-static Range* parseRange(IDataStream* file, const char* range) {
-    Range* result = new Range();
-
-    size_t size = file ? file->Length() : 0;
-
-    result->file = file;
-    result->total = size;
-    result->from = 0;
-    result->to = (size <= 0) ? 0 : size - 1;
+static void resolveRange(Range& result, size_t size, const char* range) {
+    result.total = size;
+    result.from = 0;
+    result.to = (size <= 0) ? 0 : size - 1;
 
-    if (range) {
+    if (range && size > 0) {
         std::string str(range);
 
         if (str.substr(0, 6) == "bytes=") {
@@ -180,36 +203,105 @@ static Range* parseRange(IDataStream* file, const char* range) {
             std::vector<std::string> parts = str::Split(str, "-");
             if (parts.size() == 2) {
                 try {
-                    size_t from = (size_t) std::max(0, std::stoi(str::Trim(parts[0])));
-                    size_t to = size;
-
-                    if (parts.at(1).size()) {
-                        to = (size_t) std::min((int) size, std::stoi(str::Trim(parts[1])));
-                    }
-
-                    if (to > from) {
-                        result->from = from;
-                        if (to == 0) {
-                            result->to = 0;
-                        }
-                        else if (to >= size) {
-                            result->to = (size == 0) ? 0 : size - 1;
+                    const std::string first = str::Trim(parts[0]);
+                    const std::string last = str::Trim(parts[1]);
+                    size_t from, to = size - 1;
+
+                    if (first.empty()) {
+                        /* "bytes=-500" is a suffix range: the final 500 bytes */
+                        const size_t suffix = (size_t) std::stoull(last);
+                        if (suffix == 0) {
+                            return;
                         }
-                        else {
-                            result->to = (to == 0) ? 0 : to - 1;
+                        from = (suffix >= size) ? 0 : size - suffix;
+                    }
+                    else {
+                        /* "bytes=500-999" or "bytes=500-". note the end is inclusive */
+                        from = (size_t) std::stoull(first);
+                        if (last.size()) {
+                            to = std::min(to, (size_t) std::stoull(last));
                         }
                     }
+
+                    /* unsatisfiable ranges are ignored, and the whole file is
+                    returned; see HTTP_416_DISABLED. */
+                    if (from <= to && from < size) {
+                        result.from = from;
+                        result.to = to;
+                    }
                 }
                 catch (...) {
-                    /* return false below */
+                    /* malformed, use the whole file */
                 }
             }
         }
     }
+}
 
+static Range* parseRange(IDataStream* file, const char* range) {
+    Range* result = new Range();
+    result->file = file;
+    resolveRange(*result, file ? (size_t) file->Length() : 0, range);
     return result;
 }
 
+#ifdef ENABLE_FD_RESPONSES
+static int openReadOnly(const std::string& filename) {
+#ifdef WIN32
+    return _wopen(utf8to16(filename.c_str()).c_str(), _O_RDONLY | _O_BINARY);
+#else
+    return open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+}
+
+static void closeFile(int fd) {
+#ifdef WIN32
+    _close(fd);
+#else
+    close(fd);
+#endif
+}
+
+/* returns a response that lets microhttpd hand the file straight to the
+socket, without copying it through our process. returns nullptr if the
+uri isn't a plain local file, in which case the caller should fall back
+to an IDataStream. `range` is resolved against the file's size. */
+static MHD_Response* createFileResponse(const std::string& filename, const char* rangeVal, Range& range) {
+    std::error_code ec;
+    const std::fs::path path = std::fs::u8path(filename);
+
+    if (!std::fs::is_regular_file(path, ec) || ec) {
+        return nullptr;
+    }
+
+    const uintmax_t size = std::fs::file_size(path, ec);
+    if (ec || size == 0) {
+        return nullptr;
+    }
+
+    const int fd = openReadOnly(filename);
+    if (fd == -1) {
+        return nullptr;
+    }
+
+    range.file = nullptr;
+    resolveRange(range, (size_t) size, rangeVal);
+
+    /* microhttpd takes ownership of the descriptor, and closes it when the
+    response is destroyed. */
+    MHD_Response* response = MHD_create_response_from_fd_at_offset64(
+        (uint64_t) (range.to - range.from) + 1,
+        fd,
+        (uint64_t) range.from);
+
+    if (!response) {
+        closeFile(fd);
+    }
+
+    return response;
+}
+#endif
+
 static size_t getUnsignedUrlParam(
     struct MHD_Connection *connection,
     const std::string& argument,
@@ -247,6 +339,130 @@ static std::string getStringUrlParam(
     return stringValue ? std::string(stringValue) : defaultValue;
 }
 
+/* validators (ETag, Last-Modified) for responses backed by a local file.
+`variant` distinguishes different representations of the same file, e.g.
+transcodes or resized thumbnails. representations that aren't guaranteed to be
+byte-for-byte identical each time they're produced (transcodes) get `weak`
+validators, which are good for revalidation but not for resuming a range. */
+struct Validators {
+    std::string etag;
+    std::string lastModified;
+    bool weak{ false };
+};
+
+static bool getFileValidators(
+    const std::string& filename,
+    const std::string& variant,
+    bool weak,
+    Validators& validators)
+{
+#ifdef WIN32
+    struct _stat64 info;
+    if (_wstat64(utf8to16(filename.c_str()).c_str(), &info) != 0 || !(info.st_mode & _S_IFREG)) {
+        return false;
+    }
+#else
+    struct stat info;
+    if (stat(filename.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+        return false;
+    }
+#endif
+
+    const time_t modified = (time_t) info.st_mtime;
+
+    struct tm utc;
+#ifdef WIN32
+    gmtime_s(&utc, &modified);
+#else
+    gmtime_r(&modified, &utc);
+#endif
+
+    char date[64];
+    strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &utc);
+
+    validators.lastModified = date;
+    validators.weak = weak;
+    validators.etag = str::Format(
+        "%s\"%llx-%llx%s%s\"",
+        weak ? "W/" : "",
+        (unsigned long long) info.st_size,
+        (unsigned long long) modified,
+        variant.size() ? "-" : "",
+        variant.c_str());
+
+    return true;
+}
+
+/* true if the client's cached copy, described by If-None-Match (or, if
+that's absent, If-Modified-Since), is still current. */
+static bool isNotModified(MHD_Connection* connection, const Validators& validators) {
+    const char* ifNoneMatch = MHD_lookup_connection_value(
+        connection, MHD_HEADER_KIND, "If-None-Match");
+
+    if (ifNoneMatch) {
+        const std::string etag = validators.weak
+            ? validators.etag.substr(2) : validators.etag;
+
+        for (std::string tag : str::Split(std::string(ifNoneMatch), ",")) {
+            tag = str::Trim(tag);
+            if (tag.substr(0, 2) == "W/") {
+                tag = tag.substr(2); /* If-None-Match uses weak comparison */
+            }
+            if (tag == "*" || tag == etag) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /* clients echo back what we sent; an exact match is all we need */
+    const char* ifModifiedSince = MHD_lookup_connection_value(
+        connection, MHD_HEADER_KIND, "If-Modified-Since");
+
+    return ifModifiedSince && validators.lastModified == ifModifiedSince;
+}
+
+/* If-Range: only honor the Range header if the client's partial copy
+is of the same representation we're about to send. that takes a strong
+validator; with a weak one the bytes may differ, so the range is ignored. */
+static bool isRangeValid(MHD_Connection* connection, const Validators* validators) {
+    const char* ifRange = MHD_lookup_connection_value(
+        connection, MHD_HEADER_KIND, "If-Range");
+
+    if (!ifRange) {
+        return true;
+    }
+
+    return validators && !validators->weak &&
+        (validators->etag == ifRange || validators->lastModified == ifRange);
+}
+
+static void addValidatorHeaders(MHD_Response* response, const Validators& validators) {
+    MHD_add_response_header(response, "ETag", validators.etag.c_str());
+    MHD_add_response_header(response, "Last-Modified", validators.lastModified.c_str());
+}
+
+static MHD_Response* createNotModifiedResponse(const Validators& validators, const char* cacheControl) {
+    MHD_Response* response = MHD_create_response_from_buffer(0, nullptr, MHD_RESPMEM_PERSISTENT);
+    if (response) {
+        addValidatorHeaders(response, validators);
+        MHD_add_response_header(response, "Cache-Control", cacheControl);
+        MHD_add_response_header(response, "Server", "musikcube server");
+    }
+    return response;
+}
+
+/* keep user-supplied values (e.g. the transcode format) out of the etag */
+static std::string sanitizeForEtag(const std::string& value) {
+    std::string result;
+    for (char c : value) {
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) {
+            result += c;
+        }
+    }
+    return result;
+}
+
 static bool isAuthenticated(MHD_Connection *connection, Context& context) {
     const char* disableAuth = std::getenv(ENVIRONMENT_DISABLE_HTTP_SERVER_AUTH);
     if (disableAuth && std::string(disableAuth) == "1") {
@@ -274,8 +490,17 @@ static bool isAuthenticated(MHD_Connection *connection, Context& context) {
     return false;
 }
 
-HttpServer::HttpServer(Context& context)
+HttpServer::HttpServer(Context& context, Snapshots& snapshots)
 : context(context)
+, thumbnails(context)
+, prefetcher(context, snapshots)
+, threadPoolSize(0)
+, connectionLimit(0)
+, perIpConnectionLimit(0)
+, activeConnections(0)
+, peakConnections(0)
+, activeRequests(0)
+, totalRequests(0)
 , running(false) {
     this->httpServer = nullptr;
 }
@@ -293,23 +518,70 @@ void HttpServer::Wait() {
 
 bool HttpServer::Start() {
     if (this->Stop()) {
-        Transcoder::RemoveTempTranscodeFiles(this->context);
+        TranscodeCache::Reset(this->context);
 
         MHD_FLAG ipVersion = MHD_NO_FLAG;
         if (context.prefs->GetBool(prefs::use_ipv6.c_str(), defaults::use_ipv6)) {
             ipVersion = MHD_USE_IPv6;
         }
 
+        this->threadPoolSize = std::max(0, context.prefs->GetInt(
+            prefs::http_server_thread_pool_size.c_str(),
+            defaults::http_server_thread_pool_size));
+
+        this->connectionLimit = std::max(0, context.prefs->GetInt(
+            prefs::http_server_connection_limit.c_str(),
+            defaults::http_server_connection_limit));
+
+        this->perIpConnectionLimit = std::max(0, context.prefs->GetInt(
+            prefs::http_server_per_ip_connection_limit.c_str(),
+            defaults::http_server_per_ip_connection_limit));
+
+        /* by default every connection gets its own thread, which is simple and
+        robust, but expensive with lots of clients. alternatively, a fixed pool
+        of threads can multiplex all connections (using epoll where available).
+        note in that mode anything that blocks while producing a response (on-demand
+        transcodes, thumbnail resizes) stalls the other connections on the same
+        thread, so it's opt-in; plain files are sent without blocking. */
         int serverFlags =
 #if MHD_VERSION >= 0x00095300
-            MHD_USE_AUTO | MHD_USE_INTERNAL_POLLING_THREAD | MHD_USE_THREAD_PER_CONNECTION | ipVersion;
+            MHD_USE_AUTO | MHD_USE_INTERNAL_POLLING_THREAD | ipVersion;
 #else
-            MHD_USE_SELECT_INTERNALLY | MHD_USE_THREAD_PER_CONNECTION | ipVersion;
+            MHD_USE_SELECT_INTERNALLY | ipVersion;
 #endif
 
+        if (this->threadPoolSize == 0) {
+            serverFlags |= MHD_USE_THREAD_PER_CONNECTION;
+        }
+
         int serverPort =
             context.prefs->GetInt(prefs::http_server_port.c_str(), defaults::http_server_port);
 
+        std::vector<MHD_OptionItem> options = {
+            /* callback to be called for unescaping data */
+            { MHD_OPTION_UNESCAPE_CALLBACK, (intptr_t) &HttpServer::HandleUnescape, this },
+            /* enable address reuse */
+            { MHD_OPTION_LISTENING_ADDRESS_REUSE, 1, nullptr },
+            /* used to keep track of active connections and requests */
+            { MHD_OPTION_NOTIFY_CONNECTION, (intptr_t) &HttpServer::HandleConnectionNotification, this },
+            { MHD_OPTION_NOTIFY_COMPLETED, (intptr_t) &HttpServer::HandleRequestCompleted, this },
+        };
+
+        if (this->threadPoolSize > 0) {
+            options.push_back({ MHD_OPTION_THREAD_POOL_SIZE, this->threadPoolSize, nullptr });
+        }
+        if (this->connectionLimit > 0) {
+            options.push_back({ MHD_OPTION_CONNECTION_LIMIT, this->connectionLimit, nullptr });
+        }
+        if (this->perIpConnectionLimit > 0) {
+            options.push_back({ MHD_OPTION_PER_IP_CONNECTION_LIMIT, this->perIpConnectionLimit, nullptr });
+        }
+
+        options.push_back({ MHD_OPTION_END, 0, nullptr });
+
+        this->activeConnections = 0;
+        this->activeRequests = 0;
+
         httpServer = MHD_start_daemon(
             serverFlags,
             serverPort,
@@ -317,11 +589,8 @@ bool HttpServer::Start() {
             nullptr,                                    /* accept() policy callback data */
             &HttpServer::HandleRequest,                 /* request handler callback */
             this,                                       /* request handler callback data */
-            MHD_OPTION_UNESCAPE_CALLBACK,               /* option to configure unescaping */
-            &HttpServer::HandleUnescape,                /* callback to be called for unescaping data */
-            this,                                       /* unescape data callback data */
-            MHD_OPTION_LISTENING_ADDRESS_REUSE,         /* option to configure address reuse */
-            1,                                          /* enable address reuse */
+            MHD_OPTION_ARRAY,                           /* the options above */
+            options.data(),
             MHD_OPTION_END);                            /* terminal option */
 
         this->running = (httpServer != nullptr);
@@ -337,6 +606,11 @@ bool HttpServer::Stop() {
         this->httpServer = nullptr;
     }
 
+    /* after the daemon, which waits for in-flight requests, some of which
+    may be waiting on a resize. */
+    this->thumbnails.Stop();
+    this->prefetcher.Stop();
+
     this->running = false;
     this->exitCondition.notify_all();
 
@@ -349,6 +623,37 @@ size_t HttpServer::HandleUnescape(void * cls, struct MHD_Connection *c, char *s)
     return strlen(s);
 }
 
+void HttpServer::HandleConnectionNotification(
+    void* cls,
+    struct MHD_Connection* connection,
+    void** socketContext,
+    enum MHD_ConnectionNotificationCode code)
+{
+    auto server = static_cast<HttpServer*>(cls);
+    if (code == MHD_CONNECTION_NOTIFY_STARTED) {
+        const int active = ++server->activeConnections;
+        int peak = server->peakConnections;
+        while (active > peak && !server->peakConnections.compare_exchange_weak(peak, active)) {
+        }
+    }
+    else if (code == MHD_CONNECTION_NOTIFY_CLOSED) {
+        --server->activeConnections;
+    }
+}
+
+void HttpServer::HandleRequestCompleted(
+    void* cls,
+    struct MHD_Connection* connection,
+    void** requestContext,
+    enum MHD_RequestTerminationCode code)
+{
+    /* set by HandleRequest() the first time it sees the request */
+    if (*requestContext) {
+        *requestContext = nullptr;
+        --static_cast<HttpServer*>(cls)->activeRequests;
+    }
+}
+
 MHD_Result HttpServer::HandleRequest(
     void *cls,
     struct MHD_Connection *connection,
@@ -361,6 +666,14 @@ MHD_Result HttpServer::HandleRequest(
 {
     auto server = static_cast<HttpServer*>(cls);
 
+    if (!*con_cls) {
+        /* any non-null value will do; it's only used to pair this request
+        with its completion notification */
+        *con_cls = server;
+        ++server->activeRequests;
+        ++server->totalRequests;
+    }
+
 #ifdef ENABLE_DEBUG
     server->context.debug->Info(TAG, str::Format("new request: %s", url).c_str());
 #endif
@@ -397,6 +710,10 @@ MHD_Result HttpServer::HandleRequest(
                     else if (parts.at(0) == fragment::thumbnail && parts.size() == 2) {
                         status = HandleThumbnailRequest(server, response, connection, parts);
                     }
+                    /* /stats */
+                    else if (parts.at(0) == fragment::stats && parts.size() == 1) {
+                        status = HandleStatsRequest(server, response, connection);
+                    }
                 }
             }
         }
@@ -427,11 +744,6 @@ int HttpServer::HandleAudioTrackRequest(
         prefs::transcoder_max_active_count.c_str(),
         defaults::transcoder_max_active_count);
 
-    if (bitrate != 0 && Transcoder::GetActiveCount() >= maxActiveTranscoders) {
-        response = MHD_create_response_from_buffer(0, nullptr, MHD_RESPMEM_PERSISTENT);
-        return MHD_HTTP_TOO_MANY_REQUESTS;
-    }
-
     int status = MHD_HTTP_OK;
 
     ITrack* track = nullptr;
@@ -451,6 +763,7 @@ int HttpServer::HandleAudioTrackRequest(
         const std::string filename = GetMetadataString(track, key::filename);
         const std::string title = GetMetadataString(track, key::title, "");
         const std::string externalId = GetMetadataString(track, key::external_id, "");
+        const int64_t trackId = track->GetId();
 
         track->Release();
 
@@ -458,33 +771,124 @@ int HttpServer::HandleAudioTrackRequest(
 
         if (bitrate != 0) {
             format = getStringUrlParam(connection, "format", "mp3");
+
+            /* requests for a transcode that's already running share it, so
+            they don't count against the limit */
+            if (Transcoder::GetActiveCount() >= maxActiveTranscoders &&
+                !Transcoder::IsActive(server->context, filename, bitrate, format))
+            {
+                response = MHD_create_response_from_buffer(0, nullptr, MHD_RESPMEM_PERSISTENT);
+                return MHD_HTTP_TOO_MANY_REQUESTS;
+            }
         }
 
-        IDataStream* file = (bitrate == 0)
-            ? server->context.environment->GetDataStream(filename.c_str(), OpenFlags::Read)
-            : Transcoder::Transcode(server->context, filename, bitrate, format);
+        /* a transcode is a different representation of the same file, and
+        not necessarily byte-identical if it's produced again */
+        Validators validators;
+        const bool hasValidators = getFileValidators(
+            filename,
+            bitrate ? std::to_string(bitrate) + sanitizeForEtag(format) : "",
+            bitrate != 0,
+            validators);
+
+        const char* cacheControl = byExternalId
+            ? CACHE_CONTROL_IMMUTABLE : CACHE_CONTROL_REVALIDATE;
+
+        if (hasValidators && isNotModified(connection, validators)) {
+            response = createNotModifiedResponse(validators, cacheControl);
+            return MHD_HTTP_NOT_MODIFIED;
+        }
 
         const char* rangeVal = MHD_lookup_connection_value(
             connection, MHD_HEADER_KIND, "Range");
 
-        Range* range = parseRange(file, rangeVal);
+        if (rangeVal && !isRangeValid(connection, hasValidators ? &validators : nullptr)) {
+            rangeVal = nullptr; /* the client's partial copy is stale; send it all */
+        }
 
-        /* ehh... */
-        bool isOnDemandTranscoder = !!dynamic_cast<TranscodingAudioDataStream*>(file);
+        Range* range = nullptr;
+        IDataStream* file = nullptr;
+        bool isOnDemandTranscoder = false;
+        bool isSeekableTranscoder = false;
+
+#ifdef ENABLE_FD_RESPONSES
+        /* plain local files, served as-is, don't need to go through an
+        IDataStream at all: let microhttpd send them directly. */
+        Range fileRange;
+        if (bitrate == 0) {
+            response = createFileResponse(filename, rangeVal, fileRange);
+            if (response) {
+                range = &fileRange;
+            }
+        }
+#endif
+
+        if (!response) {
+            file = (bitrate == 0)
+                ? server->context.environment->GetDataStream(filename.c_str(), OpenFlags::Read)
+                : Transcoder::Transcode(server->context, filename, bitrate, format);
+
+            range = parseRange(file, rangeVal);
+
+            /* while this one plays, get a head start on what's next */
+            if (bitrate != 0 && file) {
+                server->prefetcher.OnTrackRequested(trackId, bitrate, format);
+            }
+
+            /* ehh... */
+            isOnDemandTranscoder =
+                !!dynamic_cast<TranscodingAudioDataStream*>(file) ||
+                !!dynamic_cast<TranscodeSessionStream*>(file);
+        }
 
 #ifdef ENABLE_DEBUG
         server->context.debug->Info(TAG, str::Format(
-            "range request: %s, resolved range: %s, isOnDemandTranscoder=%s",
+            "range request: %s, resolved range: %s, isOnDemandTranscoder=%s, fd=%s",
             rangeVal ? rangeVal : "[unspecified]",
             range ? range->HeaderValue().c_str() : "[unresolved]",
-            isOnDemandTranscoder ? "true" : "false").c_str());
+            isOnDemandTranscoder ? "true" : "false",
+            response ? "true" : "false").c_str());
+#endif
+
+        /* a shared, in-progress transcode can serve any range: bytes that have
+        already been produced go out immediately, and we'll wait for ones the
+        encoder is about to reach. for a seek well beyond that, start a second
+        transcode from the equivalent time rather than making the client wait
+        for the encoder to catch up. */
+        TranscodeSessionStream* sessionStream = dynamic_cast<TranscodeSessionStream*>(file);
+        if (sessionStream) {
+            isSeekableTranscoder = true;
+
+            const size_t lookahead = (size_t)(
+                SEGMENT_SEEK_THRESHOLD_SECONDS * 1000.0 * (double) bitrate / 8.0);
+
+            if (range->from > (size_t) sessionStream->Available() + lookahead &&
+                Transcoder::GetActiveCount() < maxActiveTranscoders)
+            {
+                IDataStream* segment = Transcoder::TranscodeSegment(
+                    server->context, filename, bitrate, format, range->from);
+
+#ifdef ENABLE_DEBUG
+                server->context.debug->Info(TAG, str::Format(
+                    "seek to %d beyond transcode frontier %d, segment=%s",
+                    (int) range->from,
+                    (int) sessionStream->Available(),
+                    segment ? "true" : "false").c_str());
 #endif
 
-        /* gotta be careful with request ranges if we're transcoding. don't
-        allow any custom ranges other than from 0 to end. */
-        if (isOnDemandTranscoder && rangeVal && strlen(rangeVal)) {
+                if (segment) {
+                    sessionStream->Release();
+                    file = segment;
+                    range->file = segment;
+                }
+            }
+        }
+        /* otherwise gotta be careful with request ranges if we're transcoding.
+        don't allow any custom ranges other than from 0 to end. */
+        else if (isOnDemandTranscoder && rangeVal && strlen(rangeVal)) {
             if (range->from != 0 || range->to != range->total - 1) {
                 delete range;
+                range = nullptr;
 
 #ifdef ENABLE_DEBUG
                 server->context.debug->Info(TAG, "removing range header, seek requested with ondemand transcoder");
@@ -539,60 +943,71 @@ int HttpServer::HandleAudioTrackRequest(
             server->context.debug->Info(TAG, str::Format("response length=%d", ((length == 0) ? 0 : length + 1)).c_str());
 #endif
 
-            if (response) {
-                /* 'format' will be valid if we're transcoding. otherwise, extract the extension
-                from the filename. the client can use this as a hint when naming downloaded files */
-                std::string extension = format.size() ? format : fileExtension(filename);
-                MHD_add_response_header(response, "X-musikcube-File-Extension", extension.c_str());
+            if (!response) {
+                file->Release();
+                file = nullptr;
+            }
+        }
+        else if (!response) {
+            delete range;
+            status = MHD_HTTP_NOT_FOUND;
+        }
 
-                if (!isOnDemandTranscoder) {
-                    MHD_add_response_header(response, "Accept-Ranges", "bytes");
+        if (response && status != 416) {
+            /* 'format' will be valid if we're transcoding. otherwise, extract the extension
+            from the filename. the client can use this as a hint when naming downloaded files */
+            std::string extension = format.size() ? format : fileExtension(filename);
+            MHD_add_response_header(response, "X-musikcube-File-Extension", extension.c_str());
 
-                    if (std::fs::exists(std::fs::u8path(filename))) {
-                        MHD_add_response_header(response, "X-musikcube-Filename-Override", externalId.c_str());
-                    }
+            if (!isOnDemandTranscoder) {
+                MHD_add_response_header(response, "Accept-Ranges", "bytes");
+
+                if (std::fs::exists(std::fs::u8path(filename))) {
+                    MHD_add_response_header(response, "X-musikcube-Filename-Override", externalId.c_str());
                 }
-                else {
-                    MHD_add_response_header(response, "X-musikcube-Estimated-Content-Length", "true");
+            }
+            else {
+                if (isSeekableTranscoder) {
+                    MHD_add_response_header(response, "Accept-Ranges", "bytes");
                 }
+                MHD_add_response_header(response, "X-musikcube-Estimated-Content-Length", "true");
+            }
 
-                if (duration.size()) {
-                    MHD_add_response_header(response, "X-Content-Duration", duration.c_str());
-                    MHD_add_response_header(response, "Content-Duration", duration.c_str());
-                }
+            if (duration.size()) {
+                MHD_add_response_header(response, "X-Content-Duration", duration.c_str());
+                MHD_add_response_header(response, "Content-Duration", duration.c_str());
+            }
 
-                if (byExternalId) {
-                    /* if we're using an on-demand transcoder, ensure the client does not cache the
-                    result because we have to guess the content length. */
-                    std::string value = isOnDemandTranscoder ? "no-cache" : "public, max-age=31536000";
-                    MHD_add_response_header(response, "Cache-Control", value.c_str());
+            /* if we're using an on-demand transcoder, ensure the client does not cache the
+            result because we have to guess the content length. for the same reason it
+            doesn't get validators: the body may differ from the eventual cached transcode. */
+            if (isOnDemandTranscoder) {
+                MHD_add_response_header(response, "Cache-Control", "no-cache");
+            }
+            else {
+                MHD_add_response_header(response, "Cache-Control", cacheControl);
+                if (hasValidators) {
+                    addValidatorHeaders(response, validators);
                 }
+            }
 
-                std::string type = (isOnDemandTranscoder || format.size())
-                    ? contentType("." + format) : contentType(filename);
+            std::string type = (isOnDemandTranscoder || format.size())
+                ? contentType("." + format) : contentType(filename);
 
-                MHD_add_response_header(response, "Content-Type", type.c_str());
-                MHD_add_response_header(response, "Server", "musikcube server");
+            MHD_add_response_header(response, "Content-Type", type.c_str());
+            MHD_add_response_header(response, "Server", "musikcube server");
 
-                if ((rangeVal && strlen(rangeVal)) || range->from > 0) {
-                    if (range->total > 0) {
-                        MHD_add_response_header(response, "Content-Range", range->HeaderValue().c_str());
-                        status = MHD_HTTP_PARTIAL_CONTENT;
+            if ((rangeVal && strlen(rangeVal)) || range->from > 0) {
+                if (range->total > 0) {
+                    MHD_add_response_header(response, "Content-Range", range->HeaderValue().c_str());
+                    status = MHD_HTTP_PARTIAL_CONTENT;
 #ifdef ENABLE_DEBUG
-                        if (rangeVal) {
-                            server->context.debug->Info(TAG, str::Format("range header: %s", range->HeaderValue().c_str()).c_str());
-                        }
-#endif
+                    if (rangeVal) {
+                        server->context.debug->Info(TAG, str::Format("range header: %s", range->HeaderValue().c_str()).c_str());
                     }
+#endif
                 }
             }
-            else {
-                file->Release();
-                file = nullptr;
-            }
-        }
-        else {
-            status = MHD_HTTP_NOT_FOUND;
         }
     }
     else {
@@ -614,30 +1029,118 @@ int HttpServer::HandleThumbnailRequest(
     server->context.environment->GetPath(PathType::Library, pathBuffer, sizeof(pathBuffer));
 
     if (strlen(pathBuffer)) {
-        std::string path = std::string(pathBuffer) + "thumbs/" + pathParts.at(1) + ".jpg";
-        IDataStream* file = server->context.environment->GetDataStream(path.c_str(), OpenFlags::Read);
+        const std::string& id = pathParts.at(1);
+        std::string path = std::string(pathBuffer) + "thumbs/" + id + ".jpg";
+
+        /* clients can ask for a downscaled copy, e.g. for grid tiles. */
+        const int width = (int) getUnsignedUrlParam(connection, "width", 0);
+        const int height = (int) getUnsignedUrlParam(connection, "height", 0);
+        const bool isNumericId = id.size() && std::all_of(id.begin(), id.end(), [](char c) { return c >= '0' && c <= '9'; });
+
+        const bool resize = (width || height) && isNumericId && ThumbnailCache::Enabled();
+        const auto format = (getStringUrlParam(connection, "format", "jpg") == "png")
+            ? ThumbnailCache::Format::Png : ThumbnailCache::Format::Jpeg;
+
+        /* a resized variant is derived entirely from the original, so its
+        validators are too. that means we can answer a conditional request
+        without producing (or even looking up) the variant. */
+        const std::string variantTag = resize
+            ? str::Format("%dx%d%s", width, height, format == ThumbnailCache::Format::Png ? "png" : "jpg")
+            : "";
+
+        Validators validators;
+        bool hasValidators = getFileValidators(path, variantTag, false, validators);
+
+        if (hasValidators && isNotModified(connection, validators)) {
+            response = createNotModifiedResponse(validators, CACHE_CONTROL_IMMUTABLE);
+            return MHD_HTTP_NOT_MODIFIED;
+        }
 
-        if (file) {
-            long length = file->Length();
+        if (resize) {
+            std::string variant = server->thumbnails.Get(id, path, width, height, format);
+            if (variant.size()) {
+                path = variant;
+            }
+            else {
+                /* serving the original instead */
+                hasValidators = getFileValidators(path, "", false, validators);
+            }
+        }
 
-            response = MHD_create_response_from_callback(
-                length == 0 ? MHD_SIZE_UNKNOWN : length + 1,
-                4096,
-                &fileReadCallback,
-                parseRange(file, nullptr),
-                &fileFreeCallback);
+#ifdef ENABLE_FD_RESPONSES
+        Range range;
+        response = createFileResponse(path, nullptr, range);
+#endif
 
-            if (response) {
-                MHD_add_response_header(response, "Cache-Control", "public, max-age=31536000");
-                MHD_add_response_header(response, "Content-Type", contentType(path).c_str());
-                MHD_add_response_header(response, "Server", "musikcube server");
-                status = MHD_HTTP_OK;
+        if (!response) {
+            IDataStream* file = server->context.environment->GetDataStream(path.c_str(), OpenFlags::Read);
+
+            if (file) {
+                long length = file->Length();
+
+                response = MHD_create_response_from_callback(
+                    length == 0 ? MHD_SIZE_UNKNOWN : length + 1,
+                    4096,
+                    &fileReadCallback,
+                    parseRange(file, nullptr),
+                    &fileFreeCallback);
+
+                if (!response) {
+                    file->Release();
+                }
             }
-            else {
-                file->Release();
+        }
+
+        if (response) {
+            MHD_add_response_header(response, "Cache-Control", CACHE_CONTROL_IMMUTABLE);
+            if (hasValidators) {
+                addValidatorHeaders(response, validators);
             }
+            MHD_add_response_header(response, "Content-Type", contentType(path).c_str());
+            MHD_add_response_header(response, "Server", "musikcube server");
+            status = MHD_HTTP_OK;
         }
     }
 
     return status;
 }
+
+int HttpServer::HandleStatsRequest(
+    HttpServer* server,
+    MHD_Response*& response,
+    MHD_Connection* connection)
+{
+    const TranscodeCache::Stats cache = TranscodeCache::GetStats(server->context);
+
+    nlohmann::json stats = {
+        { key::thread_pool_size, server->threadPoolSize },
+        { key::connection_limit, server->connectionLimit },
+        { key::per_ip_connection_limit, server->perIpConnectionLimit },
+        { key::active_connections, server->activeConnections.load() },
+        { key::peak_connections, server->peakConnections.load() },
+        { key::active_requests, server->activeRequests.load() },
+        { key::total_requests, server->totalRequests.load() },
+        { key::thumbnail_jobs, server->thumbnails.PendingCount() },
+        { key::active_transcoders, Transcoder::GetActiveCount() },
+        { key::transcoder_cache_entries, cache.entries },
+        { key::transcoder_cache_bytes, cache.bytes },
+        { key::transcoder_cache_budget, cache.budget },
+        { key::transcoder_cache_hits, cache.hits },
+        { key::transcoder_cache_misses, cache.misses },
+        { key::transcoder_prefetch_jobs, server->prefetcher.PendingCount() }
+    };
+
+    const std::string body = stats.dump();
+
+    response = MHD_create_response_from_buffer(
+        body.size(), (void*) body.c_str(), MHD_RESPMEM_MUST_COPY);
+
+    if (response) {
+        MHD_add_response_header(response, "Content-Type", "application/json");
+        MHD_add_response_header(response, "Cache-Control", "no-store");
+        MHD_add_response_header(response, "Server", "musikcube server");
+        return MHD_HTTP_OK;
+    }
+
+    return MHD_HTTP_NOT_FOUND;
+}
@@ -41,6 +41,9 @@ extern "C" {
 }
 
 #include "Context.h"
+#include "ThumbnailCache.h"
+#include "TranscodePrefetcher.h"
+#include <atomic>
 #include <condition_variable>
 #include <mutex>
 #include <vector>
@@ -51,7 +54,7 @@ extern "C" {
 
 class HttpServer {
     public:
-        HttpServer(Context& context);
+        HttpServer(Context& context, Snapshots& snapshots);
         ~HttpServer();
 
         bool Start();
@@ -74,6 +77,18 @@ class HttpServer {
             struct MHD_Connection *c,
             char *s);
 
+        static void HandleConnectionNotification(
+            void* cls,
+            struct MHD_Connection* connection,
+            void** socketContext,
+            enum MHD_ConnectionNotificationCode code);
+
+        static void HandleRequestCompleted(
+            void* cls,
+            struct MHD_Connection* connection,
+            void** requestContext,
+            enum MHD_RequestTerminationCode code);
+
         static int HandleAudioTrackRequest(
             HttpServer* server,
             MHD_Response*& response,
@@ -86,8 +101,22 @@ class HttpServer {
             MHD_Connection* connection,
             std::vector<std::string>& pathParts);
 
+        static int HandleStatsRequest(
+            HttpServer* server,
+            MHD_Response*& response,
+            MHD_Connection* connection);
+
         struct MHD_Daemon *httpServer;
         Context& context;
+        ThumbnailCache thumbnails;
+        TranscodePrefetcher prefetcher;
+        int threadPoolSize;
+        int connectionLimit;
+        int perIpConnectionLimit;
+        std::atomic<int> activeConnections;
+        std::atomic<int> peakConnections;
+        std::atomic<int> activeRequests;
+        std::atomic<int64_t> totalRequests;
         volatile bool running;
         std::condition_variable exitCondition;
         std::mutex exitMutex;
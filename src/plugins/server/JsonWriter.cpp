@@ -0,0 +1,234 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "JsonWriter.h"
+#include <cstdio>
+#include <cstring>
+
+static const char* HEX = "0123456789abcdef";
+static const char* REPLACEMENT_CHARACTER = "\xef\xbf\xbd";
+
+/* returns the length of the well-formed utf8 sequence starting at `s`, or
+0 if it's malformed (truncated, bad continuation, overlong, or a surrogate). */
+static inline size_t utf8SequenceLength(const unsigned char* s, size_t remaining) {
+    const unsigned char c = s[0];
+    size_t length;
+    unsigned char min = 0x80, max = 0xbf; /* valid range for the second byte */
+
+    if (c >= 0xc2 && c <= 0xdf) { length = 2; }
+    else if (c >= 0xe0 && c <= 0xef) {
+        length = 3;
+        if (c == 0xe0) { min = 0xa0; }
+        else if (c == 0xed) { max = 0x9f; }
+    }
+    else if (c >= 0xf0 && c <= 0xf4) {
+        length = 4;
+        if (c == 0xf0) { min = 0x90; }
+        else if (c == 0xf4) { max = 0x8f; }
+    }
+    else {
+        return 0;
+    }
+
+    if (remaining < length || s[1] < min || s[1] > max) {
+        return 0;
+    }
+
+    for (size_t i = 2; i < length; i++) {
+        if ((s[i] & 0xc0) != 0x80) {
+            return 0;
+        }
+    }
+
+    return length;
+}
+
+JsonWriter::JsonWriter(std::string& output)
+: output(output)
+, afterKey(false) {
+}
+
+void JsonWriter::Separate() {
+    if (this->afterKey) {
+        this->afterKey = false;
+    }
+    else if (!this->first.empty()) {
+        if (this->first.back()) {
+            this->first.back() = false;
+        }
+        else {
+            this->output += ',';
+        }
+    }
+}
+
+void JsonWriter::Escape(const char* value, size_t length) {
+    auto& out = this->output;
+    auto s = reinterpret_cast<const unsigned char*>(value);
+
+    out += '"';
+
+    /* copy runs of characters that don't need escaping in one shot */
+    size_t start = 0;
+    size_t i = 0;
+    while (i < length) {
+        const unsigned char c = s[i];
+
+        if (c >= 0x20 && c != '"' && c != '\\' && c < 0x80) {
+            ++i;
+            continue;
+        }
+
+        if (c >= 0x80) {
+            const size_t sequence = utf8SequenceLength(s + i, length - i);
+            if (sequence) {
+                i += sequence;
+                continue;
+            }
+        }
+
+        out.append(value + start, i - start);
+
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c >= 0x80) {
+                    /* malformed utf8 would otherwise fail the text frame's
+                    validation and drop the entire response. */
+                    out += REPLACEMENT_CHARACTER;
+                }
+                else {
+                    out += "\\u00";
+                    out += HEX[c >> 4];
+                    out += HEX[c & 0x0f];
+                }
+                break;
+        }
+
+        start = ++i;
+    }
+
+    out.append(value + start, length - start);
+    out += '"';
+}
+
+JsonWriter& JsonWriter::BeginObject() {
+    this->Separate();
+    this->output += '{';
+    this->first.push_back(true);
+    return *this;
+}
+
+JsonWriter& JsonWriter::EndObject() {
+    this->output += '}';
+    this->first.pop_back();
+    return *this;
+}
+
+JsonWriter& JsonWriter::BeginArray() {
+    this->Separate();
+    this->output += '[';
+    this->first.push_back(true);
+    return *this;
+}
+
+JsonWriter& JsonWriter::EndArray() {
+    this->output += ']';
+    this->first.pop_back();
+    return *this;
+}
+
+JsonWriter& JsonWriter::Key(const std::string& key) {
+    this->Separate();
+    this->Escape(key.c_str(), key.size());
+    this->output += ':';
+    this->afterKey = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::String(const char* value) {
+    this->Separate();
+    this->Escape(value, strlen(value));
+    return *this;
+}
+
+JsonWriter& JsonWriter::String(const std::string& value) {
+    this->Separate();
+    this->Escape(value.c_str(), value.size());
+    return *this;
+}
+
+JsonWriter& JsonWriter::Int(int64_t value) {
+    this->Separate();
+    char buffer[24];
+    const int length = snprintf(buffer, sizeof(buffer), "%lld", (long long) value);
+    this->output.append(buffer, (size_t) length);
+    return *this;
+}
+
+JsonWriter& JsonWriter::Bool(bool value) {
+    this->Separate();
+    this->output += value ? "true" : "false";
+    return *this;
+}
+
+JsonWriter& JsonWriter::Null() {
+    this->Separate();
+    this->output += "null";
+    return *this;
+}
+
+JsonWriter& JsonWriter::Value(const nlohmann::json& value) {
+    this->Separate();
+    this->output += value.dump();
+    return *this;
+}
+
+JsonWriter& JsonWriter::Field(const std::string& key, const char* value) {
+    return this->Key(key).String(value);
+}
+
+JsonWriter& JsonWriter::Field(const std::string& key, const std::string& value) {
+    return this->Key(key).String(value);
+}
+
+JsonWriter& JsonWriter::Field(const std::string& key, int64_t value) {
+    return this->Key(key).Int(value);
+}
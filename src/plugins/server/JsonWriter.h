@@ -0,0 +1,79 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+/* a small, forward-only json emitter that appends directly to an existing
+string (usually a websocket message payload). used for large responses
+(track lists, albums) so we don't have to build a DOM, dump() it to a
+temporary, then copy that temporary into the outgoing frame. */
+class JsonWriter {
+    public:
+        JsonWriter(std::string& output);
+
+        JsonWriter(const JsonWriter&) = delete;
+        JsonWriter& operator=(const JsonWriter&) = delete;
+
+        JsonWriter& BeginObject();
+        JsonWriter& EndObject();
+        JsonWriter& BeginArray();
+        JsonWriter& EndArray();
+
+        JsonWriter& Key(const std::string& key);
+        JsonWriter& String(const char* value);
+        JsonWriter& String(const std::string& value);
+        JsonWriter& Int(int64_t value);
+        JsonWriter& Bool(bool value);
+        JsonWriter& Null();
+
+        /* escape hatch for small values that already live in a DOM */
+        JsonWriter& Value(const nlohmann::json& value);
+
+        /* same as (Key(key), String(value)) etc. */
+        JsonWriter& Field(const std::string& key, const char* value);
+        JsonWriter& Field(const std::string& key, const std::string& value);
+        JsonWriter& Field(const std::string& key, int64_t value);
+
+    private:
+        void Separate();
+        void Escape(const char* value, size_t length);
+
+        std::string& output;
+        std::vector<bool> first; /* one per open container */
+        bool afterKey;
+};
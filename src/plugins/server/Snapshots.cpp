@@ -58,7 +58,12 @@ Snapshots::~Snapshots() {
     Reset();
 }
 
+std::unique_lock<std::recursive_mutex> Snapshots::Lock() {
+    return std::unique_lock<std::recursive_mutex>(this->mutex);
+}
+
 TrackList* Snapshots::Get(const std::string& key) {
+    auto lock = this->Lock();
     auto it = this->cache.find(key);
     if (it != this->cache.end()) {
         this->cache[key] = CacheKey(it->second.tracks, expiry());
@@ -67,13 +72,25 @@ TrackList* Snapshots::Get(const std::string& key) {
     return nullptr;
 }
 
+bool Snapshots::Find(std::function<bool(TrackList*)> visitor) {
+    auto lock = this->Lock();
+    for (auto& it : this->cache) {
+        if (!expired(it.second.expiry) && visitor(it.second.tracks)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void Snapshots::Put(const std::string& key, TrackList* tracks) {
+    auto lock = this->Lock();
     this->Prune();
     this->Remove(key);
     this->cache[key] = CacheKey(tracks, expiry());
 }
 
 void Snapshots::Remove(const std::string& key) {
+    auto lock = this->Lock();
     this->Prune();
     auto it = this->cache.find(key);
     if (it != this->cache.end()) {
@@ -83,6 +100,7 @@ void Snapshots::Remove(const std::string& key) {
 }
 
 void Snapshots::Prune() {
+    auto lock = this->Lock();
     auto it = this->cache.begin();
     while (it != this->cache.end()) {
         if (expired(it->second.expiry)) {
@@ -95,6 +113,7 @@ void Snapshots::Prune() {
 }
 
 void Snapshots::Reset() {
+    auto lock = this->Lock();
     for (auto it : cache) {
         it.second.tracks->Release();
     }
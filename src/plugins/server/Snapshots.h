@@ -35,7 +35,9 @@
 #pragma once
 
 #include <musikcore/sdk/ITrackList.h>
+#include <functional>
 #include <map>
+#include <mutex>
 #include <string>
 
 class Snapshots {
@@ -44,7 +46,15 @@ class Snapshots {
 
         ~Snapshots();
 
+        /* requests are handled concurrently; hold this while using a
+        TrackList returned by Get() so it can't be removed underneath you */
+        std::unique_lock<std::recursive_mutex> Lock();
+
         TrackList* Get(const std::string& key);
+
+        /* calls `visitor` with each snapshot, with the lock held, until it
+        returns true. returns false if it never did. */
+        bool Find(std::function<bool(TrackList*)> visitor);
         void Put(const std::string& key, TrackList* tracks);
         void Remove(const std::string& key);
         void Prune();
@@ -67,4 +77,5 @@ class Snapshots {
         };
 
         std::map<std::string, CacheKey> cache;
+        std::recursive_mutex mutex;
 };
\ No newline at end of file
@@ -0,0 +1,715 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "ThumbnailCache.h"
+#include "Constants.h"
+
+#include <musikcore/sdk/String.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#ifdef ENABLE_THUMBNAIL_RESIZING
+extern "C" {
+    #include <png.h>
+    #include <jpeglib.h>
+}
+#include <csetjmp>
+#endif
+
+namespace fs = std::filesystem;
+
+using namespace musik::core::sdk;
+
+static const size_t kMaxQueuedJobs = 32;
+static const int kMaxDimension = 2048;
+static const int kJpegQuality = 85;
+static const size_t kMaxSourcePixels = 40 * 1000 * 1000;
+
+static std::string extension(ThumbnailCache::Format format) {
+    return format == ThumbnailCache::Format::Png ? "png" : "jpg";
+}
+
+/* identifies the current contents of the source image, so variants of a
+thumbnail that was regenerated or replaced (or whose id was reused) are never
+served; stale ones age out of the cache like any other. */
+static bool sourceVersion(const std::string& source, std::string& version) {
+    std::error_code ec;
+    const auto path = fs::u8path(source);
+    const auto modified = fs::last_write_time(path, ec);
+    if (ec) {
+        return false;
+    }
+    const auto bytes = fs::file_size(path, ec);
+    if (ec) {
+        return false;
+    }
+    version =
+        std::to_string((long long) modified.time_since_epoch().count()) + "-" +
+        std::to_string((unsigned long long) bytes);
+    return true;
+}
+
+/* scales (srcWidth, srcHeight) down, preserving aspect ratio, so it fits
+within (maxWidth, maxHeight). zero means unbounded. never scales up. */
+static void fitWithin(int srcWidth, int srcHeight, int maxWidth, int maxHeight, int& width, int& height) {
+    double scale = 1.0;
+    if (maxWidth > 0) {
+        scale = std::min(scale, (double) maxWidth / srcWidth);
+    }
+    if (maxHeight > 0) {
+        scale = std::min(scale, (double) maxHeight / srcHeight);
+    }
+    width = std::max(1, (int) std::lround(srcWidth * scale));
+    height = std::max(1, (int) std::lround(srcHeight * scale));
+}
+
+#ifdef ENABLE_THUMBNAIL_RESIZING
+
+struct Image {
+    int width{ 0 };
+    int height{ 0 };
+    int channels{ 0 };
+    std::vector<unsigned char> pixels;
+};
+
+static FILE* openFile(const std::string& filename, const char* mode) {
+#ifdef WIN32
+    return _wfopen(utf8to16(filename.c_str()).c_str(), utf8to16(mode).c_str());
+#else
+    return fopen(filename.c_str(), mode);
+#endif
+}
+
+static bool readFile(const std::string& filename, std::vector<unsigned char>& data) {
+    std::ifstream in(fs::u8path(filename), std::ios::binary | std::ios::ate);
+    if (!in.good()) {
+        return false;
+    }
+    const std::streamsize size = in.tellg();
+    if (size <= 0) {
+        return false;
+    }
+    data.resize((size_t) size);
+    in.seekg(0);
+    return !!in.read((char*) data.data(), size);
+}
+
+static bool isJpeg(const std::vector<unsigned char>& data) {
+    return data.size() > 3 && data[0] == 0xff && data[1] == 0xd8 && data[2] == 0xff;
+}
+
+static bool isPng(const std::vector<unsigned char>& data) {
+    static const unsigned char signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    return data.size() > sizeof(signature) && memcmp(data.data(), signature, sizeof(signature)) == 0;
+}
+
+struct JpegError {
+    jpeg_error_mgr manager;
+    jmp_buf jump;
+};
+
+static void jpegErrorExit(j_common_ptr info) {
+    longjmp(reinterpret_cast<JpegError*>(info->err)->jump, 1);
+}
+
+static bool decodeJpeg(const std::vector<unsigned char>& data, int maxWidth, int maxHeight, Image& image) {
+    jpeg_decompress_struct info;
+    JpegError error;
+    info.err = jpeg_std_error(&error.manager);
+    error.manager.error_exit = &jpegErrorExit;
+
+    if (setjmp(error.jump)) {
+        /* corrupt, truncated, or a color space we can't convert to rgb */
+        jpeg_destroy_decompress(&info);
+        return false;
+    }
+
+    jpeg_create_decompress(&info);
+    jpeg_mem_src(&info, const_cast<unsigned char*>(data.data()), (unsigned long) data.size());
+    jpeg_read_header(&info, TRUE);
+
+    if ((size_t) info.image_width * info.image_height > kMaxSourcePixels) {
+        jpeg_destroy_decompress(&info);
+        return false;
+    }
+
+    info.out_color_space = JCS_RGB;
+
+    /* libjpeg can scale by 1/2, 1/4 or 1/8 as part of decoding, which is a lot
+    cheaper than decoding the whole image and resampling it afterwards. use the
+    smallest scale that's still at least as big as the final size. */
+    int width, height;
+    fitWithin(info.image_width, info.image_height, maxWidth, maxHeight, width, height);
+
+    info.scale_num = 1;
+    for (unsigned denom = 8; denom >= 1; denom /= 2) {
+        info.scale_denom = denom;
+        jpeg_calc_output_dimensions(&info);
+        if ((int) info.output_width >= width && (int) info.output_height >= height) {
+            break;
+        }
+    }
+
+    jpeg_start_decompress(&info);
+
+    image.width = (int) info.output_width;
+    image.height = (int) info.output_height;
+    image.channels = (int) info.output_components;
+    image.pixels.resize((size_t) image.width * image.height * image.channels);
+
+    const size_t stride = (size_t) image.width * image.channels;
+    while (info.output_scanline < info.output_height) {
+        JSAMPROW row = image.pixels.data() + info.output_scanline * stride;
+        jpeg_read_scanlines(&info, &row, 1);
+    }
+
+    jpeg_finish_decompress(&info);
+    jpeg_destroy_decompress(&info);
+
+    return image.channels == 3;
+}
+
+static bool decodePng(const std::vector<unsigned char>& data, bool alpha, Image& image) {
+    png_image png;
+    memset(&png, 0, sizeof(png));
+    png.version = PNG_IMAGE_VERSION;
+
+    if (!png_image_begin_read_from_memory(&png, data.data(), data.size())) {
+        return false;
+    }
+
+    if ((size_t) png.width * png.height > kMaxSourcePixels) {
+        png_image_free(&png);
+        return false;
+    }
+
+    /* jpegs can't do transparency, so we flatten onto white */
+    png.format = alpha ? PNG_FORMAT_RGBA : PNG_FORMAT_RGB;
+    png_color background = { 255, 255, 255 };
+
+    image.width = (int) png.width;
+    image.height = (int) png.height;
+    image.channels = (int) PNG_IMAGE_SAMPLE_CHANNELS(png.format);
+    image.pixels.resize(PNG_IMAGE_SIZE(png));
+
+    if (!png_image_finish_read(&png, &background, image.pixels.data(), 0, nullptr)) {
+        png_image_free(&png);
+        return false;
+    }
+
+    return true;
+}
+
+struct Contribution {
+    int first;
+    std::vector<float> weights;
+};
+
+/* box filter weights: each destination sample is the area-weighted average
+of the source samples it covers. */
+static std::vector<Contribution> contributions(int srcSize, int dstSize) {
+    std::vector<Contribution> result(dstSize);
+    const double scale = (double) srcSize / dstSize;
+
+    for (int i = 0; i < dstSize; i++) {
+        const double begin = i * scale;
+        const double end = std::min((double) srcSize, (i + 1) * scale);
+        const int first = (int) std::floor(begin);
+        const int last = std::min(srcSize, (int) std::ceil(end));
+
+        auto& c = result[i];
+        c.first = first;
+
+        float total = 0.0f;
+        for (int j = first; j < last; j++) {
+            const float weight = (float) (std::min(end, (double) j + 1) - std::max(begin, (double) j));
+            c.weights.push_back(weight);
+            total += weight;
+        }
+
+        for (auto& weight : c.weights) {
+            weight /= total;
+        }
+    }
+
+    return result;
+}
+
+static Image resize(const Image& src, int width, int height) {
+    const int channels = src.channels;
+    const auto horizontal = contributions(src.width, width);
+    const auto vertical = contributions(src.height, height);
+
+    /* horizontal pass: src.width x src.height -> width x src.height */
+    std::vector<float> temp((size_t) width * src.height * channels);
+    for (int y = 0; y < src.height; y++) {
+        const unsigned char* in = src.pixels.data() + (size_t) y * src.width * channels;
+        float* out = temp.data() + (size_t) y * width * channels;
+        for (int x = 0; x < width; x++) {
+            const auto& c = horizontal[x];
+            for (int ch = 0; ch < channels; ch++) {
+                float sum = 0.0f;
+                for (size_t i = 0; i < c.weights.size(); i++) {
+                    sum += c.weights[i] * in[(c.first + i) * channels + ch];
+                }
+                out[x * channels + ch] = sum;
+            }
+        }
+    }
+
+    /* vertical pass: width x src.height -> width x height */
+    Image result;
+    result.width = width;
+    result.height = height;
+    result.channels = channels;
+    result.pixels.resize((size_t) width * height * channels);
+
+    const size_t stride = (size_t) width * channels;
+    std::vector<float> row(stride);
+    for (int y = 0; y < height; y++) {
+        const auto& c = vertical[y];
+        std::fill(row.begin(), row.end(), 0.0f);
+        for (size_t i = 0; i < c.weights.size(); i++) {
+            const float weight = c.weights[i];
+            const float* in = temp.data() + (c.first + i) * stride;
+            for (size_t x = 0; x < stride; x++) {
+                row[x] += weight * in[x];
+            }
+        }
+        unsigned char* out = result.pixels.data() + y * stride;
+        for (size_t x = 0; x < stride; x++) {
+            out[x] = (unsigned char) std::min(255.0f, std::max(0.0f, row[x] + 0.5f));
+        }
+    }
+
+    return result;
+}
+
+static bool encodeJpeg(const Image& image, FILE* file) {
+    jpeg_compress_struct info;
+    JpegError error;
+    info.err = jpeg_std_error(&error.manager);
+    error.manager.error_exit = &jpegErrorExit;
+
+    if (setjmp(error.jump)) {
+        jpeg_destroy_compress(&info);
+        return false;
+    }
+
+    jpeg_create_compress(&info);
+    jpeg_stdio_dest(&info, file);
+
+    info.image_width = (JDIMENSION) image.width;
+    info.image_height = (JDIMENSION) image.height;
+    info.input_components = 3;
+    info.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&info);
+    jpeg_set_quality(&info, kJpegQuality, TRUE);
+    jpeg_start_compress(&info, TRUE);
+
+    const size_t stride = (size_t) image.width * image.channels;
+    while (info.next_scanline < info.image_height) {
+        JSAMPROW row = const_cast<unsigned char*>(image.pixels.data()) + info.next_scanline * stride;
+        jpeg_write_scanlines(&info, &row, 1);
+    }
+
+    jpeg_finish_compress(&info);
+    jpeg_destroy_compress(&info);
+    return true;
+}
+
+static bool encodePng(const Image& image, FILE* file) {
+    png_image png;
+    memset(&png, 0, sizeof(png));
+    png.version = PNG_IMAGE_VERSION;
+    png.width = (png_uint_32) image.width;
+    png.height = (png_uint_32) image.height;
+    png.format = image.channels == 4 ? PNG_FORMAT_RGBA : PNG_FORMAT_RGB;
+    return !!png_image_write_to_stdio(&png, file, 0, image.pixels.data(), 0, nullptr);
+}
+
+static bool createVariant(
+    const std::string& source,
+    const std::string& filename,
+    int maxWidth,
+    int maxHeight,
+    ThumbnailCache::Format format,
+    size_t& bytes)
+{
+    std::vector<unsigned char> data;
+    if (!readFile(source, data)) {
+        return false;
+    }
+
+    /* note: thumbnails are always stored with a .jpg extension, but they're
+    written verbatim from the file's tags, so they're frequently pngs. */
+    Image image;
+    bool decoded = false;
+    if (isJpeg(data)) {
+        decoded = decodeJpeg(data, maxWidth, maxHeight, image);
+    }
+    else if (isPng(data)) {
+        decoded = decodePng(data, format == ThumbnailCache::Format::Png, image);
+    }
+
+    if (!decoded) {
+        return false;
+    }
+
+    data.clear();
+    data.shrink_to_fit();
+
+    int width, height;
+    fitWithin(image.width, image.height, maxWidth, maxHeight, width, height);
+    if (width != image.width || height != image.height) {
+        image = resize(image, width, height);
+    }
+
+    /* write to a temp file, then move it into place, so a concurrent reader
+    never sees a partially written image */
+    const std::string temp = filename + ".tmp";
+    FILE* file = openFile(temp, "wb");
+    if (!file) {
+        return false;
+    }
+
+    const bool encoded = (format == ThumbnailCache::Format::Png)
+        ? encodePng(image, file)
+        : encodeJpeg(image, file);
+
+    fclose(file);
+
+    std::error_code ec;
+    if (encoded) {
+        fs::rename(fs::u8path(temp), fs::u8path(filename), ec);
+        if (!ec) {
+            bytes = (size_t) fs::file_size(fs::u8path(filename), ec);
+            if (!ec) {
+                return true;
+            }
+        }
+    }
+
+    fs::remove(fs::u8path(temp), ec);
+    return false;
+}
+
+#else
+
+static bool createVariant(
+    const std::string& source,
+    const std::string& filename,
+    int maxWidth,
+    int maxHeight,
+    ThumbnailCache::Format format,
+    size_t& bytes)
+{
+    return false;
+}
+
+#endif
+
+ThumbnailCache::ThumbnailCache(Context& context)
+: context(context)
+, exit(false)
+, totalBytes(0)
+, useCount(0)
+, indexLoaded(false) {
+}
+
+ThumbnailCache::~ThumbnailCache() {
+    this->Stop();
+}
+
+bool ThumbnailCache::Enabled() {
+#ifdef ENABLE_THUMBNAIL_RESIZING
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::string ThumbnailCache::Get(
+    const std::string& thumbnailId,
+    const std::string& source,
+    int width,
+    int height,
+    Format format)
+{
+    width = std::min(std::max(width, 0), kMaxDimension);
+    height = std::min(std::max(height, 0), kMaxDimension);
+
+    std::string version;
+    if (!Enabled() || (width == 0 && height == 0) || !sourceVersion(source, version)) {
+        return "";
+    }
+
+    const std::string key =
+        thumbnailId + "_" + version + "_" +
+        std::to_string(width) + "x" + std::to_string(height) + "." +
+        extension(format);
+
+    std::shared_future<bool> result;
+    std::string filename;
+
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+
+        this->LoadIndex();
+
+        if (this->path.empty()) {
+            return "";
+        }
+
+        filename = this->path + key;
+
+        auto it = this->index.find(key);
+        if (it != this->index.end()) {
+            std::error_code ec;
+            if (fs::exists(fs::u8path(filename), ec)) {
+                it->second.lastUsed = ++this->useCount;
+                return filename;
+            }
+            /* removed out from under us; make it again */
+            this->totalBytes -= std::min(this->totalBytes, it->second.bytes);
+            this->index.erase(it);
+        }
+
+        auto pendingIt = this->pending.find(key);
+        if (pendingIt != this->pending.end()) {
+            /* someone else already asked for this variant; wait for theirs */
+            result = pendingIt->second;
+        }
+        else {
+            if (this->jobs.size() >= kMaxQueuedJobs) {
+                return ""; /* too busy; the original will have to do */
+            }
+
+            auto job = std::make_shared<Job>();
+            job->key = key;
+            job->source = source;
+            job->filename = filename;
+            job->width = width;
+            job->height = height;
+            job->format = format;
+            result = job->result.get_future().share();
+
+            this->pending[key] = result;
+            this->jobs.push_back(job);
+            this->StartWorkers();
+            this->jobCondition.notify_one();
+        }
+    }
+
+    return result.get() ? filename : "";
+}
+
+size_t ThumbnailCache::PendingCount() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    return this->pending.size();
+}
+
+void ThumbnailCache::Stop() {
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->exit = true;
+    }
+
+    this->jobCondition.notify_all();
+
+    for (auto& thread : this->workers) {
+        thread.join();
+    }
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->workers.clear();
+    this->exit = false;
+}
+
+void ThumbnailCache::StartWorkers() {
+    /* called with the lock held */
+    if (this->workers.empty()) {
+        const int count = std::max(1, context.prefs->GetInt(
+            prefs::thumbnail_resize_threads.c_str(),
+            defaults::thumbnail_resize_threads));
+
+        for (int i = 0; i < count; i++) {
+            this->workers.emplace_back(std::thread([this]() {
+                this->WorkerThreadProc();
+            }));
+        }
+    }
+}
+
+void ThumbnailCache::WorkerThreadProc() {
+    while (true) {
+        std::shared_ptr<Job> job;
+
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+
+            while (!this->exit && this->jobs.empty()) {
+                this->jobCondition.wait(lock);
+            }
+
+            /* drain the queue before exiting, someone is waiting on each job */
+            if (this->jobs.empty()) {
+                return;
+            }
+
+            job = this->jobs.front();
+            this->jobs.pop_front();
+        }
+
+        size_t bytes = 0;
+        bool success = false;
+
+        try {
+            success = createVariant(
+                job->source, job->filename, job->width, job->height, job->format, bytes);
+        }
+        catch (...) {
+            /* likely std::bad_alloc for something enormous; serve the original */
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->pending.erase(job->key);
+            if (success) {
+                this->Add(job->key, bytes);
+            }
+        }
+
+        job->result.set_value(success);
+    }
+}
+
+void ThumbnailCache::LoadIndex() {
+    /* called with the lock held */
+    if (this->indexLoaded) {
+        return;
+    }
+
+    this->indexLoaded = true;
+
+    char buf[4096];
+    context.environment->GetPath(PathType::Data, buf, sizeof(buf));
+    std::string path = std::string(buf) + "/cache/thumbnails/";
+
+    std::error_code ec;
+    fs::create_directories(fs::u8path(path), ec);
+    if (ec) {
+        return;
+    }
+
+    this->path = path;
+
+    /* order what's already on disk by modification time; that's the best
+    approximation of last use we have after a restart. */
+    std::vector<std::pair<fs::file_time_type, std::pair<std::string, size_t>>> files;
+
+    for (auto& entry : fs::directory_iterator(fs::u8path(path), ec)) {
+        if (!entry.is_regular_file(ec)) {
+            continue;
+        }
+
+        const auto& file = entry.path();
+        if (file.extension().u8string() == ".tmp") {
+            fs::remove(file, ec); /* leftover from a crash */
+            continue;
+        }
+
+        const size_t bytes = (size_t) entry.file_size(ec);
+        const auto modified = entry.last_write_time(ec);
+        files.push_back({ modified, { file.filename().u8string(), bytes } });
+    }
+
+    std::sort(files.begin(), files.end());
+
+    for (auto& file : files) {
+        this->index[file.second.first] = { file.second.second, ++this->useCount };
+        this->totalBytes += file.second.second;
+    }
+
+    this->Prune();
+}
+
+void ThumbnailCache::Add(const std::string& key, size_t bytes) {
+    /* called with the lock held */
+    this->index[key] = { bytes, ++this->useCount };
+    this->totalBytes += bytes;
+    this->Prune();
+}
+
+void ThumbnailCache::Prune() {
+    /* called with the lock held */
+    const size_t budget = (size_t) std::max(0, context.prefs->GetInt(
+        prefs::thumbnail_cache_size_mb.c_str(),
+        defaults::thumbnail_cache_size_mb)) * 1024 * 1024;
+
+    if (this->totalBytes <= budget) {
+        return;
+    }
+
+    /* trim a bit below the budget so we're not sorting on every insert
+    once the cache is full */
+    const size_t target = budget - (budget / 10);
+
+    std::vector<std::pair<int64_t, std::string>> sorted;
+    sorted.reserve(this->index.size());
+    for (auto& kv : this->index) {
+        sorted.push_back({ kv.second.lastUsed, kv.first });
+    }
+
+    std::sort(sorted.begin(), sorted.end());
+
+    for (auto& item : sorted) {
+        if (this->totalBytes <= target) {
+            break;
+        }
+
+        std::error_code ec;
+        fs::remove(fs::u8path(this->path + item.second), ec);
+        if (!ec) {
+            auto it = this->index.find(item.second);
+            this->totalBytes -= std::min(this->totalBytes, it->second.bytes);
+            this->index.erase(it);
+        }
+    }
+}
@@ -0,0 +1,122 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Context.h"
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/* produces downscaled variants of the library's thumbnails for clients that
+only need small tiles (e.g. an album grid). variants are generated lazily,
+on a small, bounded pool of worker threads, and cached on disk keyed by
+(thumbnail id, source modification time and size, variant size, format); the
+cache is trimmed, least recently used first, once it exceeds a configurable
+byte budget. */
+class ThumbnailCache {
+    public:
+        enum class Format: int { Jpeg, Png };
+
+        ThumbnailCache(Context& context);
+        ~ThumbnailCache();
+
+        ThumbnailCache(const ThumbnailCache&) = delete;
+        ThumbnailCache& operator=(const ThumbnailCache&) = delete;
+
+        /* false if the plugin was built without image codecs */
+        static bool Enabled();
+
+        /* returns the filename of a variant of the thumbnail at `source` that
+        fits within `width` x `height` (either may be 0, meaning unbounded),
+        creating it if necessary. blocks until the variant is ready. returns an
+        empty string if one couldn't be produced; callers should serve the
+        original image instead. */
+        std::string Get(
+            const std::string& thumbnailId,
+            const std::string& source,
+            int width,
+            int height,
+            Format format);
+
+        /* number of variants queued or being generated */
+        size_t PendingCount();
+
+        /* waits for any in-progress work to finish, then stops the workers.
+        they'll be restarted on demand. */
+        void Stop();
+
+    private:
+        struct Job {
+            std::string key;
+            std::string source;
+            std::string filename;
+            int width, height;
+            Format format;
+            std::promise<bool> result;
+        };
+
+        struct Entry {
+            size_t bytes;
+            int64_t lastUsed;
+        };
+
+        void StartWorkers();
+        void WorkerThreadProc();
+        void LoadIndex();
+        void Add(const std::string& key, size_t bytes);
+        void Prune();
+
+        Context& context;
+
+        std::mutex mutex;
+        std::condition_variable jobCondition;
+        std::deque<std::shared_ptr<Job>> jobs;
+        std::unordered_map<std::string, std::shared_future<bool>> pending;
+        std::vector<std::thread> workers;
+        bool exit;
+
+        std::string path;
+        std::unordered_map<std::string, Entry> index;
+        size_t totalBytes;
+        int64_t useCount;
+        bool indexLoaded;
+};
@@ -0,0 +1,230 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "TranscodeCache.h"
+#include "Constants.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+using namespace musik::core::sdk;
+
+/* the list is ordered most recently used first; the map points into it so
+a hit can be moved to the front, and the oldest entry removed, in constant
+time. */
+struct IndexEntry {
+    std::list<std::string>::iterator position;
+    size_t bytes;
+};
+
+static std::mutex cacheMutex;
+static std::list<std::string> lru;
+static std::unordered_map<std::string, IndexEntry> entries;
+static size_t totalBytes = 0;
+static int64_t hits = 0, misses = 0;
+static bool loaded = false;
+
+static size_t byteBudget(Context& context) {
+    return (size_t) std::max(0, context.prefs->GetInt(
+        prefs::transcoder_cache_size_mb.c_str(),
+        defaults::transcoder_cache_size_mb)) * 1024 * 1024;
+}
+
+static size_t countLimit(Context& context) {
+    return (size_t) std::max(0, context.prefs->GetInt(
+        prefs::transcoder_cache_count.c_str(),
+        defaults::transcoder_cache_count));
+}
+
+static void removeEntry(std::unordered_map<std::string, IndexEntry>::iterator it) {
+    /* called with the lock held */
+    totalBytes -= std::min(totalBytes, it->second.bytes);
+    lru.erase(it->second.position);
+    entries.erase(it);
+}
+
+static void addEntry(const std::string& filename, size_t bytes) {
+    /* called with the lock held */
+    auto it = entries.find(filename);
+    if (it != entries.end()) {
+        removeEntry(it);
+    }
+    lru.push_front(filename);
+    entries[filename] = { lru.begin(), bytes };
+    totalBytes += bytes;
+}
+
+static void pruneEntries(Context& context) {
+    /* called with the lock held. files that can't be removed (e.g. because
+    they're still open on a platform that doesn't allow deleting them) are
+    skipped and tried again next time. */
+    const size_t budget = byteBudget(context);
+    const size_t maxCount = countLimit(context);
+
+    auto it = lru.end();
+    while (it != lru.begin() && (totalBytes > budget || entries.size() > maxCount)) {
+        --it;
+        std::error_code ec;
+        fs::remove(fs::u8path(*it), ec);
+        if (!ec) {
+            auto next = std::next(it);
+            removeEntry(entries.find(*it));
+            it = next;
+        }
+    }
+}
+
+static void loadEntries(Context& context, bool force) {
+    /* called with the lock held */
+    if (loaded && !force) {
+        return;
+    }
+
+    loaded = true;
+    lru.clear();
+    entries.clear();
+    totalBytes = 0;
+
+    const std::string path = TranscodeCache::Path(context);
+
+    /* order what's already on disk by modification time; that's the best
+    approximation of last use we have after a restart. */
+    std::vector<std::pair<fs::file_time_type, std::pair<std::string, size_t>>> files;
+
+    std::error_code ec;
+    for (auto& entry : fs::directory_iterator(fs::u8path(path), ec)) {
+        if (!entry.is_regular_file(ec)) {
+            continue;
+        }
+
+        const auto& file = entry.path();
+        if (file.extension().u8string() == ".tmp") {
+            fs::remove(file, ec); /* leftover from an interrupted transcode */
+            continue;
+        }
+
+        const size_t bytes = (size_t) entry.file_size(ec);
+        const auto modified = entry.last_write_time(ec);
+        files.push_back({ modified, { path + file.filename().u8string(), bytes } });
+    }
+
+    std::sort(files.begin(), files.end());
+
+    for (auto& file : files) {
+        addEntry(file.second.first, file.second.second);
+    }
+
+    pruneEntries(context);
+}
+
+std::string TranscodeCache::Path(Context& context) {
+    char buf[4096];
+    context.environment->GetPath(PathType::Data, buf, sizeof(buf));
+    std::string path = std::string(buf) + "/cache/transcoder/";
+    std::error_code ec;
+    fs::create_directories(fs::u8path(path), ec);
+    return path;
+}
+
+bool TranscodeCache::Enabled(Context& context) {
+    return byteBudget(context) > 0 && countLimit(context) > 0;
+}
+
+void TranscodeCache::Reset(Context& context) {
+    std::unique_lock<std::mutex> lock(cacheMutex);
+    loadEntries(context, true);
+}
+
+IDataStream* TranscodeCache::Open(Context& context, const std::string& filename) {
+    std::unique_lock<std::mutex> lock(cacheMutex);
+
+    loadEntries(context, false);
+
+    auto it = entries.find(filename);
+    if (it != entries.end()) {
+        /* opened with the lock held so the file can't be evicted out from
+        under us between the lookup and the open */
+        IDataStream* stream = context.environment->GetDataStream(filename.c_str(), OpenFlags::Read);
+        if (stream) {
+            lru.splice(lru.begin(), lru, it->second.position);
+            ++hits;
+
+            /* keep the modification time current so the order survives a
+            restart */
+            std::error_code ec;
+            fs::last_write_time(fs::u8path(filename), fs::file_time_type::clock::now(), ec);
+            return stream;
+        }
+        removeEntry(it); /* removed from disk out from under us */
+    }
+
+    ++misses;
+    return nullptr;
+}
+
+bool TranscodeCache::Contains(Context& context, const std::string& filename) {
+    std::unique_lock<std::mutex> lock(cacheMutex);
+    loadEntries(context, false);
+    return entries.find(filename) != entries.end();
+}
+
+void TranscodeCache::Add(Context& context, const std::string& filename) {
+    std::error_code ec;
+    const size_t bytes = (size_t) fs::file_size(fs::u8path(filename), ec);
+    if (ec) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(cacheMutex);
+    loadEntries(context, false);
+    addEntry(filename, bytes);
+    pruneEntries(context);
+}
+
+void TranscodeCache::Prune(Context& context) {
+    std::unique_lock<std::mutex> lock(cacheMutex);
+    loadEntries(context, false);
+    pruneEntries(context);
+}
+
+TranscodeCache::Stats TranscodeCache::GetStats(Context& context) {
+    std::unique_lock<std::mutex> lock(cacheMutex);
+    return { entries.size(), totalBytes, byteBudget(context), hits, misses };
+}
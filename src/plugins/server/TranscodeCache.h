@@ -0,0 +1,89 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Context.h"
+#include <musikcore/sdk/IDataStream.h>
+#include <string>
+
+/* in-memory index of the completed transcodes in the on-disk cache. the
+index is built from the cache directory the first time it's used, then kept
+up to date as transcodes finish, so lookups and eviction never need to scan
+the directory. entries are evicted least recently used first once the cache
+exceeds its byte budget (or its file count limit). */
+class TranscodeCache {
+    public:
+        using IDataStream = musik::core::sdk::IDataStream;
+
+        struct Stats {
+            size_t entries;
+            size_t bytes;
+            size_t budget;
+            int64_t hits;
+            int64_t misses;
+        };
+
+        /* the directory cached transcodes are written to, with a trailing
+        separator. created if it doesn't exist. */
+        static std::string Path(Context& context);
+
+        /* false if the user has disabled the cache */
+        static bool Enabled(Context& context);
+
+        /* removes leftover temp files and (re)builds the index from disk */
+        static void Reset(Context& context);
+
+        /* opens the cached transcode with the specified filename, marking it
+        most recently used. returns nullptr (and counts a miss) if it's not
+        in the cache. */
+        static IDataStream* Open(Context& context, const std::string& filename);
+
+        /* true if the specified file is in the cache. doesn't count as a
+        hit or a miss, or affect eviction order. */
+        static bool Contains(Context& context, const std::string& filename);
+
+        /* records a newly completed transcode, evicting older entries as
+        necessary to stay within budget */
+        static void Add(Context& context, const std::string& filename);
+
+        /* evicts entries until the cache is within its limits */
+        static void Prune(Context& context);
+
+        static Stats GetStats(Context& context);
+
+    private:
+        TranscodeCache() { }
+        ~TranscodeCache() { }
+};
@@ -0,0 +1,259 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "TranscodePrefetcher.h"
+#include "Constants.h"
+#include "Transcoder.h"
+#include "TranscodeSession.h"
+#include "Util.h"
+
+#include <algorithm>
+
+using namespace musik::core::sdk;
+
+/* older requests are dropped in favor of newer ones; they're only hints */
+static const size_t kMaxQueuedRequests = 8;
+static const size_t kMaxQueuedJobs = 16;
+
+static std::string jobKey(const std::string& uri, size_t bitrate, const std::string& format) {
+    return uri + "|" + std::to_string(bitrate) + "|" + format;
+}
+
+TranscodePrefetcher::TranscodePrefetcher(Context& context, Snapshots& snapshots)
+: context(context)
+, snapshots(snapshots)
+, exit(false) {
+}
+
+TranscodePrefetcher::~TranscodePrefetcher() {
+    this->Stop();
+}
+
+void TranscodePrefetcher::OnTrackRequested(int64_t trackId, size_t bitrate, const std::string& format) {
+    const int count = context.prefs->GetInt(
+        prefs::transcoder_prefetch_count.c_str(),
+        defaults::transcoder_prefetch_count);
+
+    if (count <= 0 || bitrate == 0) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    if (this->exit) {
+        return;
+    }
+
+    if (this->requests.size() >= kMaxQueuedRequests) {
+        this->requests.pop_front();
+    }
+
+    this->requests.push_back({ trackId, bitrate, format });
+    this->StartWorkers();
+    this->jobCondition.notify_one();
+}
+
+size_t TranscodePrefetcher::PendingCount() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    return this->pending.size();
+}
+
+void TranscodePrefetcher::Stop() {
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->exit = true;
+        this->requests.clear();
+        this->jobs.clear();
+        for (auto stream : this->running) {
+            stream->Interrupt();
+        }
+    }
+
+    this->jobCondition.notify_all();
+
+    for (auto& thread : this->workers) {
+        thread.join();
+    }
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->workers.clear();
+    this->pending.clear();
+    this->exit = false;
+}
+
+void TranscodePrefetcher::StartWorkers() {
+    /* called with the lock held */
+    if (this->workers.empty()) {
+        const int count = std::max(1, context.prefs->GetInt(
+            prefs::transcoder_prefetch_threads.c_str(),
+            defaults::transcoder_prefetch_threads));
+
+        for (int i = 0; i < count; i++) {
+            this->workers.emplace_back(std::thread([this]() {
+                this->WorkerThreadProc();
+            }));
+        }
+    }
+}
+
+void TranscodePrefetcher::WorkerThreadProc() {
+    while (true) {
+        Request request;
+        Job job;
+        bool hasRequest = false;
+
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+
+            while (!this->exit && this->requests.empty() && this->jobs.empty()) {
+                this->jobCondition.wait(lock);
+            }
+
+            /* nobody is waiting on any of this; just drop it */
+            if (this->exit) {
+                return;
+            }
+
+            /* plan before transcoding so the queue reflects what clients are
+            listening to now */
+            if (!this->requests.empty()) {
+                request = this->requests.front();
+                this->requests.pop_front();
+                hasRequest = true;
+            }
+            else {
+                job = this->jobs.front();
+                this->jobs.pop_front();
+            }
+        }
+
+        if (hasRequest) {
+            this->Plan(request);
+        }
+        else {
+            this->Run(job);
+        }
+    }
+}
+
+void TranscodePrefetcher::Plan(const Request& request) {
+    const size_t count = (size_t) std::max(0, context.prefs->GetInt(
+        prefs::transcoder_prefetch_count.c_str(),
+        defaults::transcoder_prefetch_count));
+
+    auto upcoming = this->Upcoming(request.trackId, count);
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    for (auto& uri : upcoming) {
+        const std::string key = jobKey(uri, request.bitrate, request.format);
+        if (this->jobs.size() < kMaxQueuedJobs && this->pending.find(key) == this->pending.end()) {
+            this->pending.insert(key);
+            this->jobs.push_back({ key, uri, request.bitrate, request.format });
+        }
+    }
+
+    this->jobCondition.notify_all();
+}
+
+void TranscodePrefetcher::Run(const Job& job) {
+    const int maxActiveTranscoders = context.prefs->GetInt(
+        prefs::transcoder_max_active_count.c_str(),
+        defaults::transcoder_max_active_count);
+
+    /* only use spare capacity; if clients are keeping the transcoders busy
+    skip it, they'll ask for it soon enough anyway. */
+    TranscodeSessionStream* stream = nullptr;
+    if (Transcoder::GetActiveCount() < maxActiveTranscoders) {
+        stream = Transcoder::Prefetch(this->context, job.uri, job.bitrate, job.format);
+    }
+
+    if (stream) {
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            if (this->exit) {
+                stream->Interrupt();
+            }
+            this->running.insert(stream);
+        }
+
+        stream->WaitForCompletion();
+
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->running.erase(stream);
+        }
+
+        stream->Release();
+    }
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->pending.erase(job.key);
+}
+
+std::vector<std::string> TranscodePrefetcher::Upcoming(int64_t trackId, size_t count) {
+    std::vector<std::string> result;
+
+    auto collect = [&result, trackId, count](ITrackList* tracks) -> bool {
+        const int index = tracks->IndexOf(trackId);
+        if (index < 0) {
+            return false;
+        }
+
+        for (size_t i = (size_t) index + 1; i < tracks->Count() && result.size() < count; i++) {
+            ITrack* track = tracks->GetTrack(i);
+            if (track) {
+                const std::string filename = GetMetadataString(track, key::filename);
+                track->Release();
+                if (filename.size()) {
+                    result.push_back(filename);
+                }
+            }
+        }
+
+        return true;
+    };
+
+    /* streaming clients usually play from a snapshot of the play queue; if
+    the track isn't in one, try the play queue itself. */
+    if (!this->snapshots.Find(collect) && this->context.playback) {
+        ITrackList* playQueue = this->context.playback->Clone();
+        if (playQueue) {
+            collect(playQueue);
+            playQueue->Release();
+        }
+    }
+
+    return result;
+}
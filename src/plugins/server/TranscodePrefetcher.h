@@ -0,0 +1,107 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Context.h"
+#include "Snapshots.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+class TranscodeSessionStream;
+
+/* transcodes the tracks a streaming client is likely to ask for next, so
+they're already in the transcode cache when it does. whenever a client
+requests a transcoded track we look for it in the snapshots clients have
+taken of the play queue (and the play queue itself), and queue up the next
+few tracks at the same bitrate and format. the work is done on a small,
+bounded pool of threads, in background transcode sessions that yield to
+real requests. */
+class TranscodePrefetcher {
+    public:
+        TranscodePrefetcher(Context& context, Snapshots& snapshots);
+        ~TranscodePrefetcher();
+
+        TranscodePrefetcher(const TranscodePrefetcher&) = delete;
+        TranscodePrefetcher& operator=(const TranscodePrefetcher&) = delete;
+
+        /* called when a client starts streaming the track with the specified
+        id, transcoded to `format` at `bitrate`. returns immediately. */
+        void OnTrackRequested(int64_t trackId, size_t bitrate, const std::string& format);
+
+        /* number of tracks queued or being transcoded */
+        size_t PendingCount();
+
+        /* abandons queued and in-progress work and stops the workers. they'll
+        be restarted on demand. */
+        void Stop();
+
+    private:
+        struct Request {
+            int64_t trackId;
+            size_t bitrate;
+            std::string format;
+        };
+
+        struct Job {
+            std::string key;
+            std::string uri;
+            size_t bitrate;
+            std::string format;
+        };
+
+        void StartWorkers();
+        void WorkerThreadProc();
+        void Plan(const Request& request);
+        void Run(const Job& job);
+        std::vector<std::string> Upcoming(int64_t trackId, size_t count);
+
+        Context& context;
+        Snapshots& snapshots;
+
+        std::mutex mutex;
+        std::condition_variable jobCondition;
+        std::deque<Request> requests;
+        std::deque<Job> jobs;
+        std::set<std::string> pending;
+        std::set<TranscodeSessionStream*> running;
+        std::vector<std::thread> workers;
+        bool exit;
+};
@@ -0,0 +1,408 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#include "TranscodeSession.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+
+#define BUFFER_SIZE 8192
+
+using namespace musik::core::sdk;
+
+using PositionType = TranscodeSession::PositionType;
+
+/* output is buffered in fixed size pages. only the most recent pages are
+kept in memory, which is where readers that are keeping up with the encoder
+read from; older pages are moved to an anonymous temporary file, and read back
+from there by readers that seek backwards or fall behind. */
+static const size_t kPageSize = 512 * 1024;
+static const size_t kMaxMemoryPages = 8;
+
+/* how long a background session sleeps between chunks while a foreground
+transcode is running */
+static const int kBackgroundThrottleMillis = 20;
+
+static std::atomic<int> foregroundCount(0);
+static std::atomic<int> backgroundCount(0);
+
+static std::mutex sessionsMutex;
+static std::unordered_map<std::string, std::weak_ptr<TranscodeSession>> sessions;
+
+/* the spill file can grow past 2GB, and `long` is 32 bits on windows */
+static bool seekTo(FILE* file, uint64_t offset) {
+#ifdef WIN32
+    return _fseeki64(file, (__int64) offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, (off_t) offset, SEEK_SET) == 0;
+#endif
+}
+
+/* returns a reader attached to the running session with the specified key,
+or nullptr if there isn't one. sessionsMutex must be held. */
+IDataStream* TranscodeSession::AttachTo(const std::string& key, bool background) {
+    auto it = sessions.find(key);
+    if (it != sessions.end()) {
+        auto session = it->second.lock();
+        if (session && session->Attach()) {
+            if (!background) {
+                session->Promote();
+            }
+            return new TranscodeSessionStream(session);
+        }
+        sessions.erase(it);
+    }
+    return nullptr;
+}
+
+IDataStream* TranscodeSession::Open(
+    const std::string& key,
+    size_t bitrate,
+    Factory factory,
+    bool background)
+{
+    {
+        std::unique_lock<std::mutex> lock(sessionsMutex);
+        IDataStream* reader = AttachTo(key, background);
+        if (reader) {
+            return reader;
+        }
+    }
+
+    /* opening the decoder and cache file may be slow; don't make every
+    other request wait on it */
+    TranscodingAudioDataStream* producer = factory ? factory() : nullptr;
+
+    if (!producer || producer->Length() < 0) {
+        return producer;
+    }
+
+    std::unique_lock<std::mutex> lock(sessionsMutex);
+
+    /* someone else may have started the same transcode in the meantime; if
+    so, use theirs. ours hasn't produced anything yet, so releasing it just
+    removes its empty temp file. */
+    IDataStream* reader = AttachTo(key, background);
+    if (reader) {
+        producer->Release();
+        return reader;
+    }
+
+    std::shared_ptr<TranscodeSession> session(new TranscodeSession(key, producer, bitrate));
+    session->background = background;
+    ++(background ? backgroundCount : foregroundCount);
+    session->Attach();
+    sessions[key] = session;
+    session->Start();
+
+    return new TranscodeSessionStream(session);
+}
+
+bool TranscodeSession::Active(const std::string& key) {
+    std::unique_lock<std::mutex> lock(sessionsMutex);
+    auto it = sessions.find(key);
+    return it != sessions.end() && !it->second.expired();
+}
+
+int TranscodeSession::BackgroundCount() {
+    return backgroundCount.load();
+}
+
+TranscodeSession::TranscodeSession(
+    const std::string& key,
+    TranscodingAudioDataStream* producer,
+    size_t bitrate)
+: key(key)
+, uri(producer->Uri())
+, type(producer->Type())
+, producer(producer)
+, spill(std::tmpfile())
+, firstPage(0)
+, total(0)
+, estimatedLength(producer->Length())
+, abandonAt(0)
+, readers(0)
+, finished(false)
+, complete(false)
+, stopping(false)
+, background(false) {
+    /* same allowance TranscodingAudioDataStream gives itself when it's
+    closed before reaching the end: about 5 seconds of audio. */
+    this->detachTolerance = (size_t)(5.0 * 1000.0 * (float) bitrate / 8.0);
+}
+
+TranscodeSession::~TranscodeSession() {
+    if (this->spill) {
+        fclose(this->spill);
+    }
+}
+
+bool TranscodeSession::Attach() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->stopping && !this->complete) {
+        return false;
+    }
+    ++this->readers;
+    return true;
+}
+
+void TranscodeSession::Detach() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (--this->readers == 0) {
+        this->abandonAt = this->total + this->detachTolerance;
+    }
+}
+
+void TranscodeSession::Promote() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->background) {
+        this->background = false;
+        --backgroundCount;
+        ++foregroundCount;
+    }
+}
+
+void TranscodeSession::Start() {
+    auto self = shared_from_this();
+    std::thread([self]() {
+        self->ThreadProc();
+    }).detach();
+}
+
+void TranscodeSession::ThreadProc() {
+    char buffer[BUFFER_SIZE];
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            if (this->readers == 0 && this->total >= this->abandonAt) {
+                this->stopping = true;
+                break;
+            }
+        }
+
+        PositionType count = this->producer->Read(buffer, sizeof(buffer));
+
+        std::unique_lock<std::mutex> lock(this->mutex);
+
+        if (count <= 0) {
+            this->stopping = true;
+            this->complete = this->producer->Eof();
+            break;
+        }
+
+        this->Append(buffer, (size_t) count);
+        this->dataAvailable.notify_all();
+        const bool throttle = this->background && foregroundCount > 0;
+        lock.unlock();
+
+        if (throttle) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(kBackgroundThrottleMillis));
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+
+    /* if the producer didn't finish this will remove its partially written
+    cache file. */
+    this->producer->Release();
+    this->producer = nullptr;
+
+    {
+        std::unique_lock<std::mutex> lock(sessionsMutex);
+        auto it = sessions.find(this->key);
+        if (it != sessions.end()) {
+            auto existing = it->second.lock();
+            if (!existing || existing.get() == this) {
+                sessions.erase(it);
+            }
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    --(this->background ? backgroundCount : foregroundCount);
+    this->finished = true;
+    this->dataAvailable.notify_all();
+}
+
+void TranscodeSession::Append(const char* buffer, size_t count) {
+    while (count > 0) {
+        if (this->pages.empty() || this->pages.back().size() == kPageSize) {
+            this->pages.emplace_back();
+            this->pages.back().reserve(kPageSize);
+        }
+
+        auto& page = this->pages.back();
+        const size_t copied = std::min(count, kPageSize - page.size());
+        page.insert(page.end(), buffer, buffer + copied);
+        buffer += copied;
+        count -= copied;
+        this->total += copied;
+    }
+
+    /* page out everything but the most recent pages. if the temporary file
+    can't be created or written the remaining pages just stay in memory. */
+    while (this->spill && this->pages.size() > kMaxMemoryPages) {
+        auto& page = this->pages.front();
+        if (!seekTo(this->spill, (uint64_t) this->firstPage * kPageSize) ||
+            fwrite(page.data(), 1, page.size(), this->spill) != page.size())
+        {
+            break;
+        }
+        this->pages.pop_front();
+        ++this->firstPage;
+    }
+}
+
+PositionType TranscodeSession::Read(
+    PositionType offset,
+    void* buffer,
+    PositionType count,
+    std::atomic<bool>& interrupted)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    while (!interrupted && !this->finished && this->total <= (size_t) offset) {
+        this->dataAvailable.wait(lock);
+    }
+
+    if (offset < 0 || (size_t) offset >= this->total) {
+        return 0;
+    }
+
+    /* reads never cross a page boundary; callers just read again */
+    const size_t pageIndex = (size_t) offset / kPageSize;
+    const size_t pageOffset = (size_t) offset % kPageSize;
+    const size_t available = std::min(
+        (size_t) count, std::min(kPageSize - pageOffset, this->total - (size_t) offset));
+
+    if (pageIndex >= this->firstPage) {
+        auto& page = this->pages[pageIndex - this->firstPage];
+        memcpy(buffer, page.data() + pageOffset, available);
+        return (PositionType) available;
+    }
+
+    if (!seekTo(this->spill, (uint64_t) offset)) {
+        return 0;
+    }
+
+    return (PositionType) fread(buffer, 1, available, this->spill);
+}
+
+bool TranscodeSession::Wait(std::atomic<bool>& interrupted) {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (!interrupted && !this->finished) {
+        this->dataAvailable.wait(lock);
+    }
+    return this->finished && this->complete;
+}
+
+bool TranscodeSession::Finished(PositionType offset) {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    return this->finished && (size_t) offset >= this->total;
+}
+
+PositionType TranscodeSession::Available() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    return (PositionType) this->total;
+}
+
+long TranscodeSession::Length() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    return this->complete ? (long) this->total : this->estimatedLength;
+}
+
+void TranscodeSession::Wake() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->dataAvailable.notify_all();
+}
+
+TranscodeSessionStream::TranscodeSessionStream(std::shared_ptr<TranscodeSession> session)
+: session(session)
+, position(0)
+, interrupted(false) {
+}
+
+TranscodeSessionStream::~TranscodeSessionStream() {
+    this->session->Detach();
+}
+
+bool TranscodeSessionStream::WaitForCompletion() {
+    return this->session->Wait(this->interrupted);
+}
+
+PositionType TranscodeSessionStream::Available() {
+    return this->session->Available();
+}
+
+bool TranscodeSessionStream::SetPosition(PositionType position) {
+    if (position < 0) {
+        return false;
+    }
+    this->position = position;
+    return true;
+}
+
+bool TranscodeSessionStream::Close() {
+    delete this;
+    return true;
+}
+
+void TranscodeSessionStream::Interrupt() {
+    this->interrupted = true;
+    this->session->Wake();
+}
+
+void TranscodeSessionStream::Release() {
+    delete this;
+}
+
+PositionType TranscodeSessionStream::Read(void *buffer, PositionType readBytes) {
+    PositionType count = this->session->Read(
+        this->position, buffer, readBytes, this->interrupted);
+    this->position += count;
+    return count;
+}
+
+bool TranscodeSessionStream::Eof() {
+    return this->session->Finished(this->position);
+}
+
+long TranscodeSessionStream::Length() {
+    return this->session->Length();
+}
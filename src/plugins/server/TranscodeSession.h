@@ -0,0 +1,161 @@
+//////////////////////////////////////////////////////////////////////////////
+//
+// Copyright (c) 2004-2023 musikcube team
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright notice,
+//      this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the author nor the names of other contributors may
+//      be used to endorse or promote products derived from this software
+//      without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "TranscodingAudioDataStream.h"
+#include <musikcore/sdk/IDataStream.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+/* a single in-progress transcode that may be shared by any number of
+readers. the output of the underlying TranscodingAudioDataStream is pulled on
+a background thread and buffered, with only the most recent part kept in memory
+and the rest paged out to a temporary file; readers attach to the buffer and
+only block when they've caught up with the encoder. readers may seek anywhere:
+bytes that have already been produced are served immediately, later ones as
+soon as the encoder reaches them. if every reader goes away
+the transcode is allowed to run a few more seconds, then abandoned, just like
+a lone TranscodingAudioDataStream that's been closed early.
+
+sessions started speculatively (see TranscodePrefetcher) run in the background:
+they back off while any foreground transcode is running, and don't count
+against the active transcoder limit. a background session is promoted as soon
+as a real request attaches to it. */
+class TranscodeSession: public std::enable_shared_from_this<TranscodeSession> {
+    public:
+        using IDataStream = musik::core::sdk::IDataStream;
+        using PositionType = musik::core::sdk::PositionType;
+        using Factory = std::function<TranscodingAudioDataStream*()>;
+
+        /* returns a new reader for the transcode identified by `key`. if one
+        is already running the reader is attached to it; otherwise `factory`
+        is called to create the stream that will produce it. streams with an
+        indeterminate length can't be buffered, so they're returned as-is,
+        and not shared. returns nullptr if `factory` does. */
+        static IDataStream* Open(
+            const std::string& key,
+            size_t bitrate,
+            Factory factory,
+            bool background = false);
+
+        /* true if a transcode with the specified key is running */
+        static bool Active(const std::string& key);
+
+        /* number of running sessions that are still in the background */
+        static int BackgroundCount();
+
+        ~TranscodeSession();
+
+        PositionType Read(PositionType offset, void* buffer, PositionType count, std::atomic<bool>& interrupted);
+        bool Wait(std::atomic<bool>& interrupted);
+        bool Finished(PositionType offset);
+        PositionType Available();
+        long Length();
+        void Wake();
+        void Detach();
+
+        const std::string& Uri() const { return this->uri; }
+        const std::string& Type() const { return this->type; }
+
+    private:
+        TranscodeSession(const std::string& key, TranscodingAudioDataStream* producer, size_t bitrate);
+
+        static IDataStream* AttachTo(const std::string& key, bool background);
+
+        bool Attach();
+        void Append(const char* buffer, size_t count);
+        void Promote();
+        void Start();
+        void ThreadProc();
+
+        std::string key, uri, type;
+        TranscodingAudioDataStream* producer;
+        std::mutex mutex;
+        std::condition_variable dataAvailable;
+        std::deque<std::vector<char>> pages;
+        FILE* spill;
+        size_t firstPage, total;
+        long estimatedLength;
+        size_t detachTolerance, abandonAt;
+        int readers;
+        bool finished, complete, stopping, background;
+};
+
+/* one reader's view of a TranscodeSession */
+class TranscodeSessionStream: public musik::core::sdk::IDataStream {
+    public:
+        using PositionType = musik::core::sdk::PositionType;
+        using OpenFlags = musik::core::sdk::OpenFlags;
+
+        TranscodeSessionStream(std::shared_ptr<TranscodeSession> session);
+
+        virtual ~TranscodeSessionStream();
+
+        /* blocks until the transcode has finished. returns true if it ran to
+        completion, false if it failed or was interrupted. */
+        bool WaitForCompletion();
+
+        /* number of bytes produced so far */
+        PositionType Available();
+
+        virtual bool Open(const char *uri, OpenFlags flags) override { return true; }
+        virtual bool Close() override;
+        virtual void Interrupt() override;
+        virtual void Release() override;
+        virtual bool Readable() override { return true; }
+        virtual bool Writable() override { return false; }
+        virtual PositionType Read(void *buffer, PositionType readBytes) override;
+        virtual PositionType Write(void *buffer, PositionType writeBytes) override { return 0; }
+        virtual bool SetPosition(PositionType position) override;
+        virtual PositionType Position() override { return this->position; }
+        virtual bool Seekable() override { return true; }
+        virtual bool Eof() override;
+        virtual long Length() override;
+        virtual const char* Type() override { return this->session->Type().c_str(); }
+        virtual const char* Uri() override { return this->session->Uri().c_str(); }
+        virtual bool CanPrefetch() override { return true; }
+
+    private:
+        std::shared_ptr<TranscodeSession> session;
+        PositionType position;
+        std::atomic<bool> interrupted;
+};
@@ -35,20 +35,20 @@
 #include "Transcoder.h"
 #include "BlockingTranscoder.h"
 #include "TranscodingAudioDataStream.h"
+#include "TranscodeCache.h"
+#include "TranscodeSession.h"
 #include "Constants.h"
 #include "Util.h"
 #include <musikcore/sdk/IBlockingEncoder.h>
 
+#include <algorithm>
 #include <thread>
 #include <set>
-#include <map>
 #include <filesystem>
 #include <functional>
-#include <chrono>
 
 namespace fs = std::filesystem;
 
-using namespace std::chrono;
 using namespace musik::core::sdk;
 
 std::mutex transcoderMutex;
@@ -73,82 +73,26 @@ static T* getTypedEncoder(Context& context, const std::string& format) {
     return nullptr;
 }
 
-static size_t lastWriteTime(const fs::path& path) {
-    std::error_code ec;
-    return (size_t)duration_cast<milliseconds>(
-        std::filesystem::last_write_time(path, ec).time_since_epoch()).count();
-}
-
-static size_t lastWriteTime(const std::string& path) {
-    return lastWriteTime(fs::u8path(path));
-}
-
-static std::filesystem::file_time_type touch(const std::string& path) {
-    auto fsPath = fs::u8path(path);
-    try {
-        std::chrono::time_point now = fs::file_time_type::clock::now();
-        fs::last_write_time(fsPath, now);
-    }
-    catch (...) {
-    }
-
-    return fs::last_write_time(fsPath);
-}
-
-static std::string cachePath(Context& context) {
-    char buf[4096];
-    context.environment->GetPath(PathType::Data, buf, sizeof(buf));
-    std::string path = std::string(buf) + "/cache/transcoder/";
-	fs::path fsPath(fs::u8path(path));
-    if (!fs::exists(fsPath)) {
-        fs::create_directories(fsPath);
-    }
-    return path;
-}
-
-static void iterateTranscodeCache(Context& context, std::function<void(fs::path)> cb) {
-    if (cb) {
-        fs::directory_iterator end;
-        fs::directory_iterator file(fs::u8path(cachePath(context)));
-        while (file != end) {
-            if (!is_directory(file->status())) {
-                cb(file->path());
-            }
-            ++file;
-        }
-    }
-}
-
-void Transcoder::RemoveTempTranscodeFiles(Context& context) {
-    iterateTranscodeCache(context, [](fs::path p) {
-        if (p.extension().u8string() == ".tmp") {
-            std::error_code ec;
-            fs::remove(p, ec);
-        }
-    });
+/* identifies a transcode; requests with the same key can share one */
+static std::string sessionKey(
+    const std::string& uri,
+    size_t bitrate,
+    const std::string& format)
+{
+    return uri + "|" + std::to_string(bitrate) + "|" + format;
 }
 
-void Transcoder::PruneTranscodeCache(Context& context) {
-    std::map<time_t, fs::path> sorted;
-
-    iterateTranscodeCache(context, [&sorted](fs::path p) {
-        sorted[lastWriteTime(p)] = p;
-    });
-
-    int maxSize = context.prefs->GetInt(
-        prefs::transcoder_cache_count.c_str(),
-        defaults::transcoder_cache_count);
-
-    int extra = (int) sorted.size() - (maxSize - 1);
-    auto it = sorted.begin();
-    while (extra > 0 && it != sorted.end()) {
-        auto p = it->second;
-        std::error_code ec;
-        if (fs::remove(p, ec)) {
-            --extra;
-        }
-        ++it;
-    }
+static std::string getFinalFilename(
+    Context& context,
+    const std::string& uri,
+    size_t bitrate,
+    const std::string& format)
+{
+    return std::string(
+        TranscodeCache::Path(context) +
+        std::to_string(std::hash<std::string>()(uri)) +
+        "-" + std::to_string(bitrate) +
+        "." + format);
 }
 
 static void getTempAndFinalFilename(
@@ -159,11 +103,7 @@ static void getTempAndFinalFilename(
     std::string& tempFn,
     std::string& finalFn)
 {
-    finalFn = std::string(
-        cachePath(context) +
-        std::to_string(std::hash<std::string>()(uri)) +
-        "-" + std::to_string(bitrate) +
-        "." + format);
+    finalFn = getFinalFilename(context, uri, bitrate, format);
 
     do {
         tempFn = finalFn + "." + std::to_string(rand()) + ".tmp";
@@ -213,38 +153,50 @@ IDataStream* Transcoder::TranscodeOnDemand(
     std::string expectedFilename, tempFilename;
     getTempAndFinalFilename(context, uri, bitrate, format, tempFilename, expectedFilename);
 
-    if (fs::exists(fs::u8path(expectedFilename))) {
-        touch(expectedFilename);
-        return context.environment->GetDataStream(expectedFilename.c_str(), OpenFlags::Read);
+    IDataStream* cached = TranscodeCache::Open(context, expectedFilename);
+    if (cached) {
+        encoder->Release();
+        return cached;
     }
 
-    /* if it doesn't exist, check to see if the cache is enabled. */
-    int cacheCount = context.prefs->GetInt(
-        prefs::transcoder_cache_count.c_str(),
-        defaults::transcoder_cache_count);
+    /* if it's already being transcoded, attach to the one in progress instead
+    of starting another. otherwise start a new one, writing it to the cache if
+    the cache is enabled. */
+    bool created = false;
 
-    TranscodingAudioDataStream* transcoderStream = nullptr;
+    IDataStream* stream = TranscodeSession::Open(
+        sessionKey(uri, bitrate, format),
+        bitrate,
+        [&]() -> TranscodingAudioDataStream* {
+            created = true;
 
-    if (cacheCount > 0) {
-        PruneTranscodeCache(context);
+            if (!TranscodeCache::Enabled(context)) {
+                return new TranscodingAudioDataStream(context, encoder, uri, bitrate, format);
+            }
 
-        transcoderStream = new TranscodingAudioDataStream(
-            context, encoder, uri, tempFilename, expectedFilename, bitrate, format);
+            auto transcoderStream = new TranscodingAudioDataStream(
+                context, encoder, uri, tempFilename, expectedFilename, bitrate, format);
 
-        /* if the stream has an indeterminate length, close it down and
-        re-open it without caching options; we don't want to fill up
-        the storage disk */
-        if (transcoderStream->Length() < 0) {
-            transcoderStream->Release();
-            delete transcoderStream;
-            transcoderStream = new TranscodingAudioDataStream(context, encoder, uri, bitrate, format);
-        }
-    }
-    else {
-        transcoderStream = new TranscodingAudioDataStream(context, encoder, uri, bitrate, format);
+            /* if the stream has an indeterminate length, close it down and
+            re-open it without caching options; we don't want to fill up
+            the storage disk */
+            if (transcoderStream->Length() < 0) {
+                transcoderStream->Release();
+                encoder = getTypedEncoder<IStreamingEncoder>(context, format);
+                if (!encoder) {
+                    return nullptr;
+                }
+                transcoderStream = new TranscodingAudioDataStream(context, encoder, uri, bitrate, format);
+            }
+
+            return transcoderStream;
+        });
+
+    if (!created) {
+        encoder->Release();
     }
 
-    return transcoderStream;
+    return stream;
 }
 
 IDataStream* Transcoder::TranscodeAndWait(
@@ -267,33 +219,62 @@ IDataStream* Transcoder::TranscodeAndWait(
     getTempAndFinalFilename(context, uri, bitrate, format, tempFilename, expectedFilename);
 
     /* already exists? */
-    if (fs::exists(fs::u8path(expectedFilename))) {
-        touch(expectedFilename);
-        return context.environment->GetDataStream(expectedFilename.c_str(), OpenFlags::Read);
+    IDataStream* cached = TranscodeCache::Open(context, expectedFilename);
+    if (cached) {
+        encoder->Release();
+        return cached;
     }
 
     IStreamingEncoder* audioStreamEncoder = dynamic_cast<IStreamingEncoder*>(encoder);
     if (audioStreamEncoder) {
-        TranscodingAudioDataStream* transcoderStream = new TranscodingAudioDataStream(
-            context, audioStreamEncoder, uri, tempFilename, expectedFilename, bitrate, format);
-
-        /* transcoders with a negative length have an indeterminate duration, so
-        we disallow waiting for them because they may never finish */
-        if (transcoderStream->Length() < 0) {
-            transcoderStream->Release();
-            delete transcoderStream;
+        /* share the transcode with anyone else that's asked for it */
+        bool created = false;
+
+        IDataStream* stream = TranscodeSession::Open(
+            sessionKey(uri, bitrate, format),
+            bitrate,
+            [&]() -> TranscodingAudioDataStream* {
+                created = true;
+
+                auto transcoderStream = new TranscodingAudioDataStream(
+                    context, audioStreamEncoder, uri, tempFilename, expectedFilename, bitrate, format);
+
+                /* transcoders with a negative length have an indeterminate duration, so
+                we disallow waiting for them because they may never finish */
+                if (transcoderStream->Length() < 0) {
+                    transcoderStream->Release();
+                    return nullptr;
+                }
+
+                return transcoderStream;
+            });
+
+        if (!created) {
+            audioStreamEncoder->Release();
+        }
+
+        TranscodeSessionStream* sessionStream = dynamic_cast<TranscodeSessionStream*>(stream);
+        if (!sessionStream) {
+            if (stream) {
+                stream->Release();
+            }
+            return nullptr;
+        }
+
+        if (!sessionStream->WaitForCompletion()) {
+            sessionStream->Release();
             return nullptr;
         }
 
-        char buffer[8192];
-        while (!transcoderStream->Eof()) {
-            transcoderStream->Read(buffer, sizeof(buffer));
-            std::this_thread::yield();
+        /* prefer the cached copy if there is one; otherwise (e.g. the transcode
+        we attached to isn't being cached) the buffered one is complete */
+        cached = context.environment->GetDataStream(expectedFilename.c_str(), OpenFlags::Read);
+        if (cached) {
+            sessionStream->Release();
+            return cached;
         }
 
-        transcoderStream->Release();
-        PruneTranscodeCache(context);
-        return context.environment->GetDataStream(uri.c_str(), OpenFlags::Read);
+        return sessionStream;
     }
     else {
         IBlockingEncoder* blockingEncoder = dynamic_cast<IBlockingEncoder*>(encoder);
@@ -301,17 +282,17 @@ IDataStream* Transcoder::TranscodeAndWait(
             bool alreadyTranscoding = false;
             {
                 /* see if there's already a blocking transcoder running for the specified
-                uri. if there is, wait for it to complete. if there's not, add it to the
-                running set */
+                file, bitrate and format. if there is, wait for it to complete. if there's
+                not, add it to the running set */
                 std::unique_lock<std::mutex> lock(transcoderMutex);
-                alreadyTranscoding = runningBlockingTranscoders.find(uri) != runningBlockingTranscoders.end();
+                alreadyTranscoding = runningBlockingTranscoders.find(expectedFilename) != runningBlockingTranscoders.end();
                 if (alreadyTranscoding) {
-                    while (runningBlockingTranscoders.find(uri) != runningBlockingTranscoders.end()) {
+                    while (runningBlockingTranscoders.find(expectedFilename) != runningBlockingTranscoders.end()) {
                         waitForTranscode.wait(lock);
                     }
                 }
                 else {
-                    runningBlockingTranscoders.insert(uri);
+                    runningBlockingTranscoders.insert(expectedFilename);
                 }
             }
 
@@ -325,7 +306,7 @@ IDataStream* Transcoder::TranscodeAndWait(
                     /* let anyone else waiting for a resource to be transcoding that we
                     finished. */
                     std::unique_lock<std::mutex> lock(transcoderMutex);
-                    auto it = runningBlockingTranscoders.find(uri);
+                    auto it = runningBlockingTranscoders.find(expectedFilename);
                     if (it != runningBlockingTranscoders.end()) {
                         runningBlockingTranscoders.erase(it);
                     }
@@ -336,13 +317,116 @@ IDataStream* Transcoder::TranscodeAndWait(
                     return nullptr;
                 }
             }
+            else {
+                blockingEncoder->Release();
+            }
         }
 
-        PruneTranscodeCache(context);
         return context.environment->GetDataStream(expectedFilename.c_str(), OpenFlags::Read);
     }
 }
 
+IDataStream* Transcoder::TranscodeSegment(
+    Context& context,
+    const std::string& uri,
+    size_t bitrate,
+    const std::string& format,
+    size_t offset)
+{
+    IStreamingEncoder* encoder = getTypedEncoder<IStreamingEncoder>(context, format);
+    if (!encoder) {
+        return nullptr;
+    }
+
+    /* never cached: it's only part of the track */
+    auto segment = new TranscodingAudioDataStream(context, encoder, uri, bitrate, format);
+
+    if (segment->Length() < 0 || !segment->SetPosition((PositionType) offset)) {
+        segment->Release();
+        return nullptr;
+    }
+
+    return segment;
+}
+
+TranscodeSessionStream* Transcoder::Prefetch(
+    Context& context,
+    const std::string& uri,
+    size_t bitrate,
+    const std::string& format)
+{
+    if (!TranscodeCache::Enabled(context)) {
+        return nullptr; /* nowhere to put it */
+    }
+
+    std::string expectedFilename, tempFilename;
+    getTempAndFinalFilename(context, uri, bitrate, format, tempFilename, expectedFilename);
+
+    if (TranscodeCache::Contains(context, expectedFilename) ||
+        IsActive(context, uri, bitrate, format))
+    {
+        return nullptr;
+    }
+
+    /* blocking encoders can't be shared with a request that arrives while
+    they're running, so only streaming encoders are used speculatively */
+    IStreamingEncoder* encoder = getTypedEncoder<IStreamingEncoder>(context, format);
+    if (!encoder) {
+        return nullptr;
+    }
+
+    bool created = false;
+
+    IDataStream* stream = TranscodeSession::Open(
+        sessionKey(uri, bitrate, format),
+        bitrate,
+        [&]() -> TranscodingAudioDataStream* {
+            created = true;
+
+            auto transcoderStream = new TranscodingAudioDataStream(
+                context, encoder, uri, tempFilename, expectedFilename, bitrate, format);
+
+            if (transcoderStream->Length() < 0) {
+                transcoderStream->Release();
+                return nullptr;
+            }
+
+            return transcoderStream;
+        },
+        true);
+
+    if (!created) {
+        encoder->Release();
+    }
+
+    TranscodeSessionStream* sessionStream = dynamic_cast<TranscodeSessionStream*>(stream);
+    if (!sessionStream && stream) {
+        stream->Release();
+    }
+
+    return sessionStream;
+}
+
+bool Transcoder::IsActive(
+    Context& context,
+    const std::string& uri,
+    size_t bitrate,
+    const std::string& format)
+{
+    if (TranscodeSession::Active(sessionKey(uri, bitrate, format))) {
+        return true;
+    }
+
+    const std::string expectedFilename = getFinalFilename(context, uri, bitrate, format);
+
+    std::unique_lock<std::mutex> lock(transcoderMutex);
+    return runningBlockingTranscoders.find(expectedFilename) != runningBlockingTranscoders.end();
+}
+
 int Transcoder::GetActiveCount() {
-    return BlockingTranscoder::GetActiveCount() + TranscodingAudioDataStream::GetActiveCount();
+    /* speculative transcodes yield to real ones, so they don't count */
+    return std::max(0,
+        BlockingTranscoder::GetActiveCount() +
+        TranscodingAudioDataStream::GetActiveCount() -
+        TranscodeSession::BackgroundCount());
 }
\ No newline at end of file
@@ -41,16 +41,14 @@
 #include <musikcore/sdk/IStreamingEncoder.h>
 #include <string>
 
+class TranscodeSessionStream;
+
 class Transcoder {
     public:
         using IDataStream = musik::core::sdk::IDataStream;
         using IEncoder = musik::core::sdk::IEncoder;
         using IStreamingEncoder = musik::core::sdk::IStreamingEncoder;
 
-        static void RemoveTempTranscodeFiles(Context& context);
-
-        static void PruneTranscodeCache(Context& context);
-
         static IDataStream* Transcode(
             Context& context,
             const std::string& uri,
@@ -64,6 +62,35 @@ class Transcoder {
             size_t bitrate,
             const std::string& format);
 
+        /* starts an uncached transcode of the specified track from roughly
+        the specified byte offset, by seeking the decoder to the equivalent
+        time. used to serve seeks that are far ahead of a running transcode.
+        returns nullptr if the format's encoder can't stream. */
+        static IDataStream* TranscodeSegment(
+            Context& context,
+            const std::string& uri,
+            size_t bitrate,
+            const std::string& format,
+            size_t offset);
+
+        /* starts transcoding the specified track into the cache in the
+        background, unless it's already cached or running. returns a stream
+        the caller can wait on (and must release), or nullptr if there's
+        nothing to wait for. */
+        static TranscodeSessionStream* Prefetch(
+            Context& context,
+            const std::string& uri,
+            size_t bitrate,
+            const std::string& format);
+
+        /* true if the specified transcode is already running; new requests
+        for it will share the running one instead of starting another. */
+        static bool IsActive(
+            Context& context,
+            const std::string& uri,
+            size_t bitrate,
+            const std::string& format);
+
         static int GetActiveCount();
 
     private:
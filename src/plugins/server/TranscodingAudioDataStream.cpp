@@ -33,6 +33,7 @@
 //////////////////////////////////////////////////////////////////////////////
 
 #include "TranscodingAudioDataStream.h"
+#include "TranscodeCache.h"
 #include "Util.h"
 #include <algorithm>
 #include <atomic>
@@ -188,7 +189,7 @@ void TranscodingAudioDataStream::Release() {
 }
 
 PositionType TranscodingAudioDataStream::Read(void *buffer, PositionType bytesToRead) {
-    if (this->eof || !this->pcmBuffer) {
+    if ((this->eof && spillover.empty()) || !this->pcmBuffer) {
         return 0;
     }
 
@@ -287,7 +288,14 @@ PositionType TranscodingAudioDataStream::Read(void *buffer, PositionType bytesTo
         this->eof = true;
 
         if (encodedLength >= 0) {
-            memcpy(dst + bytesWritten, encodedData, encodedLength);
+            /* the flushed tail may be larger than the caller's buffer; keep
+            whatever doesn't fit for the next read. */
+            size_t toWrite = std::min((size_t) encodedLength, (size_t) bytesToRead);
+            memcpy(dst, encodedData, toWrite);
+            if ((size_t) encodedLength > toWrite) {
+                spillover.from(encodedData + toWrite, encodedLength - toWrite);
+            }
+            bytesWritten = toWrite;
 
             if (this->outFile) {
                 fwrite(encodedData, 1, encodedLength, this->outFile);
@@ -304,6 +312,9 @@ PositionType TranscodingAudioDataStream::Read(void *buffer, PositionType bytesTo
                 if (ec) {
                     fs::remove(fs::u8path(this->tempFilename), ec);
                 }
+                else {
+                    TranscodeCache::Add(this->context, this->finalFilename);
+                }
             }
         }
         else {
@@ -316,15 +327,39 @@ PositionType TranscodingAudioDataStream::Read(void *buffer, PositionType bytesTo
 
 internal_error:
     this->eof = true;
-    fclose(this->outFile);
-    this->outFile = nullptr;
-    std::error_code ec;
-    fs::remove(fs::u8path(this->tempFilename), ec);
+    if (this->outFile) {
+        fclose(this->outFile);
+        this->outFile = nullptr;
+        std::error_code ec;
+        fs::remove(fs::u8path(this->tempFilename), ec);
+    }
     return 0;
 }
 
 bool TranscodingAudioDataStream::SetPosition(PositionType position) {
-    return false;
+    if (position == this->position) {
+        return true;
+    }
+
+    /* only a fresh stream that isn't being written to the cache can be
+    repositioned, and only once. the output has a constant bitrate, so the
+    byte offset maps to a time; the decoder is moved there, and encoding
+    starts from that point. the result isn't byte-for-byte identical to the
+    same range of a full transcode, but mp3 decoders resynchronize on the
+    next frame, so it plays as if it were. */
+    if (this->outFile || this->encoderInitialized || this->position != 0 ||
+        !this->decoder || this->bitrate == 0 || position < 0)
+    {
+        return false;
+    }
+
+    const double seconds = (double) position / (1000.0 * (double) this->bitrate / 8.0);
+    if (this->decoder->SetPosition(seconds) < 0.0) {
+        return false;
+    }
+
+    this->position = position;
+    return true;
 }
 
 PositionType TranscodingAudioDataStream::Position() {
@@ -336,7 +371,7 @@ bool TranscodingAudioDataStream::Seekable() {
 }
 
 bool TranscodingAudioDataStream::Eof() {
-    return this->eof;
+    return this->eof && spillover.empty();
 }
 
 long TranscodingAudioDataStream::Length() {
@@ -32,6 +32,8 @@
 //
 //////////////////////////////////////////////////////////////////////////////
 
+#pragma once
+
 #include <musikcore/sdk/IDataStream.h>
 #include <musikcore/sdk/IStreamingEncoder.h>
 #include <musikcore/sdk/DataBuffer.h>
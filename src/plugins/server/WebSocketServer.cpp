@@ -38,6 +38,9 @@
 #include <musikcore/sdk/constants.h>
 #include <musikcore/sdk/String.h>
 
+#include <algorithm>
+#include <unordered_set>
+
 using websocketpp::lib::placeholders::_1;
 using websocketpp::lib::placeholders::_2;
 using websocketpp::lib::bind;
@@ -48,12 +51,65 @@ using namespace musik::core::sdk;
 static int nextId = 0;
 static const char* TAG = "WebSocketServer";
 
+/* cheap requests that are handled directly on the asio thread, as long as
+they won't overtake an earlier request from the same connection */
+static const std::unordered_set<std::string> FAST_LANE_REQUESTS = {
+    request::ping,
+    request::pause_or_resume,
+    request::stop,
+    request::previous,
+    request::next,
+    request::play_at_index,
+    request::toggle_shuffle,
+    request::toggle_repeat,
+    request::toggle_mute,
+    request::set_volume,
+    request::seek_to,
+    request::seek_relative,
+    request::get_playback_overview,
+    request::get_current_time
+};
+
 /* UTILITY METHODS */
 
 static std::string nextMessageId() {
     return str::Format("musikcube-server-%d", ++nextId);
 }
 
+/* rough per-row sizes used to pre-size streamed responses, so the payload
+buffer doesn't get reallocated (and copied) too many times as it grows. */
+static const size_t kEstimatedTrackBytes = 384;
+static const size_t kEstimatedAlbumBytes = 160;
+static const size_t kEstimatedIdBytes = 40;
+
+/* like GetMetadataString(), but written straight from the thread local
+buffer into the response */
+template <typename MetadataT>
+static void writeMetadataString(JsonWriter& writer, MetadataT* metadata, const std::string& key) {
+    if (!metadata) {
+        writer.String("missing metadata!");
+        return;
+    }
+    metadata->GetString(key.c_str(), threadLocalBuffer, sizeof(threadLocalBuffer));
+    writer.String(threadLocalBuffer);
+}
+
+template <typename MetadataT>
+static void writeMetadataField(JsonWriter& writer, MetadataT* metadata, const std::string& key) {
+    writer.Key(key);
+    writeMetadataString(writer, metadata, key);
+}
+
+static void writeValueField(JsonWriter& writer, IValue* value, const std::string& key) {
+    writer.Key(key);
+    if (!value) {
+        writer.String("missing metadata!");
+        return;
+    }
+    value->GetValue(threadLocalBuffer, sizeof(threadLocalBuffer));
+    writer.String(threadLocalBuffer);
+}
+
 static std::shared_ptr<char*> jsonToStringArray(const json& jsonArray) {
     char** result = nullptr;
     size_t count = 0;
@@ -125,9 +181,11 @@ static json getEnvironment(Context& context) {
 
 /* IMPLEMENTATION */
 
-WebSocketServer::WebSocketServer(Context& context)
+WebSocketServer::WebSocketServer(Context& context, Snapshots& snapshots)
 : context(context)
-, running(false) {
+, snapshots(snapshots)
+, running(false)
+, compressionThreshold(defaults::websocket_compression_threshold) {
 
 }
 
@@ -173,6 +231,14 @@ void WebSocketServer::ThreadProc() {
         const bool ipv6 = context.prefs->GetBool(
             prefs::use_ipv6.c_str(), defaults::use_ipv6);
 
+        /* 0 disables compression, -1 is zlib's default; read when each
+        connection is created. */
+        deflate_extension::level = std::max(-1, std::min(9, context.prefs->GetInt(
+            prefs::websocket_compression_level.c_str(), defaults::websocket_compression_level)));
+
+        this->compressionThreshold = (size_t) std::max(0, context.prefs->GetInt(
+            prefs::websocket_compression_threshold.c_str(), defaults::websocket_compression_threshold));
+
         wss->init_asio();
         wss->set_reuse_addr(true);
         wss->set_message_handler(std::bind(&WebSocketServer::OnMessage, this, wss.get(), ::_1, ::_2));
@@ -181,6 +247,8 @@ void WebSocketServer::ThreadProc() {
         wss->listen(ipv6 ? tcp::v6() : tcp::v4(), port);
         wss->start_accept();
 
+        this->StartWorkers();
+
         wss->run();
     }
     catch (websocketpp::exception const & e) {
@@ -194,6 +262,7 @@ void WebSocketServer::ThreadProc() {
 
     }
 
+    this->StopWorkers();
     this->wss.reset();
     this->running = false;
     this->snapshots.Reset();
@@ -241,6 +310,10 @@ void WebSocketServer::OnPlayQueueChanged() {
     this->BroadcastPlayQueueChanged();
 }
 
+void WebSocketServer::OnLibraryChanged(int64_t generation) {
+    this->BroadcastLibraryChanged(generation);
+}
+
 void WebSocketServer::HandleAuthentication(connection_hdl connection, json& request) {
     std::string name = request[message::name];
 
@@ -251,7 +324,13 @@ void WebSocketServer::HandleAuthentication(connection_hdl connection, json& requ
             context.prefs, key::password, defaults::password);
 
         if (sent == actual) {
-            this->connections[connection] = true; /* mark as authed */
+            {
+                auto wl = connectionLock.Write();
+                auto it = this->connections.find(connection);
+                if (it != this->connections.end()) {
+                    it->second = true; /* mark as authed */
+                }
+            }
 
             this->RespondWithOptions(
                 connection, request, json({
@@ -270,7 +349,7 @@ void WebSocketServer::HandleAuthentication(connection_hdl connection, json& requ
 }
 
 void WebSocketServer::HandleRequest(connection_hdl connection, json& request) {
-    if (this->connections[connection] == false) {
+    if (!this->IsAuthenticated(connection)) {
         this->HandleAuthentication(connection, request);
         return;
     }
@@ -501,11 +580,51 @@ void WebSocketServer::HandleRequest(connection_hdl connection, json& request) {
             this->RespondWithSuccess(connection, request);
             return;
         }
+        else if (name == request::get_connection_stats) {
+            this->RespondWithConnectionStats(connection, request);
+            return;
+        }
     }
 
     this->RespondWithInvalidRequest(connection, name, id);
 }
 
+void WebSocketServer::Send(connection_hdl connection, const std::string& message) {
+    auto con = wss->get_con_from_hdl(connection);
+    auto msg = con->get_message(websocketpp::frame::opcode::text, message.size());
+    msg->append_payload(message);
+    this->Send(con, msg);
+}
+
+void WebSocketServer::Send(connection_hdl connection, std::string&& message) {
+    /* take ownership of the caller's buffer instead of copying it into the
+    message; large responses are written straight into it by JsonWriter. */
+    auto con = wss->get_con_from_hdl(connection);
+    auto msg = con->get_message(websocketpp::frame::opcode::text, 0);
+    msg->get_raw_payload() = std::move(message);
+    this->Send(con, msg);
+}
+
+void WebSocketServer::Send(connection_ptr con, message_ptr msg) {
+    const size_t size = msg->get_payload().size();
+
+    /* small messages (transport commands, acks) aren't worth the cpu, and may
+    even grow. this is a no-op if compression wasn't negotiated. */
+    msg->set_compressed(size >= this->compressionThreshold);
+
+    /* the message is framed (and compressed) synchronously on this thread */
+    deflate_extension::compressedBytesOut = 0;
+
+    auto ec = con->send(msg);
+    if (ec) {
+        throw websocketpp::exception(ec);
+    }
+
+    const size_t compressed = deflate_extension::compressedBytesOut;
+    con->bytesOut += compressed ? compressed : size;
+    con->uncompressedBytesOut += size;
+}
+
 void WebSocketServer::Broadcast(const std::string& name, json& options) {
     json msg;
     msg[message::name] = name;
@@ -519,7 +638,7 @@ void WebSocketServer::Broadcast(const std::string& name, json& options) {
     try {
         if (wss) {
             for (const auto &keyValue : this->connections) {
-                wss->send(keyValue.first, str.c_str(), websocketpp::frame::opcode::text);
+                this->Send(keyValue.first, str);
             }
         }
     }
@@ -536,7 +655,7 @@ void WebSocketServer::RespondWithOptions(connection_hdl connection, json& reques
         { message::options, options }
     };
 
-    wss->send(connection, response.dump().c_str(), websocketpp::frame::opcode::text);
+    this->Send(connection, response.dump());
 }
 
 void WebSocketServer::RespondWithOptions(connection_hdl connection, json& request, json&& options) {
@@ -547,7 +666,32 @@ void WebSocketServer::RespondWithOptions(connection_hdl connection, json& reques
         { message::options, options }
     };
 
-    wss->send(connection, response.dump().c_str(), websocketpp::frame::opcode::text);
+    this->Send(connection, response.dump());
+}
+
+void WebSocketServer::RespondWithOptions(
+    connection_hdl connection,
+    json& request,
+    size_t sizeHint,
+    std::function<void(JsonWriter&)> writeOptions)
+{
+    /* same envelope as above, but the options are streamed by the caller
+    directly into the buffer that becomes the message payload. */
+    std::string response;
+    response.reserve(sizeHint + 256);
+
+    JsonWriter writer(response);
+    writer.BeginObject()
+        .Key(message::name).Value(request[message::name])
+        .Field(message::type, type::response)
+        .Key(message::id).Value(request[message::id])
+        .Key(message::options).BeginObject();
+
+    writeOptions(writer);
+
+    writer.EndObject().EndObject();
+
+    this->Send(connection, std::move(response));
 }
 
 void WebSocketServer::RespondWithInvalidRequest(connection_hdl connection, const std::string& name, const std::string& id)
@@ -559,7 +703,7 @@ void WebSocketServer::RespondWithInvalidRequest(connection_hdl connection, const
         { message::options,{{ key::error, value::invalid }} }
     };
 
-    wss->send(connection, error.dump().c_str(), websocketpp::frame::opcode::text);
+    this->Send(connection, error.dump());
 }
 
 void WebSocketServer::RespondWithSuccess(connection_hdl connection, json& request) {
@@ -577,7 +721,7 @@ void WebSocketServer::RespondWithSuccess(connection_hdl connection, const std::s
         { message::options, {{ key::success, true }} }
     };
 
-    wss->send(connection, success.dump().c_str(), websocketpp::frame::opcode::text);
+    this->Send(connection, success.dump());
 }
 
 void WebSocketServer::RespondWithFailure(connection_hdl connection, json& request) {
@@ -588,7 +732,7 @@ void WebSocketServer::RespondWithFailure(connection_hdl connection, json& reques
         { message::options, {{ key::success, false }} }
     };
 
-    wss->send(connection, error.dump().c_str(), websocketpp::frame::opcode::text);
+    this->Send(connection, error.dump());
 }
 
 void WebSocketServer::RespondWithSendRawQuery(connection_hdl connection, json& request) {
@@ -662,29 +806,32 @@ bool WebSocketServer::RespondWithTracks(
             return true;
         }
         else {
-            json data = json::array();
+            const size_t count = tracks->Count();
+            const size_t sizeHint = count * (idsOnly ? kEstimatedIdBytes : kEstimatedTrackBytes);
 
-            ITrack* track = nullptr;
-            for (size_t i = 0; i < tracks->Count(); i++) {
-                track = tracks->GetTrack(i);
+            this->RespondWithOptions(connection, request, sizeHint, [&](JsonWriter& writer) {
+                writer.Key(key::data).BeginArray();
 
-                if (idsOnly) {
-                    data.push_back(GetMetadataString(track, key::external_id));
-                }
-                else {
-                    data.push_back(this->ReadTrackMetadata(track));
-                }
+                ITrack* track = nullptr;
+                for (size_t i = 0; i < count; i++) {
+                    track = tracks->GetTrack(i);
 
-                track->Release();
-            }
+                    if (idsOnly) {
+                        writeMetadataString(writer, track, key::external_id);
+                    }
+                    else {
+                        this->WriteTrackMetadata(writer, track);
+                    }
 
-            tracks->Release();
+                    track->Release();
+                }
 
-            this->RespondWithOptions(connection, request, {
-                { key::data, data },
-                { key::count, data.size() },
-                { key::limit, std::max(0, limit) },
-                { key::offset, offset },
+                writer.EndArray()
+                    .Field(key::count, (int64_t) count)
+                    .Field(key::limit, std::max(0, limit))
+                    .Field(key::offset, offset);
+
+                tracks->Release();
             });
 
             return true;
@@ -738,21 +885,24 @@ void WebSocketServer::RespondWithQueryTracksByExternalIds(connection_hdl connect
                     externalIds.size());
 
             if (trackList) {
-                json tracks = { };
-
-                ITrack* track;
-                std::string externalId;
-                for (size_t i = 0; i < trackList->Count(); i++) {
-                    track = trackList->GetTrack(i);
-                    externalId = GetMetadataString(track, track::ExternalId);
-                    tracks[externalId] = this->ReadTrackMetadata(track);
-                    track->Release();
-                }
+                const size_t count = trackList->Count();
+
+                this->RespondWithOptions(connection, request, count * kEstimatedTrackBytes, [&](JsonWriter& writer) {
+                    writer.Key(key::data).BeginObject();
 
-                trackList->Release();
-                json options = { { key::data, tracks } };
+                    ITrack* track;
+                    for (size_t i = 0; i < count; i++) {
+                        track = trackList->GetTrack(i);
+                        writer.Key(GetMetadataString(track, track::ExternalId));
+                        this->WriteTrackMetadata(writer, track);
+                        track->Release();
+                    }
+
+                    writer.EndObject();
+
+                    trackList->Release();
+                });
 
-                this->RespondWithOptions(connection, request, options);
                 return;
             }
         }
@@ -788,6 +938,7 @@ void WebSocketServer::RespondWithPlayQueueTracks(connection_hdl connection, json
         size_t count = context.playback->Count();
 
         if (type == value::snapshot) {
+            auto lock = snapshots.Lock();
             auto snapshot = snapshots.Get(request[message::device_id]);
             count = snapshot ? snapshot->Count() : 0;
         }
@@ -799,65 +950,62 @@ void WebSocketServer::RespondWithPlayQueueTracks(connection_hdl connection, json
     }
     else {
         bool idsOnly = request[message::options].value(key::ids_only, false);
+        const size_t sizeHint = std::max(0, limit) * (idsOnly ? kEstimatedIdBytes : kEstimatedTrackBytes);
 
-        /* now add the tracks to the output. they will be Release()'d automatically
-        as soon as this scope ends. */
-        json data = json::array();
-
-        if (type == value::live) {
-            /* edit the playlist so it can be changed while we're getting the tracks
-            out of it. only applicable for the "live" type. */
-            ITrackListEditor* editor = context.playback->EditPlaylist();
-            int to = (int)context.playback->Count();
-
-            if (offset >= 0 && limit >= 0) {
-                to = std::min(to, offset + limit);
-            }
-
-            for (int i = offset; i < to; i++) {
-                ITrack* track = context.playback->GetTrack(i);
-                if (idsOnly) {
-                    data.push_back(GetMetadataString(track, key::external_id));
-                }
-                else {
-                    data.push_back(this->ReadTrackMetadata(track));
-                }
-                if (track) {
-                    track->Release();
-                }
-            }
+        this->RespondWithOptions(connection, request, sizeHint, [&](JsonWriter& writer) {
+            int64_t count = 0;
 
-            editor->Release();
-        }
-        else if (type == value::snapshot) {
-            auto snapshot = snapshots.Get(request[message::device_id]);
-            if (snapshot) {
-                int to = (int) snapshot->Count();
+            auto writeTracks = [&](auto getTrack, int total) {
+                int to = total;
 
                 if (offset >= 0 && limit >= 0) {
                     to = std::min(to, offset + limit);
                 }
 
                 for (int i = offset; i < to; i++) {
-                    ITrack* track = snapshot->GetTrack(i);
+                    ITrack* track = getTrack(i);
                     if (idsOnly) {
-                        data.push_back(GetMetadataString(track, key::external_id));
+                        writeMetadataString(writer, track, key::external_id);
                     }
                     else {
-                        data.push_back(this->ReadTrackMetadata(track));
+                        this->WriteTrackMetadata(writer, track);
                     }
                     if (track) {
                         track->Release();
                     }
+                    ++count;
+                }
+            };
+
+            /* the tracks are written straight into the response as they're
+            read, and Release()'d right away. */
+            writer.Key(key::data).BeginArray();
+
+            if (type == value::live) {
+                /* edit the playlist so it can be changed while we're getting the tracks
+                out of it. only applicable for the "live" type. */
+                ITrackListEditor* editor = context.playback->EditPlaylist();
+
+                writeTracks(
+                    [this](int i) { return context.playback->GetTrack(i); },
+                    (int) context.playback->Count());
+
+                editor->Release();
+            }
+            else if (type == value::snapshot) {
+                auto lock = snapshots.Lock();
+                auto snapshot = snapshots.Get(request[message::device_id]);
+                if (snapshot) {
+                    writeTracks(
+                        [snapshot](int i) { return snapshot->GetTrack(i); },
+                        (int) snapshot->Count());
                 }
             }
-        }
 
-        this->RespondWithOptions(connection, request, {
-            { key::data, data },
-            { key::count, data.size() },
-            { key::limit, std::max(0, limit) },
-            { key::offset, offset },
+            writer.EndArray()
+                .Field(key::count, count)
+                .Field(key::limit, std::max(0, limit))
+                .Field(key::offset, offset);
         });
     }
 }
@@ -873,28 +1021,30 @@ void WebSocketServer::RespondWithQueryAlbums(connection_hdl connection, json& re
         IMapList* albumList = context.metadataProxy
             ->QueryAlbums(category.c_str(), categoryId, filter.c_str());
 
-        json result = json::array();
+        const size_t count = albumList->Count();
 
-        IMap* album;
-        for (size_t i = 0; i < albumList->Count(); i++) {
-            album = albumList->GetAt(i);
+        this->RespondWithOptions(connection, request, count * kEstimatedAlbumBytes, [&](JsonWriter& writer) {
+            writer.Field(key::category, key::album);
+            writer.Key(key::data).BeginArray();
 
-            result.push_back({
-                { key::title, GetValueString(album) },
-                { key::id, album->GetId() },
-                { key::thumbnail_id, album->GetInt64(key::thumbnail_id.c_str()) },
-                { key::album_artist_id, album->GetInt64(key::album_artist_id.c_str()) },
-                { key::album_artist, GetMetadataString(album, key::album_artist) }
-            });
+            IMap* album;
+            for (size_t i = 0; i < count; i++) {
+                album = albumList->GetAt(i);
 
-            album->Release();
-        }
+                writer.BeginObject();
+                writeValueField(writer, album, key::title);
+                writer.Field(key::id, album->GetId());
+                writer.Field(key::thumbnail_id, album->GetInt64(key::thumbnail_id.c_str()));
+                writer.Field(key::album_artist_id, album->GetInt64(key::album_artist_id.c_str()));
+                writeMetadataField(writer, album, key::album_artist);
+                writer.EndObject();
 
-        albumList->Release();
+                album->Release();
+            }
 
-        this->RespondWithOptions(connection, request, {
-            { key::category, key::album },
-            { key::data, result }
+            writer.EndArray();
+
+            albumList->Release();
         });
 
         return;
@@ -1116,6 +1266,7 @@ void WebSocketServer::RespondWithPlayAllTracks(connection_hdl connection, json&
 }
 
 void WebSocketServer::RespondWithPlaySnapshotTracks(connection_hdl connection, json& request) {
+    auto lock = this->snapshots.Lock();
     auto snapshot = this->snapshots.Get(request[message::device_id]);
     if (snapshot) {
         size_t index = 0;
@@ -1166,6 +1317,21 @@ void WebSocketServer::RespondWithEnvironment(connection_hdl connection, json& re
     this->RespondWithOptions(connection, request, getEnvironment(context));
 }
 
+void WebSocketServer::RespondWithConnectionStats(connection_hdl connection, json& request) {
+    auto con = wss->get_con_from_hdl(connection);
+
+    const bool compressed =
+        con->get_response_header("Sec-WebSocket-Extensions").find("permessage-deflate") != std::string::npos;
+
+    this->RespondWithOptions(connection, request, {
+        { key::compressed, compressed },
+        { key::bytes_in, con->bytesIn.load() },
+        { key::bytes_out, con->bytesOut.load() },
+        { key::uncompressed_bytes_in, con->uncompressedBytesIn.load() },
+        { key::uncompressed_bytes_out, con->uncompressedBytesOut.load() }
+    });
+}
+
 void WebSocketServer::RespondWithCurrentTime(connection_hdl connection, json& request) {
     auto track = context.playback->GetPlayingTrack();
 
@@ -1518,7 +1684,6 @@ void WebSocketServer::RespondWithSetTransportType(connection_hdl connection, jso
 
 void WebSocketServer::RespondWithSnapshotPlayQueue(connection_hdl connection, json& request) {
     auto deviceId = request[message::device_id];
-    this->snapshots.Remove(deviceId);
     this->snapshots.Put(deviceId, context.playback->Clone());
     this->RespondWithSuccess(connection, request);
 }
@@ -1590,6 +1755,19 @@ void WebSocketServer::BroadcastPlayQueueChanged() {
     this->Broadcast(broadcast::play_queue_changed, options);
 }
 
+void WebSocketServer::BroadcastLibraryChanged(int64_t generation) {
+    {
+        auto rl = connectionLock.Read();
+        if (!this->connections.size()) {
+            return;
+        }
+    }
+
+    /* clients use this to invalidate any query results they have cached */
+    json options = { { key::generation, generation } };
+    this->Broadcast(broadcast::library_changed, options);
+}
+
 json WebSocketServer::WebSocketServer::ReadTrackMetadata(ITrack* track) {
     return {
         { key::id, track ? track->GetId() : -1LL },
@@ -1608,6 +1786,25 @@ json WebSocketServer::WebSocketServer::ReadTrackMetadata(ITrack* track) {
     };
 }
 
+void WebSocketServer::WriteTrackMetadata(JsonWriter& writer, ITrack* track) {
+    /* mirrors ReadTrackMetadata(), without the intermediate dom */
+    writer.BeginObject();
+    writer.Field(key::id, track ? track->GetId() : -1LL);
+    writeMetadataField(writer, track, key::external_id);
+    writeMetadataField(writer, track, key::title);
+    writer.Field(key::track_num, (int64_t) GetMetadataInt32(track, key::track_num.c_str(), 0));
+    writeMetadataField(writer, track, key::album);
+    writer.Field(key::album_id, GetMetadataInt64(track, key::album_id.c_str()));
+    writeMetadataField(writer, track, key::album_artist);
+    writer.Field(key::album_artist_id, GetMetadataInt64(track, key::album_artist_id.c_str()));
+    writeMetadataField(writer, track, key::artist);
+    writer.Field(key::artist_id, GetMetadataInt64(track, key::visual_artist_id.c_str()));
+    writeMetadataField(writer, track, key::genre);
+    writer.Field(key::genre_id, GetMetadataInt64(track, key::visual_genre_id.c_str()));
+    writer.Field(key::thumbnail_id, GetMetadataInt64(track, key::thumbnail_id.c_str()));
+    writer.EndObject();
+}
+
 void WebSocketServer::BuildPlaybackOverview(json& options) {
     options[key::state] = PLAYBACK_STATE_TO_STRING.find(context.playback->GetPlaybackState())->second;
     options[key::repeat_mode] = REPEAT_MODE_TO_STRING.find(context.playback->GetRepeatMode())->second;
@@ -1626,24 +1823,153 @@ void WebSocketServer::BuildPlaybackOverview(json& options) {
     }
 }
 
+bool WebSocketServer::IsAuthenticated(connection_hdl connection) {
+    auto rl = connectionLock.Read();
+    auto it = this->connections.find(connection);
+    return it != this->connections.end() && it->second;
+}
+
+void WebSocketServer::StartWorkers() {
+    const int count = std::max(1, context.prefs->GetInt(
+        prefs::websocket_server_worker_threads.c_str(), defaults::websocket_server_worker_threads));
+
+    std::unique_lock<std::mutex> lock(this->workerMutex);
+    this->workersExit = false;
+    for (int i = 0; i < count; i++) {
+        this->workers.emplace_back(std::bind(&WebSocketServer::WorkerThreadProc, this));
+    }
+}
+
+void WebSocketServer::StopWorkers() {
+    {
+        std::unique_lock<std::mutex> lock(this->workerMutex);
+        this->workersExit = true;
+    }
+
+    this->workerCondition.notify_all();
+
+    for (auto& worker : this->workers) {
+        worker.join();
+    }
+
+    std::unique_lock<std::mutex> lock(this->workerMutex);
+    for (auto& connection : this->readyConnections) {
+        connection->pendingRequests.clear();
+    }
+    this->readyConnections.clear();
+    this->workers.clear();
+}
+
+void WebSocketServer::WorkerThreadProc() {
+    while (true) {
+        connection_ptr connection;
+        json request;
+
+        {
+            std::unique_lock<std::mutex> lock(this->workerMutex);
+            while (!this->workersExit && this->readyConnections.empty()) {
+                this->workerCondition.wait(lock);
+            }
+            if (this->workersExit) {
+                return;
+            }
+            connection = this->readyConnections.front();
+            this->readyConnections.pop_front();
+            if (connection->pendingRequests.empty()) {
+                continue; /* closed while waiting */
+            }
+            request = std::move(connection->pendingRequests.front());
+            connection->pendingRequests.pop_front();
+            connection->requestInProgress = true;
+        }
+
+        this->HandleMessage(connection->get_handle(), request);
+
+        {
+            /* one request per turn, then back of the line, so a client with a
+            long backlog doesn't monopolize a worker */
+            std::unique_lock<std::mutex> lock(this->workerMutex);
+            connection->requestInProgress = false;
+            if (!connection->pendingRequests.empty()) {
+                this->readyConnections.push_back(connection);
+                this->workerCondition.notify_one();
+            }
+        }
+    }
+}
+
+void WebSocketServer::EnqueueRequest(connection_ptr connection, json&& request) {
+    std::unique_lock<std::mutex> lock(this->workerMutex);
+    connection->pendingRequests.push_back(std::move(request));
+
+    /* if a request is already in progress the worker handling it will put
+    the connection back in line when it's done */
+    if (!connection->requestInProgress && connection->pendingRequests.size() == 1) {
+        this->readyConnections.push_back(connection);
+        this->workerCondition.notify_one();
+    }
+}
+
+void WebSocketServer::HandleMessage(connection_hdl connection, json& request) {
+    try {
+        this->HandleRequest(connection, request);
+    }
+    catch (std::exception& e) {
+        this->context.debug->Error(TAG, str::Format("HandleRequest failed: %s", e.what()).c_str());
+        try {
+            this->RespondWithInvalidRequest(connection, value::invalid, value::invalid);
+        }
+        catch (...) {
+            /* connection went away */
+        }
+    }
+    catch (...) {
+        this->context.debug->Error(TAG, "HandleRequest failed: unknown/unexpected exception");
+    }
+}
+
 void WebSocketServer::OnOpen(connection_hdl connection) {
     auto wl = connectionLock.Write();
     connections[connection] = false;
 }
 
 void WebSocketServer::OnClose(connection_hdl connection) {
-    auto wl = connectionLock.Write();
-    connections.erase(connection);
+    {
+        auto wl = connectionLock.Write();
+        connections.erase(connection);
+    }
+
+    std::unique_lock<std::mutex> lock(this->workerMutex);
+    wss->get_con_from_hdl(connection)->pendingRequests.clear();
 }
 
 void WebSocketServer::OnMessage(server* s, connection_hdl hdl, message_ptr msg) {
-    auto rl = connectionLock.Read();
-
     try {
+        auto connection = s->get_con_from_hdl(hdl);
+        /* frames are inflated on this (the asio) thread as they arrive, so the
+        tally covers exactly this message; count wire bytes, like Send() */
+        const size_t size = msg->get_payload().size();
+        const size_t compressed = deflate_extension::compressedBytesIn;
+        deflate_extension::compressedBytesIn = 0;
+        connection->bytesIn += compressed ? compressed : size;
+        connection->uncompressedBytesIn += size;
+
         json data = json::parse(msg->get_payload());
         std::string type = data[message::type];
         if (type == type::request) {
-            this->HandleRequest(hdl, data);
+            bool fastLane = false;
+
+            if (FAST_LANE_REQUESTS.find(data.value(message::name, "")) != FAST_LANE_REQUESTS.end()) {
+                std::unique_lock<std::mutex> lock(this->workerMutex);
+                fastLane = !connection->requestInProgress && connection->pendingRequests.empty();
+            }
+
+            if (fastLane) {
+                this->HandleMessage(hdl, data);
+            }
+            else {
+                this->EnqueueRequest(connection, std::move(data));
+            }
         }
     }
     catch (std::exception& e) {
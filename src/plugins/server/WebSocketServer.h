@@ -33,6 +33,7 @@
 //////////////////////////////////////////////////////////////////////////////
 
 #include "Context.h"
+#include "JsonWriter.h"
 #include "Snapshots.h"
 
 #include <musikcore/sdk/constants.h>
@@ -45,12 +46,17 @@
 #include <nlohmann/json.hpp>
 #pragma warning(pop, 0)
 
+#include <atomic>
+#include <deque>
+#include <functional>
 #include <mutex>
 #include <condition_variable>
+#include <thread>
+#include <vector>
 
 class WebSocketServer {
     public:
-        WebSocketServer(Context& context);
+        WebSocketServer(Context& context, Snapshots& snapshots);
         ~WebSocketServer();
 
         bool Start();
@@ -63,6 +69,7 @@ class WebSocketServer {
         void OnVolumeChanged(double volume);
         void OnModeChanged(musik::core::sdk::RepeatMode repeatMode, bool shuffled);
         void OnPlayQueueChanged();
+        void OnLibraryChanged(int64_t generation);
 
     private:
         /* our special server config that supports gzip */
@@ -99,14 +106,66 @@ class WebSocketServer {
 
             struct permessage_deflate_config {};
 
-            typedef websocketpp::extensions::permessage_deflate::enabled
-                <permessage_deflate_config> permessage_deflate_type;
+            /* the stock extension with a configurable compression level (0 declines
+            negotiation entirely). also tallies compressed input and output for the
+            calling thread, which is how Send() and OnMessage() learn a message's
+            size on the wire. */
+            class permessage_deflate_type: public websocketpp::extensions::
+                permessage_deflate::enabled<permessage_deflate_config>
+            {
+                public:
+                    using base = websocketpp::extensions::
+                        permessage_deflate::enabled<permessage_deflate_config>;
+
+                    static inline std::atomic<int> level{ Z_DEFAULT_COMPRESSION };
+                    static inline thread_local size_t compressedBytesIn = 0;
+                    static inline thread_local size_t compressedBytesOut = 0;
+
+                    permessage_deflate_type() {
+                        this->set_compression_level(level);
+                    }
+
+                    websocketpp::err_str_pair negotiate(websocketpp::http::attribute_list const& offer) {
+                        if (level == 0) {
+                            return websocketpp::err_str_pair(make_error_code(
+                                websocketpp::extensions::permessage_deflate::error::general), "");
+                        }
+                        return base::negotiate(offer);
+                    }
+
+                    websocketpp::lib::error_code compress(std::string const& in, std::string& out) {
+                        const size_t before = out.size();
+                        auto result = base::compress(in, out);
+                        compressedBytesOut += out.size() - before;
+                        return result;
+                    }
+
+                    websocketpp::lib::error_code decompress(uint8_t const* buf, size_t len, std::string& out) {
+                        compressedBytesIn += len;
+                        return base::decompress(buf, len, out);
+                    }
+            };
+
+            /* per-connection state, reachable via get_con_from_hdl() */
+            struct connection_base {
+                std::atomic<uint64_t> bytesIn{ 0 };
+                std::atomic<uint64_t> bytesOut{ 0 };
+                std::atomic<uint64_t> uncompressedBytesIn{ 0 };
+                std::atomic<uint64_t> uncompressedBytesOut{ 0 };
+
+                /* requests waiting for a worker, in the order they arrived. guarded
+                by WebSocketServer::workerMutex */
+                std::deque<nlohmann::json> pendingRequests;
+                bool requestInProgress{ false };
+            };
         };
 
         /* typedefs */
         using server = websocketpp::server<asio_with_deflate>;
         using connection_hdl = websocketpp::connection_hdl;
         using message_ptr = server::message_ptr;
+        using connection_ptr = server::connection_ptr;
+        using deflate_extension = asio_with_deflate::permessage_deflate_type;
         using ConnectionList = std::map<connection_hdl, bool, std::owner_less<connection_hdl>>;
         using json = nlohmann::json;
         using ITrackList = musik::core::sdk::ITrackList;
@@ -120,19 +179,40 @@ class WebSocketServer {
         std::shared_ptr<std::thread> thread;
         std::mutex exitMutex;
         std::condition_variable exitCondition;
-        Snapshots snapshots;
+        Snapshots& snapshots;
         volatile bool running;
+        size_t compressionThreshold;
+
+        /* requests are handled by a pool of workers so slow library queries don't
+        hold up the asio thread. connections with pending requests wait in
+        readyConnections; a connection is handled by at most one worker at a
+        time, so its requests stay ordered. */
+        std::vector<std::thread> workers;
+        std::deque<connection_ptr> readyConnections;
+        std::mutex workerMutex;
+        std::condition_variable workerCondition;
+        bool workersExit{ false };
 
         /* gross extra state */
         std::string lastPlaybackOverview;
 
         void ThreadProc();
+        void WorkerThreadProc();
+        void StartWorkers();
+        void StopWorkers();
+        void EnqueueRequest(connection_ptr connection, json&& request);
+        bool IsAuthenticated(connection_hdl connection);
+        void HandleMessage(connection_hdl connection, json& request);
         void HandleAuthentication(connection_hdl connection, json& request);
         void HandleRequest(connection_hdl connection, json& request);
 
+        void Send(connection_hdl connection, const std::string& message);
+        void Send(connection_hdl connection, std::string&& message);
+        void Send(connection_ptr connection, message_ptr message);
         void Broadcast(const std::string& name, json& options);
         void RespondWithOptions(connection_hdl connection, json& request, json& options);
         void RespondWithOptions(connection_hdl connection, json& request, json&& options = json({}));
+        void RespondWithOptions(connection_hdl connection, json& request, size_t sizeHint, std::function<void(JsonWriter&)> writeOptions);
         void RespondWithInvalidRequest(connection_hdl connection, const std::string& name, const std::string& id);
         void RespondWithSuccess(connection_hdl connection, json& request);
         void RespondWithFailure(connection_hdl connection, json& request);
@@ -171,14 +251,17 @@ class WebSocketServer {
         void RespondWithSetTransportType(connection_hdl connection, json& request);
         void RespondWithSnapshotPlayQueue(connection_hdl connection, json& request);
         void RespondWithInvalidatePlayQueueSnapshot(connection_hdl connection, json& request);
+        void RespondWithConnectionStats(connection_hdl connection, json& request);
 
         void BroadcastPlaybackOverview();
         void BroadcastPlayQueueChanged();
+        void BroadcastLibraryChanged(int64_t generation);
 
         void GetLimitAndOffset(json& options, int& limit, int& offset);
         ITrackList* QueryTracksByCategory(json& request, int& limit, int& offset);
         ITrackList* QueryTracks(json& request, int& limit, int& offset);
         json ReadTrackMetadata(ITrack* track);
+        void WriteTrackMetadata(JsonWriter& writer, ITrack* track);
         void BuildPlaybackOverview(json& options);
 
         void OnOpen(connection_hdl connection);
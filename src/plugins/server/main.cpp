@@ -55,13 +55,14 @@ static Context context;
 
 static class PlaybackRemote : public IPlaybackRemote {
     private:
+        Snapshots snapshots;
         HttpServer httpServer;
         WebSocketServer webSocketServer;
 
     public:
         PlaybackRemote()
-        : httpServer(context)
-        , webSocketServer(context) {
+        : httpServer(context, snapshots)
+        , webSocketServer(context, snapshots) {
 #ifdef ENABLE_DEBUG
             freopen("z:\\webserver.log", "w", stderr);
 #endif
@@ -120,6 +121,10 @@ static class PlaybackRemote : public IPlaybackRemote {
             webSocketServer.OnPlayQueueChanged();
         }
 
+        void OnLibraryChanged(int64_t generation) {
+            webSocketServer.OnLibraryChanged(generation);
+        }
+
     private:
         void ThreadProc() {
             httpServer.Wait();
@@ -185,8 +190,19 @@ extern "C" DLL_EXPORT void SetPreferences(musik::core::sdk::IPreferences* prefs)
         prefs->GetBool(prefs::http_server_enabled.c_str(), true);
         prefs->GetString(key::password.c_str(), nullptr, 0, defaults::password.c_str());
         prefs->GetInt(prefs::transcoder_cache_count.c_str(), defaults::transcoder_cache_count);
+        prefs->GetInt(prefs::transcoder_cache_size_mb.c_str(), defaults::transcoder_cache_size_mb);
         prefs->GetBool(prefs::transcoder_synchronous.c_str(), defaults::transcoder_synchronous);
         prefs->GetBool(prefs::transcoder_synchronous_fallback.c_str(), defaults::transcoder_synchronous_fallback);
+        prefs->GetInt(prefs::transcoder_prefetch_count.c_str(), defaults::transcoder_prefetch_count);
+        prefs->GetInt(prefs::transcoder_prefetch_threads.c_str(), defaults::transcoder_prefetch_threads);
+        prefs->GetInt(prefs::websocket_compression_level.c_str(), defaults::websocket_compression_level);
+        prefs->GetInt(prefs::websocket_compression_threshold.c_str(), defaults::websocket_compression_threshold);
+        prefs->GetInt(prefs::websocket_server_worker_threads.c_str(), defaults::websocket_server_worker_threads);
+        prefs->GetInt(prefs::thumbnail_resize_threads.c_str(), defaults::thumbnail_resize_threads);
+        prefs->GetInt(prefs::thumbnail_cache_size_mb.c_str(), defaults::thumbnail_cache_size_mb);
+        prefs->GetInt(prefs::http_server_thread_pool_size.c_str(), defaults::http_server_thread_pool_size);
+        prefs->GetInt(prefs::http_server_connection_limit.c_str(), defaults::http_server_connection_limit);
+        prefs->GetInt(prefs::http_server_per_ip_connection_limit.c_str(), defaults::http_server_per_ip_connection_limit);
         prefs->Save();
     }
 
@@ -199,6 +215,10 @@ extern "C" DLL_EXPORT void SetMetadataProxy(musik::core::sdk::IMetadataProxy* me
     remote.CheckRunningStatus();
 }
 
+extern "C" DLL_EXPORT void SetLibraryGeneration(int64_t generation) {
+    remote.OnLibraryChanged(generation);
+}
+
 extern "C" DLL_EXPORT void SetDebug(musik::core::sdk::IDebug*  debug) {
     auto wl = context.lock.Write();
     context.debug = debug;